@@ -243,7 +243,12 @@ run_benchmark(arguments* args)
 	}
 
 	if (! args->random) {
-		gen_value(args, &data.fixed_value);
+		if (args->bintype == 'M') {
+			data.fixed_map = gen_map(args->binlen);
+		}
+		else {
+			gen_value(args, &data.fixed_value);
+		}
 	}
 	
 	if (args->latency) {
@@ -264,7 +269,12 @@ run_benchmark(arguments* args)
 	}
 	
 	if (! args->random) {
-		as_val_destroy(&data.fixed_value);
+		if (args->bintype == 'M') {
+			as_map_destroy(data.fixed_map);
+		}
+		else {
+			as_val_destroy(&data.fixed_value);
+		}
 	}
 
 	if (args->latency) {
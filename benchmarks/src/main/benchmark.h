@@ -23,6 +23,7 @@
 
 #include "aerospike/aerospike.h"
 #include "aerospike/as_password.h"
+#include "aerospike/as_map.h"
 #include "aerospike/as_record.h"
 #include "latency.h"
 
@@ -68,6 +69,7 @@ typedef struct clientdata_t {
 	
 	aerospike client;
 	as_bin_value fixed_value;
+	as_map* fixed_map;
 	
 	latency write_latency;
 	cf_atomic32 write_count;
@@ -104,6 +106,7 @@ int random_read_write(clientdata* data);
 int write_record(int key, clientdata* data);
 int read_record(int key, clientdata* data);
 int gen_value(arguments* args, as_bin_value* val);
+as_map* gen_map(int entries);
 bool is_stop_writes(aerospike* client, const char* host, int port, const char* namespace);
 
 void blog_line(const char* fmt, ...);
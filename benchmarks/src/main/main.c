@@ -20,6 +20,7 @@
  * IN THE SOFTWARE.
  ******************************************************************************/
 #include "benchmark.h"
+#include "aerospike/as_pack.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -95,11 +96,12 @@ print_usage(const char* program)
 	blog_line("   Key/record count or key/record range.");
 	blog_line("");
 	
-	blog_line("-o --objectSpec I| B:<size> | S:<size>  # Default: I");
+	blog_line("-o --objectSpec I| B:<size> | S:<size> | M:<size>  # Default: I");
 	blog_line("   Bin object specification.");
 	blog_line("   -o I     : Read/write integer bin.");
 	blog_line("   -o B:200 : Read/write byte array bin of length 200.");
 	blog_line("   -o S:50  : Read/write string bin of length 50.");
+	blog_line("   -o M:20  : Read/write map bin of 20 nested maps, each holding an int, a string and a list.");
 	blog_line("");
 	
 	blog_line("-R --random          # Default: static fixed bin values");
@@ -231,6 +233,16 @@ print_args(arguments* args)
 			blog_line("UTF8 string[%d]", args->binlen);
 			break;
 
+		case 'M': {
+			// Each write packs the map once, straight into the message.
+			as_map* map = gen_map(args->binlen);
+			uint32_t size = 0;
+			as_pack_size((as_val*)map, &size);
+			as_map_destroy(map);
+			blog_line("map[%d] of nested maps, %u bytes packed per write", args->binlen, size);
+			break;
+		}
+
 		default:
 			blog_line("");
 			break;
@@ -289,6 +301,7 @@ validate_args(arguments* args)
 			
 		case 'B':
 		case 'S':
+		case 'M':
 			if (args->binlen <= 0 || args->binlen > 1000000) {
 				blog_line("Invalid bin length: %d  Valid values: [1-1000000]", args->binlen);
 				return 1;
@@ -296,7 +309,7 @@ validate_args(arguments* args)
 			break;
 			
 		default:
-			blog_line("Invalid bin type: %c  Valid values: I|B:<size>|S:<size>", args->bintype);
+			blog_line("Invalid bin type: %c  Valid values: I|B:<size>|S:<size>|M:<size>", args->bintype);
 			return 1;
 	}
 	
@@ -411,7 +424,7 @@ set_args(int argc, char * const * argv, arguments* args)
 			case 'o': {
 				args->bintype = *optarg;
 				
-				if (args->bintype == 'B' || args->bintype == 'S') {
+				if (args->bintype == 'B' || args->bintype == 'S' || args->bintype == 'M') {
 					char *p = optarg + 1;
 					if (*p == ':') {
 						args->binlen = atoi(p+1);
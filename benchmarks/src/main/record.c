@@ -21,6 +21,9 @@
  ******************************************************************************/
 #include "benchmark.h"
 #include "aerospike/aerospike_key.h"
+#include "aerospike/as_arraylist.h"
+#include "aerospike/as_hashmap.h"
+#include "aerospike/as_stringmap.h"
 #include <citrusleaf/cf_clock.h>
 
 static const char alphanum[] =
@@ -75,6 +78,43 @@ gen_value(arguments* args, as_bin_value* val)
 	return 0;
 }
 
+static as_string*
+gen_string(int len)
+{
+	uint8_t* buf = cf_malloc(len+1);
+	cf_get_rand_buf(buf, len);
+	
+	for (int i = 0; i < len; i++) {
+		buf[i] = alphanum[buf[i] % alphanum_len];
+	}
+	buf[len] = 0;
+	return as_string_new((char*)buf, true);
+}
+
+as_map*
+gen_map(int entries)
+{
+	// Each entry is a small nested record: {i: int, s: string, l: [int, int, int]}
+	as_hashmap* map = as_hashmap_new(entries);
+	
+	for (int i = 0; i < entries; i++) {
+		as_arraylist* list = as_arraylist_new(3, 0);
+		as_arraylist_append_int64(list, cf_get_rand32());
+		as_arraylist_append_int64(list, cf_get_rand32());
+		as_arraylist_append_int64(list, cf_get_rand32());
+		
+		as_hashmap* entry = as_hashmap_new(3);
+		as_stringmap_set_int64((as_map*)entry, "i", cf_get_rand32());
+		as_stringmap_set_string((as_map*)entry, "s", gen_string(8));
+		as_stringmap_set_list((as_map*)entry, "l", (as_list*)list);
+		
+		char key[16];
+		sprintf(key, "k%d", i);
+		as_stringmap_set_map((as_map*)map, key, (as_map*)entry);
+	}
+	return (as_map*)map;
+}
+
 static as_status
 put_record(int keyval, as_record* rec, clientdata* data)
 {
@@ -164,6 +204,14 @@ write_record(int keyval, clientdata* data)
 				break;
 			}
 				
+			case 'M': {
+				// Generate nested map on heap.
+				as_record_set_map(&rec, data->bin_name, gen_map(data->binlen));
+				status = put_record(keyval, &rec, data);
+				as_record_destroy(&rec);
+				break;
+			}
+				
 			default: {
 				blog_error("Unknown type %c", data->bintype);
 				status = AEROSPIKE_ERR_CLIENT;
@@ -173,7 +221,12 @@ write_record(int keyval, clientdata* data)
 	}
 	else {
 		// Use fixed value.
-		as_record_set(&rec, data->bin_name, &data->fixed_value);
+		if (data->bintype == 'M') {
+			as_record_set_map(&rec, data->bin_name, data->fixed_map);
+		}
+		else {
+			as_record_set(&rec, data->bin_name, &data->fixed_value);
+		}
 		status = put_record(keyval, &rec, data);
 	}
 	return (int)status;
@@ -44,7 +44,7 @@
 
 /**
  *	This callback will be called with the results of aerospike_batch_get(),
- *	or aerospike_batch_exists() functions.
+ *	aerospike_batch_select() or aerospike_batch_exists() functions.
  *
  * 	The `results` argument will be an array of `n` as_batch_read entries. The
  * 	`results` argument is on the stack and is only available within the context
@@ -139,3 +139,41 @@ as_status aerospike_batch_exists(
 	const as_batch * batch, 
 	aerospike_batch_read_callback callback, void * udata
 	);
+
+/**
+ *	Look up multiple records by key, then return the specified bins.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_batch batch;
+ *	as_batch_inita(&batch, 3);
+ *	
+ *	as_key_init(as_batch_keyat(&batch,0), "ns", "set", "key1");
+ *	as_key_init(as_batch_keyat(&batch,1), "ns", "set", "key2");
+ *	as_key_init(as_batch_keyat(&batch,2), "ns", "set", "key3");
+ *	
+ *	const char * bins[] = { "bin1", "bin2", NULL };
+ *	
+ *	if ( aerospike_batch_select(&as, &err, NULL, &batch, bins, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_batch_destroy(&batch);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param batch		The batch of keys to read.
+ *	@param bins			A NULL-terminated list of bin names to read.
+ *	@param callback 	The callback to invoke for each record read.
+ *	@param udata		The user-data for the callback.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup batch_operations
+ */
+as_status aerospike_batch_select(
+	aerospike * as, as_error * err, const as_policy_batch * policy, 
+	const as_batch * batch, const char * bins[], 
+	aerospike_batch_read_callback callback, void * udata
+	);
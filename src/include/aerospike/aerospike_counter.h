@@ -0,0 +1,258 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+/**
+ *	@defgroup counter_operations Sharded Counter Operations
+ *	@ingroup client_operations
+ *
+ *	A counter updated by every request serializes on the master node of its
+ *	record's partition.  A sharded counter spreads increments over several
+ *	records, each in its own partition, and sums them on read.
+ *
+ *	Shard 0 is the record of the base key, so a counter with one shard is an
+ *	ordinary integer bin.  The other shards are addressed by digests derived
+ *	from the base key's digest.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_key key;
+ *	as_key_init(&key, "test", "counters", "requests");
+ *
+ *	as_counter counter;
+ *	as_counter_init(&counter, &key, "count", 16);
+ *
+ *	aerospike_counter_add(&as, &err, NULL, &counter, 1);
+ *
+ *	int64_t total;
+ *	aerospike_counter_get(&as, &err, NULL, &counter, &total);
+ *	~~~~~~~~~~
+ */
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_bin.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_status.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Maximum number of shards of a counter.
+ */
+#define AS_COUNTER_MAX_SHARDS 4096
+
+/**
+ *	Bin of the base record holding the shard count set by
+ *	aerospike_counter_reshard().
+ */
+#define AS_COUNTER_SHARDS_BIN "_shards"
+
+/**
+ *	Bin of the base record holding the number of shards to read.
+ */
+#define AS_COUNTER_READ_SHARDS_BIN "_read_shards"
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	How aerospike_counter_add() picks the shard to increment.
+ *
+ *	@ingroup counter_operations
+ */
+typedef enum as_counter_pick_e {
+
+	/**
+	 *	A random shard per increment.  Spreads load best.
+	 */
+	AS_COUNTER_PICK_RANDOM,
+
+	/**
+	 *	The same shard for every increment from a thread.  Avoids a thread
+	 *	contending with itself on several records.
+	 */
+	AS_COUNTER_PICK_THREAD
+
+} as_counter_pick;
+
+/**
+ *	A counter sharded over several records.
+ *
+ *	@ingroup counter_operations
+ */
+typedef struct as_counter_s {
+
+	/**
+	 *	Namespace of the shard records.
+	 */
+	as_namespace ns;
+
+	/**
+	 *	Set of the shard records.
+	 */
+	as_set set;
+
+	/**
+	 *	Digest of the base key - the digest of shard 0.
+	 */
+	as_digest_value digest;
+
+	/**
+	 *	Integer bin holding each shard's count.
+	 */
+	as_bin_name bin;
+
+	/**
+	 *	Number of shards incremented.
+	 */
+	uint32_t n_shards;
+
+	/**
+	 *	Number of shards read.  More than n_shards after the counter shrinks,
+	 *	so increments still made to the dropped shards by other clients are
+	 *	counted.
+	 */
+	uint32_t read_shards;
+
+	/**
+	 *	How shards are picked for increments.
+	 *	Default: AS_COUNTER_PICK_RANDOM
+	 */
+	as_counter_pick pick;
+
+} as_counter;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Initialize a sharded counter.  Every client of the counter must use the
+ *	same key and bin.  Use aerospike_counter_load() to pick up a shard count
+ *	stored by aerospike_counter_reshard().
+ *
+ *	@param counter		The counter to initialize.
+ *	@param key			The base key.  Its digest is computed if not yet set.
+ *	@param bin			The integer bin holding the count.
+ *	@param n_shards		Number of shards, from 1 to AS_COUNTER_MAX_SHARDS.
+ *
+ *	@return The initialized counter, or NULL if the arguments are invalid.
+ *
+ *	@ingroup counter_operations
+ */
+as_counter * as_counter_init(as_counter * counter, as_key * key, const char * bin, uint32_t n_shards);
+
+/**
+ *	Initialize the key of one of a counter's shard records.
+ *
+ *	@param counter		The counter.
+ *	@param shard		Shard index.
+ *	@param key			The key to initialize.
+ *
+ *	@return The initialized key.
+ *
+ *	@ingroup counter_operations
+ */
+as_key * as_counter_shard_key(const as_counter * counter, uint32_t shard, as_key * key);
+
+/**
+ *	Add to a sharded counter.  One shard record is incremented with
+ *	aerospike_key_operate().
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param counter		The counter.
+ *	@param value		The amount to add.  May be negative.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup counter_operations
+ */
+as_status aerospike_counter_add(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	const as_counter * counter, int64_t value
+	);
+
+/**
+ *	Read a sharded counter.  All shards are read with one aerospike_batch_get()
+ *	and summed.  Shards never incremented count as 0.  If the base record
+ *	lists more shards to read than the counter, another batch reads the rest.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param counter		The counter.
+ *	@param value		The sum of all shards.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup counter_operations
+ */
+as_status aerospike_counter_get(
+	aerospike * as, as_error * err, const as_policy_batch * policy, 
+	const as_counter * counter, int64_t * value
+	);
+
+/**
+ *	Change the number of shards of a counter.
+ *
+ *	The new count is stored in the base record, where other clients pick it
+ *	up with aerospike_counter_load().  Shrinking then moves the count of each
+ *	dropped shard into a remaining shard, subtracting it from the dropped
+ *	shard first, so no increment is lost.  All clients keep reading the
+ *	dropped shards, in case clients that have not loaded the new count still
+ *	increment them.  Once every client has loaded it, reshard to the same
+ *	count again to drain the dropped shards once more and stop reading them.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy for the increments. If NULL, then the default policy will be used.
+ *	@param counter		The counter.
+ *	@param n_shards		The new number of shards, from 1 to AS_COUNTER_MAX_SHARDS.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup counter_operations
+ */
+as_status aerospike_counter_reshard(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	as_counter * counter, uint32_t n_shards
+	);
+
+/**
+ *	Load the shard count stored in the base record by
+ *	aerospike_counter_reshard().  A counter that was never resharded keeps
+ *	its count.  May be called while other threads use the counter.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param counter		The counter.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup counter_operations
+ */
+as_status aerospike_counter_load(
+	aerospike * as, as_error * err, const as_policy_read * policy, 
+	as_counter * counter
+	);
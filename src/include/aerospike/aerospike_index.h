@@ -43,6 +43,7 @@
 #include <aerospike/aerospike.h>
 #include <aerospike/as_bin.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_job_watcher.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_status.h>
@@ -144,6 +145,32 @@ as_status aerospike_index_create(
  */
 as_status aerospike_index_create_wait(as_error * err, as_index_task * task, uint32_t interval_ms);
 
+/**
+ *	Register a listener to be called when the asynchronous task completes.
+ *	This call returns immediately. All outstanding tasks are polled together
+ *	by the client's job watcher thread, which also calls the listener.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_index_task task;
+ *	if ( aerospike_index_create(&as, &err, &task, NULL, "test", "demo", "bin1", "idx_test_demo_bin1") == AEROSPIKE_OK ) {
+ *		aerospike_index_create_listen(&err, &task, 0, index_done, NULL);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param task			The task data used to poll for completion.
+ *	@param interval_ms	The polling interval in milliseconds. If zero, 1000 ms is used.
+ *	@param listener		The function called when the task completes.
+ *	@param udata		User-data to be passed to the listener.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup index_operations
+ */
+as_status aerospike_index_create_listen(
+	as_error * err, as_index_task * task, uint32_t interval_ms,
+	as_job_listener listener, void * udata);
+
 /**
  *	Removes (drops) a secondary index.
  *
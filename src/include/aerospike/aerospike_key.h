@@ -38,6 +38,57 @@
 #include <aerospike/as_status.h>
 #include <aerospike/as_val.h>
 
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+struct cl_operate_template_s;
+
+/**
+ *	Operations laid out once by aerospike_key_operate_prepare(), for use with
+ *	aerospike_key_operate_prepared().
+ *
+ *	The op headers and bin names are encoded when the operations are
+ *	prepared, so each call only writes the key, digest and values into the
+ *	request. This pays off when the same shape of operations is applied
+ *	over and over, e.g. a fixed set of counters.
+ *
+ *	Prepared operations are read-only once prepared, and may be shared by
+ *	multiple threads.
+ *
+ *	@ingroup key_operations
+ */
+typedef struct as_operations_prepared_s {
+
+	/**
+	 *	The policy used for each call.
+	 */
+	as_policy_operate policy;
+
+	/**
+	 *	Number of operations.
+	 */
+	uint16_t n_ops;
+
+	/**
+	 *	Number of AS_OPERATOR_READ operations.
+	 */
+	uint16_t n_read_ops;
+
+	/**
+	 *	The operator of each operation, to check calls against.
+	 *	@private
+	 */
+	as_operator * operators;
+
+	/**
+	 *	Pre-encoded op headers and bin names.
+	 *	@private
+	 */
+	struct cl_operate_template_s * tmpl;
+
+} as_operations_prepared;
+
 /******************************************************************************
  *	FUNCTIONS
  *****************************************************************************/
@@ -244,6 +295,91 @@ as_status aerospike_key_operate(
 	as_record ** rec
 	);
 
+/**
+ *	Prepare a fixed set of operations for repeated use with
+ *	aerospike_key_operate_prepared(). The bin names and operators of @a ops
+ *	are encoded once; the values in @a ops are not used.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_operations ops;
+ *	as_operations_inita(&ops, 2);
+ *	as_operations_add_incr(&ops, "hits", 1);
+ *	as_operations_add_read(&ops, "hits");
+ *
+ *	as_operations_prepared prepared;
+ *	if ( aerospike_key_operate_prepare(&as, &err, NULL, &ops, &prepared) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	When no longer needed, release the prepared operations with
+ *	as_operations_prepared_destroy().
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for each call. If NULL, then the default policy will be used.
+ *	@param ops			The operations to prepare.
+ *	@param prepared		The prepared operations to initialize.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_operate_prepare(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	const as_operations * ops, as_operations_prepared * prepared
+	);
+
+/**
+ *	Lookup a record by key, then perform prepared operations.
+ *
+ *	@a ops must have the same operators, in the same order, as the operations
+ *	that were prepared. Only its values, ttl and generation are used; the bin
+ *	names are taken from the prepared operations.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_operations ops;
+ *	as_operations_inita(&ops, 2);
+ *	as_operations_add_incr(&ops, "hits", 5);
+ *	as_operations_add_read(&ops, "hits");
+ *
+ *	as_record * rec = NULL;
+ *
+ *	if ( aerospike_key_operate_prepared(&as, &err, &prepared, &key, &ops, &rec) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	else {
+ *		as_record_destroy(rec);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param prepared		The prepared operations.
+ *	@param key			The key of the record.
+ *	@param ops			The values to apply, in the shape of the prepared operations.
+ *	@param rec			The record to be populated with the data from AS_OPERATOR_READ operations.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_operate_prepared(
+	aerospike * as, as_error * err, const as_operations_prepared * prepared,
+	const as_key * key, const as_operations * ops,
+	as_record ** rec
+	);
+
+/**
+ *	Release the resources held by prepared operations.
+ *
+ *	@param prepared		The prepared operations to destroy.
+ *
+ *	@relates as_operations_prepared
+ *	@ingroup key_operations
+ */
+void as_operations_prepared_destroy(as_operations_prepared * prepared);
+
 /**
  *	Lookup a record by key, then apply the UDF.
  *
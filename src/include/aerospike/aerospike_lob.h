@@ -0,0 +1,135 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+/**
+ *	@defgroup lob_operations Large Object Operations
+ *	@ingroup client_operations
+ *
+ *	Stores bytes values too large for one record, or large enough that a
+ *	single record would hot-spot one node, as fixed-size chunk records spread
+ *	across partitions.
+ *
+ *	The record of the key itself is a small manifest: bins `lob_size`,
+ *	`lob_chunk`, `lob_n` and `lob_id`.  Chunk records are addressed by digests
+ *	derived from the key's digest and `lob_id`, and hold their part of the
+ *	value in bin `lob`.  Values no larger than one chunk are stored in bin
+ *	`lob` of the manifest instead.
+ *
+ *	A write stores the chunks under a new `lob_id`, then replaces the manifest
+ *	only if it has not changed since the write started, then removes the old
+ *	chunks.  Readers therefore see the old or the new value, never a mix.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_key key;
+ *	as_key_init(&key, "test", "blobs", "image-1");
+ *
+ *	aerospike_lob_put(&as, &err, NULL, &key, data, data_size, 0);
+ *
+ *	uint32_t size;
+ *	aerospike_lob_get(&as, &err, NULL, &key, NULL, 0, &size);
+ *
+ *	uint8_t * buf = malloc(size);
+ *	aerospike_lob_get(&as, &err, NULL, &key, buf, size, &size);
+ *	~~~~~~~~~~
+ */
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_status.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Default chunk size.  Leaves room for record overhead in the server's
+ *	default 128K write block.
+ */
+#define AS_LOB_CHUNK_SIZE (127 * 1024)
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Store a large bytes value.  Chunks are written in parallel.
+ *
+ *	The exists and gen fields of the policy are ignored - the manifest is
+ *	replaced only if unchanged since the write started.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the value.
+ *	@param value		The value.
+ *	@param size			Size of the value in bytes.
+ *	@param chunk_size	Chunk size in bytes.  0 for AS_LOB_CHUNK_SIZE.
+ *
+ *	@return AEROSPIKE_OK if successful.  AEROSPIKE_ERR_RECORD_GENERATION or
+ *	AEROSPIKE_ERR_RECORD_EXISTS if another write replaced the value first.
+ *	Otherwise an error.
+ *
+ *	@ingroup lob_operations
+ */
+as_status aerospike_lob_put(
+	aerospike * as, as_error * err, const as_policy_write * policy, 
+	const as_key * key, const uint8_t * value, uint32_t size, uint32_t chunk_size
+	);
+
+/**
+ *	Read a large bytes value into a caller buffer.  Chunks are read with one
+ *	batch read, so they are fetched from all nodes in parallel.
+ *
+ *	With a NULL buffer, only the size is read.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the value.
+ *	@param buf			Buffer for the value, or NULL.
+ *	@param capacity		Size of buf in bytes.
+ *	@param size			Size of the value in bytes.
+ *
+ *	@return AEROSPIKE_OK if successful.  AEROSPIKE_ERR_PARAM if the buffer is
+ *	too small - size is set.  Otherwise an error.
+ *
+ *	@ingroup lob_operations
+ */
+as_status aerospike_lob_get(
+	aerospike * as, as_error * err, const as_policy_read * policy, 
+	const as_key * key, uint8_t * buf, uint32_t capacity, uint32_t * size
+	);
+
+/**
+ *	Remove a large bytes value - the manifest, then the chunks.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the value.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup lob_operations
+ */
+as_status aerospike_lob_remove(
+	aerospike * as, as_error * err, const as_policy_remove * policy, 
+	const as_key * key
+	);
@@ -0,0 +1,387 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+/**
+ *	@defgroup multi_operations Multi-Cluster Operations
+ *	@ingroup client_operations
+ *
+ *	One client handle over several clusters holding the same data, e.g. one
+ *	per region kept in sync by XDR.  Each cluster is an ordinary aerospike
+ *	instance with its own configuration and tend thread.
+ *
+ *	Writes go to the primary cluster.  Reads go to the healthy cluster with
+ *	the lowest observed latency, and fail over to the next one on timeouts
+ *	and cluster errors.  Clusters failing several reads in a row are skipped
+ *	for a while.  With hedging enabled, reads are sent from hedge threads
+ *	while the caller waits.  A read not answered within
+ *	aerospike_multi.hedge_us, or failed sooner, is also sent to the next
+ *	best cluster.  The caller takes whichever answer arrives first, and the
+ *	other one is discarded.
+ *
+ *	~~~~~~~~~~{.c}
+ *	aerospike_multi multi;
+ *	aerospike_multi_init(&multi);
+ *	multi.hedge_us = 5000;
+ *
+ *	aerospike_multi_add(&multi, &err, &config_east, true);
+ *	aerospike_multi_add(&multi, &err, &config_west, false);
+ *
+ *	if ( aerospike_multi_connect(&multi, &err) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_record * rec = NULL;
+ *	aerospike_multi_get(&multi, &err, NULL, &key, &rec);
+ *
+ *	aerospike_multi_close(&multi, &err);
+ *	aerospike_multi_destroy(&multi);
+ *	~~~~~~~~~~
+ */
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_config.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_operations.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include <citrusleaf/cf_queue.h>
+
+#include <pthread.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Maximum clusters of a multi-cluster client.
+ */
+#define AS_MULTI_MAX_CLUSTERS 4
+
+/**
+ *	Threads sending hedged reads.  Each hedged read holds two until it is
+ *	answered, and reads beyond that are sent by the caller without a hedge.
+ */
+#define AS_MULTI_HEDGE_THREADS 8
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	A cluster of a multi-cluster client.
+ *
+ *	@ingroup multi_operations
+ */
+typedef struct as_multi_cluster_s {
+
+	/**
+	 *	The cluster's client instance.
+	 */
+	aerospike as;
+
+	/**
+	 *	Whether the cluster was connected.
+	 */
+	bool connected;
+
+	/**
+	 *	Read latency in microseconds, a moving average.  0 until measured.
+	 */
+	uint64_t latency_us;
+
+	/**
+	 *	@private
+	 *	Consecutive failed reads.
+	 */
+	uint32_t failures;
+
+	/**
+	 *	@private
+	 *	Time in milliseconds until which reads skip the cluster.
+	 */
+	uint64_t down_until_ms;
+
+} as_multi_cluster;
+
+/**
+ *	A client over several clusters holding the same data.
+ *
+ *	Settings may be changed between aerospike_multi_init() and
+ *	aerospike_multi_connect().
+ *
+ *	@ingroup multi_operations
+ */
+typedef struct aerospike_multi_s {
+
+	/**
+	 *	The clusters.
+	 */
+	as_multi_cluster clusters[AS_MULTI_MAX_CLUSTERS];
+
+	/**
+	 *	Number of clusters.
+	 */
+	uint32_t n_clusters;
+
+	/**
+	 *	Index of the cluster receiving writes.
+	 */
+	uint32_t primary;
+
+	/**
+	 *	Microseconds to wait for a read before sending it to a second
+	 *	cluster.  0, the default, disables hedging.
+	 */
+	uint32_t hedge_us;
+
+	/**
+	 *	One in this many reads goes to the second best cluster, so its
+	 *	latency stays current.  0 disables probing.  Default 100.
+	 */
+	uint32_t probe_interval;
+
+	/**
+	 *	Consecutive failed reads after which a cluster is skipped.  Default 3.
+	 */
+	uint32_t max_failures;
+
+	/**
+	 *	Milliseconds a failing cluster is skipped for.  Default 5000.
+	 */
+	uint32_t down_ms;
+
+	/**
+	 *	Hedges sent.  Statistic.
+	 */
+	uint64_t hedges_sent;
+
+	/**
+	 *	Reads answered by their hedge before the first attempt.  Statistic.
+	 */
+	uint64_t hedge_wins;
+
+	/**
+	 *	@private
+	 *	Reads routed, for probing.
+	 */
+	uint32_t n_reads;
+
+	/**
+	 *	@private
+	 *	Hedges waiting for a thread.
+	 */
+	cf_queue * hedge_q;
+
+	/**
+	 *	@private
+	 */
+	pthread_t hedge_threads[AS_MULTI_HEDGE_THREADS];
+
+	/**
+	 *	@private
+	 *	Hedge threads started.
+	 */
+	uint32_t n_hedge_threads;
+
+	/**
+	 *	@private
+	 *	Hedge threads taken by queued or running reads.
+	 */
+	uint32_t n_hedges;
+
+} aerospike_multi;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Initialize a multi-cluster client with no clusters.
+ *
+ *	@param multi		The client.
+ *
+ *	@return The initialized client.
+ *
+ *	@ingroup multi_operations
+ */
+aerospike_multi * aerospike_multi_init(aerospike_multi * multi);
+
+/**
+ *	Add a cluster.  The first cluster added is the primary unless a later
+ *	one is added as primary.
+ *
+ *	@param multi		The client.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param config		The cluster's configuration, copied.
+ *	@param primary		Whether writes go to this cluster.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@ingroup multi_operations
+ */
+as_status aerospike_multi_add(
+	aerospike_multi * multi, as_error * err, as_config * config, bool primary
+	);
+
+/**
+ *	Connect to the clusters.  Fails if the primary cluster cannot be
+ *	connected.  Other clusters that cannot be connected are left out of
+ *	reads.
+ *
+ *	@param multi		The client.
+ *	@param err			The as_error to be populated if an error occurs.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@ingroup multi_operations
+ */
+as_status aerospike_multi_connect(aerospike_multi * multi, as_error * err);
+
+/**
+ *	Close the connections to the clusters.  No operations may be running.
+ *
+ *	@param multi		The client.
+ *	@param err			The as_error to be populated if an error occurs.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@ingroup multi_operations
+ */
+as_status aerospike_multi_close(aerospike_multi * multi, as_error * err);
+
+/**
+ *	Destroy a multi-cluster client.
+ *
+ *	@param multi		The client.
+ *
+ *	@ingroup multi_operations
+ */
+void aerospike_multi_destroy(aerospike_multi * multi);
+
+/**
+ *	The primary cluster's client instance, for operations without a
+ *	multi-cluster version.
+ *
+ *	@param multi		The client.
+ *
+ *	@return The primary cluster's aerospike instance.
+ *
+ *	@ingroup multi_operations
+ */
+aerospike * aerospike_multi_primary(aerospike_multi * multi);
+
+/**
+ *	Read a record from the best cluster.  See aerospike_key_get().
+ *
+ *	Reads are hedged only if `*rec` is NULL, so that the hedge can
+ *	allocate the record.
+ *
+ *	@param multi		The client.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then each cluster's default policy will be used.
+ *	@param key			The key of the record.
+ *	@param rec 			The record to be populated with the data from request.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup multi_operations
+ */
+as_status aerospike_multi_get(
+	aerospike_multi * multi, as_error * err, const as_policy_read * policy, 
+	const as_key * key, 
+	as_record ** rec
+	);
+
+/**
+ *	Read bins of a record from the best cluster.  See aerospike_key_select().
+ *
+ *	@param multi		The client.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then each cluster's default policy will be used.
+ *	@param key			The key of the record.
+ *	@param bins			The bins to select. A NULL terminated array of NULL terminated strings.
+ *	@param rec 			The record to be populated with the data from request.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup multi_operations
+ */
+as_status aerospike_multi_select(
+	aerospike_multi * multi, as_error * err, const as_policy_read * policy, 
+	const as_key * key, const char * bins[], 
+	as_record ** rec
+	);
+
+/**
+ *	Store a record in the primary cluster.  See aerospike_key_put().
+ *
+ *	@param multi		The client.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param rec 			The record containing the data to be written.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup multi_operations
+ */
+as_status aerospike_multi_put(
+	aerospike_multi * multi, as_error * err, const as_policy_write * policy, 
+	const as_key * key, as_record * rec
+	);
+
+/**
+ *	Remove a record from the primary cluster.  See aerospike_key_remove().
+ *
+ *	@param multi		The client.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup multi_operations
+ */
+as_status aerospike_multi_remove(
+	aerospike_multi * multi, as_error * err, const as_policy_remove * policy, 
+	const as_key * key
+	);
+
+/**
+ *	Apply operations to a record in the primary cluster.  See
+ *	aerospike_key_operate().
+ *
+ *	@param multi		The client.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param ops			The operations to perform on the record.
+ *	@param rec			The record to be populated with the data from AS_OPERATOR_READ operations.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup multi_operations
+ */
+as_status aerospike_multi_operate(
+	aerospike_multi * multi, as_error * err, const as_policy_operate * policy, 
+	const as_key * key, const as_operations * ops,
+	as_record ** rec
+	);
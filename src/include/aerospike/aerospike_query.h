@@ -87,12 +87,29 @@
  */
 
 #include <aerospike/aerospike.h>
+#include <aerospike/as_batch.h>
+#include <aerospike/as_bin.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_query.h>
+#include <aerospike/as_record.h>
 #include <aerospike/as_status.h>
 #include <aerospike/as_stream.h>
 
+#include <string.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Default number of keys per node looked up together by aerospike_query_join().
+ *
+ *	@ingroup query_operations
+ */
+#define AS_QUERY_JOIN_BATCH_SIZE_DEFAULT 100
+
 /******************************************************************************
  *	TYPES
  *****************************************************************************/
@@ -118,6 +135,107 @@
  */
 typedef bool (* aerospike_query_foreach_callback)(const as_val * val, void * udata);
 
+/**
+ *	This callback extracts the key of the record to look up for a query
+ *	result, when the key is not simply the value of a bin.
+ *
+ *	~~~~~~~~~~{.c}
+ *	bool my_key_callback(const as_record * rec, as_key * key, void * udata) {
+ *		char * name = as_record_get_str(rec, "owner");
+ *		return name && as_key_init_str(key, "test", "users", name) != NULL;
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	The key may reference memory of `rec`.  It must be in the namespace of
+ *	as_query_join.
+ *
+ *	@param rec 			The query result.
+ *	@param key 			The key to initialize.
+ *	@param udata 		as_query_join.key_udata.
+ *
+ *	@return `true` to look up the key. `false` to skip the query result.
+ *
+ *	@ingroup query_operations
+ */
+typedef bool (* aerospike_query_join_key_callback)(const as_record * rec, as_key * key, void * udata);
+
+/**
+ *	This callback will be called for each query result with the record it
+ *	joins to, as looked up by aerospike_query_join().
+ *
+ *	Like aerospike_query_foreach() callbacks, it may be called concurrently
+ *	from multiple threads.  Both records are only available within the
+ *	context of the callback.
+ *
+ *	~~~~~~~~~~{.c}
+ *	bool my_join_callback(const as_record * rec, const as_batch_read * joined, void * udata) {
+ *		if ( joined->result == AEROSPIKE_OK ) {
+ *			// use rec and joined->record
+ *		}
+ *		return true;
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param rec 			The query result.
+ *	@param joined 		The looked up record. `joined->result` is
+ *						AEROSPIKE_ERR_RECORD_NOT_FOUND if it does not exist.
+ *	@param udata 		User-data provided to aerospike_query_join().
+ *
+ *	@return `true` to continue. Otherwise, the join will end.
+ *
+ *	@ingroup query_operations
+ */
+typedef bool (* aerospike_query_join_callback)(const as_record * rec, const as_batch_read * joined, void * udata);
+
+/**
+ *	Describes how aerospike_query_join() finds the record a query result
+ *	joins to.
+ *
+ *	@ingroup query_operations
+ */
+typedef struct as_query_join_s {
+
+	/**
+	 *	Namespace of the looked up records.
+	 */
+	as_namespace ns;
+
+	/**
+	 *	Set of the looked up records, used with bin values to compute digests.
+	 */
+	as_set set;
+
+	/**
+	 *	Bin of the query result holding the key of the record to look up.
+	 *	Integer, string and bytes values are used as the user key.
+	 *	Ignored if key_callback is set.
+	 */
+	as_bin_name bin;
+
+	/**
+	 *	If true, the bin holds the 20 byte digest of the record to look up,
+	 *	rather than its user key.
+	 */
+	bool digest;
+
+	/**
+	 *	Extracts the key to look up instead of bin.
+	 */
+	aerospike_query_join_key_callback key_callback;
+
+	/**
+	 *	User-data passed to key_callback.
+	 */
+	void * key_udata;
+
+	/**
+	 *	Number of keys mapping to the same node that are looked up together.
+	 *	Bounds the query results held while waiting for their lookup.
+	 */
+	uint32_t batch_size;
+
+} as_query_join;
+
 /******************************************************************************
  *	FUNCTIONS
  *****************************************************************************/
@@ -154,3 +272,75 @@ as_status aerospike_query_foreach(
 	const as_query * query, 
 	aerospike_query_foreach_callback callback, void * udata
 	);
+
+/**
+ *	Initialize a join of query results to the records named by a bin.
+ *
+ *	@param join			The join to initialize.
+ *	@param ns			Namespace of the looked up records.
+ *	@param set			Set of the looked up records.
+ *	@param bin			Bin of the query result holding the key of the record to look up.
+ *
+ *	@return The initialized join.
+ *
+ *	@ingroup query_operations
+ */
+static inline as_query_join * as_query_join_init(as_query_join * join, const as_namespace ns, const as_set set, const as_bin_name bin)
+{
+	strncpy(join->ns, ns, AS_NAMESPACE_MAX_SIZE);
+	join->ns[AS_NAMESPACE_MAX_SIZE - 1] = '\0';
+	strncpy(join->set, set ? set : "", AS_SET_MAX_SIZE);
+	join->set[AS_SET_MAX_SIZE - 1] = '\0';
+	strncpy(join->bin, bin ? bin : "", AS_BIN_NAME_MAX_SIZE);
+	join->bin[AS_BIN_NAME_MAX_SIZE - 1] = '\0';
+	join->digest = false;
+	join->key_callback = NULL;
+	join->key_udata = NULL;
+	join->batch_size = AS_QUERY_JOIN_BATCH_SIZE_DEFAULT;
+	return join;
+}
+
+/**
+ *	Execute a query and look up the record each result refers to, calling
+ *	the callback with each joined pair.
+ *
+ *	Keys are gathered per node and looked up in batches of
+ *	as_query_join.batch_size while the query is still running, so lookups
+ *	overlap the query and only a bounded number of results are held.
+ *	Remaining keys are looked up when the query completes.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_query query;
+ *	as_query_init(&query, "test", "orders");
+ *	as_query_where_init(&query, 1);
+ *	as_query_where(&query, "day", integer_equals(20140501));
+ *
+ *	as_query_join join;
+ *	as_query_join_init(&join, "test", "users", "user_id");
+ *
+ *	if ( aerospike_query_join(&as, &err, NULL, NULL, &query, &join, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	
+ *	as_query_destroy(&query);
+ *	~~~~~~~~~~
+ *
+ *	@param as				The aerospike instance to use for this operation.
+ *	@param err				The as_error to be populated if an error occurs.
+ *	@param policy			The policy to use for the query. If NULL, then the default policy will be used.
+ *	@param batch_policy		The policy to use for the lookups. If NULL, then the default policy will be used.
+ *	@param query			The query to execute against the cluster. Aggregations are not supported.
+ *	@param join				Describes the records to look up.
+ *	@param callback			The callback function to call for each joined pair.
+ *	@param udata			User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success, otherwise an error.
+ *
+ *	@ingroup query_operations
+ */
+as_status aerospike_query_join(
+	aerospike * as, as_error * err, const as_policy_query * policy, 
+	const as_policy_batch * batch_policy, const as_query * query, 
+	const as_query_join * join, 
+	aerospike_query_join_callback callback, void * udata
+	);
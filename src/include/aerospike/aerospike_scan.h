@@ -93,7 +93,9 @@
  */
 
 #include <aerospike/aerospike.h>
+#include <aerospike/as_columns.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_job_watcher.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_scan.h>
 #include <aerospike/as_status.h>
@@ -191,6 +193,27 @@ as_status aerospike_scan_wait(
 	uint64_t scan_id, uint32_t interval_ms
 	);
 
+/**
+ *	Register a listener to be called when a background scan is completed by
+ *	servers. This call returns immediately. All outstanding jobs are polled
+ *	together by the client's job watcher thread, which also calls the listener.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param scan_id		The id for the scan job.
+ *	@param interval_ms	The polling interval in milliseconds. If zero, 1000 ms is used.
+ *	@param listener		The function called when the scan completes.
+ *	@param udata		User-data to be passed to the listener.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ */
+as_status aerospike_scan_listen(
+	aerospike * as, as_error * err, const as_policy_info * policy,
+	uint64_t scan_id, uint32_t interval_ms,
+	as_job_listener listener, void * udata
+	);
+
 /**
  *	Check the progress of a background scan running on the database. The status
  *	of the scan running on the datatabse will be populated into an as_scan_info.
@@ -257,3 +280,56 @@ as_status aerospike_scan_foreach(
 	const as_scan * scan, 
 	aerospike_scan_foreach_callback callback, void * udata
 	);
+
+/**
+ *	Scan the records in the specified namespace and set in the cluster,
+ *	decoding the declared bins of each record straight from the wire into
+ *	column batches, rather than building an as_record per record.
+ *
+ *	Only the declared bins are read - the scan's select list is ignored.
+ *	Each node worker fills its own batches, and hands each to the callback
+ *	when it holds batch_rows rows, or when the node's scan ends.
+ *
+ *	~~~~~~~~~~{.c}
+ *	bool callback(as_columns * columns, const char * node, void * udata) {
+ *		if ( columns ) {
+ *			as_column * age = &columns->columns[0];
+ *			for ( uint32_t i = 0; i < columns->n_rows; i++ ) {
+ *				if ( as_column_isvalid(age, i) ) {
+ *					sum += age->values[i];
+ *				}
+ *			}
+ *			as_columns_destroy(columns);
+ *		}
+ *		return true;
+ *	}
+ *
+ *	as_column_def defs[] = {
+ *		{ "age", AS_COLUMN_INT64 },
+ *		{ "name", AS_COLUMN_STRING }
+ *	};
+ *
+ *	if ( aerospike_scan_columns(&as, &err, NULL, &scan, defs, 2, 4096, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param scan			The scan to execute against the cluster.
+ *	@param defs			The columns.
+ *	@param n_defs		Number of columns.
+ *	@param batch_rows	Maximum rows per batch.
+ *	@param callback		The function to be called with each batch.
+ *	@param udata		User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@ingroup scan_operations
+ */
+as_status aerospike_scan_columns(
+	aerospike * as, as_error * err, const as_policy_scan * policy, 
+	const as_scan * scan, const as_column_def * defs, uint16_t n_defs, uint32_t batch_rows,
+	as_columns_callback callback, void * udata
+	);
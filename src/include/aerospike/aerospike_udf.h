@@ -32,6 +32,7 @@
 
 #include <aerospike/aerospike.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_job_watcher.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_status.h>
 #include <aerospike/as_udf.h>
@@ -173,6 +174,28 @@ as_status aerospike_udf_put_wait(
 	aerospike * as, as_error * err, const as_policy_info * policy,
 	const char * filename, uint32_t interval_ms);
 
+/**
+ *	Register a listener to be called when an asynchronous udf put completes.
+ *	This call returns immediately. All outstanding jobs are polled together
+ *	by the client's job watcher thread, which also calls the listener.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param filename		The name of the UDF file.
+ *	@param interval_ms	The polling interval in milliseconds. If zero, 1000 ms is used.
+ *	@param listener		The function called when the UDF is registered on all nodes.
+ *	@param udata		User-data to be passed to the listener.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error occurred.
+ *
+ *	@ingroup udf_operations
+ */
+as_status aerospike_udf_put_listen(
+	aerospike * as, as_error * err, const as_policy_info * policy,
+	const char * filename, uint32_t interval_ms,
+	as_job_listener listener, void * udata);
+
 /**
  *	Remove a UDF file from the cluster.
  *
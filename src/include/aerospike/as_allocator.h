@@ -0,0 +1,176 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Client subsystem on whose behalf memory is allocated.  Used to tag
+ *	allocations passed to a custom allocator and to keep memory statistics.
+ *
+ *	@ingroup as_allocator_object
+ */
+typedef enum as_alloc_tag_e {
+	/**
+	 *	Single record command buffers and requests built by the shared
+	 *	command compiler.
+	 */
+	AS_ALLOC_TAG_WIRE,
+	
+	/**
+	 *	Conversion between the aerospike API and the wire layer.
+	 */
+	AS_ALLOC_TAG_SHIM,
+	
+	/**
+	 *	Batch commands.
+	 */
+	AS_ALLOC_TAG_BATCH,
+	
+	/**
+	 *	Scan commands.
+	 */
+	AS_ALLOC_TAG_SCAN,
+	
+	/**
+	 *	Query commands.
+	 */
+	AS_ALLOC_TAG_QUERY,
+	
+	/**
+	 *	Cluster tending: nodes, node arrays and partition tables.
+	 */
+	AS_ALLOC_TAG_CLUSTER,
+	
+	/**
+	 *	Number of tags.  Not a valid tag.
+	 */
+	AS_ALLOC_TAG_MAX
+} as_alloc_tag;
+
+/**
+ *	Allocator used for memory the client allocates and frees internally.
+ *
+ *	Memory handed to the application (records, values, bins) is always
+ *	allocated with malloc() because the application frees it.
+ *
+ *	Both functions must be set for the allocator to be used.  Otherwise
+ *	malloc() and free() are used.
+ *
+ *	@ingroup as_allocator_object
+ */
+typedef struct as_allocator_s {
+	/**
+	 *	Allocate size bytes.  Return NULL on failure.
+	 */
+	void* (*alloc_fn)(size_t size, as_alloc_tag tag, void* udata);
+	
+	/**
+	 *	Free memory returned by alloc_fn.
+	 */
+	void (*free_fn)(void* ptr, as_alloc_tag tag, void* udata);
+	
+	/**
+	 *	User-data passed to alloc_fn and free_fn.
+	 */
+	void* udata;
+} as_allocator;
+
+/**
+ *	Memory statistics for one subsystem.
+ *
+ *	@ingroup as_allocator_object
+ */
+typedef struct as_alloc_stats_s {
+	/**
+	 *	Number of allocations.
+	 */
+	uint64_t allocs;
+	
+	/**
+	 *	Number of frees.
+	 */
+	uint64_t frees;
+	
+	/**
+	 *	Total bytes allocated.  Divide deltas by elapsed time for allocation rate.
+	 */
+	uint64_t bytes;
+	
+	/**
+	 *	Bytes currently allocated.
+	 */
+	uint64_t live_bytes;
+} as_alloc_stats;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Install allocator and enable statistics for the process.  The first custom
+ *	allocator installed wins.  Statistics stay enabled once enabled.
+ */
+void
+as_allocator_configure(const as_allocator* allocator, bool stats_enabled);
+
+/**
+ *	@private
+ *	Allocate memory on behalf of a subsystem.  Free with as_alloc_free().
+ */
+void*
+as_alloc_malloc(as_alloc_tag tag, size_t size);
+
+/**
+ *	@private
+ *	Free memory allocated with as_alloc_malloc().  NULL is ignored.
+ */
+void
+as_alloc_free(void* ptr);
+
+/**
+ *	Get memory statistics for a subsystem.  Statistics are zero unless
+ *	enabled by as_config.alloc.stats_enabled.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_alloc_stats stats;
+ *	as_alloc_stats_get(AS_ALLOC_TAG_BATCH, &stats);
+ *	printf("%s: %"PRIu64" bytes live\n", as_alloc_tag_name(AS_ALLOC_TAG_BATCH), stats.live_bytes);
+ *	~~~~~~~~~~
+ *
+ *	@param tag		Subsystem.
+ *	@param stats	Statistics to populate.
+ *
+ *	@ingroup as_allocator_object
+ */
+void
+as_alloc_stats_get(as_alloc_tag tag, as_alloc_stats* stats);
+
+/**
+ *	Get subsystem name for display.
+ *
+ *	@ingroup as_allocator_object
+ */
+const char*
+as_alloc_tag_name(as_alloc_tag tag);
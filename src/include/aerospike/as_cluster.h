@@ -16,7 +16,9 @@
  */
 #pragma once
 
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_config.h>
+#include <aerospike/as_key.h>
 #include <aerospike/as_node.h>
 #include <aerospike/as_partition.h>
 #include <aerospike/as_policy.h>
@@ -31,6 +33,7 @@
 #define AS_NUM_BATCH_THREADS 6
 #define AS_NUM_SCAN_THREADS	5
 #define AS_NUM_QUERY_THREADS 5
+#define AS_NUM_LOB_THREADS 7
 
 /******************************************************************************
  *	TYPES
@@ -115,6 +118,13 @@ typedef struct as_cluster_s {
 	 */
 	as_partition_tables* partition_tables;
 	
+	/**
+	 *	@private
+	 *	Partition map generation. Changes whenever partition_tables is
+	 *	replaced, invalidating routing hints cached in keys.
+	 */
+	uint32_t partition_generation;
+	
 	/**
 	 *	@private
 	 *	Batch process queue.
@@ -133,6 +143,12 @@ typedef struct as_cluster_s {
 	 */
 	cf_queue* query_q;
 	
+	/**
+	 *	@private
+	 *	Large object chunk queue.
+	 */
+	cf_queue* lob_q;
+	
 	/**
 	 *	@private
 	 *	Nodes to be garbage collected.
@@ -145,6 +161,30 @@ typedef struct as_cluster_s {
 	 */
 	struct as_shm_info_s* shm_info;
 	
+	/**
+	 *	@private
+	 *	Background job status tracker. Created on first job wait.
+	 */
+	struct as_job_watcher_s* job_watcher;
+	
+	/**
+	 *	@private
+	 *	Set when the job watcher was shut down, so no new one is created.
+	 */
+	bool job_watcher_closed;
+	
+	/**
+	 *	@private
+	 *	Hot key sampler.  NULL unless enabled in config.
+	 */
+	struct as_hotkeys_s* hotkeys;
+	
+	/**
+	 *	@private
+	 *	Slow operation sampler.  NULL unless enabled in config.
+	 */
+	struct as_slowops_s* slowops;
+	
 	/**
 	 *	@private
 	 *	User name in UTF-8 encoded bytes.
@@ -213,6 +253,18 @@ typedef struct as_cluster_s {
 	 */
 	uint32_t conn_queue_size;
 	
+	/**
+	 *	@private
+	 *	Number of pools node's synchronous connection pool is split into.
+	 */
+	uint32_t conn_pools_per_node;
+	
+	/**
+	 *	@private
+	 *	Socket options for node connections, resolved from the profile.
+	 */
+	as_config_socket socket;
+	
 	/**
 	 *	@private
 	 *	Initial connection timeout in milliseconds.
@@ -249,6 +301,12 @@ typedef struct as_cluster_s {
 	 */
 	uint32_t query_initialized;
 	
+	/**
+	 *	@private
+	 *	Large object initialize indicator.
+	 */
+	uint32_t lob_initialized;
+	
 	/**
 	 *	@private
 	 *	Total number of data partitions used by cluster.
@@ -290,6 +348,12 @@ typedef struct as_cluster_s {
 	 *	Query process threads.
 	 */
 	pthread_t query_threads[AS_NUM_QUERY_THREADS];
+	
+	/**
+	 *	@private
+	 *	Large object chunk threads.
+	 */
+	pthread_t lob_threads[AS_NUM_LOB_THREADS];
 } as_cluster;
 
 /******************************************************************************
@@ -344,7 +408,7 @@ as_nodes_release(as_nodes* nodes)
 	ck_pr_dec_32_zero(&nodes->ref_count, &destroy);
 	
 	if (destroy) {
-		cf_free(nodes);
+		as_alloc_free(nodes);
 	}
 }
 
@@ -395,7 +459,7 @@ as_partition_tables_release(as_partition_tables* tables)
 	ck_pr_dec_32_zero(&tables->ref_count, &destroy);
 	
 	if (destroy) {
-		cf_free(tables);
+		as_alloc_free(tables);
 	}
 }
 
@@ -425,6 +489,38 @@ as_cluster_get_partition_table(as_cluster* cluster, const char* ns)
 as_node*
 as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, const cf_digest* d, bool write, as_policy_replica replica);
 
+/**
+ *	@private
+ *	Get mapped node given partition.  If there is no mapped node, a random node is used instead.
+ *	as_nodes_release() must be called when done with node.
+ */
+as_node*
+as_partition_get_node(as_cluster* cluster, as_partition* p, bool write, as_policy_replica replica);
+
+/**
+ *	@private
+ *	Get active master and prole nodes given digest key and partition table.  Unmapped or
+ *	inactive owners are returned as NULL.
+ *	as_node_release() must be called on each node returned.
+ */
+void
+as_partition_table_get_owners(as_cluster* cluster, as_partition_table* table, const cf_digest* d, as_node** master, as_node** prole);
+
+/**
+ *	@private
+ *	Get mapped node given digest key, using and refreshing the routing hints cached in a key.
+ *	as_nodes_release() must be called when done with node.
+ */
+as_node*
+as_partition_route_get_node(as_cluster* cluster, as_key_route* route, const char* ns, const cf_digest* d, bool write, as_policy_replica replica);
+
+/**
+ *	@private
+ *	Next partition map generation, unique across clusters.
+ */
+uint32_t
+as_partition_generation_next(void);
+
 /**
  *	@private
  *	Get shared memory mapped node given digest key.  If there is no mapped node, a random node is used instead.
@@ -449,3 +545,18 @@ as_node_get(as_cluster* cluster, const char* ns, const cf_digest* d, bool write,
 		return as_partition_table_get_node(cluster, table, d, write, replica);
 	}
 }
+
+/**
+ *	@private
+ *	Get mapped node given digest key and the routing hints cached in the key, if any.
+ *	If there is no mapped node, a random node is used instead.
+ *	as_nodes_release() must be called when done with node.
+ */
+static inline as_node*
+as_node_get_routed(as_cluster* cluster, as_key_route* route, const char* ns, const cf_digest* d, bool write, as_policy_replica replica)
+{
+	if (! route || cluster->shm_info) {
+		return as_node_get(cluster, ns, d, write, replica);
+	}
+	return as_partition_route_get_node(cluster, route, ns, d, write, replica);
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_bin.h>
+#include <aerospike/as_status.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Type of a column.
+ *
+ *	@ingroup scan_operations
+ */
+typedef enum as_column_type_e {
+
+	/**
+	 *	Integer bins, in as_column.values.
+	 */
+	AS_COLUMN_INT64,
+
+	/**
+	 *	String bins, in as_column.offsets and as_column.data.
+	 */
+	AS_COLUMN_STRING,
+
+	/**
+	 *	Bins of any type but integer, as their raw particle bytes.  Lists and
+	 *	maps are msgpack.
+	 */
+	AS_COLUMN_BYTES
+
+} as_column_type;
+
+/**
+ *	Declares a column - the bin to read and the type it is read as.
+ *
+ *	@ingroup scan_operations
+ */
+typedef struct as_column_def_s {
+
+	/**
+	 *	Bin name.
+	 */
+	as_bin_name name;
+
+	/**
+	 *	Column type.  A bin of another type is null in this column.
+	 */
+	as_column_type type;
+
+} as_column_def;
+
+/**
+ *	A column of a batch of rows.
+ *
+ *	Row i holds a value if bit (i % 8) of valid[i / 8] is set - see
+ *	as_column_isvalid().  Rows without a value, because the record lacks the
+ *	bin or holds another type, are null.
+ *
+ *	String and bytes values of row i are data[offsets[i]] to
+ *	data[offsets[i + 1]], with no terminator.  Null rows have empty values,
+ *	and null integers are 0.
+ *
+ *	@ingroup scan_operations
+ */
+typedef struct as_column_s {
+
+	/**
+	 *	Bin name.
+	 */
+	as_bin_name name;
+
+	/**
+	 *	Column type.
+	 */
+	as_column_type type;
+
+	/**
+	 *	Validity bitmap, one bit per row.
+	 */
+	uint8_t * valid;
+
+	/**
+	 *	Values of an AS_COLUMN_INT64 column, one per row.
+	 */
+	int64_t * values;
+
+	/**
+	 *	Offsets into data of a string or bytes column, one per row plus one.
+	 */
+	uint32_t * offsets;
+
+	/**
+	 *	Values of a string or bytes column.
+	 */
+	uint8_t * data;
+
+	/**
+	 *	Size of data.
+	 */
+	uint32_t data_size;
+
+	/**
+	 *	@private
+	 *	Allocated size of data.
+	 */
+	uint32_t data_capacity;
+
+	/**
+	 *	@private
+	 *	Length of name.
+	 */
+	uint8_t name_sz;
+
+} as_column;
+
+/**
+ *	A batch of rows decoded into columns, one column per as_column_def.
+ *
+ *	@ingroup scan_operations
+ */
+typedef struct as_columns_s {
+
+	/**
+	 *	Number of rows.
+	 */
+	uint32_t n_rows;
+
+	/**
+	 *	Maximum number of rows.
+	 */
+	uint32_t capacity;
+
+	/**
+	 *	Number of columns.
+	 */
+	uint16_t n_columns;
+
+	/**
+	 *	The columns.
+	 */
+	as_column columns[];
+
+} as_columns;
+
+/**
+ *	Receives batches of rows.  The callback owns the batch and must release
+ *	it with as_columns_destroy(), which it may do on any thread.
+ *
+ *	The callback is called concurrently by the node workers of a concurrent
+ *	scan.  Rows of a batch all come from one node.
+ *
+ *	@param columns		The batch, or NULL once all batches were received.
+ *	@param node			Name of the node the rows came from, or NULL.
+ *	@param udata		User-data.
+ *
+ *	@return true to continue receiving batches, false to abort the scan.
+ *
+ *	@ingroup scan_operations
+ */
+typedef bool (* as_columns_callback)(as_columns * columns, const char * node, void * udata);
+
+/**
+ *	@private
+ *	Decodes the rows a node worker reads into a batch, handing the batch over
+ *	when full.
+ */
+typedef struct as_columns_builder_s {
+
+	const as_column_def * defs;
+
+	uint16_t n_defs;
+
+	uint32_t batch_rows;
+
+	as_columns_callback callback;
+
+	void * udata;
+
+	const char * node;
+
+	// Batch being filled, NULL if one could not be allocated.
+	as_columns * batch;
+
+	// Column after the last one matched - bins usually arrive in select order.
+	uint16_t next;
+
+	// Set when any builder of the scan aborts it.
+	uint32_t * abort;
+
+	as_status result;
+
+} as_columns_builder;
+
+/******************************************************************************
+ *	INLINE FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Whether a row of a column holds a value.
+ *
+ *	@relates as_column
+ */
+static inline bool
+as_column_isvalid(const as_column * column, uint32_t row)
+{
+	return column->valid[row >> 3] & (1 << (row & 7));
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Create an empty batch of columns.
+ *
+ *	@param defs			The columns.
+ *	@param n_defs		Number of columns.
+ *	@param capacity		Maximum number of rows.
+ *
+ *	@return The batch, or NULL if it could not be allocated.
+ *
+ *	@relates as_columns
+ */
+as_columns *
+as_columns_create(const as_column_def * defs, uint16_t n_defs, uint32_t capacity);
+
+/**
+ *	Destroy a batch of columns.
+ *
+ *	@relates as_columns
+ */
+void
+as_columns_destroy(as_columns * columns);
+
+/**
+ *	@private
+ *	Initialize a builder.
+ */
+void
+as_columns_builder_init(as_columns_builder * builder, const as_column_def * defs, uint16_t n_defs,
+	uint32_t batch_rows, as_columns_callback callback, void * udata, const char * node, uint32_t * abort);
+
+/**
+ *	@private
+ *	Add a bin read from the wire to the current row.
+ */
+void
+as_columns_builder_bin(as_columns_builder * builder, const uint8_t * name, uint8_t name_sz,
+	uint8_t particle_type, const uint8_t * value, uint32_t size);
+
+/**
+ *	@private
+ *	Finish the current row.
+ *
+ *	@return 0 to continue the scan, non-zero to abort it.
+ */
+int
+as_columns_builder_row(as_columns_builder * builder);
+
+/**
+ *	@private
+ *	Hand over the remaining rows, and destroy the builder.
+ */
+void
+as_columns_builder_destroy(as_columns_builder * builder);
@@ -16,6 +16,7 @@
  */
 #pragma once 
 
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_error.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_password.h>
@@ -133,6 +134,177 @@ typedef struct as_config_lua_s {
 
 } as_config_lua;
 
+/**
+ *	Memory allocation config
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_alloc_s {
+
+	/**
+	 *	Allocator for buffers the client allocates and frees internally.
+	 *	Process wide: the first custom allocator installed by
+	 *	aerospike_connect() is used by all clients.
+	 *	Default: malloc() and free()
+	 */
+	as_allocator allocator;
+
+	/**
+	 *	Count allocations and live bytes per subsystem.
+	 *	See as_alloc_stats_get().
+	 *	Default: false
+	 */
+	bool stats_enabled;
+
+} as_config_alloc;
+
+/**
+ *	Socket tuning presets.  A preset provides the values of as_config_socket
+ *	fields left at 0.
+ *
+ *	@ingroup as_config_object
+ */
+typedef enum as_socket_profile_e {
+
+	/**
+	 *	Operating system defaults.
+	 */
+	AS_SOCKET_PROFILE_DEFAULT,
+
+	/**
+	 *	Trade CPU for lower latency: kernel busy polling, quick ACKs, high
+	 *	priority and a user-space spin before blocking for a response.
+	 */
+	AS_SOCKET_PROFILE_LATENCY,
+
+	/**
+	 *	Large socket buffers for batch, scan and query traffic.
+	 */
+	AS_SOCKET_PROFILE_THROUGHPUT
+
+} as_socket_profile;
+
+/**
+ *	Socket options applied to every connection to the server nodes - pooled
+ *	command connections, the tend thread's info connections and connections
+ *	used by batch, scan and query.  Options the platform does not support are
+ *	ignored.
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_socket_s {
+
+	/**
+	 *	Preset for fields left at 0.
+	 *	Default: AS_SOCKET_PROFILE_DEFAULT
+	 */
+	as_socket_profile profile;
+
+	/**
+	 *	Microseconds the kernel busy polls the device queue on a blocking
+	 *	read (SO_BUSY_POLL, Linux only).
+	 */
+	uint32_t busy_poll_us;
+
+	/**
+	 *	Receive buffer size in bytes (SO_RCVBUF).
+	 */
+	uint32_t rcvbuf_size;
+
+	/**
+	 *	Send buffer size in bytes (SO_SNDBUF).
+	 */
+	uint32_t sndbuf_size;
+
+	/**
+	 *	Priority of sent packets, 1 to 6 (SO_PRIORITY, Linux only).
+	 */
+	uint32_t priority;
+
+	/**
+	 *	Send ACKs immediately rather than delaying them (TCP_QUICKACK,
+	 *	Linux only).
+	 */
+	bool quickack;
+
+	/**
+	 *	Microseconds a single record command spins, checking for the
+	 *	response, before blocking in the kernel.
+	 */
+	uint32_t spin_us;
+
+} as_config_socket;
+
+/**
+ *	Hot key sampling config.  See aerospike_hotkeys_get().
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_hotkeys_s {
+
+	/**
+	 *	Sample single record commands into per interval hot key reports.
+	 *	Default: false
+	 */
+	bool enabled;
+
+	/**
+	 *	Sample one in sample_rate commands per thread.  1 samples every
+	 *	command.
+	 *	Default: 64
+	 */
+	uint32_t sample_rate;
+
+	/**
+	 *	Reporting interval in milliseconds.
+	 *	Default: 10000
+	 */
+	uint32_t interval_ms;
+
+	/**
+	 *	Number of keys reported per interval, up to AS_HOTKEYS_MAX (64).
+	 *	Default: 16
+	 */
+	uint32_t top_k;
+
+} as_config_hotkeys;
+
+/**
+ *	Slow operation sampling config.  See aerospike_slowops_get().
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_slowops_s {
+
+	/**
+	 *	Time the stages of single record commands and record those slower
+	 *	than threshold_us.
+	 *	Default: false
+	 */
+	bool enabled;
+
+	/**
+	 *	Commands taking at least this many microseconds are recorded.
+	 *	Default: 10000
+	 */
+	uint32_t threshold_us;
+
+	/**
+	 *	Number of operations held, rounded up to a power of 2.  Older
+	 *	operations are overwritten.
+	 *	Default: 256
+	 */
+	uint32_t capacity;
+
+	/**
+	 *	Log a slow operation at most once per log_interval_ms, with the
+	 *	number of slow operations not logged since.  0 disables logging.
+	 *	Default: 1000
+	 */
+	uint32_t log_interval_ms;
+
+} as_config_slowops;
+
 /**
  *	The `as_config` contains the settings for the `aerospike` client. Including
  *	default policies, seed hosts in the cluster and other settings.
@@ -274,6 +446,15 @@ typedef struct as_config_s {
 	 */
 	uint32_t max_threads;
 	
+	/**
+	 *	Number of pools each server node's synchronous connection pool is split into.
+	 *	A thread takes connections from the pool of the CPU it runs on, and from
+	 *	other pools only when that one is empty, so connections tend to stay on one
+	 *	CPU and contention is spread across pools.
+	 *	Default: 0 (one pool per online CPU, at most 64)
+	 */
+	uint32_t conn_pools_per_node;
+	
 	/**
 	 *	@private
 	 *	Not currently used.
@@ -317,6 +498,26 @@ typedef struct as_config_s {
 	 *	lua config
 	 */
 	as_config_lua lua;
+
+	/**
+	 *	memory allocation config
+	 */
+	as_config_alloc alloc;
+
+	/**
+	 *	socket tuning config
+	 */
+	as_config_socket socket;
+
+	/**
+	 *	hot key sampling config
+	 */
+	as_config_hotkeys hotkeys;
+
+	/**
+	 *	slow operation sampling config
+	 */
+	as_config_slowops slowops;
 	
 	/**
 	 *	Action to perform if client fails to connect to seed hosts.
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_config.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_status.h>
+#include <citrusleaf/cf_digest.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Maximum number of keys tracked per reporting interval.
+ */
+#define AS_HOTKEYS_MAX 64
+
+/**
+ *	@private
+ *	Rows in the count-min sketch.
+ */
+#define AS_HOTKEYS_DEPTH 4
+
+/**
+ *	@private
+ *	Counters per row in the count-min sketch.  Must be a power of 2.
+ */
+#define AS_HOTKEYS_WIDTH 4096
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	A frequently accessed key.
+ *
+ *	@ingroup as_hotkeys_object
+ */
+typedef struct as_hotkey_s {
+
+	/**
+	 *	Namespace of the key.
+	 */
+	as_namespace ns;
+
+	/**
+	 *	Set of the key.  Empty if the command was addressed by digest only.
+	 */
+	as_set set;
+
+	/**
+	 *	Digest of the key.
+	 */
+	cf_digest digest;
+
+	/**
+	 *	Estimated reads in the interval, scaled by the sample rate.
+	 */
+	uint64_t reads;
+
+	/**
+	 *	Estimated writes in the interval, scaled by the sample rate.
+	 */
+	uint64_t writes;
+
+	/**
+	 *	Partition the key belongs to.
+	 */
+	uint32_t partition_id;
+
+	/**
+	 *	Name of the partition's master node when reported.  Empty if unknown.
+	 */
+	char master[AS_NODE_NAME_MAX_SIZE];
+
+	/**
+	 *	Name of the partition's prole node when reported.  Empty if unknown.
+	 */
+	char prole[AS_NODE_NAME_MAX_SIZE];
+
+} as_hotkey;
+
+/**
+ *	Heaviest keys of a reporting interval, in descending order of
+ *	reads + writes.
+ *
+ *	@ingroup as_hotkeys_object
+ */
+typedef struct as_hotkeys_report_s {
+
+	/**
+	 *	Start of the interval in milliseconds (cf_getms() clock).
+	 */
+	uint64_t begin_ms;
+
+	/**
+	 *	End of the interval in milliseconds.
+	 */
+	uint64_t end_ms;
+
+	/**
+	 *	Number of keys.
+	 */
+	uint32_t size;
+
+	/**
+	 *	Keys.
+	 */
+	as_hotkey keys[AS_HOTKEYS_MAX];
+
+} as_hotkeys_report;
+
+/**
+ *	@private
+ *	Top-K heap entry.
+ */
+typedef struct as_hotkeys_entry_s {
+	as_namespace ns;
+	as_set set;
+	cf_digest digest;
+	uint32_t reads;
+	uint32_t writes;
+} as_hotkeys_entry;
+
+/**
+ *	@private
+ *	Sampled key frequencies of a cluster.  Sampled commands increment
+ *	count-min sketch counters without locking.  Only keys whose estimate
+ *	reaches the smallest top-K count take the lock to update the heap.
+ */
+typedef struct as_hotkeys_s {
+
+	/**
+	 *	@private
+	 *	Read counts.
+	 */
+	uint32_t reads[AS_HOTKEYS_DEPTH][AS_HOTKEYS_WIDTH];
+
+	/**
+	 *	@private
+	 *	Write counts.
+	 */
+	uint32_t writes[AS_HOTKEYS_DEPTH][AS_HOTKEYS_WIDTH];
+
+	/**
+	 *	@private
+	 *	Protects the heap, the interval and the last report.
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 *	@private
+	 *	Min-heap of the heaviest keys, by reads + writes.
+	 */
+	as_hotkeys_entry heap[AS_HOTKEYS_MAX];
+
+	/**
+	 *	@private
+	 *	Number of keys in heap.
+	 */
+	uint32_t heap_size;
+
+	/**
+	 *	@private
+	 *	Count a key must exceed to enter the heap.  0 until the heap is full.
+	 *	Read without the lock.
+	 */
+	uint32_t heap_min;
+
+	/**
+	 *	@private
+	 *	Heap capacity.
+	 */
+	uint32_t top_k;
+
+	/**
+	 *	@private
+	 *	Sample one in sample_rate commands per thread.
+	 */
+	uint32_t sample_rate;
+
+	/**
+	 *	@private
+	 *	Reporting interval in milliseconds.
+	 */
+	uint32_t interval_ms;
+
+	/**
+	 *	@private
+	 *	Start of the current interval.
+	 */
+	uint64_t begin_ms;
+
+	/**
+	 *	@private
+	 *	End of the current interval.  Read without the lock.
+	 */
+	uint64_t end_ms;
+
+	/**
+	 *	@private
+	 *	Heap of the last completed interval, sorted.
+	 */
+	as_hotkeys_entry last[AS_HOTKEYS_MAX];
+
+	/**
+	 *	@private
+	 *	Number of keys in last.
+	 */
+	uint32_t last_size;
+
+	/**
+	 *	@private
+	 *	Start of the last completed interval.
+	 */
+	uint64_t last_begin_ms;
+
+	/**
+	 *	@private
+	 *	End of the last completed interval.
+	 */
+	uint64_t last_end_ms;
+
+} as_hotkeys;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Get the heaviest keys of the last completed reporting interval.
+ *	Hot key sampling must be enabled with as_config.hotkeys.enabled.
+ *
+ *	Counts are estimates: the sketch may overcount keys sharing counters
+ *	with other keys, and sampling misses keys accessed too rarely to matter.
+ *	Nodes are those owning the partition when the report is read.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_hotkeys_report report;
+ *
+ *	if (aerospike_hotkeys_get(&as, &err, &report) == AEROSPIKE_OK) {
+ *		for (uint32_t i = 0; i < report.size; i++) {
+ *			as_hotkey* key = &report.keys[i];
+ *			printf("%s.%s pid %u reads %"PRIu64" writes %"PRIu64" master %s\n",
+ *				key->ns, key->set, key->partition_id, key->reads, key->writes, key->master);
+ *		}
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param as		The aerospike instance to use for this operation.
+ *	@param err		The as_error to be populated if an error occurs.
+ *	@param report	The report to populate.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@ingroup as_hotkeys_object
+ */
+as_status
+aerospike_hotkeys_get(aerospike* as, as_error* err, as_hotkeys_report* report);
+
+/**
+ *	@private
+ *	Create hot key sampler from config.  Returns NULL if disabled.
+ */
+as_hotkeys*
+as_hotkeys_create(const as_config_hotkeys* config);
+
+/**
+ *	@private
+ *	Destroy hot key sampler.
+ */
+void
+as_hotkeys_destroy(as_hotkeys* hotkeys);
+
+/**
+ *	@private
+ *	Count a single record command, if this thread's turn to sample.
+ */
+void
+as_hotkeys_sample(as_hotkeys* hotkeys, const char* ns, const char* set, const cf_digest* d, bool write);
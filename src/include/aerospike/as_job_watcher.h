@@ -0,0 +1,256 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_key.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+#include <aerospike/as_udf.h>
+#include <aerospike/as_vector.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Kind of background server job tracked by the job watcher.
+ */
+typedef enum as_job_type_e {
+	/**
+	 *	Background scan, tracked through "scan-list".
+	 */
+	AS_JOB_SCAN,
+	
+	/**
+	 *	Secondary index build, tracked through "sindex/<ns>/<name>".
+	 */
+	AS_JOB_INDEX,
+	
+	/**
+	 *	UDF module registration, tracked through "udf-list".
+	 */
+	AS_JOB_UDF
+} as_job_type;
+
+/**
+ *	Called from the job watcher thread when a job completes.
+ *
+ *	@param status	AEROSPIKE_OK if the job completed. Otherwise an error.
+ *	@param udata	User-data registered with the job.
+ */
+typedef void (*as_job_listener)(as_status status, void* udata);
+
+/**
+ *	Background server job to be tracked until completion.
+ */
+typedef struct as_job_s {
+	/**
+	 *	Kind of job.
+	 */
+	as_job_type type;
+	
+	/**
+	 *	Scan job id (AS_JOB_SCAN only).
+	 */
+	uint64_t scan_id;
+	
+	/**
+	 *	Index namespace (AS_JOB_INDEX only).
+	 */
+	as_namespace ns;
+	
+	/**
+	 *	Index name (AS_JOB_INDEX) or UDF file name (AS_JOB_UDF).
+	 */
+	char name[AS_UDF_FILE_NAME_SIZE];
+	
+	/**
+	 *	Info request timeout in milliseconds.
+	 */
+	uint32_t timeout_ms;
+	
+	/**
+	 *	Requested polling interval in milliseconds.
+	 */
+	uint32_t interval_ms;
+	
+	/**
+	 *	Completion listener. NULL when a thread waits on the job instead.
+	 */
+	as_job_listener listener;
+	
+	/**
+	 *	User-data passed to listener.
+	 */
+	void* udata;
+	
+	/**
+	 *	Job completion status.
+	 */
+	as_status status;
+	
+	/**
+	 *	Has job completed.
+	 */
+	bool done;
+	
+	/**
+	 *	@private
+	 *	Set during a sweep when any node still reports the job running.
+	 */
+	bool running;
+} as_job;
+
+/**
+ *	@private
+ *	Client-owned tracker which polls all outstanding jobs with a single
+ *	combined info request per node per interval.
+ */
+typedef struct as_job_watcher_s {
+	/**
+	 *	@private
+	 *	Cluster whose nodes are polled.
+	 */
+	struct as_cluster_s* cluster;
+	
+	/**
+	 *	@private
+	 *	Outstanding jobs.
+	 */
+	as_vector /* <as_job*> */ jobs;
+	
+	/**
+	 *	@private
+	 *	Protects jobs and wakes the watcher thread.
+	 */
+	pthread_mutex_t lock;
+	
+	/**
+	 *	@private
+	 *	Signaled when jobs are added or watcher is shutting down.
+	 */
+	pthread_cond_t wake_cond;
+	
+	/**
+	 *	@private
+	 *	Broadcast after each sweep that completed at least one job.
+	 */
+	pthread_cond_t done_cond;
+	
+	/**
+	 *	@private
+	 *	Absolute time in milliseconds of the next sweep.
+	 */
+	uint64_t next_sweep;
+	
+	/**
+	 *	@private
+	 *	Watcher thread.
+	 */
+	pthread_t thread;
+	
+	/**
+	 *	@private
+	 *	Should watcher thread keep running.
+	 */
+	volatile bool valid;
+	
+	/**
+	 *	@private
+	 *	Callers which got the watcher from the cluster and did not return yet.
+	 *	Shutdown waits for them to leave before the watcher is destroyed.
+	 */
+	uint32_t users;
+	
+	/**
+	 *	@private
+	 *	Shutdown was requested from the watcher thread itself, so the thread
+	 *	destroys the watcher when it exits.
+	 */
+	bool detached;
+} as_job_watcher;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Initialize scan job.
+ */
+static inline void
+as_job_init_scan(as_job* job, uint64_t scan_id, uint32_t timeout_ms, uint32_t interval_ms)
+{
+	memset(job, 0, sizeof(as_job));
+	job->type = AS_JOB_SCAN;
+	job->scan_id = scan_id;
+	job->timeout_ms = timeout_ms;
+	job->interval_ms = interval_ms;
+}
+
+/**
+ *	Initialize secondary index build job.
+ */
+static inline void
+as_job_init_index(as_job* job, const char* ns, const char* name, uint32_t timeout_ms, uint32_t interval_ms)
+{
+	memset(job, 0, sizeof(as_job));
+	job->type = AS_JOB_INDEX;
+	as_strncpy(job->ns, ns, sizeof(job->ns));
+	as_strncpy(job->name, name, sizeof(job->name));
+	job->timeout_ms = timeout_ms;
+	job->interval_ms = interval_ms;
+}
+
+/**
+ *	Initialize UDF registration job.
+ */
+static inline void
+as_job_init_udf(as_job* job, const char* filename, uint32_t timeout_ms, uint32_t interval_ms)
+{
+	memset(job, 0, sizeof(as_job));
+	job->type = AS_JOB_UDF;
+	as_strncpy(job->name, filename, sizeof(job->name));
+	job->timeout_ms = timeout_ms;
+	job->interval_ms = interval_ms;
+}
+
+/**
+ *	Block until job completes. The job is polled together with all other
+ *	outstanding jobs on the cluster.
+ *
+ *	@return Job completion status.
+ */
+as_status
+as_job_watcher_wait(struct as_cluster_s* cluster, as_job* job);
+
+/**
+ *	Register job and return immediately. The job is copied and the
+ *	listener is called from the watcher thread when the job completes.
+ */
+void
+as_job_watcher_listen(struct as_cluster_s* cluster, const as_job* job);
+
+/**
+ *	@private
+ *	Stop watcher thread. Outstanding jobs complete with AEROSPIKE_ERR_CLIENT.
+ */
+void
+as_job_watcher_shutdown(struct as_cluster_s* cluster);
@@ -119,6 +119,51 @@ typedef union as_key_value_u {
 } as_key_value;
 
 
+/**
+ *	Routing hints for a key, so that repeat transactions on the key skip the
+ *	partition id and namespace lookups.
+ *
+ *	The storage is owned by the caller and attached to a key with
+ *	as_key_set_route(). It must be zero initialized, and must outlive every
+ *	transaction on the key it is attached to. The same hints may be shared
+ *	by threads using the same key concurrently.
+ *
+ *	Hints are meant for one key. They are only used while their namespace
+ *	and partition id match the key's, and the generation matches the
+ *	partition map generation of the cluster they were resolved against.
+ *	Attached to a different key they are resolved again, so they are never
+ *	wrong, but they don't save any lookups. A generation of 0 means no hints
+ *	are cached.
+ */
+typedef struct as_key_route_s {
+
+	/**
+	 *	@private
+	 *	Namespace partition table the key maps to. The table holds the
+	 *	namespace it was resolved for.
+	 */
+	void * table;
+
+	/**
+	 *	@private
+	 *	Partition map generation the table was resolved at.
+	 */
+	uint32_t generation;
+
+	/**
+	 *	@private
+	 *	Partition id of the key's digest.
+	 */
+	uint32_t partition_id;
+
+	/**
+	 *	@private
+	 *	Odd while the hints are being updated.
+	 */
+	uint32_t seq;
+
+} as_key_route;
+
 /** 
  *	A key is used for locating records in the database.
  *
@@ -225,6 +270,12 @@ typedef struct as_key_s {
 	 */
 	as_digest digest;
 
+	/**
+	 *	Routing hints for the key, or NULL if none are cached.
+	 *	Set with as_key_set_route().
+	 */
+	as_key_route * route;
+
 } as_key;
 
 /******************************************************************************
@@ -653,3 +704,21 @@ void as_key_destroy(as_key * key);
  *	@ingroup as_key_object
  */
 as_digest * as_key_digest(as_key * key);
+
+/**
+ *	Attach caller owned storage for routing hints to the key. Transactions on
+ *	the key then cache the key's partition in the hints, and reuse it until
+ *	the cluster's partition map changes. Use one as_key_route per key.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_key_route route = { 0 };
+ *	as_key_set_route(key, &route);
+ *	~~~~~~~~~~
+ *
+ *	@param key 		The key to attach the hints to.
+ *	@param route 	Zero initialized hints, or NULL to stop caching.
+ *
+ *	@relates as_key
+ *	@ingroup as_key_object
+ */
+void as_key_set_route(as_key * key, as_key_route * route);
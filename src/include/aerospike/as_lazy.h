@@ -0,0 +1,154 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_val.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ *	@defgroup lazy_values Raw List and Map Values
+ *
+ *	When a read, batch or scan policy has `deserialize` set to false, list
+ *	and map bins are returned as the raw msgpack sent by the server, in an
+ *	as_bytes value of type `AS_BYTES_LIST` or `AS_BYTES_MAP`.  Nothing is
+ *	allocated per element until the value is used.
+ *
+ *	The functions below read single elements directly from the raw bytes,
+ *	or decode the whole value on first access.  A raw value written back
+ *	with aerospike_key_put() is sent as is, without being re-encoded.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_policy_read policy;
+ *	as_policy_read_init(&policy);
+ *	policy.deserialize = false;
+ *
+ *	as_record* rec = NULL;
+ *	aerospike_key_get(&as, &err, &policy, &key, &rec);
+ *
+ *	as_bytes* raw = as_lazy_fromval((as_val*)as_record_get(rec, "list"));
+ *	as_val* third = as_lazy_list_get(raw, 2);
+ *	...
+ *	as_val_destroy(third);
+ *	as_record_destroy(rec);
+ *	~~~~~~~~~~
+ */
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Return the value as raw list or map bytes.
+ *
+ *	@param v	The value.
+ *
+ *	@return The raw bytes, or NULL if v is not a raw list or map.
+ *
+ *	@ingroup lazy_values
+ */
+as_bytes*
+as_lazy_fromval(const as_val* v);
+
+/**
+ *	Get the number of elements in a raw list, or entries in a raw map.
+ *
+ *	@param b	The raw list or map.
+ *	@param size	The number of elements.
+ *
+ *	@return true on success, false if the bytes are malformed.
+ *
+ *	@ingroup lazy_values
+ */
+bool
+as_lazy_size(const as_bytes* b, uint32_t* size);
+
+/**
+ *	Decode a raw list or map into an as_list or as_map.
+ *
+ *	@param b	The raw list or map.
+ *
+ *	@return The decoded value, which the caller must destroy, or NULL if the
+ *	bytes are malformed.
+ *
+ *	@ingroup lazy_values
+ */
+as_val*
+as_lazy_decode(const as_bytes* b);
+
+/**
+ *	Decode the element at an index of a raw list.  Elements before the index
+ *	are skipped without being decoded.
+ *
+ *	@param b		The raw list.
+ *	@param index	The index of the element.
+ *
+ *	@return The decoded element, which the caller must destroy, or NULL if
+ *	the index is out of range or the bytes are malformed.
+ *
+ *	@ingroup lazy_values
+ */
+as_val*
+as_lazy_list_get(const as_bytes* b, uint32_t index);
+
+/**
+ *	Decode the value of a string key in a raw map.  Other keys and values
+ *	are skipped without being decoded.
+ *
+ *	@param b	The raw map.
+ *	@param key	The key.
+ *
+ *	@return The decoded value, which the caller must destroy, or NULL if the
+ *	key is not found or the bytes are malformed.
+ *
+ *	@ingroup lazy_values
+ */
+as_val*
+as_lazy_map_get_str(const as_bytes* b, const char* key);
+
+/**
+ *	Decode the value of an integer key in a raw map.  Other keys and values
+ *	are skipped without being decoded.
+ *
+ *	@param b	The raw map.
+ *	@param key	The key.
+ *
+ *	@return The decoded value, which the caller must destroy, or NULL if the
+ *	key is not found or the bytes are malformed.
+ *
+ *	@ingroup lazy_values
+ */
+as_val*
+as_lazy_map_get_int64(const as_bytes* b, int64_t key);
+
+/**
+ *	Get a bin of a record, decoding it in place if it holds a raw list or
+ *	map.  Later calls return the decoded value without decoding again.
+ *
+ *	@param rec	The record.
+ *	@param name	The bin name.
+ *
+ *	@return The bin value, owned by the record, or NULL if the bin does not
+ *	exist or the bytes are malformed.
+ *
+ *	@ingroup lazy_values
+ */
+as_val*
+as_lazy_record_get(as_record* rec, const as_bin_name name);
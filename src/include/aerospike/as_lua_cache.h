@@ -0,0 +1,187 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_config.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "ck_pr.h"
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Lua states mod_lua keeps pooled per module. A state returned to a full
+ *	pool is closed.
+ */
+#define AS_LUA_POOL_STATES_MAX 128
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Client-side Lua state cache statistics. Use these to decide whether
+ *	`as_config_lua.cache_enabled` is effective for the aggregation workload.
+ */
+typedef struct as_lua_cache_stats_s {
+	/**
+	 *	Stream UDF executions which reused a pooled Lua state.
+	 */
+	uint64_t hits;
+	
+	/**
+	 *	Stream UDF executions which had to create a new Lua state, because
+	 *	no pooled state was idle, the module was (re)loaded, or the cache
+	 *	is disabled.
+	 */
+	uint64_t misses;
+	
+	/**
+	 *	Number of times cached states were discarded because a UDF file changed.
+	 */
+	uint64_t invalidations;
+} as_lua_cache_stats;
+
+/**
+ *	@private
+ *	Tracks the Lua states mod_lua pools for one module. Executions take an
+ *	idle state or build a new one, and put it back when done. The load
+ *	generation (high 32 bits) and idle count (low 32 bits) share one word,
+ *	so a reload and a concurrent put can't interleave.
+ */
+typedef struct as_lua_pool_s {
+	uint64_t state;
+} as_lua_pool;
+
+/******************************************************************************
+ *	INLINE FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Start a new load generation with no idle states.
+ *
+ *	@return The new generation, never 0.
+ */
+static inline uint32_t
+as_lua_pool_reset(as_lua_pool* pool)
+{
+	uint64_t old;
+	uint32_t gen;
+	
+	do {
+		old = ck_pr_load_64(&pool->state);
+		gen = (uint32_t)(old >> 32) + 1;
+		
+		if (gen == 0) {
+			gen = 1;
+		}
+	} while (! ck_pr_cas_64(&pool->state, old, (uint64_t)gen << 32));
+	return gen;
+}
+
+/**
+ *	@private
+ *	Take an idle state if there is one, otherwise one is built.
+ *
+ *	@param hit		Set when an idle state was reused.
+ *	@return Ticket for as_lua_pool_put(). 0 if the module was never loaded.
+ */
+static inline uint32_t
+as_lua_pool_take(as_lua_pool* pool, bool* hit)
+{
+	uint64_t old;
+	
+	do {
+		old = ck_pr_load_64(&pool->state);
+		
+		if ((uint32_t)old == 0) {
+			*hit = false;
+			return (uint32_t)(old >> 32);
+		}
+	} while (! ck_pr_cas_64(&pool->state, old, old - 1));
+	
+	*hit = true;
+	return (uint32_t)(old >> 32);
+}
+
+/**
+ *	@private
+ *	Return a state taken with as_lua_pool_take().
+ *
+ *	@return false if the state is not pooled, because the module was reloaded
+ *	since it was taken or the pool is full.
+ */
+static inline bool
+as_lua_pool_put(as_lua_pool* pool, uint32_t ticket)
+{
+	uint64_t old;
+	
+	do {
+		old = ck_pr_load_64(&pool->state);
+		
+		if (ticket == 0 || (uint32_t)(old >> 32) != ticket || (uint32_t)old >= AS_LUA_POOL_STATES_MAX) {
+			return false;
+		}
+	} while (! ck_pr_cas_64(&pool->state, old, old + 1));
+	return true;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Configure Lua module and warm the cache with all files in user path.
+ */
+void
+as_lua_cache_configure(as_config_lua* config);
+
+/**
+ *	@private
+ *	Called before running a stream UDF. Reloads module into the cache if it
+ *	was never loaded or its file changed since last load.
+ *
+ *	@return Ticket to pass to as_lua_cache_release() after the execution.
+ */
+uint32_t
+as_lua_cache_reserve(const char* module);
+
+/**
+ *	@private
+ *	Called after running a stream UDF, when its Lua state is back in the pool.
+ */
+void
+as_lua_cache_release(const char* module, uint32_t ticket);
+
+/**
+ *	Discard cached Lua states for a UDF file so they are rebuilt on next use.
+ *
+ *	@param filename		UDF file name, e.g. "my.lua".
+ */
+void
+as_lua_cache_invalidate(const char* filename);
+
+/**
+ *	Retrieve Lua state cache statistics.
+ */
+void
+as_lua_cache_get_stats(as_lua_cache_stats* stats);
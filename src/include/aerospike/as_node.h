@@ -50,6 +50,7 @@ typedef struct as_address_s {
 } as_address;
 
 struct as_cluster_s;
+struct as_slowop_s;
 
 /**
  *	Server node representation.
@@ -89,9 +90,21 @@ typedef struct as_node_s {
 	
 	/**
 	 *	@private
-	 *	Pool of current, cached FDs.
+	 *	Pools of current, cached FDs, one per CPU by default.
 	 */
-	cf_queue* conn_q;
+	cf_queue** conn_qs;
+	
+	/**
+	 *	@private
+	 *	Number of pools in conn_qs.
+	 */
+	uint32_t conn_qs_size;
+	
+	/**
+	 *	@private
+	 *	Maximum FDs cached in each pool.
+	 */
+	uint32_t conn_q_limit;
 	
 	/**
 	 *	@private
@@ -134,6 +147,25 @@ typedef struct as_node_s {
 	 *	Is node currently active.
 	 */
 	uint8_t active;
+	
+	/**
+	 *	@private
+	 *	Did partition generation change on the last tend.  If so, replicas are
+	 *	requested with the node status, since they are likely still migrating.
+	 */
+	uint8_t partitions_changed;
+	
+	/**
+	 *	@private
+	 *	Info request and response buffer, reused by each tend.
+	 */
+	uint8_t* info_buffer;
+	
+	/**
+	 *	@private
+	 *	Size of info_buffer.
+	 */
+	uint32_t info_buffer_size;
 } as_node;
 
 /**
@@ -251,6 +283,14 @@ as_node_get_address_full(as_node* node)
 int
 as_node_get_connection(as_node* node, int* fd);
 
+/**
+ *	@private
+ *	Get a connection as as_node_get_connection() does, adding the time taken
+ *	to the checkout, connect and auth stages of op.  NULL op is not timed.
+ */
+int
+as_node_get_connection_timed(as_node* node, int* fd, struct as_slowop_s* op);
+
 /**
  *	@private
  *	Put connection back into pool.
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_val.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Compute the exact msgpack size of a value, as the server expects lists
+ *	and maps to be encoded.  Collections are walked once, so the value can
+ *	then be packed into a buffer of exactly this size with as_pack_write().
+ *
+ *	@param val	The value.
+ *	@param size	The encoded size in bytes.
+ *
+ *	@return false if the value holds a type that can't be packed.
+ */
+bool
+as_pack_size(const as_val* val, uint32_t* size);
+
+/**
+ *	@private
+ *	Pack a value into buf, which must hold at least the size returned by
+ *	as_pack_size().
+ *
+ *	@param val	The value.
+ *	@param buf	The buffer.
+ *
+ *	@return The end of the packed bytes.
+ */
+uint8_t*
+as_pack_write(const as_val* val, uint8_t* buf);
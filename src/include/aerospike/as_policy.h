@@ -53,6 +53,8 @@
  *  - as_policy_write
  */
 
+#include <aerospike/as_scan_throttle.h>
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -397,6 +399,17 @@ typedef struct as_policy_read_s {
 	 */
 	as_policy_consistency_level consistency_level;
 
+	/**
+	 *	Deserialize list and map bins into as_list and as_map values.
+	 *	If false, list and map bins are returned as raw msgpack in an
+	 *	as_bytes value of type `AS_BYTES_LIST` or `AS_BYTES_MAP`.  The raw
+	 *	value can be read in place with the functions in as_lazy.h and
+	 *	written back to the server without being re-encoded.
+	 *
+	 *	The default value is true.
+	 */
+	bool deserialize;
+
 } as_policy_read;
 
 /**
@@ -545,6 +558,16 @@ typedef struct as_policy_query_s {
 	 */
 	uint32_t timeout;
 
+	/**
+	 *	Run the client-side aggregation reduce on each node's results in
+	 *	parallel on the query worker threads, then merge the per-node
+	 *	partial results. Only valid when the client-side part of the stream
+	 *	function is an associative reduce, since it is applied twice.
+	 *
+	 *	Default: false
+	 */
+	bool parallel_reduce;
+
 } as_policy_query;
 
 /**
@@ -567,6 +590,23 @@ typedef struct as_policy_scan_s {
 	 */
 	bool fail_on_cluster_change;
 
+	/**
+	 *	Limit the rate at which records are read from the cluster.
+	 *	The throttle is shared by all node workers and may be adjusted
+	 *	while the scan runs.  Scans with a UDF running in the background
+	 *	are not throttled.
+	 *
+	 *	The default (NULL) means no limit.
+	 */
+	as_scan_throttle* throttle;
+
+	/**
+	 *	Deserialize list and map bins, as as_policy_read.deserialize does.
+	 *
+	 *	The default value is true.
+	 */
+	bool deserialize;
+
 } as_policy_scan;
 
 /**
@@ -615,6 +655,22 @@ typedef struct as_policy_batch_s {
 	 */
 	uint32_t timeout;
 
+	/**
+	 *	Specifies the replicas to read.  With `AS_POLICY_REPLICA_ANY`, keys are
+	 *	spread across masters and proles to balance the number of keys sent to
+	 *	each node.  Keys re-sent after a node error always go to the master.
+	 *
+	 *	The default value is `AS_POLICY_REPLICA_MASTER`.
+	 */
+	as_policy_replica replica;
+
+	/**
+	 *	Deserialize list and map bins, as as_policy_read.deserialize does.
+	 *
+	 *	The default value is true.
+	 */
+	bool deserialize;
+
 } as_policy_batch;
 
 /**
@@ -785,6 +841,7 @@ as_policy_read_init(as_policy_read* p)
 	p->key = AS_POLICY_KEY_DEFAULT;
 	p->replica = AS_POLICY_REPLICA_DEFAULT;
 	p->consistency_level = AS_POLICY_CONSISTENCY_LEVEL_DEFAULT;
+	p->deserialize = true;
 	return p;
 }
 
@@ -803,6 +860,7 @@ as_policy_read_copy(as_policy_read* src, as_policy_read* trg)
 	trg->key = src->key;
 	trg->replica = src->replica;
 	trg->consistency_level = src->consistency_level;
+	trg->deserialize = src->deserialize;
 }
 
 /**
@@ -1002,6 +1060,8 @@ static inline as_policy_batch*
 as_policy_batch_init(as_policy_batch* p)
 {
 	p->timeout = AS_POLICY_TIMEOUT_DEFAULT;
+	p->replica = AS_POLICY_REPLICA_DEFAULT;
+	p->deserialize = true;
 	return p;
 }
 
@@ -1017,6 +1077,8 @@ static inline void
 as_policy_batch_copy(as_policy_batch* src, as_policy_batch* trg)
 {
 	trg->timeout = src->timeout;
+	trg->replica = src->replica;
+	trg->deserialize = src->deserialize;
 }
 
 /**
@@ -1061,6 +1123,8 @@ as_policy_scan_init(as_policy_scan* p)
 {
 	p->timeout = 0;
 	p->fail_on_cluster_change = false;
+	p->throttle = NULL;
+	p->deserialize = true;
 	return p;
 }
 
@@ -1077,6 +1141,8 @@ as_policy_scan_copy(as_policy_scan* src, as_policy_scan* trg)
 {
 	trg->timeout = src->timeout;
 	trg->fail_on_cluster_change = src->fail_on_cluster_change;
+	trg->throttle = src->throttle;
+	trg->deserialize = src->deserialize;
 }
 
 /**
@@ -1091,6 +1157,7 @@ static inline as_policy_query*
 as_policy_query_init(as_policy_query* p)
 {
 	p->timeout = 0;
+	p->parallel_reduce = false;
 	return p;
 }
 
@@ -1106,6 +1173,7 @@ static inline void
 as_policy_query_copy(as_policy_query* src, as_policy_query* trg)
 {
 	trg->timeout = src->timeout;
+	trg->parallel_reduce = src->parallel_reduce;
 }
 
 /**
@@ -356,7 +356,11 @@ typedef struct as_query_sort_s {
  *
  *	as_query_where() is used to specify predicates to be added to the the query.
  *
- *	**Note:** Currently, a single where predicate is supported. To do more advanced filtering,
+ *	A record must match every predicate. With more than one predicate,
+ *	aerospike_query_foreach() runs a digest-only query per predicate in
+ *	parallel, keeps the digests all of them returned, then reads those
+ *	records with a batch read. Each predicate needs its own secondary index.
+ *	Aggregations support a single predicate. To do more advanced filtering,
  *	you will want to use a UDF to process the result set on the server.
  *	
  *	~~~~~~~~~~{.c}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Limits the rate at which foreground scans consume records from the
+ *	cluster.  A throttle is a token bucket shared by all node workers of
+ *	every scan whose policy references it.  When the bucket is empty, workers
+ *	stop reading their sockets, so TCP back-pressure slows the server.
+ *
+ *	The throttle is owned by the application and must outlive the scans using
+ *	it.  Limits may be changed with as_scan_throttle_set() while scans run.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_scan_throttle throttle;
+ *	as_scan_throttle_init(&throttle, 5000, 0);
+ *
+ *	as_policy_scan policy;
+ *	as_policy_scan_init(&policy);
+ *	policy.throttle = &throttle;
+ *
+ *	aerospike_scan_foreach(&as, &err, &policy, &scan, callback, NULL);
+ *	as_scan_throttle_destroy(&throttle);
+ *	~~~~~~~~~~
+ *
+ *	@ingroup scan_operations
+ */
+typedef struct as_scan_throttle_s {
+
+	/**
+	 *	@private
+	 *	Protects the bucket.
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 *	Maximum records per second.  0 means no limit.
+	 */
+	uint32_t records_per_sec;
+
+	/**
+	 *	Maximum bytes per second.  0 means no limit.
+	 */
+	uint32_t bytes_per_sec;
+
+	/**
+	 *	@private
+	 *	Available records.  Negative when workers have consumed ahead of the
+	 *	limit and must wait.
+	 */
+	double records;
+
+	/**
+	 *	@private
+	 *	Available bytes.
+	 */
+	double bytes;
+
+	/**
+	 *	@private
+	 *	Time of last refill in milliseconds.
+	 */
+	uint64_t refill_ms;
+
+} as_scan_throttle;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Initialize a scan throttle.
+ *
+ *	@param throttle			The throttle to initialize.
+ *	@param records_per_sec	Maximum records per second.  0 means no limit.
+ *	@param bytes_per_sec	Maximum bytes per second.  0 means no limit.
+ *
+ *	@return The initialized throttle.
+ *
+ *	@relates as_scan_throttle
+ */
+as_scan_throttle*
+as_scan_throttle_init(as_scan_throttle* throttle, uint32_t records_per_sec, uint32_t bytes_per_sec);
+
+/**
+ *	Change the limits of a scan throttle.  Safe to call while scans using the
+ *	throttle are running.  Workers waiting on the old limits pick up the new
+ *	limits within 100 milliseconds.
+ *
+ *	@param throttle			The throttle.
+ *	@param records_per_sec	Maximum records per second.  0 means no limit.
+ *	@param bytes_per_sec	Maximum bytes per second.  0 means no limit.
+ *
+ *	@relates as_scan_throttle
+ */
+void
+as_scan_throttle_set(as_scan_throttle* throttle, uint32_t records_per_sec, uint32_t bytes_per_sec);
+
+/**
+ *	Destroy a scan throttle.  No scan may be using it.
+ *
+ *	@relates as_scan_throttle
+ */
+void
+as_scan_throttle_destroy(as_scan_throttle* throttle);
+
+/**
+ *	@private
+ *	Consume records and bytes read by a scan worker.  Block until the bucket
+ *	is no longer in debt, so the worker reads no more until the limit allows.
+ */
+void
+as_scan_throttle_consume(as_scan_throttle* throttle, uint32_t n_records, uint32_t n_bytes);
@@ -0,0 +1,340 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_config.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+#include <citrusleaf/cf_clock.h>
+#include <citrusleaf/cf_digest.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Maximum number of nodes recorded per operation.  Later tries are counted
+ *	but their nodes are not recorded.
+ */
+#define AS_SLOWOP_MAX_NODES 4
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Stages of a single record command.  Stages repeated by retries are summed.
+ *
+ *	@ingroup as_slowops_object
+ */
+typedef enum as_slowop_stage_e {
+	/**
+	 *	Finding the node owning the partition.
+	 */
+	AS_SLOWOP_PARTITION,
+
+	/**
+	 *	Taking a pooled connection and checking it is still open.
+	 */
+	AS_SLOWOP_CHECKOUT,
+
+	/**
+	 *	Opening a new connection when the pool was empty.
+	 */
+	AS_SLOWOP_CONNECT,
+
+	/**
+	 *	Authenticating a new connection.
+	 */
+	AS_SLOWOP_AUTH,
+
+	/**
+	 *	Writing the request.
+	 */
+	AS_SLOWOP_WRITE,
+
+	/**
+	 *	Waiting for the response header.
+	 */
+	AS_SLOWOP_FIRST_BYTE,
+
+	/**
+	 *	Reading the response body.
+	 */
+	AS_SLOWOP_BODY,
+
+	/**
+	 *	Parsing the response.
+	 */
+	AS_SLOWOP_PARSE,
+
+	/**
+	 *	Backing off before retrying.
+	 */
+	AS_SLOWOP_RETRY_WAIT,
+
+	/**
+	 *	Number of stages.  Not a valid stage.
+	 */
+	AS_SLOWOP_STAGE_MAX
+} as_slowop_stage;
+
+/**
+ *	Timing breakdown of a command slower than the configured threshold.
+ *
+ *	@ingroup as_slowops_object
+ */
+typedef struct as_slowop_s {
+
+	/**
+	 *	Start of the command in milliseconds (cf_getms() clock).
+	 */
+	uint64_t begin_ms;
+
+	/**
+	 *	Total command time in microseconds.
+	 */
+	uint32_t total_us;
+
+	/**
+	 *	Time spent in each stage in microseconds.
+	 */
+	uint32_t stage_us[AS_SLOWOP_STAGE_MAX];
+
+	/**
+	 *	Number of tries.  More than 1 if the command was retried.
+	 */
+	uint32_t tries;
+
+	/**
+	 *	Result code of the command.
+	 */
+	int result;
+
+	/**
+	 *	Whether the command was a write.
+	 */
+	bool write;
+
+	/**
+	 *	Namespace of the key.
+	 */
+	as_namespace ns;
+
+	/**
+	 *	Digest of the key.
+	 */
+	cf_digest digest;
+
+	/**
+	 *	Number of names in nodes.
+	 */
+	uint32_t n_nodes;
+
+	/**
+	 *	Nodes tried, in order.
+	 */
+	char nodes[AS_SLOWOP_MAX_NODES][AS_NODE_NAME_MAX_SIZE];
+
+	/**
+	 *	@private
+	 *	End of the last timed stage in microseconds.
+	 */
+	uint64_t mark_us;
+
+} as_slowop;
+
+/**
+ *	@private
+ *	Ring buffer slot.  seq is odd while the slot is being written.  dropped
+ *	is one past the last position whose writer could not claim the slot.
+ */
+typedef struct as_slowops_slot_s {
+	uint64_t seq;
+	uint64_t dropped;
+	as_slowop op;
+} as_slowops_slot;
+
+/**
+ *	@private
+ *	Slow operation sampler of a cluster.  Writers take positions with an
+ *	atomic increment, claim the position's slot with a CAS on its sequence
+ *	number and publish it with a store, so neither writers nor readers lock.
+ *	A writer whose slot is still being written by an earlier lap drops its
+ *	operation and marks the position dropped.  Readers skip dropped
+ *	positions and slots overwritten while being copied.
+ */
+typedef struct as_slowops_s {
+
+	/**
+	 *	@private
+	 *	Commands taking at least this long are recorded.
+	 */
+	uint32_t threshold_us;
+
+	/**
+	 *	@private
+	 *	Minimum milliseconds between log lines.  0 disables logging.
+	 */
+	uint32_t log_interval_ms;
+
+	/**
+	 *	@private
+	 *	Time of the last log line.
+	 */
+	uint64_t log_ms;
+
+	/**
+	 *	@private
+	 *	Slow operations not logged since the last log line.
+	 */
+	uint32_t log_suppressed;
+
+	/**
+	 *	@private
+	 *	Number of slots.  Power of 2.
+	 */
+	uint32_t capacity;
+
+	/**
+	 *	@private
+	 *	Number of slots ever claimed.
+	 */
+	uint64_t head;
+
+	/**
+	 *	@private
+	 *	Slots.
+	 */
+	as_slowops_slot slots[];
+
+} as_slowops;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Get slow operations recorded since a cursor, oldest first.  Slow
+ *	operation sampling must be enabled with as_config.slowops.enabled.
+ *
+ *	Operations overwritten by newer ones before they are read are lost.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_slowop ops[64];
+ *	uint32_t n_ops = 64;
+ *	uint64_t cursor = 0;
+ *
+ *	if (aerospike_slowops_get(&as, &err, ops, &n_ops, &cursor) == AEROSPIKE_OK) {
+ *		for (uint32_t i = 0; i < n_ops; i++) {
+ *			printf("%s %u us first byte %u us\n", ops[i].ns, ops[i].total_us,
+ *				ops[i].stage_us[AS_SLOWOP_FIRST_BYTE]);
+ *		}
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param as		The aerospike instance to use for this operation.
+ *	@param err		The as_error to be populated if an error occurs.
+ *	@param ops		Array to populate.
+ *	@param n_ops	Capacity of ops on input.  Number populated on output.
+ *	@param cursor	0 for the oldest operation still held.  Updated to resume
+ *					after the last operation returned.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@ingroup as_slowops_object
+ */
+as_status
+aerospike_slowops_get(aerospike* as, as_error* err, as_slowop* ops, uint32_t* n_ops, uint64_t* cursor);
+
+/**
+ *	Get stage name for display.
+ *
+ *	@ingroup as_slowops_object
+ */
+const char*
+as_slowop_stage_name(as_slowop_stage stage);
+
+/**
+ *	@private
+ *	Create slow operation sampler from config.  Returns NULL if disabled.
+ */
+as_slowops*
+as_slowops_create(const as_config_slowops* config);
+
+/**
+ *	@private
+ *	Destroy slow operation sampler.
+ */
+void
+as_slowops_destroy(as_slowops* slowops);
+
+/**
+ *	@private
+ *	Finish timing an operation.  Records it if slower than the threshold.
+ */
+void
+as_slowops_end(as_slowops* slowops, as_slowop* op, int result);
+
+/**
+ *	@private
+ *	Start timing an operation.
+ */
+static inline void
+as_slowop_begin(as_slowop* op, const char* ns, const cf_digest* d, bool write)
+{
+	memset(op, 0, sizeof(as_slowop));
+	op->begin_ms = cf_getms();
+	op->mark_us = cf_getus();
+	op->write = write;
+	as_strncpy(op->ns, ns, sizeof(op->ns));
+	op->digest = *d;
+}
+
+/**
+ *	@private
+ *	Add time since the last mark to a stage.  NULL op is ignored, so callers
+ *	need not check whether sampling is enabled.
+ */
+static inline void
+as_slowop_mark(as_slowop* op, as_slowop_stage stage)
+{
+	if (op) {
+		uint64_t now = cf_getus();
+		op->stage_us[stage] += (uint32_t)(now - op->mark_us);
+		op->mark_us = now;
+	}
+}
+
+/**
+ *	@private
+ *	Record the node of the current try.
+ */
+static inline void
+as_slowop_add_node(as_slowop* op, const as_node* node)
+{
+	if (op && op->n_nodes < AS_SLOWOP_MAX_NODES) {
+		as_strncpy(op->nodes[op->n_nodes++], node->name, AS_NODE_NAME_MAX_SIZE);
+	}
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_config.h>
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Fill fields of config left at 0 from its profile.
+ */
+void
+as_socket_profile_resolve(const as_config_socket* config, as_config_socket* resolved);
+
+/**
+ *	@private
+ *	Apply resolved socket options to a new connection.
+ */
+void
+as_socket_profile_apply(const as_config_socket* config, int fd);
+
+/**
+ *	@private
+ *	Spin for up to config->spin_us until fd has data to read, so a response
+ *	that arrives quickly is read without sleeping in the kernel.
+ */
+void
+as_socket_profile_spin(const as_config_socket* config, int fd);
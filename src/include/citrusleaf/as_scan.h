@@ -48,6 +48,7 @@ typedef struct cl_scan_parameters {
     cl_scan_priority    priority;               // honored by server: priority of scan
     cl_scan_pct         pct;                    // honored by server: % of data to be scanned
     bool                concurrent;				// honored by client: if all the nodes should be scanned in parallel or not
+    as_scan_throttle *  throttle;               // honored by client: limit read rate across all node workers, NULL for none
 } cl_scan_params;
 
 typedef struct cl_scan_s {
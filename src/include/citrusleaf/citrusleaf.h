@@ -89,6 +89,20 @@ citrusleaf_cluster_change_compression_threshold(as_cluster *asc, int size_in_byt
 
 cl_rv citrusleaf_operate(as_cluster *asc, const char *ns, const char *set, const cl_object *key, cf_digest *d, cl_bin **values, cl_operation *operations, int *n_values, const cl_write_parameters *cl_w_p, uint32_t *generation, uint32_t* ttl, int consistency_level, int commit_level, as_policy_replica replica);
 
+/**
+ * Lay out the op headers and bin names of a set of operations once, for use with
+ * citrusleaf_operate_template(). Only the bin names and operators are used.
+ */
+int citrusleaf_operate_template_init(cl_operate_template *tmpl, const cl_operation *operations, int n_operations, int consistency_level, int commit_level);
+
+void citrusleaf_operate_template_destroy(cl_operate_template *tmpl);
+
+/**
+ * Same as citrusleaf_operate(), but the operations come from a template and only
+ * their values are passed, one object per templated operation.
+ */
+cl_rv citrusleaf_operate_template(as_cluster *asc, const cl_operate_template *tmpl, const char *ns, const char *set, const cl_object *key, cf_digest *d, cl_object *objects, cl_bin **values, int *n_values, const cl_write_parameters *cl_w_p, uint32_t *generation, uint32_t* ttl, as_policy_replica replica);
+
 /**
  * This debugging call can be useful for tracking down errors and coordinating with server failures
  * gets the digest for a particular set and key
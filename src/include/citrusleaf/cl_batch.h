@@ -38,6 +38,16 @@ cl_cluster_batch_init(as_cluster* asc);
 void
 cl_cluster_batch_shutdown(as_cluster* asc);
 
+/**
+ * Read many keys of one namespace. Keys on a node that fails are re-routed
+ * against the current partition map and sent again while timeout_ms allows
+ * (0 means no deadline). Keys that already got a response are never re-sent.
+ * With AS_POLICY_REPLICA_ANY, keys are spread across masters and proles to
+ * balance the keys per node - re-sent keys always go to the master.
+ * cb is called once per key - keys that never got a response are reported at
+ * the end with their last error.
+ */
 cl_rv citrusleaf_batch_read(as_cluster *asc, char *ns,
 		const cf_digest *digests, int n_digests, cl_bin *bins, int n_bins,
-		bool get_bin_data, citrusleaf_get_many_cb cb, void *udata);
+		bool get_bin_data, int timeout_ms, as_policy_replica replica,
+		citrusleaf_get_many_cb cb, void *udata);
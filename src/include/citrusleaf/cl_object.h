@@ -45,6 +45,10 @@ typedef enum cl_type_e {
     CL_LUA_BLOB     = 18,
     CL_MAP          = 19,
     CL_LIST         = 20,
+    // Client only - u.blob is an as_map or as_list, packed straight into the
+    // outgoing message. Sent as CL_MAP or CL_LIST.
+    CL_VAL_MAP      = 1019,
+    CL_VAL_LIST     = 1020,
     CL_UNKNOWN      = 666666
 } cl_type;
 
@@ -68,12 +72,15 @@ typedef struct cl_object_s {
  * FUNCTIONS
  ******************************************************************************/
 
+struct as_val_s;
+
 void citrusleaf_object_init(cl_object * o);
 void citrusleaf_object_init_str(cl_object * o, char const * str);
 void citrusleaf_object_init_str2(cl_object * o, char const * str, size_t str_len);
 void citrusleaf_object_init_blob(cl_object * o, void const * buf, size_t buf_len);
 void citrusleaf_object_init_blob2(cl_object * o, void const * buf, size_t buf_len, cl_type type);
 void citrusleaf_object_init_blob_handoff(cl_object *o, void *blob, size_t len, cl_type t);
+void citrusleaf_object_init_val(cl_object * o, const struct as_val_s * val, size_t packed_len, cl_type t);
 void citrusleaf_object_init_int(cl_object * o, int64_t i);
 void citrusleaf_object_init_null(cl_object * o);
 void citrusleaf_object_free(cl_object * o);
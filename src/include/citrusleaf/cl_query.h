@@ -60,6 +60,8 @@ typedef struct cl_query {
     void            * res_streamq;
     int             limit;  
     uint64_t        job_id;
+    bool            parallel_reduce; // Reduce each node's stream on query workers
+    bool            no_bins;         // Return digests only, without bin data
 } cl_query;
 
 typedef struct cl_query_response_record_t {
@@ -18,6 +18,8 @@
 
 #include <citrusleaf/cl_types.h>
 #include <aerospike/as_cluster.h>
+#include <aerospike/as_columns.h>
+#include <aerospike/as_scan_throttle.h>
 
 /******************************************************************************
  * TYPES
@@ -62,6 +64,8 @@ struct cl_scan_parameters_s {
     cl_scan_priority    priority;   // honored by server: priority of scan
     bool concurrent;				// honored on client: work on nodes in parallel or serially
     uint8_t threads_per_node;       // honored on client: have multiple threads per node. @TODO
+    as_scan_throttle *throttle;     // honored on client: limit read rate across all node threads, NULL for none
+    as_columns_builder *columns;    // honored on client: decode records into columns instead of calling back, NULL for none
 };
 
 struct cl_node_response_s {
@@ -79,6 +83,8 @@ static inline void cl_scan_parameters_set_default(cl_scan_parameters *cl_scan_p)
     cl_scan_p->concurrent = false;
     cl_scan_p->threads_per_node = 1;    // not honored currently
     cl_scan_p->priority = CL_SCAN_PRIORITY_AUTO;
+    cl_scan_p->throttle = NULL;
+    cl_scan_p->columns = NULL;
 }
 
 
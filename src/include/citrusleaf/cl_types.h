@@ -106,6 +106,20 @@ typedef struct cl_operation_s {
     cl_bin              bin;
     cl_operator         op;
 } cl_operation;
+
+/**
+ * A fixed set of operations pre-encoded for repeated 'operate' calls.
+ * The op headers and bin names are laid out once; each call supplies
+ * only the key, digest and values.
+ */
+typedef struct cl_operate_template_s {
+    uint8_t *           ops;
+    size_t              ops_sz;
+    int                 n_ops;
+    int                 info1;
+    int                 info2;
+    int                 info3;
+} cl_operate_template;
     
 /**
  * Structure to map the internal address to the external address
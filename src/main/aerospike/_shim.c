@@ -19,6 +19,7 @@
 #include <aerospike/as_list.h>
 #include <aerospike/as_map.h>
 #include <aerospike/as_operations.h>
+#include <aerospike/as_pack.h>
 #include <aerospike/as_string.h>
 #include <aerospike/as_val.h>
 #include <aerospike/as_record.h>
@@ -142,19 +143,17 @@ void asval_to_clobject(as_val * val, cl_object * obj)
 			citrusleaf_object_init_blob2(obj, v->value, v->size, (cl_type)v->type);
 			break;
 		}
-		case AS_LIST:{
-			as_buffer buffer;
-			as_buffer_init(&buffer);
-
-			as_serializer ser;
-			as_msgpack_init(&ser);
-			as_serializer_serialize(&ser, val, &buffer);
-			as_serializer_destroy(&ser);
-			
-			citrusleaf_object_init_blob_handoff(obj, buffer.data, buffer.size, CL_LIST);
-			break;
-		}
+		case AS_LIST:
 		case AS_MAP: {
+			cl_type type = val->type == AS_LIST ? CL_LIST : CL_MAP;
+			uint32_t size;
+
+			// Size exactly now, and pack straight into the message later.
+			if ( as_pack_size(val, &size) ) {
+				citrusleaf_object_init_val(obj, val, size, type);
+				break;
+			}
+
 			as_buffer buffer;
 			as_buffer_init(&buffer);
 
@@ -162,8 +161,8 @@ void asval_to_clobject(as_val * val, cl_object * obj)
 			as_msgpack_init(&ser);
 			as_serializer_serialize(&ser, val, &buffer);
 			as_serializer_destroy(&ser);
-
-			citrusleaf_object_init_blob_handoff(obj, buffer.data, buffer.size, CL_MAP);
+			
+			citrusleaf_object_init_blob_handoff(obj, buffer.data, buffer.size, type);
 			break;
 		}
 		default: {
@@ -287,7 +286,11 @@ void clbin_to_asval(cl_bin * bin, as_serializer * ser, as_val ** val)
 }
 
 
-void clbin_to_asrecord(cl_bin * bin, as_record * r)
+/**
+ * Move bin into r. List and map bins are deserialized with ser, or kept as
+ * raw msgpack bytes if ser is NULL.
+ */
+void clbin_to_asrecord(cl_bin * bin, as_serializer * ser, as_record * r)
 {
 	switch(bin->object.type) {
 		case CL_NULL: {
@@ -306,6 +309,26 @@ void clbin_to_asrecord(cl_bin * bin, as_record * r)
 		}
 		case CL_LIST:
 		case CL_MAP: {
+			if ( ser == NULL ) {
+				as_bytes_type type = bin->object.type == CL_LIST ? AS_BYTES_LIST : AS_BYTES_MAP;
+
+				if ( bin->object.free ) {
+					as_record_set_raw_typep(r, bin->bin_name, bin->object.u.blob, (uint32_t)bin->object.sz, type, true);
+					// the following completes the handoff of the value.
+					bin->object.free = NULL;
+				}
+				else {
+					uint8_t * raw = malloc(bin->object.sz);
+
+					if ( raw == NULL ) {
+						as_record_set_nil(r, bin->bin_name);
+						break;
+					}
+					memcpy(raw, bin->object.u.blob, bin->object.sz);
+					as_record_set_raw_typep(r, bin->bin_name, raw, (uint32_t)bin->object.sz, type, true);
+				}
+				break;
+			}
 
 			as_val * val = NULL;
 
@@ -313,10 +336,7 @@ void clbin_to_asrecord(cl_bin * bin, as_record * r)
 			buffer.data = (uint8_t *) bin->object.u.blob;
 			buffer.size = (uint32_t)bin->object.sz;
 
-			as_serializer ser;
-			as_msgpack_init(&ser);
-			as_serializer_deserialize(&ser, &buffer, &val);
-			as_serializer_destroy(&ser);
+			as_serializer_deserialize(ser, &buffer, &val);
 
 			as_record_set(r, bin->bin_name, (as_bin_value *) val);
 			break;
@@ -331,11 +351,57 @@ void clbin_to_asrecord(cl_bin * bin, as_record * r)
 }
 
 
-void clbins_to_asrecord(cl_bin * bins, uint32_t nbins, as_record * r) 
+void clbins_to_asrecord(cl_bin * bins, uint32_t nbins, as_record * r, bool deserialize) 
 {
+	// One serializer for all the bins. The msgpack serializer holds no
+	// state between calls.
+	as_serializer ser;
+	as_msgpack_init(&ser);
+
 	uint32_t n = nbins < r->bins.capacity ? nbins : r->bins.capacity;
 	for ( int i = 0; i < n; i++ ) {
-		clbin_to_asrecord(&bins[i], r);
+		clbin_to_asrecord(&bins[i], deserialize ? &ser : NULL, r);
+	}
+
+	as_serializer_destroy(&ser);
+}
+
+/**
+ * Fill r with the bins of src, so r outlives src. Heap values (lists, maps,
+ * blobs) are shared by reference. Values stored inside the bins of src are
+ * copied, since they go away with it.
+ */
+void asrecord_share(const as_record * src, as_record * r)
+{
+	r->gen = src->gen;
+	r->ttl = src->ttl;
+
+	for ( uint16_t i = 0; i < src->bins.size; i++ ) {
+		as_bin * bin = &src->bins.entries[i];
+		as_val * val = (as_val *) bin->valuep;
+
+		if ( !val || as_val_type(val) == AS_NIL ) {
+			as_record_set_nil(r, bin->name);
+		}
+		else if ( bin->valuep != &bin->value ) {
+			as_val_reserve(val);
+			as_record_set(r, bin->name, bin->valuep);
+		}
+		else if ( as_val_type(val) == AS_INTEGER ) {
+			as_record_set_int64(r, bin->name, as_integer_get((as_integer *) val));
+		}
+		else if ( as_val_type(val) == AS_STRING ) {
+			as_record_set_strp(r, bin->name, strdup(as_string_get((as_string *) val)), true);
+		}
+		else if ( as_val_type(val) == AS_BYTES ) {
+			as_bytes * b = (as_bytes *) val;
+			uint8_t * raw = malloc(b->size);
+			memcpy(raw, b->value, b->size);
+			as_record_set_raw_typep(r, bin->name, raw, b->size, as_bytes_get_type(b), true);
+		}
+		else {
+			as_record_set_nil(r, bin->name);
+		}
 	}
 }
 
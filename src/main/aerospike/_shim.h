@@ -35,9 +35,11 @@ void askey_from_clkey(as_key * key, const as_namespace ns, const as_set set, cl_
 
 void clbin_to_asval(cl_bin * bin, as_serializer * ser, as_val ** val);
 
-void clbin_to_asrecord(cl_bin * bin, as_record * r);
+void clbin_to_asrecord(cl_bin * bin, as_serializer * ser, as_record * r);
 
-void clbins_to_asrecord(cl_bin * bins, uint32_t nbins, as_record * rec);
+void clbins_to_asrecord(cl_bin * bins, uint32_t nbins, as_record * rec, bool deserialize);
+
+void asrecord_share(const as_record * src, as_record * rec);
 
 void aspolicywrite_to_clwriteparameters(const as_policy_write * policy, const as_record * rec, cl_write_parameters * wp);
 
@@ -15,12 +15,11 @@
  * the License.
  */
 #include <aerospike/aerospike.h>
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_config.h>
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_log_macros.h>
-#include <aerospike/as_module.h>
-#include <aerospike/mod_lua.h>
-#include <aerospike/mod_lua_config.h>
+#include <aerospike/as_lua_cache.h>
 
 #include <citrusleaf/citrusleaf.h>
 #include "_shim.h"
@@ -96,16 +95,11 @@ as_status aerospike_connect(aerospike * as, as_error * err)
 		return as_error_update(err, AEROSPIKE_ERR_CLUSTER, "no hosts provided");
 	}
 
-    mod_lua_config config = {
-        .server_mode    = false,
-        .cache_enabled  = as->config.lua.cache_enabled,
-        .system_path    = {0},
-        .user_path      = {0}
-    };
-    memcpy(config.system_path, as->config.lua.system_path, sizeof(config.system_path));
-    memcpy(config.user_path, as->config.lua.user_path, sizeof(config.user_path));
-    
-    as_module_configure(&mod_lua, &config);
+	// Install allocator for client-internal buffers.
+	as_allocator_configure(&as->config.alloc.allocator, as->config.alloc.stats_enabled);
+
+	// Configure Lua and preload user modules into the Lua state cache.
+	as_lua_cache_configure(&as->config.lua);
 	
 	// Create the cluster object.
 	int status = as_cluster_create(&as->config, &as->cluster);
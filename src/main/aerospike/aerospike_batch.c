@@ -46,55 +46,107 @@ typedef struct batch_bridge_s {
 	// Number of array elements.
 	uint32_t n;
 
+	// Unique digests sent to the cluster.
+	cf_digest * digests;
+
+	// Digest hash index - first unique digest in each bucket, and the next
+	// unique digest in the same bucket.
+	int * buckets;
+	int * next;
+	uint32_t n_buckets;
+
+	// Result slots requesting each unique digest - first slot of each digest,
+	// and the next slot with the same digest.
+	int * first_slot;
+	int * next_slot;
+
+	// Deserialize list and map bins.
+	bool deserialize;
+
 } batch_bridge;
 
 /**************************************************************************
  * 	STATIC FUNCTIONS
  **************************************************************************/
 
+static inline uint32_t
+batch_digest_hash(const uint8_t * digest, uint32_t n_buckets)
+{
+	// Digests are uniformly distributed - any 4 bytes make a good hash.
+	uint32_t h;
+	memcpy(&h, digest + 8, sizeof(h));
+	return h & (n_buckets - 1);
+}
+
+static int
+batch_digest_find(const batch_bridge * p_bridge, const uint8_t * digest)
+{
+	int u = p_bridge->buckets[batch_digest_hash(digest, p_bridge->n_buckets)];
+
+	while (u >= 0) {
+		if (memcmp(&p_bridge->digests[u], digest, AS_DIGEST_VALUE_SIZE) == 0) {
+			return u;
+		}
+		u = p_bridge->next[u];
+	}
+	return -1;
+}
+
+/**
+ *	Fill a duplicate key's slot from the slot that got the server response.
+ */
+static void
+batch_read_share(as_batch_read * p_r, const as_batch_read * src)
+{
+	p_r->result = src->result;
+
+	if (src->result != AEROSPIKE_OK) {
+		return;
+	}
+
+	as_record_init(&p_r->record, src->record.bins.size);
+	asrecord_share(&src->record, &p_r->record);
+}
+
 static int
 cl_batch_cb(char *ns, cf_digest *keyd, char *set, cl_object *key, int result,
 		uint32_t generation, uint32_t ttl, cl_bin *bins, uint16_t n_bins,
 		void *udata)
 {
 	batch_bridge * p_bridge = (batch_bridge *) udata;
-	as_batch_read * p_r = NULL;
 
-	// Find the digest.
-	for (uint32_t i = 0; i < p_bridge->n; i++) {
-		p_r = &p_bridge->results[i];
+	// Find the digest. Not bothering to check set, which is not always filled.
+	int u = batch_digest_find(p_bridge, (const uint8_t *) keyd);
 
-		if (memcmp(keyd, p_r->key->digest.value, AS_DIGEST_VALUE_SIZE) == 0) {
-			// Not bothering to check set, which is not always filled.
-			break;
-		}
-
-		p_r = NULL;
-	}
-
-	if (! p_r) {
+	if (u < 0) {
 		as_log_error("Couldn't find digest");
 		return -1; // not that this is even checked...
 	}
 
-	// Fill out this result slot.
+	// Fill out the first result slot of this digest.
+	int first = p_bridge->first_slot[u];
+	as_batch_read * p_r = &p_bridge->results[first];
+
 	as_error err;
 	p_r->result = as_error_fromrc(&err, result);
 
 	// If the result wasn't success, we won't have any record data or metadata.
-	if (result != 0) {
-		return 0;
-	}
+	if (result == 0) {
+		as_record_init(&p_r->record, n_bins); // works even if n_bins is 0
 
-	as_record_init(&p_r->record, n_bins); // works even if n_bins is 0
+		// There should be record metadata.
+		p_r->record.gen = (uint16_t)generation;
+		p_r->record.ttl = ttl;
 
-	// There should be record metadata.
-	p_r->record.gen = (uint16_t)generation;
-	p_r->record.ttl = ttl;
+		// There may be bin data.
+		if (n_bins != 0) {
+			clbins_to_asrecord(bins, (uint32_t)n_bins, &p_r->record, p_bridge->deserialize);
+		}
+	}
 
-	// There may be bin data.
-	if (n_bins != 0) {
-		clbins_to_asrecord(bins, (uint32_t)n_bins, &p_r->record);
+	// Fan out to the slots of duplicate keys.
+	for (int i = p_bridge->next_slot[first]; i >= 0; i = p_bridge->next_slot[i]) {
+		batch_read_share(&p_bridge->results[i], p_r);
 	}
 
 	return 0;
@@ -104,11 +156,37 @@ static as_status batch_read(
 		aerospike * as, as_error * err, const as_policy_batch * policy,
 		const as_batch * batch,
 		aerospike_batch_read_callback callback, void * udata,
-		bool get_bin_data
+		const char ** bins, bool get_bin_data
 		)
 {
 	as_error_reset(err);
 
+	if (! policy) {
+		policy = &as->config.policies.batch;
+	}
+
+	// Bins to read. None means all bins.
+	int n_bins = 0;
+	cl_bin* clbins = NULL;
+
+	if (bins) {
+		while (bins[n_bins] && bins[n_bins][0] != '\0') {
+			n_bins++;
+		}
+
+		clbins = (cl_bin*)alloca(sizeof(cl_bin) * n_bins);
+
+		for (int i = 0; i < n_bins; i++) {
+			if (strlen(bins[i]) > AS_BIN_NAME_MAX_LEN) {
+				return as_error_update(err, AEROSPIKE_ERR_PARAM,
+						"bin name too long: %s", bins[i]);
+			}
+
+			strcpy(clbins[i].bin_name, bins[i]);
+			citrusleaf_object_init(&clbins[i].object);
+		}
+	}
+
 	// Lazily initialize batch machinery:
 	cl_cluster_batch_init(as->cluster);
 
@@ -127,6 +205,21 @@ static as_status batch_read(
 				"failed digests array allocation");
 	}
 
+	uint32_t n_buckets = 1;
+
+	while (n_buckets < n) {
+		n_buckets <<= 1;
+	}
+
+	int* buckets = (int*)alloca(sizeof(int) * n_buckets);
+	int* next = (int*)alloca(sizeof(int) * n);
+	int* first_slot = (int*)alloca(sizeof(int) * n);
+	int* last_slot = (int*)alloca(sizeof(int) * n);
+	int* next_slot = (int*)alloca(sizeof(int) * n);
+
+	memset(buckets, 0xff, sizeof(int) * n_buckets);
+	uint32_t n_digests = 0;
+
 	// Because we're wrapping the old functionality, we only support a batch
 	// with all keys in the same namespace.
 	char* ns = batch->keys.entries[0].ns;
@@ -145,17 +238,44 @@ static as_status batch_read(
 		as_record_init(&p_r->record, 0);
 		p_r->key = (const as_key*)as_batch_keyat(batch, i);
 
-		memcpy(&digests[i], as_key_digest((as_key*)p_r->key)->value,
-				AS_DIGEST_VALUE_SIZE);
+		// Send each digest once - duplicate keys share the response.
+		const uint8_t* digest = as_key_digest((as_key*)p_r->key)->value;
+		uint32_t b = batch_digest_hash(digest, n_buckets);
+		int u = buckets[b];
+
+		while (u >= 0 && memcmp(&digests[u], digest, AS_DIGEST_VALUE_SIZE) != 0) {
+			u = next[u];
+		}
+
+		next_slot[i] = -1;
+
+		if (u < 0) {
+			u = (int)n_digests++;
+			memcpy(&digests[u], digest, AS_DIGEST_VALUE_SIZE);
+			next[u] = buckets[b];
+			buckets[b] = u;
+			first_slot[u] = (int)i;
+		}
+		else {
+			next_slot[last_slot[u]] = (int)i;
+		}
+		last_slot[u] = (int)i;
 	}
 
 	batch_bridge bridge;
 	bridge.as = as;
 	bridge.results = results;
 	bridge.n = n;
+	bridge.digests = digests;
+	bridge.buckets = buckets;
+	bridge.next = next;
+	bridge.n_buckets = n_buckets;
+	bridge.first_slot = first_slot;
+	bridge.next_slot = next_slot;
+	bridge.deserialize = policy->deserialize;
 
-	cl_rv rc = citrusleaf_batch_read(as->cluster, ns, digests, n, NULL, 0,
-			get_bin_data, cl_batch_cb, &bridge);
+	cl_rv rc = citrusleaf_batch_read(as->cluster, ns, digests, (int)n_digests,
+			n_bins ? clbins : NULL, n_bins, get_bin_data, (int)policy->timeout, policy->replica, cl_batch_cb, &bridge);
 
 	callback(results, n, udata);
 
@@ -179,7 +299,7 @@ as_status aerospike_batch_get(
 	aerospike_batch_read_callback callback, void * udata
 	)
 {
-	return batch_read(as, err, policy, batch, callback, udata, true);
+	return batch_read(as, err, policy, batch, callback, udata, NULL, true);
 }
 
 /**
@@ -191,5 +311,17 @@ as_status aerospike_batch_exists(
 	aerospike_batch_read_callback callback, void * udata
 	)
 {
-	return batch_read(as, err, policy, batch, callback, udata, false);
+	return batch_read(as, err, policy, batch, callback, udata, NULL, false);
+}
+
+/**
+ *	Look up multiple records by key, then return the specified bins.
+ */
+as_status aerospike_batch_select(
+	aerospike * as, as_error * err, const as_policy_batch * policy, 
+	const as_batch * batch, const char * bins[], 
+	aerospike_batch_read_callback callback, void * udata
+	)
+{
+	return batch_read(as, err, policy, batch, callback, udata, bins, true);
 }
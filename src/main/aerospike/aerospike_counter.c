@@ -0,0 +1,412 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_batch.h>
+#include <aerospike/aerospike_counter.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_batch.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_operations.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+
+#include <citrusleaf/cf_clock.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#include "ck_pr.h"
+
+/************************************************************************
+ * 	TYPES
+ ************************************************************************/
+
+typedef struct counter_sum_s {
+
+	const char * bin;
+
+	const uint8_t * digest;
+
+	int64_t value;
+
+	// Shards read count stored in the base record, 0 if none.
+	uint32_t read_shards;
+
+	// First shard read failure, other than not found.
+	as_status result;
+
+} counter_sum;
+
+/**************************************************************************
+ * 	STATIC VARIABLES
+ **************************************************************************/
+
+// Per thread random state and shard, so picking a shard is contention free.
+static __thread uint32_t counter_rand_state;
+static __thread uint32_t counter_thread_shard;
+
+/**************************************************************************
+ * 	STATIC FUNCTIONS
+ **************************************************************************/
+
+static uint32_t
+counter_rand(void)
+{
+	uint32_t x = counter_rand_state;
+
+	if ( x == 0 ) {
+		// Seed each thread differently.
+		uintptr_t self = (uintptr_t) pthread_self();
+		x = (uint32_t) ((uint64_t) self ^ ((uint64_t) self >> 32) ^ cf_getus()) | 1;
+	}
+
+	// xorshift32
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	counter_rand_state = x;
+	return x;
+}
+
+static uint32_t
+counter_pick(const as_counter * counter)
+{
+	// A reshard may change the count under us.
+	uint32_t n_shards = ck_pr_load_32(&counter->n_shards);
+
+	if ( n_shards == 1 ) {
+		return 0;
+	}
+
+	if ( counter->pick == AS_COUNTER_PICK_THREAD ) {
+		if ( counter_thread_shard == 0 ) {
+			// Stored + 1 so 0 means unset.
+			counter_thread_shard = counter_rand() + 1;
+		}
+		return (counter_thread_shard - 1) % n_shards;
+	}
+	return counter_rand() % n_shards;
+}
+
+static as_status
+counter_incr(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	const as_counter * counter, uint32_t shard, int64_t value)
+{
+	as_key key;
+	as_counter_shard_key(counter, shard, &key);
+
+	as_operations ops;
+	as_operations_inita(&ops, 1);
+	as_operations_add_incr(&ops, counter->bin, value);
+
+	as_status rc = aerospike_key_operate(as, err, policy, &key, &ops, NULL);
+
+	as_operations_destroy(&ops);
+	as_key_destroy(&key);
+	return rc;
+}
+
+// Store the shard counts in the base record, for other clients to load.
+static as_status
+counter_store_shards(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	const as_counter * counter, uint32_t n_shards, uint32_t read_shards)
+{
+	as_key key;
+	as_counter_shard_key(counter, 0, &key);
+
+	as_operations ops;
+	as_operations_inita(&ops, 2);
+	as_operations_add_write_int64(&ops, AS_COUNTER_SHARDS_BIN, n_shards);
+	as_operations_add_write_int64(&ops, AS_COUNTER_READ_SHARDS_BIN, read_shards);
+
+	as_status rc = aerospike_key_operate(as, err, policy, &key, &ops, NULL);
+
+	as_operations_destroy(&ops);
+	as_key_destroy(&key);
+	return rc;
+}
+
+static bool
+counter_sum_callback(const as_batch_read * results, uint32_t n, void * udata)
+{
+	counter_sum * sum = (counter_sum *) udata;
+
+	for ( uint32_t i = 0; i < n; i++ ) {
+		if ( results[i].result == AEROSPIKE_OK ) {
+			sum->value += as_record_get_int64(&results[i].record, sum->bin, 0);
+
+			if ( memcmp(results[i].key->digest.value, sum->digest, AS_DIGEST_VALUE_SIZE) == 0 ) {
+				sum->read_shards = (uint32_t) as_record_get_int64(&results[i].record, AS_COUNTER_READ_SHARDS_BIN, 0);
+			}
+		}
+		else if ( results[i].result != AEROSPIKE_ERR_RECORD_NOT_FOUND && sum->result == AEROSPIKE_OK ) {
+			sum->result = results[i].result;
+		}
+	}
+	return true;
+}
+
+// Add shards [begin, end) to the sum.
+static as_status
+counter_sum_shards(
+	aerospike * as, as_error * err, const as_policy_batch * policy, 
+	const as_counter * counter, uint32_t begin, uint32_t end, counter_sum * sum)
+{
+	as_batch batch;
+	as_batch_init(&batch, end - begin);
+
+	for ( uint32_t i = begin; i < end; i++ ) {
+		as_counter_shard_key(counter, i, as_batch_keyat(&batch, i - begin));
+	}
+
+	as_status rc = aerospike_batch_get(as, err, policy, &batch, counter_sum_callback, sum);
+
+	as_batch_destroy(&batch);
+	return rc;
+}
+
+/**************************************************************************
+ * 	FUNCTIONS
+ **************************************************************************/
+
+as_counter * as_counter_init(as_counter * counter, as_key * key, const char * bin, uint32_t n_shards)
+{
+	if ( ! counter || ! key || ! bin || n_shards == 0 || n_shards > AS_COUNTER_MAX_SHARDS ) {
+		return NULL;
+	}
+
+	if ( as_strncpy(counter->bin, bin, sizeof(counter->bin)) ) {
+		// Bin name too long.
+		return NULL;
+	}
+
+	as_digest * digest = as_key_digest(key);
+	memcpy(counter->ns, key->ns, sizeof(counter->ns));
+	memcpy(counter->set, key->set, sizeof(counter->set));
+	memcpy(counter->digest, digest->value, sizeof(counter->digest));
+	counter->n_shards = n_shards;
+	counter->read_shards = n_shards;
+	counter->pick = AS_COUNTER_PICK_RANDOM;
+	return counter;
+}
+
+as_key * as_counter_shard_key(const as_counter * counter, uint32_t shard, as_key * key)
+{
+	as_digest_value digest;
+	memcpy(digest, counter->digest, sizeof(digest));
+
+	// Partition ids come from the low 12 bits of the first 2 digest bytes.
+	// Mixing in an odd multiple of the shard index gives up to 4096 shards
+	// distinct partitions.  Shard 0 keeps the base digest.
+	uint32_t w;
+	memcpy(&w, digest, sizeof(w));
+	w ^= shard * 0x9E3779B9;
+	memcpy(digest, &w, sizeof(w));
+
+	return as_key_init_digest(key, counter->ns, counter->set, digest);
+}
+
+as_status aerospike_counter_add(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	const as_counter * counter, int64_t value)
+{
+	as_error_reset(err);
+
+	// Shard keys beyond shard 0 have no user key to send.
+	as_policy_operate p = policy ? *policy : as->config.policies.operate;
+	p.key = AS_POLICY_KEY_DIGEST;
+
+	return counter_incr(as, err, &p, counter, counter_pick(counter), value);
+}
+
+as_status aerospike_counter_get(
+	aerospike * as, as_error * err, const as_policy_batch * policy, 
+	const as_counter * counter, int64_t * value)
+{
+	as_error_reset(err);
+
+	uint32_t read_shards = ck_pr_load_32(&counter->read_shards);
+
+	counter_sum sum = {
+		.bin = counter->bin,
+		.digest = counter->digest,
+		.value = 0,
+		.read_shards = 0,
+		.result = AEROSPIKE_OK
+	};
+
+	as_status rc = counter_sum_shards(as, err, policy, counter, 0, read_shards, &sum);
+
+	if ( rc != AEROSPIKE_OK ) {
+		return rc;
+	}
+
+	// Another client grew or shrank the counter since this one loaded it.
+	if ( sum.read_shards > read_shards && sum.read_shards <= AS_COUNTER_MAX_SHARDS ) {
+		rc = counter_sum_shards(as, err, policy, counter, read_shards, sum.read_shards, &sum);
+
+		if ( rc != AEROSPIKE_OK ) {
+			return rc;
+		}
+	}
+
+	if ( sum.result != AEROSPIKE_OK ) {
+		return as_error_update(err, sum.result, "Failed to read counter shard");
+	}
+
+	*value = sum.value;
+	return AEROSPIKE_OK;
+}
+
+as_status aerospike_counter_reshard(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	as_counter * counter, uint32_t n_shards)
+{
+	as_error_reset(err);
+
+	if ( n_shards == 0 || n_shards > AS_COUNTER_MAX_SHARDS ) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "Invalid shard count %u", n_shards);
+	}
+
+	as_policy_operate p = policy ? *policy : as->config.policies.operate;
+	p.key = AS_POLICY_KEY_DIGEST;
+
+	uint32_t read_shards = ck_pr_load_32(&counter->read_shards);
+	uint32_t old_shards = read_shards > n_shards ? read_shards : n_shards;
+	as_status rc;
+
+	// Resharding to the current count again finishes a shrink.
+	bool finish = n_shards == counter->n_shards;
+
+	if ( ! finish ) {
+		// Publish the new count first, so clients loading it stop
+		// incrementing dropped shards but keep reading them.
+		rc = counter_store_shards(as, err, &p, counter, n_shards, old_shards);
+
+		if ( rc != AEROSPIKE_OK ) {
+			return rc;
+		}
+
+		ck_pr_store_32(&counter->read_shards, old_shards);
+		ck_pr_store_32(&counter->n_shards, n_shards);
+	}
+
+	as_policy_read rp = as->config.policies.read;
+	rp.timeout = p.timeout;
+	rp.key = AS_POLICY_KEY_DIGEST;
+
+	const char * bins[] = { counter->bin, NULL };
+
+	for ( uint32_t i = n_shards; i < old_shards; i++ ) {
+		as_key key;
+		as_counter_shard_key(counter, i, &key);
+
+		as_record * rec = NULL;
+		rc = aerospike_key_select(as, err, &rp, &key, bins, &rec);
+		as_key_destroy(&key);
+
+		if ( rc == AEROSPIKE_ERR_RECORD_NOT_FOUND ) {
+			as_error_reset(err);
+			continue;
+		}
+
+		if ( rc != AEROSPIKE_OK ) {
+			return rc;
+		}
+
+		int64_t value = as_record_get_int64(rec, counter->bin, 0);
+		as_record_destroy(rec);
+
+		if ( value == 0 ) {
+			continue;
+		}
+
+		// Subtract first, so concurrent reads may briefly undercount but
+		// never count the value twice.
+		rc = counter_incr(as, err, &p, counter, i, -value);
+
+		if ( rc != AEROSPIKE_OK ) {
+			return rc;
+		}
+
+		rc = counter_incr(as, err, &p, counter, i % n_shards, value);
+
+		if ( rc != AEROSPIKE_OK ) {
+			// Put the value back so a retry moves it again.
+			as_error undo_err;
+			counter_incr(as, &undo_err, &p, counter, i, value);
+			return rc;
+		}
+	}
+
+	if ( finish && old_shards > n_shards ) {
+		// The dropped shards are empty - stop reading them.
+		rc = counter_store_shards(as, err, &p, counter, n_shards, n_shards);
+
+		if ( rc != AEROSPIKE_OK ) {
+			return rc;
+		}
+		ck_pr_store_32(&counter->read_shards, n_shards);
+	}
+	return AEROSPIKE_OK;
+}
+
+as_status aerospike_counter_load(
+	aerospike * as, as_error * err, const as_policy_read * policy, 
+	as_counter * counter)
+{
+	as_error_reset(err);
+
+	as_policy_read p = policy ? *policy : as->config.policies.read;
+	p.key = AS_POLICY_KEY_DIGEST;
+
+	as_key key;
+	as_counter_shard_key(counter, 0, &key);
+
+	const char * bins[] = { AS_COUNTER_SHARDS_BIN, AS_COUNTER_READ_SHARDS_BIN, NULL };
+	as_record * rec = NULL;
+	as_status rc = aerospike_key_select(as, err, &p, &key, bins, &rec);
+	as_key_destroy(&key);
+
+	if ( rc == AEROSPIKE_ERR_RECORD_NOT_FOUND ) {
+		// Never resharded - keep the initial count.
+		as_error_reset(err);
+		return AEROSPIKE_OK;
+	}
+
+	if ( rc != AEROSPIKE_OK ) {
+		return rc;
+	}
+
+	int64_t n_shards = as_record_get_int64(rec, AS_COUNTER_SHARDS_BIN, 0);
+	int64_t read_shards = as_record_get_int64(rec, AS_COUNTER_READ_SHARDS_BIN, 0);
+	as_record_destroy(rec);
+
+	if ( n_shards <= 0 || n_shards > AS_COUNTER_MAX_SHARDS || read_shards < n_shards || read_shards > AS_COUNTER_MAX_SHARDS ) {
+		// Base record was only incremented.
+		return AEROSPIKE_OK;
+	}
+
+	ck_pr_store_32(&counter->read_shards, (uint32_t) read_shards);
+	ck_pr_store_32(&counter->n_shards, (uint32_t) n_shards);
+	return AEROSPIKE_OK;
+}
@@ -15,6 +15,7 @@
  * the License.
  */
 #include <aerospike/aerospike_index.h>
+#include <aerospike/as_job_watcher.h>
 #include <aerospike/as_log.h>
 #include <citrusleaf/cl_sindex.h>
 #include "_shim.h"
@@ -87,46 +88,6 @@ as_status aerospike_index_create(
 	return err->code;
 }
 
-static bool
-aerospike_index_create_is_done(as_cluster* cluster, char* command)
-{
-	// Index is not done if any node reports percent completed < 100.
-	// Errors are ignored and considered done.
-	bool done = true;
-	as_nodes* nodes = as_nodes_reserve(cluster);
-	
-	for (uint32_t i = 0; i < nodes->size && done; i++) {
-		as_node* node = nodes->array[i];
-		struct sockaddr_in* sa_in = as_node_get_address(node);
-		
-		char* response = 0;
-		int rc = citrusleaf_info_host_auth(cluster, sa_in, command, &response, 1000, false, true);
-		
-		if (rc == AEROSPIKE_OK) {
-			char* find = "load_pct=";
-			char* p = strstr(response, find);
-			
-			if (p) {
-				p += strlen(find);
-				char* q = strchr(p, ';');
-				
-				if (q) {
-					*q = 0;
-				}
-				
-				int pct = atoi(p);
-				
-				if (pct >= 0 && pct < 100) {
-					done = false;
-				}
-			}
-		}
-		free(response);
-	}
-	as_nodes_release(nodes);
-	return done;
-}
-
 /**
  *	Wait for asynchronous task to complete using given polling interval.
  *
@@ -145,16 +106,44 @@ aerospike_index_create_wait(as_error * err, as_index_task * task, uint32_t inter
 		return AEROSPIKE_OK;
 	}
 	
-	char command[256];
-	snprintf(command, sizeof(command), "sindex/%s/%s" , task->ns, task->name);
-	
-	as_cluster* cluster = task->as->cluster;
-	uint32_t interval_micros = (interval_ms <= 0)? 1000 * 1000 : interval_ms * 1000;
+	// Errors are ignored and considered done.
+	as_job job;
+	as_job_init_index(&job, task->ns, task->name, 1000, interval_ms);
+	as_job_watcher_wait(task->as->cluster, &job);
+	task->done = true;
+	return AEROSPIKE_OK;
+}
+
+/**
+ *	Register a listener to be called when the asynchronous task completes.
+ *
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param task			The task data used to poll for completion.
+ *	@param interval_ms	The polling interval in milliseconds. If zero, 1000 ms is used.
+ *	@param listener		The function called when the task completes.
+ *	@param udata		User-data to be passed to the listener.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup index_operations
+ */
+as_status
+aerospike_index_create_listen(
+	as_error * err, as_index_task * task, uint32_t interval_ms,
+	as_job_listener listener, void * udata)
+{
+	as_error_reset(err);
 	
-	while (! task->done) {
-		usleep(interval_micros);
-		task->done = aerospike_index_create_is_done(cluster, command);
+	if (task->done) {
+		listener(AEROSPIKE_OK, udata);
+		return AEROSPIKE_OK;
 	}
+	
+	as_job job;
+	as_job_init_index(&job, task->ns, task->name, 1000, interval_ms);
+	job.listener = listener;
+	job.udata = udata;
+	as_job_watcher_listen(task->as->cluster, &job);
 	return AEROSPIKE_OK;
 }
 
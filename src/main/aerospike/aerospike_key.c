@@ -17,6 +17,7 @@
 #include <aerospike/aerospike.h>
 #include <aerospike/aerospike_key.h>
 
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_bin.h>
 #include <aerospike/as_buffer.h>
 #include <aerospike/as_error.h>
@@ -94,16 +95,16 @@ as_status aerospike_key_get(
 	switch ( policy->key ) {
 		case AS_POLICY_KEY_DIGEST: {
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_get_all(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value,
-					&values, &nvalues, timeout, &gen, &ttl, consistency_level, policy->replica);
+			rc = citrusleaf_get_all_route(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value,
+					&values, &nvalues, timeout, &gen, &ttl, consistency_level, policy->replica, key->route);
 			break;
 		}
 		case AS_POLICY_KEY_SEND: {
 			cl_object okey;
 			asval_to_clobject((as_val *) key->valuep, &okey);
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_get_all(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value,
-					&values, &nvalues, timeout, &gen, &ttl, consistency_level, policy->replica);
+			rc = citrusleaf_get_all_route(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value,
+					&values, &nvalues, timeout, &gen, &ttl, consistency_level, policy->replica, key->route);
 			break;
 		}
 		default: {
@@ -123,7 +124,7 @@ as_status aerospike_key_get(
 			r->bins.entries = malloc(sizeof(as_bin) * nvalues);
 			r->bins._free = true;
 		}
-		clbins_to_asrecord(values, nvalues, r);
+		clbins_to_asrecord(values, nvalues, r, policy->deserialize);
 		r->gen = (uint16_t) gen;
 		r->ttl = ttl;
 		*rec = r;
@@ -202,16 +203,16 @@ as_status aerospike_key_select(
 	switch ( policy->key ) {
 		case AS_POLICY_KEY_DIGEST: {
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_get(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value,
-					values, nvalues, timeout, &gen, &ttl, consistency_level, policy->replica);
+			rc = citrusleaf_get_route(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value,
+					values, nvalues, timeout, &gen, &ttl, consistency_level, policy->replica, key->route);
 			break;
 		}
 		case AS_POLICY_KEY_SEND: {
 			cl_object okey;
 			asval_to_clobject((as_val *) key->valuep, &okey);
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_get(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value,
-					values, nvalues, timeout, &gen, &ttl, consistency_level, policy->replica);
+			rc = citrusleaf_get_route(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value,
+					values, nvalues, timeout, &gen, &ttl, consistency_level, policy->replica, key->route);
 			break;
 		}
 		default: {
@@ -231,7 +232,7 @@ as_status aerospike_key_select(
 			r->bins.entries = malloc(sizeof(as_bin) * nvalues);
 			r->bins._free = true;
 		}
-		clbins_to_asrecord(values, nvalues, r);
+		clbins_to_asrecord(values, nvalues, r, policy->deserialize);
 		r->gen = (uint16_t) gen;
 		r->ttl = ttl;
 		*rec = r;
@@ -295,16 +296,16 @@ as_status aerospike_key_exists(
 	switch ( policy->key ) {
 		case AS_POLICY_KEY_DIGEST: {
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_exists_key(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value,
-					values, nvalues, timeout, &gen, &ttl, consistency_level, policy->replica);
+			rc = citrusleaf_exists_key_route(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value,
+					values, nvalues, timeout, &gen, &ttl, consistency_level, policy->replica, key->route);
 			break;
 		}
 		case AS_POLICY_KEY_SEND: {
 			cl_object okey;
 			asval_to_clobject((as_val *) key->valuep, &okey);
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_exists_key(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value,
-					values, nvalues, timeout, &gen, &ttl, consistency_level, policy->replica);
+			rc = citrusleaf_exists_key_route(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value,
+					values, nvalues, timeout, &gen, &ttl, consistency_level, policy->replica, key->route);
 			break;
 		}
 		default: {
@@ -392,14 +393,14 @@ as_status aerospike_key_put(
 	switch ( policy->key ) {
 		case AS_POLICY_KEY_DIGEST: {
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_put(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value, values, nvalues, &wp, commit_level);
+			rc = citrusleaf_put_route(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value, values, nvalues, &wp, commit_level, key->route);
 			break;
 		}
 		case AS_POLICY_KEY_SEND: {
 			cl_object okey;
 			asval_to_clobject((as_val *) key->valuep, &okey);
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_put(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value, values, nvalues, &wp, commit_level);
+			rc = citrusleaf_put_route(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value, values, nvalues, &wp, commit_level, key->route);
 			break;
 		}
 		default: {
@@ -468,14 +469,14 @@ as_status aerospike_key_remove(
 	switch ( policy->key ) {
 		case AS_POLICY_KEY_DIGEST: {
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_delete(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value, &wp, commit_level);
+			rc = citrusleaf_delete_route(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value, &wp, commit_level, key->route);
 			break;
 		}
 		case AS_POLICY_KEY_SEND: {
 			cl_object okey;
 			asval_to_clobject((as_val *) key->valuep, &okey);
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_delete(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value, &wp, commit_level);
+			rc = citrusleaf_delete_route(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value, &wp, commit_level, key->route);
 			break;
 		}
 		default: {
@@ -487,6 +488,82 @@ as_status aerospike_key_remove(
 	return as_error_fromrc(err,rc);
 }
 
+static void
+as_operate_levels(const as_policy_operate * policy, int * consistency_level, int * commit_level)
+{
+	*consistency_level = 0;
+	switch ( policy->consistency_level ) {
+		case AS_POLICY_CONSISTENCY_LEVEL_ONE:
+			*consistency_level &= ~CL_MSG_INFO1_CONSISTENCY_LEVEL_B0;
+			*consistency_level &= ~CL_MSG_INFO1_CONSISTENCY_LEVEL_B1;
+			break;
+		case AS_POLICY_CONSISTENCY_LEVEL_ALL:
+			*consistency_level |= CL_MSG_INFO1_CONSISTENCY_LEVEL_B0;
+			*consistency_level &= ~CL_MSG_INFO1_CONSISTENCY_LEVEL_B1;
+			break;
+		default: {
+			// ERROR CASE
+			break;
+		}
+	}
+
+	*commit_level = 0;
+	switch ( policy->commit_level ) {
+		case AS_POLICY_COMMIT_LEVEL_ALL:
+			*commit_level &= ~CL_MSG_INFO3_COMMIT_LEVEL_B0;
+			*commit_level &= ~CL_MSG_INFO3_COMMIT_LEVEL_B1;
+			break;
+		case AS_POLICY_COMMIT_LEVEL_MASTER:
+			*commit_level |= CL_MSG_INFO3_COMMIT_LEVEL_B0;
+			*commit_level &= ~CL_MSG_INFO3_COMMIT_LEVEL_B1;
+			break;
+		default: {
+			// ERROR CASE
+			break;
+		}
+	}
+}
+
+static as_status
+as_operate_result(
+	as_error * err, cl_rv rc, cl_bin * result_bins, int n_operations, int n_read_ops,
+	uint32_t gen, uint32_t ttl, as_record ** rec)
+{
+	if (n_read_ops != n_operations) {
+		if (result_bins) {
+			citrusleaf_bins_free(result_bins, n_operations);
+			free(result_bins);
+		}
+
+		return as_error_update(err, AEROSPIKE_ERR, "expected %d bins, got %d", n_read_ops, n_operations);
+	}
+
+	if ( n_read_ops != 0 && rc == AEROSPIKE_OK && rec != NULL ) {
+		as_record * r = *rec;
+		if ( r == NULL ) {
+			r = as_record_new(0);
+		}
+		if ( r->bins.entries == NULL ) {
+			r->bins.capacity = n_operations;
+			r->bins.size = 0;
+			r->bins.entries = malloc(sizeof(as_bin) * n_operations);
+			r->bins._free = true;
+		}
+		clbins_to_asrecord(result_bins, n_operations, r, true);
+		r->gen = (uint16_t) gen;
+		r->ttl = ttl;
+
+		*rec = r;
+	}
+
+	if (result_bins) {
+		citrusleaf_bins_free(result_bins, n_operations);
+		free(result_bins);
+	}
+
+	return as_error_fromrc(err,rc);
+}
+
 /**
  *	Lookup a record by key, then perform specified operations.
  *
@@ -557,36 +634,8 @@ as_status aerospike_key_operate(
 	}
 
 	int consistency_level = 0;
-	switch ( policy->consistency_level ) {
-		case AS_POLICY_CONSISTENCY_LEVEL_ONE:
-			consistency_level &= ~CL_MSG_INFO1_CONSISTENCY_LEVEL_B0;
-			consistency_level &= ~CL_MSG_INFO1_CONSISTENCY_LEVEL_B1;
-			break;
-		case AS_POLICY_CONSISTENCY_LEVEL_ALL:
-			consistency_level |= CL_MSG_INFO1_CONSISTENCY_LEVEL_B0;
-			consistency_level &= ~CL_MSG_INFO1_CONSISTENCY_LEVEL_B1;
-			break;
-		default: {
-			// ERROR CASE
-			break;
-		}
-	}
-
 	int commit_level = 0;
-	switch ( policy->commit_level ) {
-		case AS_POLICY_COMMIT_LEVEL_ALL:
-			commit_level &= ~CL_MSG_INFO3_COMMIT_LEVEL_B0;
-			commit_level &= ~CL_MSG_INFO3_COMMIT_LEVEL_B1;
-			break;
-		case AS_POLICY_COMMIT_LEVEL_MASTER:
-			commit_level |= CL_MSG_INFO3_COMMIT_LEVEL_B0;
-			commit_level &= ~CL_MSG_INFO3_COMMIT_LEVEL_B1;
-			break;
-		default: {
-			// ERROR CASE
-			break;
-		}
-	}
+	as_operate_levels(policy, &consistency_level, &commit_level);
 
 	cl_rv rc = AEROSPIKE_OK;
 	cl_bin *result_bins = NULL;
@@ -594,16 +643,16 @@ as_status aerospike_key_operate(
 	switch ( policy->key ) {
 		case AS_POLICY_KEY_DIGEST: {
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_operate(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value,
-					&result_bins, operations, &n_operations, &wp, &gen, &ttl, consistency_level, commit_level, policy->replica);
+			rc = citrusleaf_operate_route(as->cluster, key->ns, key->set, NULL, (cf_digest*)digest->value,
+					&result_bins, operations, &n_operations, &wp, &gen, &ttl, consistency_level, commit_level, policy->replica, key->route);
 			break;
 		}
 		case AS_POLICY_KEY_SEND: {
 			cl_object okey;
 			asval_to_clobject((as_val *) key->valuep, &okey);
 			as_digest * digest = as_key_digest((as_key *) key);
-			rc = citrusleaf_operate(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value,
-					&result_bins, operations, &n_operations, &wp, &gen, &ttl, consistency_level, commit_level, policy->replica);
+			rc = citrusleaf_operate_route(as->cluster, key->ns, key->set, &okey, (cf_digest*)digest->value,
+					&result_bins, operations, &n_operations, &wp, &gen, &ttl, consistency_level, commit_level, policy->replica, key->route);
 			break;
 		}
 		default: {
@@ -616,39 +665,145 @@ as_status aerospike_key_operate(
 		citrusleaf_object_free(&operations[i].bin.object);
 	}
 
-    if (n_read_ops != n_operations) {
-		if (result_bins) {
-			citrusleaf_bins_free(result_bins, n_operations);
-			free(result_bins);
-		}
+	return as_operate_result(err, rc, result_bins, n_operations, n_read_ops, gen, ttl, rec);
+}
 
-		return as_error_update(err, AEROSPIKE_ERR, "expected %d bins, got %d", n_read_ops, n_operations);
+/**
+ *	Lay out the operations once so that repeated calls to
+ *	aerospike_key_operate_prepared() with the same shape skip re-encoding the
+ *	op headers and bin names.
+ */
+as_status aerospike_key_operate_prepare(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	const as_operations * ops, as_operations_prepared * prepared)
+{
+	as_error_reset(err);
+
+	if (! policy) {
+		policy = &as->config.policies.operate;
 	}
 
-	if ( n_read_ops != 0 && rc == AEROSPIKE_OK && rec != NULL ) {
-		as_record * r = *rec;
-		if ( r == NULL ) {
-			r = as_record_new(0);
+	int 			n_operations = ops->binops.size;
+	cl_operation * 	operations = (cl_operation *) alloca(sizeof(cl_operation) * n_operations);
+	as_operator *	operators = (as_operator *) as_alloc_malloc(AS_ALLOC_TAG_SHIM, sizeof(as_operator) * (n_operations ? n_operations : 1));
+	int				n_read_ops = 0;
+
+	for (int i = 0; i < n_operations; i++) {
+		cl_operation * clop = &operations[i];
+		as_binop * op = &ops->binops.entries[i];
+
+		strcpy(clop->bin.bin_name, op->bin.name);
+		clop->op = (cl_operator)op->op;
+		operators[i] = op->op;
+
+		if (op->op == AS_OPERATOR_READ) {
+			n_read_ops++;
 		}
-		if ( r->bins.entries == NULL ) {
-			r->bins.capacity = n_operations;
-			r->bins.size = 0;
-			r->bins.entries = malloc(sizeof(as_bin) * n_operations);
-			r->bins._free = true;
+	}
+
+	int consistency_level = 0;
+	int commit_level = 0;
+	as_operate_levels(policy, &consistency_level, &commit_level);
+
+	cl_operate_template * tmpl = (cl_operate_template *) as_alloc_malloc(AS_ALLOC_TAG_SHIM, sizeof(cl_operate_template));
+
+	if (citrusleaf_operate_template_init(tmpl, operations, n_operations, consistency_level, commit_level) != 0) {
+		as_alloc_free(tmpl);
+		as_alloc_free(operators);
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "invalid operations");
+	}
+
+	prepared->policy = *policy;
+	prepared->operators = operators;
+	prepared->n_ops = (uint16_t)n_operations;
+	prepared->n_read_ops = (uint16_t)n_read_ops;
+	prepared->tmpl = tmpl;
+	return AEROSPIKE_OK;
+}
+
+/**
+ *	Perform prepared operations, taking only the values, ttl and generation
+ *	from the given operations.
+ */
+as_status aerospike_key_operate_prepared(
+	aerospike * as, as_error * err, const as_operations_prepared * prepared,
+	const as_key * key, const as_operations * ops,
+	as_record ** rec)
+{
+	// we want to reset the error so, we have a clean state
+	as_error_reset(err);
+
+	const as_policy_operate * policy = &prepared->policy;
+
+	if ( ops->binops.size != prepared->n_ops ) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "expected %d operations, got %d", prepared->n_ops, ops->binops.size);
+	}
+
+	cl_write_parameters wp;
+	aspolicyoperate_to_clwriteparameters(policy, ops, &wp);
+
+	uint32_t 		gen = 0;
+	uint32_t 		ttl = 0;
+	int 			n_operations = prepared->n_ops;
+	cl_object * 	objects = (cl_object *) alloca(sizeof(cl_object) * n_operations);
+
+	for (int i = 0; i < n_operations; i++) {
+		as_binop * op = &ops->binops.entries[i];
+
+		if ( op->op != prepared->operators[i] ) {
+			for (int j = 0; j < i; j++) {
+				citrusleaf_object_free(&objects[j]);
+			}
+			return as_error_update(err, AEROSPIKE_ERR_PARAM, "operation %d does not match prepared operation", i);
 		}
-		clbins_to_asrecord(result_bins, n_operations, r);
-		r->gen = (uint16_t) gen;
-		r->ttl = ttl;
+		asbinvalue_to_clobject(op->bin.valuep, &objects[i]);
+	}
 
-		*rec = r;
+	cl_rv rc = AEROSPIKE_OK;
+	cl_bin *result_bins = NULL;
+
+	switch ( policy->key ) {
+		case AS_POLICY_KEY_DIGEST: {
+			as_digest * digest = as_key_digest((as_key *) key);
+			rc = citrusleaf_operate_template_route(as->cluster, prepared->tmpl, key->ns, key->set, NULL, (cf_digest*)digest->value,
+					objects, &result_bins, &n_operations, &wp, &gen, &ttl, policy->replica, key->route);
+			break;
+		}
+		case AS_POLICY_KEY_SEND: {
+			cl_object okey;
+			asval_to_clobject((as_val *) key->valuep, &okey);
+			as_digest * digest = as_key_digest((as_key *) key);
+			rc = citrusleaf_operate_template_route(as->cluster, prepared->tmpl, key->ns, key->set, &okey, (cf_digest*)digest->value,
+					objects, &result_bins, &n_operations, &wp, &gen, &ttl, policy->replica, key->route);
+			break;
+		}
+		default: {
+			// ERROR CASE
+			break;
+		}
 	}
 
-	if (result_bins) {
-		citrusleaf_bins_free(result_bins, n_operations);
-		free(result_bins);
+	for (int i = 0; i < prepared->n_ops; i++) {
+		citrusleaf_object_free(&objects[i]);
 	}
 
-	return as_error_fromrc(err,rc);
+	return as_operate_result(err, rc, result_bins, n_operations, prepared->n_read_ops, gen, ttl, rec);
+}
+
+/**
+ *	Release the resources held by prepared operations.
+ */
+void as_operations_prepared_destroy(as_operations_prepared * prepared)
+{
+	if ( prepared->tmpl ) {
+		citrusleaf_operate_template_destroy(prepared->tmpl);
+		as_alloc_free(prepared->tmpl);
+		prepared->tmpl = NULL;
+	}
+	as_alloc_free(prepared->operators);
+	prepared->operators = NULL;
+	prepared->n_ops = 0;
+	prepared->n_read_ops = 0;
 }
 
 /**
@@ -755,7 +910,7 @@ as_status aerospike_key_apply(
 			rc = do_the_full_monte( 
 				as->cluster, 0, CL_MSG_INFO2_WRITE, commit_level,
 				key->ns, key->set, NULL, (cf_digest*)digest->value, &bins, CL_OP_WRITE, 0, &n_bins,
-				NULL, &wp, &trid, NULL, &call, NULL, -1
+				NULL, &wp, &trid, NULL, &call, NULL, -1, key->route
 			);
 			break;
 		}
@@ -766,7 +921,7 @@ as_status aerospike_key_apply(
 			rc = do_the_full_monte( 
 				as->cluster, 0, CL_MSG_INFO2_WRITE, commit_level,
 				key->ns, key->set, &okey, (cf_digest*)digest->value, &bins, CL_OP_WRITE, 0, &n_bins,
-				NULL, &wp, &trid, NULL, &call, NULL, -1
+				NULL, &wp, &trid, NULL, &call, NULL, -1, key->route
 			);
 			break;
 		}
@@ -0,0 +1,671 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_batch.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/aerospike_lob.h>
+#include <aerospike/as_batch.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <citrusleaf/cf_queue.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#include "ck_pr.h"
+
+/************************************************************************
+ * 	MACROS
+ ************************************************************************/
+
+#define LOB_BIN "lob"
+#define LOB_BIN_SIZE "lob_size"
+#define LOB_BIN_CHUNK "lob_chunk"
+#define LOB_BIN_N "lob_n"
+#define LOB_BIN_ID "lob_id"
+
+// Manifest reads when chunks are replaced by a concurrent write.
+#define LOB_READ_TRIES 3
+
+/************************************************************************
+ * 	TYPES
+ ************************************************************************/
+
+typedef struct lob_manifest_s {
+
+	uint32_t size;
+
+	uint32_t chunk_size;
+
+	// 0 if the value is stored in the manifest.
+	uint32_t n_chunks;
+
+	uint64_t id;
+
+	uint16_t gen;
+
+} lob_manifest;
+
+// Chunk writes or removes shared by a set of threads.
+typedef struct lob_job_s {
+
+	aerospike * as;
+
+	const as_key * key;
+
+	uint64_t id;
+
+	uint32_t n_chunks;
+
+	// Remove rather than write the chunks.
+	bool remove;
+
+	as_policy_write write_policy;
+
+	as_policy_remove remove_policy;
+
+	const uint8_t * value;
+
+	uint32_t size;
+
+	uint32_t chunk_size;
+
+	// Next chunk to claim.
+	uint32_t next;
+
+	// Set on first failure, so other threads stop claiming chunks.
+	uint32_t failed;
+
+	// First failure.
+	pthread_mutex_t lock;
+	as_error err;
+
+} lob_job;
+
+// A job handed to the cluster's chunk threads.  Freed by whichever of the
+// caller and the queued helpers releases it last.
+typedef struct lob_task_s {
+
+	pthread_mutex_t lock;
+
+	pthread_cond_t cond;
+
+	// The caller's job.  Only used by helpers counted in active.
+	lob_job * job;
+
+	// Set once the caller finished its share.  Helpers popped later leave
+	// the job alone.
+	bool closed;
+
+	// Helpers working on the job.
+	uint32_t active;
+
+	// Caller plus queued helpers.
+	uint32_t refs;
+
+} lob_task;
+
+typedef struct lob_reader_s {
+
+	uint8_t * buf;
+
+	uint32_t size;
+
+	uint32_t chunk_size;
+
+	as_status result;
+
+} lob_reader;
+
+/**************************************************************************
+ * 	STATIC FUNCTIONS
+ **************************************************************************/
+
+static void
+lob_chunk_key(const as_key * key, uint64_t id, uint32_t index, as_key * chunk)
+{
+	as_digest_value digest;
+	memcpy(digest, as_key_digest((as_key *) key)->value, sizeof(digest));
+
+	// Mixing the index into the partition bits spreads consecutive chunks
+	// over distinct partitions.  The id keeps each write's chunks apart.
+	uint32_t w[2];
+	memcpy(w, digest, sizeof(w));
+	w[0] ^= (uint32_t) id ^ ((index + 1) * 0x9E3779B9);
+	w[1] ^= (uint32_t) (id >> 32);
+	memcpy(digest, w, sizeof(w));
+
+	as_key_init_digest(chunk, key->ns, key->set, digest);
+}
+
+static uint64_t
+lob_new_id()
+{
+	// Only needs to differ from concurrent writes of the same key.
+	uint64_t id = cf_getus() ^ ((uint64_t) (uintptr_t) pthread_self() << 24);
+	id *= 0x9E3779B97F4A7C15ULL;
+	return id ? id : 1;
+}
+
+static void
+lob_manifest_parse(const as_record * rec, lob_manifest * m)
+{
+	m->size = (uint32_t) as_record_get_int64(rec, LOB_BIN_SIZE, 0);
+	m->chunk_size = (uint32_t) as_record_get_int64(rec, LOB_BIN_CHUNK, 0);
+	m->n_chunks = (uint32_t) as_record_get_int64(rec, LOB_BIN_N, 0);
+	m->id = (uint64_t) as_record_get_int64(rec, LOB_BIN_ID, 0);
+	m->gen = rec->gen;
+}
+
+static void *
+lob_job_worker(void * udata)
+{
+	lob_job * job = (lob_job *) udata;
+
+	while ( ck_pr_load_32(&job->failed) == 0 ) {
+		uint32_t i = ck_pr_faa_32(&job->next, 1);
+
+		if ( i >= job->n_chunks ) {
+			break;
+		}
+
+		as_key chunk;
+		lob_chunk_key(job->key, job->id, i, &chunk);
+
+		as_error err;
+		as_status rc;
+
+		if ( job->remove ) {
+			rc = aerospike_key_remove(job->as, &err, &job->remove_policy, &chunk);
+
+			if ( rc == AEROSPIKE_ERR_RECORD_NOT_FOUND ) {
+				rc = AEROSPIKE_OK;
+			}
+		}
+		else {
+			uint32_t offset = i * job->chunk_size;
+			uint32_t len = job->size - offset < job->chunk_size ? job->size - offset : job->chunk_size;
+
+			as_record rec;
+			as_record_init(&rec, 1);
+			as_record_set_rawp(&rec, LOB_BIN, job->value + offset, len, false);
+			rc = aerospike_key_put(job->as, &err, &job->write_policy, &chunk, &rec);
+			as_record_destroy(&rec);
+		}
+		as_key_destroy(&chunk);
+
+		if ( rc != AEROSPIKE_OK ) {
+			pthread_mutex_lock(&job->lock);
+
+			if ( ! job->failed ) {
+				job->err = err;
+				ck_pr_store_32(&job->failed, 1);
+			}
+			pthread_mutex_unlock(&job->lock);
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void
+lob_task_release(lob_task * task)
+{
+	pthread_mutex_lock(&task->lock);
+	bool last = --task->refs == 0;
+	pthread_mutex_unlock(&task->lock);
+
+	if ( ! last ) {
+		return;
+	}
+	pthread_cond_destroy(&task->cond);
+	pthread_mutex_destroy(&task->lock);
+	cf_free(task);
+}
+
+static void *
+lob_pool_worker(void * udata)
+{
+	as_cluster * cluster = (as_cluster *) udata;
+
+	while ( true ) {
+		lob_task * task;
+
+		if ( cf_queue_pop(cluster->lob_q, &task, CF_QUEUE_FOREVER) != CF_QUEUE_OK ) {
+			as_log_error("queue pop failed");
+			continue;
+		}
+
+		// This is how as_lob_shutdown() signals we're done.
+		if ( ! task ) {
+			break;
+		}
+
+		pthread_mutex_lock(&task->lock);
+		bool run = ! task->closed;
+
+		if ( run ) {
+			task->active++;
+		}
+		pthread_mutex_unlock(&task->lock);
+
+		if ( run ) {
+			lob_job_worker(task->job);
+
+			pthread_mutex_lock(&task->lock);
+
+			if ( --task->active == 0 ) {
+				pthread_cond_signal(&task->cond);
+			}
+			pthread_mutex_unlock(&task->lock);
+		}
+		lob_task_release(task);
+	}
+	return NULL;
+}
+
+// Start the cluster's chunk threads on the first large object, as batch
+// threads are started on the first batch.
+static void
+lob_pool_init(as_cluster * cluster)
+{
+	if ( ck_pr_load_32(&cluster->lob_initialized) == 1 ) {
+		return;
+	}
+
+	pthread_mutex_lock(&cluster->batch_init_lock);
+
+	if ( ck_pr_load_32(&cluster->lob_initialized) == 0 ) {
+		cluster->lob_q = cf_queue_create(sizeof(lob_task *), true);
+
+		for ( int i = 0; i < AS_NUM_LOB_THREADS; i++ ) {
+			pthread_create(&cluster->lob_threads[i], 0, lob_pool_worker, cluster);
+		}
+		ck_pr_store_32(&cluster->lob_initialized, 1);
+	}
+	pthread_mutex_unlock(&cluster->batch_init_lock);
+}
+
+static as_status
+lob_job_run(lob_job * job, as_error * err)
+{
+	if ( job->n_chunks == 0 ) {
+		return AEROSPIKE_OK;
+	}
+
+	job->next = 0;
+	job->failed = 0;
+	pthread_mutex_init(&job->lock, NULL);
+
+	// Chunk threads are shared by all large objects of the cluster, so
+	// concurrent puts and removes queue behind each other rather than
+	// start threads of their own.
+	uint32_t n_helpers = job->n_chunks - 1 < AS_NUM_LOB_THREADS ? job->n_chunks - 1 : AS_NUM_LOB_THREADS;
+	lob_task * task = NULL;
+
+	if ( n_helpers ) {
+		lob_pool_init(job->as->cluster);
+		task = (lob_task *) cf_malloc(sizeof(lob_task));
+	}
+
+	if ( task ) {
+		pthread_mutex_init(&task->lock, NULL);
+		pthread_cond_init(&task->cond, NULL);
+		task->job = job;
+		task->closed = false;
+		task->active = 0;
+		task->refs = 1 + n_helpers;
+
+		for ( uint32_t i = 0; i < n_helpers; i++ ) {
+			cf_queue_push(job->as->cluster->lob_q, &task);
+		}
+	}
+
+	// The caller's thread works too, so the job finishes even while the
+	// chunk threads are busy with other jobs.
+	lob_job_worker(job);
+
+	if ( task ) {
+		// Every chunk is claimed - wait for helpers still writing theirs.
+		pthread_mutex_lock(&task->lock);
+		task->closed = true;
+
+		while ( task->active ) {
+			pthread_cond_wait(&task->cond, &task->lock);
+		}
+		pthread_mutex_unlock(&task->lock);
+		lob_task_release(task);
+	}
+	pthread_mutex_destroy(&job->lock);
+
+	if ( job->failed ) {
+		*err = job->err;
+		return err->code;
+	}
+	return AEROSPIKE_OK;
+}
+
+static void
+lob_job_init(lob_job * job, aerospike * as, const as_key * key, uint64_t id, uint32_t n_chunks, uint32_t timeout)
+{
+	memset(job, 0, sizeof(lob_job));
+	job->as = as;
+	job->key = key;
+	job->id = id;
+	job->n_chunks = n_chunks;
+
+	// Chunk keys are digests only - there is no user key to send.
+	job->write_policy = as->config.policies.write;
+	job->write_policy.timeout = timeout;
+	job->write_policy.key = AS_POLICY_KEY_DIGEST;
+	job->remove_policy = as->config.policies.remove;
+	job->remove_policy.timeout = timeout;
+	job->remove_policy.key = AS_POLICY_KEY_DIGEST;
+}
+
+static bool
+lob_read_callback(const as_batch_read * results, uint32_t n, void * udata)
+{
+	lob_reader * reader = (lob_reader *) udata;
+
+	for ( uint32_t i = 0; i < n; i++ ) {
+		if ( results[i].result != AEROSPIKE_OK ) {
+			reader->result = results[i].result;
+			break;
+		}
+
+		uint32_t offset = i * reader->chunk_size;
+		uint32_t len = reader->size - offset < reader->chunk_size ? reader->size - offset : reader->chunk_size;
+		as_bytes * bytes = as_record_get_bytes(&results[i].record, LOB_BIN);
+
+		if ( ! bytes || as_bytes_size(bytes) != len ) {
+			reader->result = AEROSPIKE_ERR_SERVER;
+			break;
+		}
+		memcpy(reader->buf + offset, as_bytes_get(bytes), len);
+	}
+	return true;
+}
+
+static as_status
+lob_read_chunks(
+	aerospike * as, as_error * err, uint32_t timeout, 
+	const as_key * key, const lob_manifest * m, uint8_t * buf)
+{
+	as_batch batch;
+	as_batch_init(&batch, m->n_chunks);
+
+	for ( uint32_t i = 0; i < m->n_chunks; i++ ) {
+		lob_chunk_key(key, m->id, i, as_batch_keyat(&batch, i));
+	}
+
+	as_policy_batch policy = as->config.policies.batch;
+	policy.timeout = timeout;
+
+	lob_reader reader = {
+		.buf = buf,
+		.size = m->size,
+		.chunk_size = m->chunk_size,
+		.result = AEROSPIKE_OK
+	};
+
+	as_status rc = aerospike_batch_get(as, err, &policy, &batch, lob_read_callback, &reader);
+
+	as_batch_destroy(&batch);
+
+	if ( rc != AEROSPIKE_OK ) {
+		return rc;
+	}
+
+	if ( reader.result == AEROSPIKE_ERR_RECORD_NOT_FOUND ) {
+		return as_error_update(err, reader.result, "Large object chunk not found");
+	}
+
+	if ( reader.result != AEROSPIKE_OK ) {
+		return as_error_update(err, reader.result, "Invalid large object chunk");
+	}
+	return AEROSPIKE_OK;
+}
+
+/**************************************************************************
+ * 	FUNCTIONS
+ **************************************************************************/
+
+as_status aerospike_lob_put(
+	aerospike * as, as_error * err, const as_policy_write * policy, 
+	const as_key * key, const uint8_t * value, uint32_t size, uint32_t chunk_size)
+{
+	as_error_reset(err);
+
+	if ( ! policy ) {
+		policy = &as->config.policies.write;
+	}
+
+	if ( chunk_size == 0 ) {
+		chunk_size = AS_LOB_CHUNK_SIZE;
+	}
+
+	// Find the chunks being replaced.
+	as_policy_read read_policy = as->config.policies.read;
+	read_policy.timeout = policy->timeout;
+
+	const char * bins[] = { LOB_BIN_N, LOB_BIN_ID, NULL };
+	as_record * old_rec = NULL;
+	as_status rc = aerospike_key_select(as, err, &read_policy, key, bins, &old_rec);
+
+	if ( rc != AEROSPIKE_OK && rc != AEROSPIKE_ERR_RECORD_NOT_FOUND ) {
+		return rc;
+	}
+
+	bool exists = rc == AEROSPIKE_OK;
+	lob_manifest old = { 0 };
+
+	if ( exists ) {
+		lob_manifest_parse(old_rec, &old);
+		as_record_destroy(old_rec);
+	}
+	as_error_reset(err);
+
+	// Write the chunks first - nothing refers to them yet.
+	uint32_t n_chunks = size > chunk_size ? (size + chunk_size - 1) / chunk_size : 0;
+	uint64_t id = n_chunks ? lob_new_id() : 0;
+
+	lob_job job;
+	lob_job_init(&job, as, key, id, n_chunks, policy->timeout);
+	job.value = value;
+	job.size = size;
+	job.chunk_size = chunk_size;
+
+	rc = lob_job_run(&job, err);
+
+	if ( rc == AEROSPIKE_OK ) {
+		// Switch readers to the new chunks, unless another write switched
+		// them since we looked.
+		as_record rec;
+		as_record_init(&rec, 5);
+		as_record_set_int64(&rec, LOB_BIN_SIZE, size);
+		as_record_set_int64(&rec, LOB_BIN_CHUNK, chunk_size);
+		as_record_set_int64(&rec, LOB_BIN_N, n_chunks);
+		as_record_set_int64(&rec, LOB_BIN_ID, (int64_t) id);
+
+		if ( n_chunks == 0 ) {
+			as_record_set_rawp(&rec, LOB_BIN, value, size, false);
+		}
+		else if ( exists ) {
+			as_record_set_nil(&rec, LOB_BIN);
+		}
+
+		as_policy_write manifest_policy = *policy;
+
+		if ( exists ) {
+			rec.gen = old.gen;
+			manifest_policy.gen = AS_POLICY_GEN_EQ;
+			manifest_policy.exists = AS_POLICY_EXISTS_IGNORE;
+		}
+		else {
+			manifest_policy.gen = AS_POLICY_GEN_IGNORE;
+			manifest_policy.exists = AS_POLICY_EXISTS_CREATE;
+		}
+
+		rc = aerospike_key_put(as, err, &manifest_policy, key, &rec);
+		as_record_destroy(&rec);
+	}
+
+	if ( rc != AEROSPIKE_OK ) {
+		// Remove our chunks.  Some may not have been written.
+		as_error remove_err;
+		job.remove = true;
+		lob_job_run(&job, &remove_err);
+		return rc;
+	}
+
+	// Remove the replaced chunks.  Readers still using them retry.
+	lob_job_init(&job, as, key, old.id, old.n_chunks, policy->timeout);
+	job.remove = true;
+
+	as_error remove_err;
+	lob_job_run(&job, &remove_err);
+	return AEROSPIKE_OK;
+}
+
+as_status aerospike_lob_get(
+	aerospike * as, as_error * err, const as_policy_read * policy, 
+	const as_key * key, uint8_t * buf, uint32_t capacity, uint32_t * size)
+{
+	as_error_reset(err);
+
+	if ( ! policy ) {
+		policy = &as->config.policies.read;
+	}
+
+	as_status rc = AEROSPIKE_OK;
+
+	for ( int i = 0; i < LOB_READ_TRIES; i++ ) {
+		as_record * rec = NULL;
+		rc = aerospike_key_get(as, err, policy, key, &rec);
+
+		if ( rc != AEROSPIKE_OK ) {
+			return rc;
+		}
+
+		lob_manifest m;
+		lob_manifest_parse(rec, &m);
+		*size = m.size;
+
+		if ( ! buf ) {
+			as_record_destroy(rec);
+			return AEROSPIKE_OK;
+		}
+
+		if ( capacity < m.size ) {
+			as_record_destroy(rec);
+			return as_error_update(err, AEROSPIKE_ERR_PARAM, "Buffer of %u bytes too small for %u byte value", capacity, m.size);
+		}
+
+		if ( m.n_chunks == 0 ) {
+			as_bytes * bytes = as_record_get_bytes(rec, LOB_BIN);
+
+			if ( ! bytes || as_bytes_size(bytes) != m.size ) {
+				as_record_destroy(rec);
+				return as_error_update(err, AEROSPIKE_ERR_SERVER, "Invalid large object manifest");
+			}
+			memcpy(buf, as_bytes_get(bytes), m.size);
+			as_record_destroy(rec);
+			return AEROSPIKE_OK;
+		}
+		as_record_destroy(rec);
+
+		rc = lob_read_chunks(as, err, policy->timeout, key, &m, buf);
+
+		if ( rc != AEROSPIKE_ERR_RECORD_NOT_FOUND ) {
+			return rc;
+		}
+
+		// A concurrent write replaced the chunks - read the new manifest.
+		as_error_reset(err);
+	}
+	return as_error_update(err, rc, "Large object replaced during read");
+}
+
+as_status aerospike_lob_remove(
+	aerospike * as, as_error * err, const as_policy_remove * policy, 
+	const as_key * key)
+{
+	as_error_reset(err);
+
+	if ( ! policy ) {
+		policy = &as->config.policies.remove;
+	}
+
+	as_policy_read read_policy = as->config.policies.read;
+	read_policy.timeout = policy->timeout;
+
+	const char * bins[] = { LOB_BIN_N, LOB_BIN_ID, NULL };
+	as_record * rec = NULL;
+	as_status rc = aerospike_key_select(as, err, &read_policy, key, bins, &rec);
+
+	if ( rc != AEROSPIKE_OK ) {
+		return rc;
+	}
+
+	lob_manifest m;
+	lob_manifest_parse(rec, &m);
+	as_record_destroy(rec);
+
+	// Remove the manifest first, so no reader finds partial chunks.
+	rc = aerospike_key_remove(as, err, policy, key);
+
+	if ( rc != AEROSPIKE_OK ) {
+		return rc;
+	}
+
+	lob_job job;
+	lob_job_init(&job, as, key, m.id, m.n_chunks, policy->timeout);
+	job.remove = true;
+	return lob_job_run(&job, err);
+}
+
+void
+as_lob_shutdown(as_cluster * cluster)
+{
+	// Like the batch threads, assumes no large object calls are in flight.
+	if ( ck_pr_load_32(&cluster->lob_initialized) == 0 ) {
+		return;
+	}
+
+	for ( int i = 0; i < AS_NUM_LOB_THREADS; i++ ) {
+		lob_task * task = NULL;
+		cf_queue_push(cluster->lob_q, &task);
+	}
+
+	for ( int i = 0; i < AS_NUM_LOB_THREADS; i++ ) {
+		pthread_join(cluster->lob_threads[i], NULL);
+	}
+
+	cf_queue_destroy(cluster->lob_q);
+	cluster->lob_q = NULL;
+	ck_pr_store_32(&cluster->lob_initialized, 0);
+}
@@ -0,0 +1,683 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/aerospike_multi.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <citrusleaf/cf_queue.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "ck_pr.h"
+
+/************************************************************************
+ * 	MACROS
+ ************************************************************************/
+
+// Defaults of the aerospike_multi settings.
+#define MULTI_PROBE_INTERVAL 100
+#define MULTI_MAX_FAILURES 3
+#define MULTI_DOWN_MS 5000
+
+/************************************************************************
+ * 	TYPES
+ ************************************************************************/
+
+// A hedged read.  Its first attempt and its hedge run on hedge threads while
+// the caller waits for the first answer.  Freed by whichever of the caller
+// and the attempts finishes last.
+typedef struct multi_read_s {
+
+	pthread_mutex_t lock;
+
+	pthread_cond_t cond;
+
+	// Caller plus queued attempts.
+	uint32_t refs;
+
+	// Digest only - reads don't need the user key.
+	as_key key;
+
+	bool has_policy;
+	as_policy_read policy;
+
+	// NULL terminated, or NULL for all bins.
+	const char ** bins;
+
+	// Attempts finished, and whether one of them failed.  A failure sends
+	// the hedge without waiting for its deadline.
+	uint32_t finished;
+	bool failed;
+
+	// Set once the caller took its answer.  A hedge not sent by then is
+	// dropped, and later answers are discarded.
+	bool closed;
+
+	// The first answer other than a failure, or else the last failure.
+	bool done;
+	bool hedged;
+	as_status rc;
+	as_error err;
+	as_record * rec;
+
+} multi_read;
+
+typedef struct multi_attempt_s {
+
+	aerospike_multi * multi;
+
+	// NULL tells the hedge thread to stop.
+	multi_read * read;
+
+	uint32_t cluster;
+
+	// Whether this is the hedge, sent at the deadline unless answered first.
+	bool hedge;
+
+	struct timespec deadline;
+
+} multi_attempt;
+
+/**************************************************************************
+ * 	STATIC FUNCTIONS
+ **************************************************************************/
+
+// Whether another cluster might answer where this one did not.  Client and
+// parameter errors would fail on every cluster, so they don't count.
+static inline bool
+multi_is_failure(as_status rc)
+{
+	return rc == AEROSPIKE_ERR_TIMEOUT || rc == AEROSPIKE_ERR_CLUSTER || rc == AEROSPIKE_ERR_CLUSTER_CHANGE;
+}
+
+static inline bool
+multi_is_usable(aerospike_multi * multi, uint32_t i, uint64_t now)
+{
+	as_multi_cluster * c = &multi->clusters[i];
+	return c->connected && as_cluster_is_connected(c->as.cluster) && 
+		ck_pr_load_64(&c->down_until_ms) <= now;
+}
+
+static void
+multi_record(aerospike_multi * multi, uint32_t i, as_status rc, uint64_t elapsed_us)
+{
+	as_multi_cluster * c = &multi->clusters[i];
+
+	// Moving average over about 8 reads.  Racing updates lose a sample.
+	// Errors may return early or late, so only successful reads count.
+	if ( rc == AEROSPIKE_OK ) {
+		uint64_t latency = ck_pr_load_64(&c->latency_us);
+		latency = latency ? latency - (latency >> 3) + (elapsed_us >> 3) : elapsed_us;
+		ck_pr_store_64(&c->latency_us, latency ? latency : 1);
+	}
+
+	if ( ! multi_is_failure(rc) ) {
+		ck_pr_store_32(&c->failures, 0);
+		return;
+	}
+
+	if ( ck_pr_faa_32(&c->failures, 1) + 1 >= multi->max_failures ) {
+		ck_pr_store_32(&c->failures, 0);
+		ck_pr_store_64(&c->down_until_ms, cf_getms() + multi->down_ms);
+		as_log_warn("Cluster %u failed %u reads, skipping it for %u ms", i, multi->max_failures, multi->down_ms);
+	}
+}
+
+// Unmeasured clusters come first, and the primary wins ties.
+static inline bool
+multi_is_faster(aerospike_multi * multi, uint32_t a, uint32_t b)
+{
+	uint64_t latency_a = ck_pr_load_64(&multi->clusters[a].latency_us);
+	uint64_t latency_b = ck_pr_load_64(&multi->clusters[b].latency_us);
+	return latency_a < latency_b || (latency_a == latency_b && a == multi->primary);
+}
+
+// Clusters in the order reads should try them.  Returns the count.
+static uint32_t
+multi_rank(aerospike_multi * multi, uint32_t * order)
+{
+	uint64_t now = cf_getms();
+	uint32_t n = 0;
+
+	for ( uint32_t i = 0; i < multi->n_clusters; i++ ) {
+		if ( ! multi_is_usable(multi, i, now) ) {
+			continue;
+		}
+
+		// Insertion sort by latency.
+		uint32_t j = n++;
+
+		while ( j > 0 && multi_is_faster(multi, i, order[j - 1]) ) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	if ( n == 0 ) {
+		// Everything looks down - try the connected clusters anyway, primary
+		// first.
+		if ( multi->clusters[multi->primary].connected ) {
+			order[n++] = multi->primary;
+		}
+
+		for ( uint32_t i = 0; i < multi->n_clusters; i++ ) {
+			if ( i != multi->primary && multi->clusters[i].connected ) {
+				order[n++] = i;
+			}
+		}
+		return n;
+	}
+
+	// Now and then let the runner-up take a read, so its latency stays known.
+	if ( n > 1 && multi->probe_interval && ck_pr_faa_32(&multi->n_reads, 1) % multi->probe_interval == 0 ) {
+		uint32_t best = order[0];
+		order[0] = order[1];
+		order[1] = best;
+	}
+	return n;
+}
+
+static as_status
+multi_read_cluster(
+	aerospike_multi * multi, uint32_t i, as_error * err, const as_policy_read * policy, 
+	const as_key * key, const char ** bins, as_record ** rec)
+{
+	aerospike * as = &multi->clusters[i].as;
+	uint64_t begin = cf_getus();
+	as_status rc;
+
+	if ( bins ) {
+		rc = aerospike_key_select(as, err, policy, key, bins, rec);
+	}
+	else {
+		rc = aerospike_key_get(as, err, policy, key, rec);
+	}
+
+	multi_record(multi, i, rc, cf_getus() - begin);
+	return rc;
+}
+
+static void
+multi_read_release(multi_read * read)
+{
+	pthread_mutex_lock(&read->lock);
+	bool last = --read->refs == 0;
+	pthread_mutex_unlock(&read->lock);
+
+	if ( ! last ) {
+		return;
+	}
+
+	if ( read->rec ) {
+		as_record_destroy(read->rec);
+	}
+	as_key_destroy(&read->key);
+	pthread_cond_destroy(&read->cond);
+	pthread_mutex_destroy(&read->lock);
+	cf_free(read->bins);
+	cf_free(read);
+}
+
+static void
+multi_attempt_run(multi_attempt * attempt)
+{
+	aerospike_multi * multi = attempt->multi;
+	multi_read * read = attempt->read;
+
+	pthread_mutex_lock(&read->lock);
+
+	// The hedge gives the first attempt until the deadline, unless it failed.
+	while ( attempt->hedge && ! read->closed && ! read->failed ) {
+		if ( pthread_cond_timedwait(&read->cond, &read->lock, &attempt->deadline) == ETIMEDOUT ) {
+			break;
+		}
+	}
+	bool send = ! read->closed;
+	pthread_mutex_unlock(&read->lock);
+
+	if ( send ) {
+		if ( attempt->hedge ) {
+			ck_pr_inc_64(&multi->hedges_sent);
+		}
+
+		as_policy_read policy = read->has_policy ? read->policy : 
+			multi->clusters[attempt->cluster].as.config.policies.read;
+		policy.key = AS_POLICY_KEY_DIGEST;
+
+		as_error err;
+		as_record * rec = NULL;
+		as_status rc = multi_read_cluster(multi, attempt->cluster, &err, &policy, &read->key, read->bins, &rec);
+
+		pthread_mutex_lock(&read->lock);
+		read->finished++;
+
+		if ( read->closed || read->done ) {
+			// Lost to the other attempt - nothing to cancel, as the read
+			// is already done.
+		}
+		else if ( multi_is_failure(rc) ) {
+			read->failed = true;
+			read->rc = rc;
+			read->err = err;
+		}
+		else {
+			read->done = true;
+			read->hedged = attempt->hedge;
+			read->rc = rc;
+			read->err = err;
+			read->rec = rec;
+			rec = NULL;
+		}
+		pthread_cond_broadcast(&read->cond);
+		pthread_mutex_unlock(&read->lock);
+
+		if ( rec ) {
+			as_record_destroy(rec);
+		}
+	}
+
+	multi_read_release(read);
+	ck_pr_dec_32(&multi->n_hedges);
+}
+
+static void *
+multi_hedge_worker(void * udata)
+{
+	aerospike_multi * multi = (aerospike_multi *) udata;
+
+	while ( true ) {
+		multi_attempt attempt;
+
+		if ( cf_queue_pop(multi->hedge_q, &attempt, CF_QUEUE_FOREVER) != CF_QUEUE_OK ) {
+			as_log_error("queue pop failed");
+			continue;
+		}
+
+		// This is how aerospike_multi_close() signals we're done.
+		if ( ! attempt.read ) {
+			break;
+		}
+		multi_attempt_run(&attempt);
+	}
+	return NULL;
+}
+
+static multi_read *
+multi_read_create(const as_policy_read * policy, const as_key * key, const char ** bins)
+{
+	multi_read * read = (multi_read *) cf_malloc(sizeof(multi_read));
+
+	if ( ! read ) {
+		return NULL;
+	}
+	read->bins = NULL;
+
+	if ( bins ) {
+		// One block - the pointers, then the names.
+		uint32_t n = 0;
+
+		while ( bins[n] ) {
+			n++;
+		}
+
+		read->bins = (const char **) cf_malloc(sizeof(char *) * (n + 1) + sizeof(as_bin_name) * n);
+
+		if ( ! read->bins ) {
+			cf_free(read);
+			return NULL;
+		}
+
+		as_bin_name * names = (as_bin_name *) (read->bins + n + 1);
+
+		for ( uint32_t i = 0; i < n; i++ ) {
+			as_strncpy(names[i], bins[i], sizeof(as_bin_name));
+			read->bins[i] = names[i];
+		}
+		read->bins[n] = NULL;
+	}
+
+	pthread_mutex_init(&read->lock, NULL);
+	pthread_cond_init(&read->cond, NULL);
+	read->refs = 1;
+	as_key_init_digest(&read->key, key->ns, key->set, as_key_digest((as_key *) key)->value);
+	read->has_policy = policy != NULL;
+
+	if ( policy ) {
+		read->policy = *policy;
+	}
+	read->finished = 0;
+	read->failed = false;
+	read->closed = false;
+	read->done = false;
+	read->hedged = false;
+	read->rc = AEROSPIKE_OK;
+	read->rec = NULL;
+	return read;
+}
+
+// Queue the first attempt to the best cluster and a hedge to the next best,
+// sent if the first has not answered within hedge_us.  Returns NULL if the
+// hedge threads can't take both.
+static multi_read *
+multi_hedge_start(
+	aerospike_multi * multi, const as_policy_read * policy, 
+	const as_key * key, const char ** bins, uint32_t first, uint32_t second)
+{
+	if ( ck_pr_faa_32(&multi->n_hedges, 2) + 2 > multi->n_hedge_threads ) {
+		ck_pr_sub_32(&multi->n_hedges, 2);
+		return NULL;
+	}
+
+	multi_read * read = multi_read_create(policy, key, bins);
+
+	if ( ! read ) {
+		ck_pr_sub_32(&multi->n_hedges, 2);
+		return NULL;
+	}
+
+	multi_attempt attempt = {
+		.multi = multi,
+		.read = read,
+		.cluster = first,
+		.hedge = false
+	};
+
+	multi_attempt hedge = {
+		.multi = multi,
+		.read = read,
+		.cluster = second,
+		.hedge = true
+	};
+
+	clock_gettime(CLOCK_REALTIME, &hedge.deadline);
+	uint64_t ns = (uint64_t) hedge.deadline.tv_nsec + (uint64_t) multi->hedge_us * 1000;
+	hedge.deadline.tv_sec += ns / 1000000000;
+	hedge.deadline.tv_nsec = ns % 1000000000;
+
+	read->refs += 2;
+	cf_queue_push(multi->hedge_q, &attempt);
+	cf_queue_push(multi->hedge_q, &hedge);
+	return read;
+}
+
+// Wait for the first answer of the two attempts which isn't a failure, or
+// for both to fail.  The other attempt's answer is discarded.
+static as_status
+multi_hedge_wait(aerospike_multi * multi, multi_read * read, as_error * err, as_record ** rec)
+{
+	pthread_mutex_lock(&read->lock);
+
+	while ( ! read->done && read->finished < 2 ) {
+		pthread_cond_wait(&read->cond, &read->lock);
+	}
+
+	as_status rc = read->rc;
+
+	if ( rc == AEROSPIKE_OK ) {
+		*rec = read->rec;
+		read->rec = NULL;
+	}
+	else {
+		*err = read->err;
+	}
+
+	if ( read->hedged ) {
+		ck_pr_inc_64(&multi->hedge_wins);
+	}
+
+	// Wake a hedge still waiting for its deadline.
+	read->closed = true;
+	pthread_cond_broadcast(&read->cond);
+	pthread_mutex_unlock(&read->lock);
+
+	multi_read_release(read);
+	return rc;
+}
+
+static as_status
+multi_get(
+	aerospike_multi * multi, as_error * err, const as_policy_read * policy, 
+	const as_key * key, const char ** bins, as_record ** rec)
+{
+	as_error_reset(err);
+
+	uint32_t order[AS_MULTI_MAX_CLUSTERS];
+	uint32_t n = multi_rank(multi, order);
+
+	if ( n == 0 ) {
+		return as_error_update(err, AEROSPIKE_ERR_CLUSTER, "No cluster connected");
+	}
+
+	multi_read * read = NULL;
+
+	if ( multi->hedge_q && n > 1 && *rec == NULL ) {
+		read = multi_hedge_start(multi, policy, key, bins, order[0], order[1]);
+	}
+
+	as_status rc;
+	uint32_t i;
+
+	if ( read ) {
+		rc = multi_hedge_wait(multi, read, err, rec);
+		i = 2;
+	}
+	else {
+		// Not hedged - the caller's thread reads.
+		rc = multi_read_cluster(multi, order[0], err, policy, key, bins, rec);
+		i = 1;
+	}
+
+	// Fail over in latency order.
+	for ( ; i < n && multi_is_failure(rc); i++ ) {
+		rc = multi_read_cluster(multi, order[i], err, policy, key, bins, rec);
+	}
+	return rc;
+}
+
+static aerospike *
+multi_writer(aerospike_multi * multi, as_error * err)
+{
+	as_error_reset(err);
+
+	if ( multi->n_clusters == 0 || ! multi->clusters[multi->primary].connected ) {
+		as_error_update(err, AEROSPIKE_ERR_CLUSTER, "Primary cluster not connected");
+		return NULL;
+	}
+	return &multi->clusters[multi->primary].as;
+}
+
+/**************************************************************************
+ * 	FUNCTIONS
+ **************************************************************************/
+
+aerospike_multi * aerospike_multi_init(aerospike_multi * multi)
+{
+	memset(multi, 0, sizeof(aerospike_multi));
+	multi->probe_interval = MULTI_PROBE_INTERVAL;
+	multi->max_failures = MULTI_MAX_FAILURES;
+	multi->down_ms = MULTI_DOWN_MS;
+	return multi;
+}
+
+as_status aerospike_multi_add(
+	aerospike_multi * multi, as_error * err, as_config * config, bool primary)
+{
+	as_error_reset(err);
+
+	if ( multi->n_clusters == AS_MULTI_MAX_CLUSTERS ) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "More than %d clusters", AS_MULTI_MAX_CLUSTERS);
+	}
+
+	as_multi_cluster * c = &multi->clusters[multi->n_clusters];
+	aerospike_init(&c->as, config);
+	c->connected = false;
+	c->latency_us = 0;
+	c->failures = 0;
+	c->down_until_ms = 0;
+
+	if ( primary ) {
+		multi->primary = multi->n_clusters;
+	}
+	multi->n_clusters++;
+	return AEROSPIKE_OK;
+}
+
+as_status aerospike_multi_connect(aerospike_multi * multi, as_error * err)
+{
+	as_error_reset(err);
+
+	if ( multi->n_clusters == 0 ) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "No clusters added");
+	}
+
+	for ( uint32_t i = 0; i < multi->n_clusters; i++ ) {
+		as_multi_cluster * c = &multi->clusters[i];
+		as_error cluster_err;
+
+		if ( aerospike_connect(&c->as, &cluster_err) == AEROSPIKE_OK ) {
+			c->connected = true;
+			continue;
+		}
+
+		if ( i == multi->primary ) {
+			*err = cluster_err;
+			aerospike_multi_close(multi, &cluster_err);
+			return err->code;
+		}
+		as_log_warn("Cluster %u not connected: %s", i, cluster_err.message);
+	}
+
+	if ( multi->hedge_us ) {
+		multi->hedge_q = cf_queue_create(sizeof(multi_attempt), true);
+		multi->n_hedge_threads = 0;
+		multi->n_hedges = 0;
+
+		for ( int i = 0; i < AS_MULTI_HEDGE_THREADS; i++ ) {
+			if ( pthread_create(&multi->hedge_threads[i], NULL, multi_hedge_worker, multi) != 0 ) {
+				as_log_warn("Failed to create hedge thread %d", i);
+				break;
+			}
+			multi->n_hedge_threads++;
+		}
+
+		if ( multi->n_hedge_threads == 0 ) {
+			as_error cluster_err;
+			aerospike_multi_close(multi, &cluster_err);
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to create hedge threads");
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
+as_status aerospike_multi_close(aerospike_multi * multi, as_error * err)
+{
+	as_error_reset(err);
+
+	if ( multi->hedge_q ) {
+		// Queued hedges run before the threads see these.
+		for ( uint32_t i = 0; i < multi->n_hedge_threads; i++ ) {
+			multi_attempt attempt = { .multi = multi, .read = NULL, .cluster = 0 };
+			cf_queue_push(multi->hedge_q, &attempt);
+		}
+
+		for ( uint32_t i = 0; i < multi->n_hedge_threads; i++ ) {
+			pthread_join(multi->hedge_threads[i], NULL);
+		}
+		cf_queue_destroy(multi->hedge_q);
+		multi->hedge_q = NULL;
+		multi->n_hedge_threads = 0;
+	}
+
+	for ( uint32_t i = 0; i < multi->n_clusters; i++ ) {
+		as_multi_cluster * c = &multi->clusters[i];
+
+		if ( c->connected ) {
+			as_error cluster_err;
+			aerospike_close(&c->as, &cluster_err);
+			c->connected = false;
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
+void aerospike_multi_destroy(aerospike_multi * multi)
+{
+	for ( uint32_t i = 0; i < multi->n_clusters; i++ ) {
+		aerospike_destroy(&multi->clusters[i].as);
+	}
+	multi->n_clusters = 0;
+}
+
+aerospike * aerospike_multi_primary(aerospike_multi * multi)
+{
+	return &multi->clusters[multi->primary].as;
+}
+
+as_status aerospike_multi_get(
+	aerospike_multi * multi, as_error * err, const as_policy_read * policy, 
+	const as_key * key, 
+	as_record ** rec)
+{
+	return multi_get(multi, err, policy, key, NULL, rec);
+}
+
+as_status aerospike_multi_select(
+	aerospike_multi * multi, as_error * err, const as_policy_read * policy, 
+	const as_key * key, const char * bins[], 
+	as_record ** rec)
+{
+	return multi_get(multi, err, policy, key, bins, rec);
+}
+
+as_status aerospike_multi_put(
+	aerospike_multi * multi, as_error * err, const as_policy_write * policy, 
+	const as_key * key, as_record * rec)
+{
+	aerospike * as = multi_writer(multi, err);
+	return as ? aerospike_key_put(as, err, policy, key, rec) : err->code;
+}
+
+as_status aerospike_multi_remove(
+	aerospike_multi * multi, as_error * err, const as_policy_remove * policy, 
+	const as_key * key)
+{
+	aerospike * as = multi_writer(multi, err);
+	return as ? aerospike_key_remove(as, err, policy, key) : err->code;
+}
+
+as_status aerospike_multi_operate(
+	aerospike_multi * multi, as_error * err, const as_policy_operate * policy, 
+	const as_key * key, const as_operations * ops,
+	as_record ** rec)
+{
+	aerospike * as = multi_writer(multi, err);
+	return as ? aerospike_key_operate(as, err, policy, key, ops, rec) : err->code;
+}
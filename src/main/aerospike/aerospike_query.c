@@ -14,18 +14,24 @@
  * License for the specific language governing permissions and limitations under
  * the License.
  */
+#include <aerospike/aerospike_batch.h>
 #include <aerospike/aerospike_query.h>
+#include <aerospike/as_bytes.h>
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_integer.h>
 #include <aerospike/as_log.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_query.h>
 #include <aerospike/as_status.h>
 #include <aerospike/as_stream.h>
+#include <aerospike/as_string.h>
 
 #include <citrusleaf/citrusleaf.h>
 #include <citrusleaf/cl_query.h>
 
+#include <pthread.h>
+#include <stdlib.h>
 #include <stdint.h>
 
 #include "_shim.h"
@@ -39,16 +45,107 @@ typedef struct clquery_bridge_s {
 	aerospike_query_foreach_callback callback;
 } clquery_bridge;
 
+/**
+ * Keys of query results mapping to the same node, waiting to be looked up.
+ */
+typedef struct join_bucket_s {
+	// Only compared, not reserved.
+	as_node * node;
+	as_batch batch;
+	// Copies of the query results, in batch key order.
+	as_record ** recs;
+	uint32_t n;
+} join_bucket;
+
+typedef struct join_state_s {
+	aerospike * as;
+	const as_policy_batch * policy;
+	const as_query_join * join;
+	uint32_t batch_size;
+	aerospike_query_join_callback callback;
+	void * udata;
+
+	pthread_mutex_t lock;
+	join_bucket * buckets;
+	uint32_t n_buckets;
+	uint32_t capacity;
+
+	// Set when the callback or a lookup fails, to stop the query. Guarded by lock.
+	bool abort;
+	as_error err;
+} join_state;
+
+typedef struct join_batch_s {
+	join_state * state;
+	as_record ** recs;
+} join_batch;
+
+/**
+ * Digests of one partition, sorted once the predicate's query is done.
+ */
+typedef struct where_part_s {
+	as_digest_value * digests;
+	uint32_t size;
+	uint32_t capacity;
+} where_part;
+
+/**
+ * The digest-only query of one predicate of a multi-predicate query.
+ */
+typedef struct where_query_s {
+	aerospike * as;
+	const as_query * query;
+	const as_predicate * predicate;
+
+	pthread_mutex_t lock;
+	where_part * parts;
+	uint32_t n_partitions;
+	bool oom;
+
+	pthread_t thread;
+	bool threaded;
+	as_error err;
+} where_query;
+
+typedef struct where_fetch_s {
+	const as_policy_batch * policy;
+	aerospike_query_foreach_callback callback;
+	void * udata;
+	bool stop;
+} where_fetch;
+
 /******************************************************************************
  * FUNCTION DECLS
  *****************************************************************************/
 
 as_status aerospike_query_init(aerospike * as, as_error * err);
 
+/******************************************************************************
+ * CONSTANTS
+ *****************************************************************************/
+
+// Matching records are read in batches of this many keys.
+#define WHERE_BATCH_SIZE 1000
+
 /******************************************************************************
  * STATIC FUNCTIONS
  *****************************************************************************/
 
+static void as_predicate_toclquery(const as_predicate * p, cl_query * clquery)
+{
+	switch(p->type) {
+		case AS_PREDICATE_STRING_EQUAL:
+			cl_query_where(clquery, p->bin, CL_EQ, CL_STR, p->value.string);
+			break;
+		case AS_PREDICATE_INTEGER_EQUAL:
+			cl_query_where(clquery, p->bin, CL_EQ, CL_INT, p->value.integer);
+			break;
+		case AS_PREDICATE_INTEGER_RANGE:
+			cl_query_where(clquery, p->bin, CL_RANGE, CL_INT, p->value.integer_range.min, p->value.integer_range.max);
+			break;
+	}
+}
+
 static cl_query * as_query_toclquery(const as_query * query)
 {
 	cl_query * clquery = cl_query_new(query->ns, query->set);
@@ -60,18 +157,7 @@ static cl_query * as_query_toclquery(const as_query * query)
 	}
 
 	for ( int i = 0; i < query->where.size; i++ ) {
-		as_predicate * p = &query->where.entries[i];
-		switch(p->type) {
-			case AS_PREDICATE_STRING_EQUAL:
-				cl_query_where(clquery, p->bin, CL_EQ, CL_STR, p->value.string);
-				break;
-			case AS_PREDICATE_INTEGER_EQUAL:
-				cl_query_where(clquery, p->bin, CL_EQ, CL_INT, p->value.integer);
-				break;
-			case AS_PREDICATE_INTEGER_RANGE:
-				cl_query_where(clquery, p->bin, CL_RANGE, CL_INT, p->value.integer_range.min, p->value.integer_range.max);
-				break;
-		}
+		as_predicate_toclquery(&query->where.entries[i], clquery);
 	}
 
 	for ( int i = 0; i < query->orderby.size; i++ ) {
@@ -97,6 +183,539 @@ static bool clquery_callback(as_val * val, void * udata)
 	}
 }
 
+/**
+ * Compute the digest of the record a query result joins to.
+ */
+static bool join_digest(const as_query_join * join, const as_record * rec, as_digest_value d)
+{
+	as_key key;
+
+	if ( join->key_callback ) {
+		if ( ! join->key_callback(rec, &key, join->key_udata) ) {
+			return false;
+		}
+	}
+	else {
+		as_val * val = (as_val *) as_record_get(rec, join->bin);
+
+		switch ( val ? as_val_type(val) : AS_NIL ) {
+			case AS_INTEGER:
+				as_key_init_int64(&key, join->ns, join->set, as_integer_get((as_integer *) val));
+				break;
+			case AS_STRING:
+				as_key_init_str(&key, join->ns, join->set, as_string_get((as_string *) val));
+				break;
+			case AS_BYTES: {
+				as_bytes * b = (as_bytes *) val;
+				if ( join->digest ) {
+					if ( b->size != AS_DIGEST_VALUE_SIZE ) {
+						return false;
+					}
+					memcpy(d, b->value, AS_DIGEST_VALUE_SIZE);
+					return true;
+				}
+				as_key_init_raw(&key, join->ns, join->set, b->value, b->size);
+				break;
+			}
+			default:
+				return false;
+		}
+	}
+
+	as_digest * digest = as_key_digest(&key);
+	if ( digest ) {
+		memcpy(d, digest->value, AS_DIGEST_VALUE_SIZE);
+	}
+	as_key_destroy(&key);
+	return digest != NULL;
+}
+
+/**
+ * Check whether the join was stopped, by any thread.
+ */
+static bool join_aborted(join_state * state)
+{
+	pthread_mutex_lock(&state->lock);
+	bool abort = state->abort;
+	pthread_mutex_unlock(&state->lock);
+	return abort;
+}
+
+/**
+ * Stop the join. The first error is the one reported.
+ */
+static void join_abort(join_state * state, const as_error * err)
+{
+	pthread_mutex_lock(&state->lock);
+	if ( err && state->err.code == AEROSPIKE_OK ) {
+		state->err = *err;
+	}
+	state->abort = true;
+	pthread_mutex_unlock(&state->lock);
+}
+
+/**
+ * Call the join callback for each looked up record.
+ */
+static bool join_batch_callback(const as_batch_read * results, uint32_t n, void * udata)
+{
+	join_batch * jb = (join_batch *) udata;
+	join_state * state = jb->state;
+
+	for ( uint32_t i = 0; i < n && ! join_aborted(state); i++ ) {
+		if ( ! state->callback(jb->recs[i], &results[i], state->udata) ) {
+			join_abort(state, NULL);
+		}
+	}
+	return true;
+}
+
+/**
+ * Look up the keys of a detached bucket, then free it.
+ */
+static void join_run(join_state * state, join_bucket * b)
+{
+	// The batch was allocated for batch_size keys.
+	b->batch.keys.size = b->n;
+
+	if ( ! join_aborted(state) ) {
+		join_batch jb = {
+			.state = state,
+			.recs = b->recs
+		};
+		as_error err;
+
+		if ( aerospike_batch_get(state->as, &err, state->policy, &b->batch, join_batch_callback, &jb) != AEROSPIKE_OK ) {
+			join_abort(state, &err);
+		}
+	}
+
+	for ( uint32_t i = 0; i < b->n; i++ ) {
+		as_record_destroy(b->recs[i]);
+	}
+	free(b->recs);
+	as_batch_destroy(&b->batch);
+}
+
+/**
+ * Find or add the bucket of a node. Called under the state lock.
+ */
+static join_bucket * join_bucket_get(join_state * state, as_node * node)
+{
+	for ( uint32_t i = 0; i < state->n_buckets; i++ ) {
+		if ( state->buckets[i].node == node ) {
+			return &state->buckets[i];
+		}
+	}
+
+	if ( state->n_buckets == state->capacity ) {
+		uint32_t capacity = state->capacity ? state->capacity * 2 : 8;
+		join_bucket * buckets = realloc(state->buckets, sizeof(join_bucket) * capacity);
+		if ( ! buckets ) {
+			return NULL;
+		}
+		state->buckets = buckets;
+		state->capacity = capacity;
+	}
+
+	join_bucket * b = &state->buckets[state->n_buckets++];
+	b->node = node;
+	b->recs = NULL;
+	b->n = 0;
+	return b;
+}
+
+/**
+ * Queue the key a query result joins to, and look up its node's keys once
+ * there are batch_size of them. The lookup runs on the query thread, so that
+ * node's query waits for it.
+ */
+static bool join_query_callback(const as_val * val, void * udata)
+{
+	join_state * state = (join_state *) udata;
+
+	// NULL is the end of the query. Remaining keys are looked up by the caller.
+	if ( ! val ) {
+		return true;
+	}
+
+	if ( join_aborted(state) ) {
+		return false;
+	}
+
+	as_record * rec = as_record_fromval(val);
+	as_digest_value d;
+
+	if ( ! rec || ! join_digest(state->join, rec, d) ) {
+		return true;
+	}
+
+	as_node * node = as_node_get(state->as->cluster, state->join->ns, (cf_digest *) d, true, AS_POLICY_REPLICA_MASTER);
+	if ( node ) {
+		as_node_release(node);
+	}
+
+	// The query result only lives for this call.
+	as_record * copy = as_record_new(rec->bins.size);
+	asrecord_share(rec, copy);
+	as_key_init_digest(&copy->key, rec->key.ns, rec->key.set, rec->key.digest.value);
+
+	pthread_mutex_lock(&state->lock);
+
+	// Another query thread may have failed since the check above.
+	if ( state->abort ) {
+		pthread_mutex_unlock(&state->lock);
+		as_record_destroy(copy);
+		return false;
+	}
+
+	join_bucket * b = join_bucket_get(state, node);
+
+	if ( b && ! b->recs ) {
+		b->recs = malloc(sizeof(as_record *) * state->batch_size);
+		as_batch_init(&b->batch, state->batch_size);
+
+		if ( ! b->recs || ! b->batch.keys.entries ) {
+			free(b->recs);
+			b->recs = NULL;
+			as_batch_destroy(&b->batch);
+			b = NULL;
+		}
+	}
+
+	if ( ! b ) {
+		if ( state->err.code == AEROSPIKE_OK ) {
+			as_error_update(&state->err, AEROSPIKE_ERR_CLIENT, "failed join allocation");
+		}
+		state->abort = true;
+		pthread_mutex_unlock(&state->lock);
+		as_record_destroy(copy);
+		return false;
+	}
+
+	as_key_init_digest(as_batch_keyat(&b->batch, b->n), state->join->ns, state->join->set, d);
+	b->recs[b->n++] = copy;
+
+	join_bucket full;
+	bool is_full = b->n == state->batch_size;
+
+	if ( is_full ) {
+		full = *b;
+		b->recs = NULL;
+		b->n = 0;
+	}
+
+	pthread_mutex_unlock(&state->lock);
+
+	if ( is_full ) {
+		join_run(state, &full);
+	}
+
+	return ! join_aborted(state);
+}
+
+/**
+ * Collect the digest of a record matching one predicate.
+ */
+static bool where_collect(as_val * val, void * udata)
+{
+	where_query * wq = (where_query *) udata;
+
+	if ( ! val ) {
+		return true;
+	}
+
+	as_record * rec = as_record_fromval(val);
+	if ( ! rec ) {
+		return true;
+	}
+
+	uint8_t * d = rec->key.digest.value;
+	uint32_t pid = wq->n_partitions > 1 ? cl_partition_getid(wq->n_partitions, (cf_digest *) d) : 0;
+
+	pthread_mutex_lock(&wq->lock);
+
+	where_part * part = &wq->parts[pid];
+
+	if ( part->size == part->capacity ) {
+		uint32_t capacity = part->capacity ? part->capacity * 2 : 16;
+		as_digest_value * digests = realloc(part->digests, sizeof(as_digest_value) * capacity);
+
+		if ( ! digests ) {
+			wq->oom = true;
+			pthread_mutex_unlock(&wq->lock);
+			return false;
+		}
+		part->digests = digests;
+		part->capacity = capacity;
+	}
+
+	memcpy(part->digests[part->size++], d, AS_DIGEST_VALUE_SIZE);
+
+	pthread_mutex_unlock(&wq->lock);
+	return true;
+}
+
+/**
+ * Run the digest-only query of one predicate.
+ */
+static void * where_run(void * udata)
+{
+	where_query * wq = (where_query *) udata;
+	as_val * err_val = NULL;
+
+	cl_query * clquery = cl_query_new(wq->query->ns, wq->query->set);
+	as_predicate_toclquery(wq->predicate, clquery);
+	clquery->no_bins = true;
+
+	cl_rv rc = citrusleaf_query_foreach(wq->as->cluster, clquery, wq, where_collect, &err_val);
+
+	if ( wq->oom ) {
+		as_error_update(&wq->err, AEROSPIKE_ERR_CLIENT, "failed digest allocation");
+	}
+	else {
+		as_error_fromrc(&wq->err, rc);
+	}
+
+	if ( err_val ) {
+		as_val_destroy(err_val);
+	}
+	cl_query_destroy(clquery);
+	return NULL;
+}
+
+static int where_digest_compare(const void * a, const void * b)
+{
+	return memcmp(a, b, AS_DIGEST_VALUE_SIZE);
+}
+
+/**
+ * Pass each record read to the query callback.
+ */
+static bool where_batch_callback(const as_batch_read * results, uint32_t n, void * udata)
+{
+	where_fetch * fetch = (where_fetch *) udata;
+
+	for ( uint32_t i = 0; i < n && ! fetch->stop; i++ ) {
+		// Removed since the index was queried.
+		if ( results[i].result != AEROSPIKE_OK ) {
+			continue;
+		}
+
+		// Query results carry their key.
+		as_record rec = results[i].record;
+		rec.key = *results[i].key;
+
+		if ( ! fetch->callback((as_val *) &rec, fetch->udata) ) {
+			fetch->stop = true;
+		}
+	}
+	return true;
+}
+
+static as_status where_fetch_run(aerospike * as, as_error * err, const as_query * query, as_batch * batch, uint32_t n, where_fetch * fetch)
+{
+	batch->keys.size = n;
+
+	if ( query->select.size == 0 ) {
+		return aerospike_batch_get(as, err, fetch->policy, batch, where_batch_callback, fetch);
+	}
+
+	const char * bins[query->select.size + 1];
+
+	for ( uint16_t i = 0; i < query->select.size; i++ ) {
+		bins[i] = query->select.entries[i];
+	}
+	bins[query->select.size] = NULL;
+
+	return aerospike_batch_select(as, err, fetch->policy, batch, bins, where_batch_callback, fetch);
+}
+
+/**
+ * Keep the digests of partition pid that every predicate returned, and read
+ * their records once a batch is full.
+ */
+static as_status where_intersect(aerospike * as, as_error * err, const as_query * query, where_query * wqs, uint32_t pid, as_batch * batch, uint32_t * n, where_fetch * fetch)
+{
+	uint32_t n_wqs = query->where.size;
+	uint32_t smallest = 0;
+
+	for ( uint32_t i = 0; i < n_wqs; i++ ) {
+		where_part * part = &wqs[i].parts[pid];
+
+		if ( part->size == 0 ) {
+			return AEROSPIKE_OK;
+		}
+
+		if ( part->size < wqs[smallest].parts[pid].size ) {
+			smallest = i;
+		}
+		qsort(part->digests, part->size, sizeof(as_digest_value), where_digest_compare);
+	}
+
+	// Walk the smallest set, advancing a cursor through each of the others.
+	uint32_t cursors[n_wqs];
+	memset(cursors, 0, sizeof(cursors));
+
+	where_part * base = &wqs[smallest].parts[pid];
+
+	for ( uint32_t k = 0; k < base->size; k++ ) {
+		uint8_t * d = base->digests[k];
+
+		if ( k > 0 && memcmp(d, base->digests[k - 1], AS_DIGEST_VALUE_SIZE) == 0 ) {
+			continue;
+		}
+
+		bool match = true;
+
+		for ( uint32_t i = 0; i < n_wqs && match; i++ ) {
+			if ( i == smallest ) {
+				continue;
+			}
+
+			where_part * part = &wqs[i].parts[pid];
+			int cmp = -1;
+
+			while ( cursors[i] < part->size && (cmp = memcmp(part->digests[cursors[i]], d, AS_DIGEST_VALUE_SIZE)) < 0 ) {
+				cursors[i]++;
+			}
+			match = cursors[i] < part->size && cmp == 0;
+		}
+
+		if ( ! match ) {
+			continue;
+		}
+
+		as_key_init_digest(as_batch_keyat(batch, *n), query->ns, query->set, d);
+
+		if ( ++*n == WHERE_BATCH_SIZE ) {
+			as_status rc = where_fetch_run(as, err, query, batch, *n, fetch);
+			*n = 0;
+
+			if ( rc != AEROSPIKE_OK || fetch->stop ) {
+				return rc;
+			}
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
+/**
+ * Run a query with more than one predicate. The index query of each
+ * predicate returns digests only. Digests all predicates returned are read
+ * with the selected bins.
+ */
+static as_status where_foreach(aerospike * as, as_error * err, const as_policy_query * policy, const as_query * query, aerospike_query_foreach_callback callback, void * udata)
+{
+	uint32_t n_wqs = query->where.size;
+	uint32_t n_partitions = as->cluster->n_partitions ? as->cluster->n_partitions : 1;
+	as_status rc = AEROSPIKE_OK;
+
+	where_query * wqs = calloc(n_wqs, sizeof(where_query));
+	if ( ! wqs ) {
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "failed query allocation");
+	}
+
+	uint32_t n_init = 0;
+
+	for ( ; n_init < n_wqs; n_init++ ) {
+		where_query * wq = &wqs[n_init];
+		wq->parts = calloc(n_partitions, sizeof(where_part));
+
+		if ( ! wq->parts ) {
+			rc = as_error_update(err, AEROSPIKE_ERR_CLIENT, "failed query allocation");
+			goto Cleanup;
+		}
+
+		wq->as = as;
+		wq->query = query;
+		wq->predicate = &query->where.entries[n_init];
+		wq->n_partitions = n_partitions;
+		as_error_init(&wq->err);
+		pthread_mutex_init(&wq->lock, NULL);
+	}
+
+	// Query the predicates in parallel - the last one on this thread.
+	for ( uint32_t i = 0; i < n_wqs - 1; i++ ) {
+		wqs[i].threaded = pthread_create(&wqs[i].thread, NULL, where_run, &wqs[i]) == 0;
+
+		if ( ! wqs[i].threaded ) {
+			where_run(&wqs[i]);
+		}
+	}
+	where_run(&wqs[n_wqs - 1]);
+
+	for ( uint32_t i = 0; i < n_wqs; i++ ) {
+		if ( wqs[i].threaded ) {
+			pthread_join(wqs[i].thread, NULL);
+		}
+
+		if ( rc == AEROSPIKE_OK && wqs[i].err.code != AEROSPIKE_OK ) {
+			*err = wqs[i].err;
+			rc = err->code;
+		}
+	}
+
+	if ( rc != AEROSPIKE_OK ) {
+		goto Cleanup;
+	}
+
+	as_batch batch;
+	as_batch_init(&batch, WHERE_BATCH_SIZE);
+
+	if ( ! batch.keys.entries ) {
+		rc = as_error_update(err, AEROSPIKE_ERR_CLIENT, "failed batch allocation");
+		goto Cleanup;
+	}
+
+	// Lookups are bounded by the query's timeout rather than the batch default.
+	as_policy_batch batch_policy = as->config.policies.batch;
+	if ( policy->timeout ) {
+		batch_policy.timeout = policy->timeout;
+	}
+
+	where_fetch fetch = {
+		.policy = &batch_policy,
+		.callback = callback,
+		.udata = udata,
+		.stop = false
+	};
+	uint32_t n = 0;
+
+	for ( uint32_t pid = 0; pid < n_partitions && rc == AEROSPIKE_OK && ! fetch.stop; pid++ ) {
+		rc = where_intersect(as, err, query, wqs, pid, &batch, &n, &fetch);
+
+		// Done with this partition.
+		for ( uint32_t i = 0; i < n_wqs; i++ ) {
+			free(wqs[i].parts[pid].digests);
+			wqs[i].parts[pid].digests = NULL;
+		}
+	}
+
+	if ( rc == AEROSPIKE_OK && n > 0 && ! fetch.stop ) {
+		rc = where_fetch_run(as, err, query, &batch, n, &fetch);
+	}
+
+	batch.keys.size = n;
+	as_batch_destroy(&batch);
+
+	// Signal the end of the query, as a single predicate query does.
+	if ( rc == AEROSPIKE_OK ) {
+		callback(NULL, udata);
+	}
+
+Cleanup:
+	for ( uint32_t i = 0; i < n_init; i++ ) {
+		for ( uint32_t pid = 0; pid < n_partitions; pid++ ) {
+			free(wqs[i].parts[pid].digests);
+		}
+		free(wqs[i].parts);
+		pthread_mutex_destroy(&wqs[i].lock);
+	}
+	free(wqs);
+	return rc;
+}
+
 /******************************************************************************
  * FUNCTIONS
  *****************************************************************************/
@@ -122,15 +741,21 @@ as_status aerospike_query_foreach(
 	as_error_reset(err);
     as_val *  err_val = NULL;
 	
-	//if (! policy) {
-	//	policy = &as->config.policies.query;
-	//}
+	if (! policy) {
+		policy = &as->config.policies.query;
+	}
 	
 	if ( aerospike_query_init(as, err) != AEROSPIKE_OK ) {
 		return err->code;
 	}
 
+	// The server runs one index range per query - intersect on the client.
+	if ( query->where.size > 1 && query->apply.function[0] == '\0' ) {
+		return where_foreach(as, err, policy, query, callback, udata);
+	}
+
 	cl_query * clquery = as_query_toclquery(query);
+	clquery->parallel_reduce = policy->parallel_reduce;
 
 	clquery_bridge bridge = {
 		.udata = udata,
@@ -161,3 +786,64 @@ as_status aerospike_query_init(aerospike * as, as_error * err)
 	cl_cluster_query_init(as->cluster);
 	return AEROSPIKE_OK;
 }
+
+/**
+ * Execute a query and look up the record each result joins to.
+ *
+ * @param as            - the aerospike cluster to connect to.
+ * @param err           - the error is populated if the return value is not AEROSPIKE_OK.
+ * @param policy        - the query policy. If NULL, then the default policy will be used.
+ * @param batch_policy  - the lookup policy. If NULL, then the default policy will be used.
+ * @param query         - the query to execute against the cluster
+ * @param join          - describes the records to look up
+ * @param callback      - the callback function to call for each joined pair.
+ * @param udata         - user-data to be passed to the callback
+ *
+ * @return AEROSPIKE_OK on success, otherwise an error.
+ */
+as_status aerospike_query_join(
+	aerospike * as, as_error * err, const as_policy_query * policy, 
+	const as_policy_batch * batch_policy, const as_query * query, 
+	const as_query_join * join, 
+	aerospike_query_join_callback callback, void * udata)
+{
+	as_error_reset(err);
+
+	if ( query->apply.function[0] != '\0' ) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "join of aggregation results not supported");
+	}
+
+	join_state state = {
+		.as = as,
+		.policy = batch_policy,
+		.join = join,
+		.batch_size = join->batch_size ? join->batch_size : AS_QUERY_JOIN_BATCH_SIZE_DEFAULT,
+		.callback = callback,
+		.udata = udata,
+		.buckets = NULL,
+		.n_buckets = 0,
+		.capacity = 0,
+		.abort = false
+	};
+	as_error_init(&state.err);
+	pthread_mutex_init(&state.lock, NULL);
+
+	as_status rc = aerospike_query_foreach(as, err, policy, query, join_query_callback, &state);
+
+	// The query threads are done - look up what is left on this thread.
+	for ( uint32_t i = 0; i < state.n_buckets; i++ ) {
+		join_bucket * b = &state.buckets[i];
+		if ( b->recs ) {
+			join_run(&state, b);
+		}
+	}
+
+	free(state.buckets);
+	pthread_mutex_destroy(&state.lock);
+
+	if ( rc == AEROSPIKE_OK && state.err.code != AEROSPIKE_OK ) {
+		*err = state.err;
+		rc = err->code;
+	}
+	return rc;
+}
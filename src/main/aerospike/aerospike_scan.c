@@ -16,6 +16,7 @@
  */
 #include <aerospike/aerospike_scan.h>
 #include <aerospike/aerospike_info.h>
+#include <aerospike/as_job_watcher.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_log.h>
 
@@ -23,6 +24,10 @@
 #include <citrusleaf/cl_scan.h>
 #include <citrusleaf/cf_random.h>
 
+#include <pthread.h>
+
+#include "ck_pr.h"
+
 #include "_shim.h"
 
 /******************************************************************************
@@ -41,8 +46,31 @@ typedef struct scan_bridge_s {
 	// user-provided callback
 	aerospike_scan_foreach_callback	callback;
 
+	// deserialize list and map bins
+	bool deserialize;
+
 } scan_bridge;
 
+typedef struct scan_columns_worker_s {
+
+	as_cluster * cluster;
+
+	const as_scan * scan;
+
+	cl_bin * bins;
+
+	int n_bins;
+
+	char * node;
+
+	struct cl_scan_parameters_s params;
+
+	as_columns_builder builder;
+
+	cl_rv rv;
+
+} scan_columns_worker;
+
 /******************************************************************************
  * FUNCTION DECLS
  *****************************************************************************/
@@ -62,6 +90,7 @@ static void as_scan_toclscan(const as_scan * scan, const as_policy_scan * policy
 	clscan->params.priority = (cl_scan_priority)scan->priority;
 	clscan->params.pct = scan->percent;
 	clscan->params.concurrent = scan->concurrent;
+	clscan->params.throttle = background ? NULL : policy->throttle;
 
 	clscan->udf.type = CL_SCAN_UDF_NONE;
 	clscan->udf.filename = NULL;
@@ -128,7 +157,7 @@ static int simplescan_cb(char *ns, cf_digest *keyd, char *set, cl_object *key,
 	// Fill the bin data
 	as_record _rec, * rec = &_rec;
 	as_record_inita(rec, n_bins);
-	clbins_to_asrecord(bins, (uint32_t)n_bins, rec);
+	clbins_to_asrecord(bins, (uint32_t)n_bins, rec, bridge->deserialize);
 
 	// Fill the metadata
 	askey_from_clkey(&rec->key, ns, set, key);
@@ -197,14 +226,16 @@ static as_status aerospike_scan_generic(
 
 		scan_bridge bridge_udata = {
 			.udata = udata,
-			.callback = callback
+			.callback = callback,
+			.deserialize = policy->deserialize
 		};
 
 		struct cl_scan_parameters_s params = {
 			.fail_on_cluster_change = clscan.params.fail_on_cluster_change,
 			.priority = clscan.params.priority,
 			.concurrent = clscan.params.concurrent,
-			.threads_per_node = 0
+			.threads_per_node = 0,
+			.throttle = clscan.params.throttle
 		};
 
 		int n_bins = scan->select.size;
@@ -256,6 +287,24 @@ static as_status aerospike_scan_generic(
 	return rc;
 }
 
+static void * scan_columns_worker_run(void * udata)
+{
+	scan_columns_worker * worker = (scan_columns_worker *) udata;
+
+	if ( worker->builder.result == AEROSPIKE_OK ) {
+		worker->rv = citrusleaf_scan_node(worker->cluster, worker->node, (char *) worker->scan->ns, (char *) worker->scan->set, 
+					worker->bins, worker->n_bins, false, worker->scan->percent, NULL, NULL, &worker->params);
+	}
+
+	if ( worker->builder.result != AEROSPIKE_OK ) {
+		worker->rv = worker->builder.result;
+	}
+
+	// Hand over the node's last rows.
+	as_columns_builder_destroy(&worker->builder);
+	return NULL;
+}
+
 // Wrapper for background scan info.
 typedef struct bg_scan_info_s {
 	char job_id[32];
@@ -418,19 +467,55 @@ as_status aerospike_scan_wait(
 	uint64_t scan_id, uint32_t interval_ms
 	)
 {
-	uint32_t interval_micros = (interval_ms <= 0)? 1000 * 1000 : interval_ms * 1000;
-	as_scan_info info;
-	as_status status;
-	
-	// Poll to see when scan is done.
-	do {
-		usleep(interval_micros);
-		status = aerospike_scan_info(as, err, policy, scan_id, &info);
-	} while (status == AEROSPIKE_OK && info.status == AS_SCAN_STATUS_INPROGRESS);
-	
+	as_error_reset(err);
+
+	if (! policy) {
+		policy = &as->config.policies.info;
+	}
+
+	as_job job;
+	as_job_init_scan(&job, scan_id, policy->timeout, interval_ms);
+	as_status status = as_job_watcher_wait(as->cluster, &job);
+
+	if (status != AEROSPIKE_OK) {
+		return as_error_update(err, status, "Failed to get scan status");
+	}
 	return status;
 }
 
+/**
+ *	Register a listener to be called when a background scan is completed by servers.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param scan_id		The id for the scan job.
+ *	@param interval_ms	The polling interval in milliseconds. If zero, 1000 ms is used.
+ *	@param listener		The function called when the scan completes.
+ *	@param udata		User-data to be passed to the listener.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ */
+as_status aerospike_scan_listen(
+	aerospike * as, as_error * err, const as_policy_info * policy,
+	uint64_t scan_id, uint32_t interval_ms,
+	as_job_listener listener, void * udata
+	)
+{
+	as_error_reset(err);
+
+	if (! policy) {
+		policy = &as->config.policies.info;
+	}
+
+	as_job job;
+	as_job_init_scan(&job, scan_id, policy->timeout, interval_ms);
+	job.listener = listener;
+	job.udata = udata;
+	as_job_watcher_listen(as->cluster, &job);
+	return AEROSPIKE_OK;
+}
+
 /**
  *	Check on a background scan running on the server.
  *
@@ -517,6 +602,93 @@ as_status aerospike_scan_foreach(
 	return aerospike_scan_generic(as, err, policy, NULL, scan, callback, udata);
 }
 
+as_status aerospike_scan_columns(
+	aerospike * as, as_error * err, const as_policy_scan * policy, 
+	const as_scan * scan, const as_column_def * defs, uint16_t n_defs, uint32_t batch_rows,
+	as_columns_callback callback, void * udata)
+{
+	as_error_reset(err);
+
+	if (! policy) {
+		policy = &as->config.policies.scan;
+	}
+
+	if ( n_defs == 0 || batch_rows == 0 ) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "No columns or zero batch rows");
+	}
+
+	if ( aerospike_scan_init(as, err) != AEROSPIKE_OK ) {
+		return err->code;
+	}
+
+	char * node_names = NULL;
+	int n_nodes = 0;
+	as_cluster_get_node_names(as->cluster, &n_nodes, &node_names);
+
+	if ( n_nodes == 0 ) {
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Cluster is empty");
+	}
+
+	// Read only the declared bins.
+	cl_bin * bins = (cl_bin *) alloca(sizeof(cl_bin) * n_defs);
+	for ( int i = 0; i < n_defs; i++ ) {
+		strcpy(bins[i].bin_name, defs[i].name);
+		citrusleaf_object_init_null(&bins[i].object);
+	}
+
+	uint32_t abort = 0;
+	scan_columns_worker * workers = (scan_columns_worker *) alloca(sizeof(scan_columns_worker) * n_nodes);
+	pthread_t * threads = (pthread_t *) alloca(sizeof(pthread_t) * n_nodes);
+	bool * started = (bool *) alloca(sizeof(bool) * n_nodes);
+
+	for ( int i = 0; i < n_nodes; i++ ) {
+		scan_columns_worker * worker = &workers[i];
+
+		worker->cluster = as->cluster;
+		worker->scan = scan;
+		worker->bins = bins;
+		worker->n_bins = n_defs;
+		worker->node = &node_names[i * NODE_NAME_SIZE];
+		worker->rv = AEROSPIKE_OK;
+
+		// Each node worker fills its own batches.
+		as_columns_builder_init(&worker->builder, defs, n_defs, batch_rows, callback, udata, worker->node, &abort);
+
+		worker->params.fail_on_cluster_change = policy->fail_on_cluster_change;
+		worker->params.priority = (cl_scan_priority) scan->priority;
+		worker->params.concurrent = false;
+		worker->params.threads_per_node = 0;
+		worker->params.throttle = policy->throttle;
+		worker->params.columns = &worker->builder;
+
+		// Without a thread, the node is scanned below on this one.
+		started[i] = scan->concurrent && pthread_create(&threads[i], NULL, scan_columns_worker_run, worker) == 0;
+	}
+
+	as_status rc = AEROSPIKE_OK;
+
+	for ( int i = 0; i < n_nodes; i++ ) {
+		if ( started[i] ) {
+			pthread_join(threads[i], NULL);
+		}
+		else {
+			scan_columns_worker_run(&workers[i]);
+		}
+
+		// Even if one node failed, the overall status is an error.
+		if ( workers[i].rv != AEROSPIKE_OK ) {
+			rc = as_error_fromrc(err, workers[i].rv);
+		}
+	}
+	free(node_names);
+
+	// If completely successful, make the callback that signals completion.
+	if ( rc == AEROSPIKE_OK && ! ck_pr_load_32(&abort) ) {
+		callback(NULL, NULL, udata);
+	}
+	return rc;
+}
+
 /**
  * Initialize scan environment
  */
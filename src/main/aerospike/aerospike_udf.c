@@ -17,7 +17,9 @@
 #include <aerospike/aerospike.h>
 #include <aerospike/aerospike_udf.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_job_watcher.h>
 #include <aerospike/as_log.h>
+#include <aerospike/as_lua_cache.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_status.h>
 
@@ -154,57 +156,45 @@ as_status aerospike_udf_put(
 		as_strncpy(err->message, error, sizeof(err->message));
 		free(error);
 	}
+	else {
+		// Local copy of module may have changed too. Reload on next use.
+		as_lua_cache_invalidate(filename);
+	}
 
 	return as_error_fromrc(err, rc);
 }
 
-static bool
-aerospike_udf_put_is_done(as_cluster* cluster, const as_policy_info* policy, char* filter)
+as_status aerospike_udf_put_wait(
+	aerospike * as, as_error * err, const as_policy_info * policy,
+	const char * filename, uint32_t interval_ms)
 {
-	// Query all nodes for task completion status.
-	bool done = true;
-	as_nodes* nodes = as_nodes_reserve(cluster);
-	
-	for (uint32_t i = 0; i < nodes->size && done; i++) {
-		as_node* node = nodes->array[i];
-		struct sockaddr_in* sa_in = as_node_get_address(node);
-		
-		char* response = 0;
-		int rc = citrusleaf_info_host_auth(cluster, sa_in, "udf-list", &response, policy->timeout, false, true);
-		
-		if (rc == AEROSPIKE_OK) {
-			char* p = strstr(response, filter);
-			
-			if (! p) {
-				done = false;
-			}
-		}
-		free(response);
+	if (! policy) {
+		policy = &as->config.policies.info;
 	}
-	as_nodes_release(nodes);
-	return done;
+
+	// Node errors are ignored and considered done.
+	as_job job;
+	as_job_init_udf(&job, filename, policy->timeout, interval_ms);
+	as_job_watcher_wait(as->cluster, &job);
+	return AEROSPIKE_OK;
 }
 
-as_status aerospike_udf_put_wait(
+as_status aerospike_udf_put_listen(
 	aerospike * as, as_error * err, const as_policy_info * policy,
-	const char * filename, uint32_t interval_ms)
+	const char * filename, uint32_t interval_ms,
+	as_job_listener listener, void * udata)
 {
+	as_error_reset(err);
+
 	if (! policy) {
 		policy = &as->config.policies.info;
 	}
 
-	char filter[256];
-	snprintf(filter, sizeof(filter), "filename=%s", filename);
-	
-	uint32_t interval_micros = (interval_ms <= 0)? 1000 * 1000 : interval_ms * 1000;
-	
-	bool done;
-		
-	do {
-		usleep(interval_micros);
-		done = aerospike_udf_put_is_done(as->cluster, policy, filter);
-	} while (! done);
-	
+	as_job job;
+	as_job_init_udf(&job, filename, policy->timeout, interval_ms);
+	job.listener = listener;
+	job.udata = udata;
+	as_job_watcher_listen(as->cluster, &job);
 	return AEROSPIKE_OK;
 }
 
@@ -230,6 +220,9 @@ as_status aerospike_udf_remove(
 		as_strncpy(err->message, error, sizeof(err->message));
 		free(error);
 	}
+	else {
+		as_lua_cache_invalidate(filename);
+	}
 
 	return as_error_fromrc(err, rc);
 }
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_allocator.h>
+#include <aerospike/as_log_macros.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ck_pr.h"
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Prefix of every allocation, so as_alloc_free() needs neither tag nor size.
+ *	Sized to keep the caller's memory 16 byte aligned.
+ */
+typedef struct as_alloc_header_s {
+	// Allocator that owns this block. NULL for malloc().
+	const as_allocator* allocator;
+	uint32_t size;
+	uint16_t tag;
+	uint16_t counted;
+} as_alloc_header;
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+static const char* g_tag_names[AS_ALLOC_TAG_MAX] = {
+	"wire", "shim", "batch", "scan", "query", "cluster"
+};
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Installed once and never released, so headers may reference it.
+static as_allocator g_custom;
+static as_allocator* g_allocator = NULL;
+
+static uint32_t g_stats_enabled = 0;
+static as_alloc_stats g_stats[AS_ALLOC_TAG_MAX];
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+void
+as_allocator_configure(const as_allocator* allocator, bool stats_enabled)
+{
+	pthread_mutex_lock(&g_lock);
+	
+	if (allocator && allocator->alloc_fn && allocator->free_fn) {
+		if (! g_allocator) {
+			g_custom = *allocator;
+			ck_pr_fence_store();
+			ck_pr_store_ptr(&g_allocator, &g_custom);
+		}
+		else if (memcmp(&g_custom, allocator, sizeof(as_allocator)) != 0) {
+			as_log_warn("Custom allocator already installed. Ignoring new allocator.");
+		}
+	}
+	
+	if (stats_enabled) {
+		ck_pr_store_32(&g_stats_enabled, 1);
+	}
+	
+	pthread_mutex_unlock(&g_lock);
+}
+
+void*
+as_alloc_malloc(as_alloc_tag tag, size_t size)
+{
+	if (size > UINT32_MAX) {
+		return NULL;
+	}
+	
+	const as_allocator* allocator = ck_pr_load_ptr(&g_allocator);
+	size_t total = sizeof(as_alloc_header) + size;
+	as_alloc_header* header = allocator ?
+		allocator->alloc_fn(total, tag, allocator->udata) : malloc(total);
+	
+	if (! header) {
+		return NULL;
+	}
+	
+	header->allocator = allocator;
+	header->size = (uint32_t)size;
+	header->tag = (uint16_t)tag;
+	header->counted = 0;
+	
+	if (ck_pr_load_32(&g_stats_enabled)) {
+		as_alloc_stats* stats = &g_stats[tag];
+		ck_pr_inc_64(&stats->allocs);
+		ck_pr_add_64(&stats->bytes, size);
+		ck_pr_add_64(&stats->live_bytes, size);
+		header->counted = 1;
+	}
+	return header + 1;
+}
+
+void
+as_alloc_free(void* ptr)
+{
+	if (! ptr) {
+		return;
+	}
+	
+	as_alloc_header* header = (as_alloc_header*)ptr - 1;
+	
+	if (header->counted) {
+		as_alloc_stats* stats = &g_stats[header->tag];
+		ck_pr_inc_64(&stats->frees);
+		ck_pr_sub_64(&stats->live_bytes, header->size);
+	}
+	
+	const as_allocator* allocator = header->allocator;
+	
+	if (allocator) {
+		allocator->free_fn(header, (as_alloc_tag)header->tag, allocator->udata);
+	}
+	else {
+		free(header);
+	}
+}
+
+void
+as_alloc_stats_get(as_alloc_tag tag, as_alloc_stats* stats)
+{
+	if ((uint32_t)tag >= AS_ALLOC_TAG_MAX) {
+		memset(stats, 0, sizeof(as_alloc_stats));
+		return;
+	}
+	
+	as_alloc_stats* src = &g_stats[tag];
+	stats->allocs = ck_pr_load_64(&src->allocs);
+	stats->frees = ck_pr_load_64(&src->frees);
+	stats->bytes = ck_pr_load_64(&src->bytes);
+	stats->live_bytes = ck_pr_load_64(&src->live_bytes);
+}
+
+const char*
+as_alloc_tag_name(as_alloc_tag tag)
+{
+	return (uint32_t)tag < AS_ALLOC_TAG_MAX ? g_tag_names[tag] : "unknown";
+}
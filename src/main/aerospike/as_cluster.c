@@ -16,10 +16,14 @@
  */
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_admin.h>
+#include <aerospike/as_hotkeys.h>
+#include <aerospike/as_job_watcher.h>
 #include <aerospike/as_log_macros.h>
 #include <aerospike/as_lookup.h>
 #include <aerospike/as_password.h>
 #include <aerospike/as_shm_cluster.h>
+#include <aerospike/as_slowops.h>
+#include <aerospike/as_socket_profile.h>
 #include <aerospike/as_vector.h>
 #include <citrusleaf/as_scan.h>
 #include <citrusleaf/cl_info.h>
@@ -28,6 +32,7 @@
 #include <citrusleaf/cf_clock.h>
 #include <citrusleaf/cl_query.h>
 #include <citrusleaf/cf_socket.h>
+#include <unistd.h>
 
 /******************************************************************************
  *	Function declarations
@@ -36,6 +41,9 @@
 bool
 as_node_refresh(as_cluster* cluster, as_node* node, as_vector* /* <as_friend> */ friends);
 
+void
+as_lob_shutdown(as_cluster* cluster);
+
 /******************************************************************************
  *	Functions
  *****************************************************************************/
@@ -134,7 +142,7 @@ static as_nodes*
 as_nodes_create(uint32_t capacity)
 {
 	size_t size = sizeof(as_nodes) + (sizeof(as_node*) * capacity);
-	as_nodes* nodes = cf_malloc(size);
+	as_nodes* nodes = as_alloc_malloc(AS_ALLOC_TAG_CLUSTER, size);
 	memset(nodes, 0, size);
 	nodes->ref_count = 1;
 	nodes->size = capacity;
@@ -882,7 +890,16 @@ as_cluster_create(as_config* config, as_cluster** cluster_out)
 	// Initialize cluster tend and node parameters
 	cluster->tend_interval = (config->tender_interval < 1000)? 1000 : config->tender_interval;
 	cluster->conn_queue_size = config->max_threads + 1;  // Add one connection for tend thread.
+	cluster->conn_pools_per_node = config->conn_pools_per_node;
+	
+	if (cluster->conn_pools_per_node == 0) {
+		long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		cluster->conn_pools_per_node = n_cpus < 1 ? 1 : (n_cpus > 64 ? 64 : (uint32_t)n_cpus);
+	}
+	as_socket_profile_resolve(&config->socket, &cluster->socket);
 	cluster->conn_timeout_ms = (config->conn_timeout_ms == 0) ? 1000 : config->conn_timeout_ms;
+	cluster->hotkeys = as_hotkeys_create(&config->hotkeys);
+	cluster->slowops = as_slowops_create(&config->slowops);
 	
 	// Initialize seed hosts.
 	cluster->seeds_size = seeds_size(config);
@@ -899,6 +916,7 @@ as_cluster_create(as_config* config, as_cluster** cluster_out)
 	
 	// Initialize empty partition tables.
 	cluster->partition_tables = as_partition_tables_create(0);
+	cluster->partition_generation = as_partition_generation_next();
 	
 	// Initialize garbage collection array.
 	cluster->gc = as_vector_create(sizeof(as_gc_item), 8);
@@ -939,10 +957,14 @@ as_cluster_create(as_config* config, as_cluster** cluster_out)
 void
 as_cluster_destroy(as_cluster* cluster)
 {
+	// Stop background job tracking.
+	as_job_watcher_shutdown(cluster);
+
 	// Shutdown work queues.
 	cl_cluster_batch_shutdown(cluster);
 	cl_cluster_scan_shutdown(cluster);
 	cl_cluster_query_shutdown(cluster);
+	as_lob_shutdown(cluster);
 
 	// Stop tend thread and wait till finished.
 	if (cluster->valid) {
@@ -1008,6 +1030,9 @@ as_cluster_destroy(as_cluster* cluster)
 	cf_free(cluster->user);
 	cf_free(cluster->password);
 	
+	as_hotkeys_destroy(cluster->hotkeys);
+	as_slowops_destroy(cluster->slowops);
+	
 	// Destroy cluster.
 	cf_free(cluster);
 }
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_columns.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <citrusleaf/cl_object.h>
+#include <string.h>
+
+#include "ck_pr.h"
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+// Initial data size of string and bytes columns, per row.
+#define COLUMNS_ROW_DATA 16
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline int64_t
+as_columns_int(const uint8_t* p, uint32_t size)
+{
+	if (size == 8) {
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return (int64_t)cf_swap_from_be64(v);
+	}
+	
+	// Sign extend shorter integers.
+	uint64_t v = (size > 0 && (p[0] & 0x80)) ? ~0ULL : 0;
+	
+	for (uint32_t i = 0; i < size; i++) {
+		v = (v << 8) | p[i];
+	}
+	return (int64_t)v;
+}
+
+static bool
+as_columns_append(as_column* column, uint32_t row, const uint8_t* value, uint32_t size)
+{
+	if (column->data_size + size > column->data_capacity) {
+		uint32_t capacity = column->data_capacity * 2;
+		
+		if (capacity < column->data_size + size) {
+			capacity = column->data_size + size;
+		}
+		
+		uint8_t* data = cf_realloc(column->data, capacity);
+		
+		if (! data) {
+			return false;
+		}
+		column->data = data;
+		column->data_capacity = capacity;
+	}
+	memcpy(column->data + column->data_size, value, size);
+	column->data_size += size;
+	column->offsets[row + 1] = column->data_size;
+	return true;
+}
+
+static inline as_column*
+as_columns_find(as_columns_builder* builder, const uint8_t* name, uint8_t name_sz)
+{
+	as_columns* batch = builder->batch;
+	uint16_t n = batch->n_columns;
+	
+	// Try the expected column first, then the others.
+	for (uint16_t i = 0, c = builder->next; i < n; i++, c++) {
+		if (c == n) {
+			c = 0;
+		}
+		
+		as_column* column = &batch->columns[c];
+		
+		if (column->name_sz == name_sz && memcmp(column->name, name, name_sz) == 0) {
+			builder->next = c + 1 == n ? 0 : c + 1;
+			return column;
+		}
+	}
+	return NULL;
+}
+
+static bool
+as_columns_flush(as_columns_builder* builder)
+{
+	as_columns* batch = builder->batch;
+	
+	if (! batch || batch->n_rows == 0) {
+		return true;
+	}
+	
+	// The callback owns the batch from here.
+	builder->batch = NULL;
+	
+	if (! builder->callback(batch, builder->node, builder->udata)) {
+		ck_pr_store_32(builder->abort, 1);
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_columns*
+as_columns_create(const as_column_def* defs, uint16_t n_defs, uint32_t capacity)
+{
+	as_columns* columns = cf_calloc(1, sizeof(as_columns) + sizeof(as_column) * n_defs);
+	
+	if (! columns) {
+		return NULL;
+	}
+	columns->capacity = capacity;
+	columns->n_columns = n_defs;
+	
+	for (uint16_t i = 0; i < n_defs; i++) {
+		as_column* column = &columns->columns[i];
+		
+		strcpy(column->name, defs[i].name);
+		column->name_sz = (uint8_t)strlen(column->name);
+		column->type = defs[i].type;
+		column->valid = cf_calloc((capacity + 7) / 8, 1);
+		
+		if (! column->valid) {
+			as_columns_destroy(columns);
+			return NULL;
+		}
+		
+		if (column->type == AS_COLUMN_INT64) {
+			column->values = cf_calloc(capacity, sizeof(int64_t));
+			
+			if (! column->values) {
+				as_columns_destroy(columns);
+				return NULL;
+			}
+		}
+		else {
+			column->offsets = cf_calloc(capacity + 1, sizeof(uint32_t));
+			column->data_capacity = capacity * COLUMNS_ROW_DATA;
+			column->data = cf_malloc(column->data_capacity);
+			
+			if (! column->offsets || ! column->data) {
+				as_columns_destroy(columns);
+				return NULL;
+			}
+		}
+	}
+	return columns;
+}
+
+void
+as_columns_destroy(as_columns* columns)
+{
+	for (uint16_t i = 0; i < columns->n_columns; i++) {
+		as_column* column = &columns->columns[i];
+		
+		cf_free(column->valid);
+		cf_free(column->values);
+		cf_free(column->offsets);
+		cf_free(column->data);
+	}
+	cf_free(columns);
+}
+
+void
+as_columns_builder_init(as_columns_builder* builder, const as_column_def* defs, uint16_t n_defs,
+	uint32_t batch_rows, as_columns_callback callback, void* udata, const char* node, uint32_t* abort)
+{
+	builder->defs = defs;
+	builder->n_defs = n_defs;
+	builder->batch_rows = batch_rows;
+	builder->callback = callback;
+	builder->udata = udata;
+	builder->node = node;
+	builder->batch = as_columns_create(defs, n_defs, batch_rows);
+	builder->next = 0;
+	builder->abort = abort;
+	builder->result = builder->batch ? AEROSPIKE_OK : AEROSPIKE_ERR_CLIENT;
+}
+
+void
+as_columns_builder_bin(as_columns_builder* builder, const uint8_t* name, uint8_t name_sz,
+	uint8_t particle_type, const uint8_t* value, uint32_t size)
+{
+	if (! builder->batch) {
+		return;
+	}
+	
+	as_column* column = as_columns_find(builder, name, name_sz);
+	uint32_t row = builder->batch->n_rows;
+	
+	if (! column || as_column_isvalid(column, row)) {
+		return;
+	}
+	
+	switch (column->type) {
+		case AS_COLUMN_INT64:
+			if (particle_type != CL_INT || size > 8) {
+				return;
+			}
+			column->values[row] = as_columns_int(value, size);
+			break;
+			
+		case AS_COLUMN_STRING:
+			if (particle_type != CL_STR) {
+				return;
+			}
+			// fall through
+		case AS_COLUMN_BYTES:
+			if (particle_type == CL_NULL || particle_type == CL_INT) {
+				return;
+			}
+			if (! as_columns_append(column, row, value, size)) {
+				builder->result = AEROSPIKE_ERR_CLIENT;
+				return;
+			}
+			break;
+	}
+	column->valid[row >> 3] |= 1 << (row & 7);
+}
+
+int
+as_columns_builder_row(as_columns_builder* builder)
+{
+	as_columns* batch = builder->batch;
+	
+	if (! batch || builder->result != AEROSPIKE_OK) {
+		ck_pr_store_32(builder->abort, 1);
+		return 1;
+	}
+	
+	uint32_t row = batch->n_rows;
+	
+	// Null string and bytes values are empty.
+	for (uint16_t i = 0; i < batch->n_columns; i++) {
+		as_column* column = &batch->columns[i];
+		
+		if (column->offsets) {
+			column->offsets[row + 1] = column->data_size;
+		}
+	}
+	batch->n_rows++;
+	builder->next = 0;
+	
+	if (batch->n_rows == batch->capacity) {
+		if (! as_columns_flush(builder)) {
+			return 1;
+		}
+		builder->batch = as_columns_create(builder->defs, builder->n_defs, builder->batch_rows);
+		
+		if (! builder->batch) {
+			builder->result = AEROSPIKE_ERR_CLIENT;
+			ck_pr_store_32(builder->abort, 1);
+			return 1;
+		}
+	}
+	return ck_pr_load_32(builder->abort) ? 1 : 0;
+}
+
+void
+as_columns_builder_destroy(as_columns_builder* builder)
+{
+	if (builder->result == AEROSPIKE_OK && ! ck_pr_load_32(builder->abort)) {
+		as_columns_flush(builder);
+	}
+	
+	if (builder->batch) {
+		as_columns_destroy(builder->batch);
+		builder->batch = NULL;
+	}
+}
@@ -38,6 +38,7 @@ as_config * as_config_init(as_config * c)
 	c->ip_map = 0;
 	c->ip_map_size = 0;
 	c->max_threads = 300;
+	c->conn_pools_per_node = 0;
 	c->max_socket_idle_sec = 14;
 	c->conn_timeout_ms = 1000;
 	c->tender_interval = 1000;
@@ -49,6 +50,17 @@ as_config * as_config_init(as_config * c)
 	c->lua.cache_enabled = MOD_LUA_CACHE_ENABLED;
 	strcpy(c->lua.system_path, AS_CONFIG_LUA_SYSTEM_PATH);
 	strcpy(c->lua.user_path, AS_CONFIG_LUA_USER_PATH);
+	memset(&c->alloc.allocator, 0, sizeof(c->alloc.allocator));
+	c->alloc.stats_enabled = false;
+	memset(&c->socket, 0, sizeof(c->socket));
+	c->hotkeys.enabled = false;
+	c->hotkeys.sample_rate = 64;
+	c->hotkeys.interval_ms = 10000;
+	c->hotkeys.top_k = 16;
+	c->slowops.enabled = false;
+	c->slowops.threshold_us = 10000;
+	c->slowops.capacity = 256;
+	c->slowops.log_interval_ms = 1000;
 	c->fail_if_not_connected = true;
 	
 	c->use_shm = false;
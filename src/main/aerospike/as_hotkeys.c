@@ -0,0 +1,354 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_hotkeys.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_partition.h>
+#include <aerospike/as_shm_cluster.h>
+#include <aerospike/as_string.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ck_pr.h"
+
+/******************************************************************************
+ *	STATIC VARIABLES
+ *****************************************************************************/
+
+// Commands this thread has issued since it last sampled one. Per thread so
+// sampling costs no shared cache line.
+static __thread uint32_t as_hotkeys_tick;
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline uint32_t
+as_hotkeys_ns_hash(const char* ns)
+{
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	
+	while (*ns) {
+		h ^= (uint8_t)*ns++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static inline void
+as_hotkeys_index(const char* ns, const cf_digest* d, uint32_t* idx)
+{
+	// Digests are uniformly distributed, so each row can use its own digest
+	// word as an independent hash.
+	uint32_t ns_hash = as_hotkeys_ns_hash(ns);
+	
+	for (uint32_t i = 0; i < AS_HOTKEYS_DEPTH; i++) {
+		uint32_t w;
+		memcpy(&w, &d->digest[i * sizeof(uint32_t)], sizeof(uint32_t));
+		idx[i] = (w ^ ns_hash) & (AS_HOTKEYS_WIDTH - 1);
+	}
+}
+
+static inline uint32_t
+as_hotkeys_estimate(uint32_t counts[AS_HOTKEYS_DEPTH][AS_HOTKEYS_WIDTH], const uint32_t* idx)
+{
+	uint32_t min = ck_pr_load_32(&counts[0][idx[0]]);
+	
+	for (uint32_t i = 1; i < AS_HOTKEYS_DEPTH; i++) {
+		uint32_t c = ck_pr_load_32(&counts[i][idx[i]]);
+		
+		if (c < min) {
+			min = c;
+		}
+	}
+	return min;
+}
+
+static inline uint32_t
+as_hotkeys_total(const as_hotkeys_entry* e)
+{
+	return e->reads + e->writes;
+}
+
+static void
+as_hotkeys_swap(as_hotkeys_entry* a, as_hotkeys_entry* b)
+{
+	as_hotkeys_entry t = *a;
+	*a = *b;
+	*b = t;
+}
+
+static void
+as_hotkeys_sift_up(as_hotkeys_entry* heap, uint32_t i)
+{
+	while (i > 0) {
+		uint32_t parent = (i - 1) / 2;
+		
+		if (as_hotkeys_total(&heap[parent]) <= as_hotkeys_total(&heap[i])) {
+			break;
+		}
+		as_hotkeys_swap(&heap[parent], &heap[i]);
+		i = parent;
+	}
+}
+
+static void
+as_hotkeys_sift_down(as_hotkeys_entry* heap, uint32_t size, uint32_t i)
+{
+	while (true) {
+		uint32_t min = i;
+		uint32_t left = 2 * i + 1;
+		uint32_t right = left + 1;
+		
+		if (left < size && as_hotkeys_total(&heap[left]) < as_hotkeys_total(&heap[min])) {
+			min = left;
+		}
+		
+		if (right < size && as_hotkeys_total(&heap[right]) < as_hotkeys_total(&heap[min])) {
+			min = right;
+		}
+		
+		if (min == i) {
+			break;
+		}
+		as_hotkeys_swap(&heap[min], &heap[i]);
+		i = min;
+	}
+}
+
+static void
+as_hotkeys_entry_set(as_hotkeys_entry* e, const char* ns, const char* set, const cf_digest* d, uint32_t reads, uint32_t writes)
+{
+	as_strncpy(e->ns, ns, sizeof(e->ns));
+	as_strncpy(e->set, set ? set : "", sizeof(e->set));
+	e->digest = *d;
+	e->reads = reads;
+	e->writes = writes;
+}
+
+/**
+ *	@private
+ *	Offer a key's current estimates to the top-K heap.  Must hold lock.
+ */
+static void
+as_hotkeys_offer(as_hotkeys* hotkeys, const char* ns, const char* set, const cf_digest* d, uint32_t reads, uint32_t writes)
+{
+	as_hotkeys_entry* heap = hotkeys->heap;
+	
+	for (uint32_t i = 0; i < hotkeys->heap_size; i++) {
+		as_hotkeys_entry* e = &heap[i];
+		
+		if (memcmp(&e->digest, d, sizeof(cf_digest)) == 0 && strcmp(e->ns, ns) == 0) {
+			// Estimates only grow within an interval.
+			e->reads = reads;
+			e->writes = writes;
+			as_hotkeys_sift_down(heap, hotkeys->heap_size, i);
+			goto Done;
+		}
+	}
+	
+	if (hotkeys->heap_size < hotkeys->top_k) {
+		as_hotkeys_entry_set(&heap[hotkeys->heap_size], ns, set, d, reads, writes);
+		as_hotkeys_sift_up(heap, hotkeys->heap_size++);
+	}
+	else if (reads + writes > as_hotkeys_total(&heap[0])) {
+		as_hotkeys_entry_set(&heap[0], ns, set, d, reads, writes);
+		as_hotkeys_sift_down(heap, hotkeys->heap_size, 0);
+	}
+	
+Done:
+	if (hotkeys->heap_size == hotkeys->top_k) {
+		ck_pr_store_32(&hotkeys->heap_min, as_hotkeys_total(&heap[0]));
+	}
+}
+
+static int
+as_hotkeys_compare(const void* a, const void* b)
+{
+	uint32_t ta = as_hotkeys_total(a);
+	uint32_t tb = as_hotkeys_total(b);
+	return ta > tb ? -1 : (ta < tb ? 1 : 0);
+}
+
+/**
+ *	@private
+ *	Close the current interval if it has ended.  Must hold lock.
+ */
+static void
+as_hotkeys_rotate(as_hotkeys* hotkeys, uint64_t now)
+{
+	if (now < hotkeys->end_ms) {
+		// Another thread rotated first.
+		return;
+	}
+	
+	memcpy(hotkeys->last, hotkeys->heap, hotkeys->heap_size * sizeof(as_hotkeys_entry));
+	qsort(hotkeys->last, hotkeys->heap_size, sizeof(as_hotkeys_entry), as_hotkeys_compare);
+	hotkeys->last_size = hotkeys->heap_size;
+	hotkeys->last_begin_ms = hotkeys->begin_ms;
+	hotkeys->last_end_ms = hotkeys->end_ms;
+	
+	// Increments racing with the reset may land in either interval.  The
+	// sketch is an estimate anyway.
+	memset(hotkeys->reads, 0, sizeof(hotkeys->reads));
+	memset(hotkeys->writes, 0, sizeof(hotkeys->writes));
+	hotkeys->heap_size = 0;
+	ck_pr_store_32(&hotkeys->heap_min, 0);
+	hotkeys->begin_ms = now;
+	ck_pr_store_64(&hotkeys->end_ms, now + hotkeys->interval_ms);
+}
+
+static void
+as_hotkeys_owners(as_cluster* cluster, as_hotkey* key)
+{
+	as_node* master = 0;
+	as_node* prole = 0;
+	
+	if (cluster->shm_info) {
+		master = as_shm_node_get(cluster, key->ns, &key->digest, true, AS_POLICY_REPLICA_MASTER);
+	}
+	else {
+		as_partition_table* table = as_cluster_get_partition_table(cluster, key->ns);
+		as_partition_table_get_owners(cluster, table, &key->digest, &master, &prole);
+	}
+	
+	key->master[0] = 0;
+	key->prole[0] = 0;
+	
+	if (master) {
+		as_strncpy(key->master, master->name, sizeof(key->master));
+		as_node_release(master);
+	}
+	
+	if (prole) {
+		as_strncpy(key->prole, prole->name, sizeof(key->prole));
+		as_node_release(prole);
+	}
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_hotkeys*
+as_hotkeys_create(const as_config_hotkeys* config)
+{
+	if (! config->enabled) {
+		return NULL;
+	}
+	
+	as_hotkeys* hotkeys = cf_malloc(sizeof(as_hotkeys));
+	
+	if (! hotkeys) {
+		return NULL;
+	}
+	memset(hotkeys, 0, sizeof(as_hotkeys));
+	pthread_mutex_init(&hotkeys->lock, NULL);
+	
+	hotkeys->top_k = config->top_k == 0 ? 1 : (config->top_k > AS_HOTKEYS_MAX ? AS_HOTKEYS_MAX : config->top_k);
+	hotkeys->sample_rate = config->sample_rate == 0 ? 1 : config->sample_rate;
+	hotkeys->interval_ms = config->interval_ms == 0 ? 10000 : config->interval_ms;
+	hotkeys->begin_ms = cf_getms();
+	hotkeys->end_ms = hotkeys->begin_ms + hotkeys->interval_ms;
+	return hotkeys;
+}
+
+void
+as_hotkeys_destroy(as_hotkeys* hotkeys)
+{
+	if (hotkeys) {
+		pthread_mutex_destroy(&hotkeys->lock);
+		cf_free(hotkeys);
+	}
+}
+
+void
+as_hotkeys_sample(as_hotkeys* hotkeys, const char* ns, const char* set, const cf_digest* d, bool write)
+{
+	if (++as_hotkeys_tick < hotkeys->sample_rate) {
+		return;
+	}
+	as_hotkeys_tick = 0;
+	
+	uint64_t now = cf_getms();
+	
+	if (now >= ck_pr_load_64(&hotkeys->end_ms)) {
+		pthread_mutex_lock(&hotkeys->lock);
+		as_hotkeys_rotate(hotkeys, now);
+		pthread_mutex_unlock(&hotkeys->lock);
+	}
+	
+	uint32_t idx[AS_HOTKEYS_DEPTH];
+	as_hotkeys_index(ns, d, idx);
+	
+	uint32_t (*counts)[AS_HOTKEYS_WIDTH] = write ? hotkeys->writes : hotkeys->reads;
+	
+	for (uint32_t i = 0; i < AS_HOTKEYS_DEPTH; i++) {
+		ck_pr_inc_32(&counts[i][idx[i]]);
+	}
+	
+	uint32_t reads = as_hotkeys_estimate(hotkeys->reads, idx);
+	uint32_t writes = as_hotkeys_estimate(hotkeys->writes, idx);
+	
+	// Most keys are cold and never take the lock.
+	if (reads + writes <= ck_pr_load_32(&hotkeys->heap_min)) {
+		return;
+	}
+	
+	pthread_mutex_lock(&hotkeys->lock);
+	as_hotkeys_offer(hotkeys, ns, set, d, reads, writes);
+	pthread_mutex_unlock(&hotkeys->lock);
+}
+
+as_status
+aerospike_hotkeys_get(aerospike* as, as_error* err, as_hotkeys_report* report)
+{
+	as_error_reset(err);
+	
+	as_cluster* cluster = as->cluster;
+	as_hotkeys* hotkeys = cluster ? cluster->hotkeys : NULL;
+	
+	if (! hotkeys) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "Hot key sampling is not enabled");
+	}
+	
+	as_hotkeys_entry last[AS_HOTKEYS_MAX];
+	
+	pthread_mutex_lock(&hotkeys->lock);
+	as_hotkeys_rotate(hotkeys, cf_getms());
+	uint32_t size = hotkeys->last_size;
+	memcpy(last, hotkeys->last, size * sizeof(as_hotkeys_entry));
+	report->begin_ms = hotkeys->last_begin_ms;
+	report->end_ms = hotkeys->last_end_ms;
+	pthread_mutex_unlock(&hotkeys->lock);
+	
+	for (uint32_t i = 0; i < size; i++) {
+		as_hotkeys_entry* e = &last[i];
+		as_hotkey* key = &report->keys[i];
+		
+		as_strncpy(key->ns, e->ns, sizeof(key->ns));
+		as_strncpy(key->set, e->set, sizeof(key->set));
+		key->digest = e->digest;
+		key->reads = (uint64_t)e->reads * hotkeys->sample_rate;
+		key->writes = (uint64_t)e->writes * hotkeys->sample_rate;
+		key->partition_id = cluster->n_partitions ? cl_partition_getid(cluster->n_partitions, &key->digest) : 0;
+		as_hotkeys_owners(cluster, key);
+	}
+	report->size = size;
+	return AEROSPIKE_OK;
+}
@@ -0,0 +1,581 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_job_watcher.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_info.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_node.h>
+#include <citrusleaf/cf_clock.h>
+#include <citrusleaf/cl_info.h>
+#include <citrusleaf/cf_socket.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+#define AS_JOB_DEFAULT_INTERVAL 1000
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline uint32_t
+as_job_interval(const as_job* job)
+{
+	return (job->interval_ms == 0)? AS_JOB_DEFAULT_INTERVAL : job->interval_ms;
+}
+
+static void
+as_job_parse_scan(as_job* job, char* value)
+{
+	// Job entries are separated by ';'. Only look inside this job's entry.
+	char tag[48];
+	snprintf(tag, sizeof(tag), "job_id=%" PRIu64 ":", job->scan_id);
+	
+	char* p = strstr(value, tag);
+	
+	if (! p) {
+		return;
+	}
+	p += strlen(tag);
+	
+	char* end = strchr(p, ';');
+	char* status = strstr(p, "job_status=");
+	
+	if (status && (! end || status < end)) {
+		status += 11;
+		
+		if (strncmp(status, "IN PROGRESS", 11) == 0) {
+			job->running = true;
+		}
+		else if (strncmp(status, "ABORTED", 7) == 0 && job->status == AEROSPIKE_OK) {
+			job->status = AEROSPIKE_ERR_SCAN_ABORTED;
+		}
+	}
+}
+
+static void
+as_job_parse_index(as_job* job, char* value)
+{
+	// Index is not done if any node reports percent completed < 100.
+	char* p = strstr(value, "load_pct=");
+	
+	if (p) {
+		int pct = atoi(p + 9);
+		
+		if (pct >= 0 && pct < 100) {
+			job->running = true;
+		}
+	}
+}
+
+static void
+as_job_parse_udf(as_job* job, char* value)
+{
+	// UDF is not done if any node does not list the file yet.
+	char filter[AS_UDF_FILE_NAME_SIZE + 16];
+	snprintf(filter, sizeof(filter), "filename=%s", job->name);
+	
+	if (! strstr(value, filter)) {
+		job->running = true;
+	}
+}
+
+static inline bool
+as_job_matches(as_job* job, const char* name)
+{
+	switch (job->type) {
+		case AS_JOB_SCAN:
+			return strcmp(name, "scan-list") == 0;
+			
+		case AS_JOB_UDF:
+			return strcmp(name, "udf-list") == 0;
+			
+		case AS_JOB_INDEX: {
+			// Name format: sindex/<ns>/<name>
+			if (strncmp(name, "sindex/", 7) != 0) {
+				return false;
+			}
+			name += 7;
+			size_t len = strlen(job->ns);
+			return strncmp(name, job->ns, len) == 0 && name[len] == '/' && strcmp(name + len + 1, job->name) == 0;
+		}
+	}
+	return false;
+}
+
+static char*
+as_job_build_command(as_vector* jobs, uint32_t* timeout_ms)
+{
+	// Combine all job status requests into one info request.
+	bool scan = false;
+	bool udf = false;
+	size_t size = 32;
+	uint32_t timeout = 0;
+	
+	for (uint32_t i = 0; i < jobs->size; i++) {
+		as_job* job = as_vector_get_ptr(jobs, i);
+		
+		if (job->type == AS_JOB_INDEX) {
+			size += strlen(job->ns) + strlen(job->name) + 9;
+		}
+		
+		if (job->timeout_ms > timeout) {
+			timeout = job->timeout_ms;
+		}
+	}
+	
+	char* command = cf_malloc(size);
+	char* p = command;
+	
+	for (uint32_t i = 0; i < jobs->size; i++) {
+		as_job* job = as_vector_get_ptr(jobs, i);
+		
+		switch (job->type) {
+			case AS_JOB_SCAN:
+				if (! scan) {
+					p += sprintf(p, "scan-list\n");
+					scan = true;
+				}
+				break;
+				
+			case AS_JOB_UDF:
+				if (! udf) {
+					p += sprintf(p, "udf-list\n");
+					udf = true;
+				}
+				break;
+				
+			case AS_JOB_INDEX:
+				p += sprintf(p, "sindex/%s/%s\n", job->ns, job->name);
+				break;
+		}
+	}
+	*p = 0;
+	*timeout_ms = (timeout == 0)? 1000 : timeout;
+	return command;
+}
+
+static int
+as_job_node_info(as_node* node, char* command, uint32_t timeout_ms, char** response)
+{
+	// Use pooled connection instead of opening a new socket per node and poll.
+	int fd;
+	int status = as_node_get_connection(node, &fd);
+	
+	if (status) {
+		*response = 0;
+		return status;
+	}
+	
+	status = citrusleaf_info_host_limit(fd, command, response, timeout_ms, true, 0, false);
+	
+	if (status) {
+		shutdown(fd, SHUT_RDWR);
+		cf_close(fd);
+		*response = 0;
+		return AEROSPIKE_ERR_CLUSTER;
+	}
+	as_node_put_connection(node, fd);
+	return AEROSPIKE_OK;
+}
+
+static void
+as_job_sweep(as_cluster* cluster, as_vector* jobs)
+{
+	uint32_t timeout_ms;
+	char* command = as_job_build_command(jobs, &timeout_ms);
+	
+	for (uint32_t i = 0; i < jobs->size; i++) {
+		as_job* job = as_vector_get_ptr(jobs, i);
+		job->running = false;
+	}
+	
+	as_vector values;
+	as_vector_inita(&values, sizeof(as_name_value), 32);
+	
+	as_nodes* nodes = as_nodes_reserve(cluster);
+	
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+		char* response = 0;
+		int status = as_job_node_info(node, command, timeout_ms, &response);
+		
+		if (status) {
+			// Scan waits report node errors. Index and UDF waits ignore them.
+			for (uint32_t j = 0; j < jobs->size; j++) {
+				as_job* job = as_vector_get_ptr(jobs, j);
+				
+				if (job->type == AS_JOB_SCAN && job->status == AEROSPIKE_OK) {
+					job->status = status;
+				}
+			}
+			continue;
+		}
+		
+		if (! response) {
+			continue;
+		}
+		
+		as_vector_clear(&values);
+		as_info_parse_multi_response(response, &values);
+		
+		for (uint32_t j = 0; j < values.size; j++) {
+			as_name_value* nv = as_vector_get(&values, j);
+			
+			// Errors embedded in a single command's value are ignored.
+			if (strncmp(nv->value, "ERROR:", 6) == 0 || strncmp(nv->value, "FAIL:", 5) == 0) {
+				continue;
+			}
+			
+			for (uint32_t k = 0; k < jobs->size; k++) {
+				as_job* job = as_vector_get_ptr(jobs, k);
+				
+				if (job->running || ! as_job_matches(job, nv->name)) {
+					continue;
+				}
+				
+				switch (job->type) {
+					case AS_JOB_SCAN:
+						as_job_parse_scan(job, nv->value);
+						break;
+					case AS_JOB_INDEX:
+						as_job_parse_index(job, nv->value);
+						break;
+					case AS_JOB_UDF:
+						as_job_parse_udf(job, nv->value);
+						break;
+				}
+			}
+		}
+		free(response);
+	}
+	as_nodes_release(nodes);
+	as_vector_destroy(&values);
+	cf_free(command);
+}
+
+static void
+as_job_watcher_destroy(as_job_watcher* watcher)
+{
+	// Woken waiters may still be reacquiring the lock, and other users
+	// may not have returned yet. Let them leave first.
+	pthread_mutex_lock(&watcher->lock);
+	
+	while (watcher->users > 0) {
+		pthread_cond_wait(&watcher->done_cond, &watcher->lock);
+	}
+	pthread_mutex_unlock(&watcher->lock);
+	
+	as_vector_destroy(&watcher->jobs);
+	pthread_cond_destroy(&watcher->done_cond);
+	pthread_cond_destroy(&watcher->wake_cond);
+	pthread_mutex_destroy(&watcher->lock);
+	cf_free(watcher);
+}
+
+static void*
+as_job_watcher_run(void* data)
+{
+	as_job_watcher* watcher = data;
+	as_vector snapshot;
+	as_vector_init(&snapshot, sizeof(as_job*), 16);
+	as_vector completed;
+	as_vector_init(&completed, sizeof(as_job*), 16);
+	struct timespec delta;
+	struct timespec abstime;
+	
+	pthread_mutex_lock(&watcher->lock);
+	
+	while (watcher->valid) {
+		if (watcher->jobs.size == 0) {
+			pthread_cond_wait(&watcher->wake_cond, &watcher->lock);
+			continue;
+		}
+		
+		uint64_t now = cf_getms();
+		
+		if (now < watcher->next_sweep) {
+			// Convert remaining interval into absolute timeout.
+			cf_clock_set_timespec_ms(watcher->next_sweep - now, &delta);
+			cf_clock_current_add(&delta, &abstime);
+			pthread_cond_timedwait(&watcher->wake_cond, &watcher->lock, &abstime);
+			continue;
+		}
+		
+		// Poll jobs registered so far. Jobs are only removed by this thread,
+		// so the pointers stay valid while the lock is released.
+		as_vector_clear(&snapshot);
+		uint32_t interval = UINT32_MAX;
+		
+		// Jobs added while the lock is released lower this to their first poll.
+		watcher->next_sweep = UINT64_MAX;
+		
+		for (uint32_t i = 0; i < watcher->jobs.size; i++) {
+			as_job* job = as_vector_get_ptr(&watcher->jobs, i);
+			as_vector_append(&snapshot, &job);
+			
+			if (as_job_interval(job) < interval) {
+				interval = as_job_interval(job);
+			}
+		}
+		pthread_mutex_unlock(&watcher->lock);
+		
+		as_job_sweep(watcher->cluster, &snapshot);
+		
+		pthread_mutex_lock(&watcher->lock);
+		as_vector_clear(&completed);
+		
+		for (uint32_t i = 0; i < snapshot.size; i++) {
+			as_job* job = as_vector_get_ptr(&snapshot, i);
+			
+			if (job->running && job->status == AEROSPIKE_OK) {
+				continue;
+			}
+			
+			// Remove completed job. Order of outstanding jobs does not matter.
+			as_job** list = watcher->jobs.list;
+			
+			for (uint32_t j = 0; j < watcher->jobs.size; j++) {
+				if (list[j] == job) {
+					list[j] = list[--watcher->jobs.size];
+					break;
+				}
+			}
+			
+			if (job->listener) {
+				as_vector_append(&completed, &job);
+			}
+			else {
+				job->done = true;
+			}
+		}
+		uint64_t next = cf_getms() + interval;
+		
+		if (next < watcher->next_sweep) {
+			watcher->next_sweep = next;
+		}
+		pthread_cond_broadcast(&watcher->done_cond);
+		
+		if (completed.size > 0) {
+			// Call listeners without holding lock.
+			pthread_mutex_unlock(&watcher->lock);
+			
+			for (uint32_t i = 0; i < completed.size; i++) {
+				as_job* job = as_vector_get_ptr(&completed, i);
+				job->done = true;
+				job->listener(job->status, job->udata);
+				cf_free(job);
+			}
+			pthread_mutex_lock(&watcher->lock);
+		}
+	}
+	
+	// Complete outstanding jobs on shutdown.
+	as_vector_clear(&completed);
+	
+	for (uint32_t i = 0; i < watcher->jobs.size; i++) {
+		as_job* job = as_vector_get_ptr(&watcher->jobs, i);
+		job->status = AEROSPIKE_ERR_CLIENT;
+		
+		if (job->listener) {
+			as_vector_append(&completed, &job);
+		}
+		else {
+			job->done = true;
+		}
+	}
+	as_vector_clear(&watcher->jobs);
+	pthread_cond_broadcast(&watcher->done_cond);
+	bool detached = watcher->detached;
+	pthread_mutex_unlock(&watcher->lock);
+	
+	for (uint32_t i = 0; i < completed.size; i++) {
+		as_job* job = as_vector_get_ptr(&completed, i);
+		job->done = true;
+		job->listener(job->status, job->udata);
+		cf_free(job);
+	}
+	as_vector_destroy(&completed);
+	as_vector_destroy(&snapshot);
+	
+	if (detached) {
+		as_job_watcher_destroy(watcher);
+	}
+	return NULL;
+}
+
+static as_job_watcher*
+as_job_watcher_get(as_cluster* cluster)
+{
+	// Register as user while holding the cluster lock, so shutdown can't
+	// destroy the watcher before as_job_watcher_release().
+	pthread_mutex_lock(&cluster->batch_init_lock);
+	as_job_watcher* watcher = cluster->job_watcher;
+	
+	if (! watcher) {
+		if (cluster->job_watcher_closed) {
+			pthread_mutex_unlock(&cluster->batch_init_lock);
+			return NULL;
+		}
+		
+		// Create watcher lazily on first job.
+		watcher = cf_malloc(sizeof(as_job_watcher));
+		watcher->cluster = cluster;
+		as_vector_init(&watcher->jobs, sizeof(as_job*), 16);
+		pthread_mutex_init(&watcher->lock, NULL);
+		pthread_cond_init(&watcher->wake_cond, NULL);
+		pthread_cond_init(&watcher->done_cond, NULL);
+		watcher->next_sweep = 0;
+		watcher->valid = true;
+		watcher->users = 0;
+		watcher->detached = false;
+		pthread_create(&watcher->thread, 0, as_job_watcher_run, watcher);
+		cluster->job_watcher = watcher;
+	}
+	
+	pthread_mutex_lock(&watcher->lock);
+	watcher->users++;
+	pthread_mutex_unlock(&watcher->lock);
+	pthread_mutex_unlock(&cluster->batch_init_lock);
+	return watcher;
+}
+
+static void
+as_job_watcher_release(as_job_watcher* watcher)
+{
+	// Caller must hold lock.
+	if (--watcher->users == 0 && ! watcher->valid) {
+		// Shutdown may be waiting for the last user to leave.
+		pthread_cond_broadcast(&watcher->done_cond);
+	}
+}
+
+static void
+as_job_watcher_add(as_job_watcher* watcher, as_job* job)
+{
+	// Caller must hold lock.
+	job->status = AEROSPIKE_OK;
+	job->done = false;
+	job->running = true;
+	
+	uint64_t next = cf_getms() + as_job_interval(job);
+	
+	if (watcher->jobs.size == 0 || next < watcher->next_sweep) {
+		watcher->next_sweep = next;
+	}
+	as_vector_append(&watcher->jobs, &job);
+	pthread_cond_signal(&watcher->wake_cond);
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_status
+as_job_watcher_wait(as_cluster* cluster, as_job* job)
+{
+	as_job_watcher* watcher = as_job_watcher_get(cluster);
+	
+	if (! watcher) {
+		return AEROSPIKE_ERR_CLIENT;
+	}
+	
+	job->listener = NULL;
+	
+	pthread_mutex_lock(&watcher->lock);
+	
+	if (! watcher->valid) {
+		as_job_watcher_release(watcher);
+		pthread_mutex_unlock(&watcher->lock);
+		return AEROSPIKE_ERR_CLIENT;
+	}
+	as_job_watcher_add(watcher, job);
+	
+	while (! job->done) {
+		pthread_cond_wait(&watcher->done_cond, &watcher->lock);
+	}
+	
+	as_status status = job->status;
+	as_job_watcher_release(watcher);
+	pthread_mutex_unlock(&watcher->lock);
+	return status;
+}
+
+void
+as_job_watcher_listen(as_cluster* cluster, const as_job* job)
+{
+	as_job_watcher* watcher = as_job_watcher_get(cluster);
+	
+	if (! watcher) {
+		job->listener(AEROSPIKE_ERR_CLIENT, job->udata);
+		return;
+	}
+	
+	as_job* copy = cf_malloc(sizeof(as_job));
+	memcpy(copy, job, sizeof(as_job));
+	
+	pthread_mutex_lock(&watcher->lock);
+	
+	if (! watcher->valid) {
+		as_job_watcher_release(watcher);
+		pthread_mutex_unlock(&watcher->lock);
+		copy->listener(AEROSPIKE_ERR_CLIENT, copy->udata);
+		cf_free(copy);
+		return;
+	}
+	as_job_watcher_add(watcher, copy);
+	as_job_watcher_release(watcher);
+	pthread_mutex_unlock(&watcher->lock);
+}
+
+void
+as_job_watcher_shutdown(as_cluster* cluster)
+{
+	// Detach watcher under the lock callers get it with. Callers which got
+	// it already are registered as users, and are waited for on destroy.
+	pthread_mutex_lock(&cluster->batch_init_lock);
+	as_job_watcher* watcher = cluster->job_watcher;
+	cluster->job_watcher = NULL;
+	cluster->job_watcher_closed = true;
+	pthread_mutex_unlock(&cluster->batch_init_lock);
+	
+	if (! watcher) {
+		return;
+	}
+	
+	// A listener may shut down the cluster from the watcher thread, which
+	// can't join itself. The thread then destroys the watcher when it exits.
+	bool self = pthread_equal(pthread_self(), watcher->thread);
+	
+	pthread_mutex_lock(&watcher->lock);
+	watcher->valid = false;
+	watcher->detached = self;
+	pthread_cond_signal(&watcher->wake_cond);
+	pthread_mutex_unlock(&watcher->lock);
+	
+	if (self) {
+		pthread_detach(watcher->thread);
+		return;
+	}
+	pthread_join(watcher->thread, NULL);
+	as_job_watcher_destroy(watcher);
+}
@@ -63,6 +63,7 @@ static as_key * as_key_cons(as_key * key, bool free, const as_namespace ns, cons
 		key->digest.init = true;
 		memcpy(key->digest.value, digest, AS_DIGEST_VALUE_SIZE);
 	}
+	key->route = NULL;
 	return key;
 }
 
@@ -235,3 +236,12 @@ as_digest * as_key_digest(as_key * key)
 
 	return NULL;
 }
+
+/**
+ *	Attach routing hints to the key.
+ */
+void as_key_set_route(as_key * key, as_key_route * route)
+{
+	if ( !key ) return;
+	key->route = route;
+}
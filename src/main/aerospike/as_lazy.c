@@ -0,0 +1,467 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_lazy.h>
+#include <aerospike/as_msgpack.h>
+#include <aerospike/as_serializer.h>
+#include <string.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef enum {
+	LAZY_OTHER,
+	LAZY_INT,
+	LAZY_RAW,
+	LAZY_ARRAY,
+	LAZY_MAP
+} lazy_kind;
+
+/**
+ *	A msgpack element header.
+ */
+typedef struct lazy_item_s {
+	lazy_kind kind;
+
+	// Value of LAZY_INT.
+	int64_t ival;
+
+	// Payload of LAZY_RAW.
+	const uint8_t* raw;
+	uint32_t raw_size;
+
+	// Number of elements of LAZY_ARRAY, or entries of LAZY_MAP.
+	uint32_t count;
+} lazy_item;
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline bool
+lazy_read_be(const uint8_t** pp, const uint8_t* end, uint32_t n, uint64_t* v)
+{
+	const uint8_t* p = *pp;
+	
+	if ((uint64_t)(end - p) < n) {
+		return false;
+	}
+	
+	uint64_t r = 0;
+	
+	for (uint32_t i = 0; i < n; i++) {
+		r = (r << 8) | p[i];
+	}
+	*v = r;
+	*pp = p + n;
+	return true;
+}
+
+static inline bool
+lazy_skip_bytes(const uint8_t** pp, const uint8_t* end, uint64_t n)
+{
+	if ((uint64_t)(end - *pp) < n) {
+		return false;
+	}
+	*pp += n;
+	return true;
+}
+
+/**
+ *	Read the header of the element at *pp.  Scalars are consumed whole.  For
+ *	arrays and maps, only the header is consumed and *pp is left at the
+ *	first element.
+ */
+static bool
+lazy_read(const uint8_t** pp, const uint8_t* end, lazy_item* item)
+{
+	if (*pp >= end) {
+		return false;
+	}
+	
+	uint8_t b = *(*pp)++;
+	uint64_t v;
+	
+	item->kind = LAZY_OTHER;
+	
+	if (b <= 0x7f) {
+		item->kind = LAZY_INT;
+		item->ival = b;
+		return true;
+	}
+	
+	if (b >= 0xe0) {
+		item->kind = LAZY_INT;
+		item->ival = (int8_t)b;
+		return true;
+	}
+	
+	if ((b & 0xf0) == 0x80 || (b & 0xf0) == 0x90) {
+		item->kind = (b & 0xf0) == 0x80 ? LAZY_MAP : LAZY_ARRAY;
+		item->count = b & 0x0f;
+		return true;
+	}
+	
+	if ((b & 0xe0) == 0xa0) {
+		v = b & 0x1f;
+		goto raw;
+	}
+	
+	switch (b) {
+		case 0xc0: // nil
+		case 0xc2: // false
+		case 0xc3: // true
+			return true;
+			
+		case 0xca: // float
+			return lazy_skip_bytes(pp, end, 4);
+			
+		case 0xcb: // double
+			return lazy_skip_bytes(pp, end, 8);
+			
+		case 0xcc:
+		case 0xcd:
+		case 0xce:
+		case 0xcf: {
+			if (! lazy_read_be(pp, end, 1 << (b - 0xcc), &v)) {
+				return false;
+			}
+			item->kind = LAZY_INT;
+			item->ival = (int64_t)v;
+			return true;
+		}
+			
+		case 0xd0:
+			if (! lazy_read_be(pp, end, 1, &v)) {
+				return false;
+			}
+			item->kind = LAZY_INT;
+			item->ival = (int8_t)v;
+			return true;
+			
+		case 0xd1:
+			if (! lazy_read_be(pp, end, 2, &v)) {
+				return false;
+			}
+			item->kind = LAZY_INT;
+			item->ival = (int16_t)v;
+			return true;
+			
+		case 0xd2:
+			if (! lazy_read_be(pp, end, 4, &v)) {
+				return false;
+			}
+			item->kind = LAZY_INT;
+			item->ival = (int32_t)v;
+			return true;
+			
+		case 0xd3:
+			if (! lazy_read_be(pp, end, 8, &v)) {
+				return false;
+			}
+			item->kind = LAZY_INT;
+			item->ival = (int64_t)v;
+			return true;
+			
+		case 0xd9: // str 8
+		case 0xc4: // bin 8
+			if (! lazy_read_be(pp, end, 1, &v)) {
+				return false;
+			}
+			goto raw;
+			
+		case 0xda: // raw 16
+		case 0xc5: // bin 16
+			if (! lazy_read_be(pp, end, 2, &v)) {
+				return false;
+			}
+			goto raw;
+			
+		case 0xdb: // raw 32
+		case 0xc6: // bin 32
+			if (! lazy_read_be(pp, end, 4, &v)) {
+				return false;
+			}
+			goto raw;
+			
+		case 0xd4: // fixext 1, 2, 4, 8, 16
+		case 0xd5:
+		case 0xd6:
+		case 0xd7:
+		case 0xd8:
+			return lazy_skip_bytes(pp, end, 1 + (1 << (b - 0xd4)));
+			
+		case 0xc7: // ext 8, 16, 32
+		case 0xc8:
+		case 0xc9:
+			if (! lazy_read_be(pp, end, 1 << (b - 0xc7), &v)) {
+				return false;
+			}
+			return lazy_skip_bytes(pp, end, v + 1);
+			
+		case 0xdc: // array 16, 32
+		case 0xdd:
+			if (! lazy_read_be(pp, end, b == 0xdc ? 2 : 4, &v)) {
+				return false;
+			}
+			item->kind = LAZY_ARRAY;
+			item->count = (uint32_t)v;
+			return true;
+			
+		case 0xde: // map 16, 32
+		case 0xdf:
+			if (! lazy_read_be(pp, end, b == 0xde ? 2 : 4, &v)) {
+				return false;
+			}
+			item->kind = LAZY_MAP;
+			item->count = (uint32_t)v;
+			return true;
+			
+		default:
+			return false;
+	}
+	
+raw:
+	item->kind = LAZY_RAW;
+	item->raw = *pp;
+	item->raw_size = (uint32_t)v;
+	return lazy_skip_bytes(pp, end, v);
+}
+
+/**
+ *	Skip the element at *pp, including everything nested in it.
+ */
+static bool
+lazy_skip(const uint8_t** pp, const uint8_t* end)
+{
+	uint64_t pending = 1;
+	lazy_item item;
+	
+	while (pending > 0) {
+		if (! lazy_read(pp, end, &item)) {
+			return false;
+		}
+		pending--;
+		
+		if (item.kind == LAZY_ARRAY) {
+			pending += item.count;
+		}
+		else if (item.kind == LAZY_MAP) {
+			pending += (uint64_t)item.count * 2;
+		}
+	}
+	return true;
+}
+
+static as_val*
+lazy_decode(const uint8_t* p, const uint8_t* end)
+{
+	as_buffer buffer;
+	buffer.data = (uint8_t*)p;
+	buffer.size = (uint32_t)(end - p);
+	buffer.capacity = buffer.size;
+	
+	as_val* val = NULL;
+	as_serializer ser;
+	as_msgpack_init(&ser);
+	as_serializer_deserialize(&ser, &buffer, &val);
+	as_serializer_destroy(&ser);
+	return val;
+}
+
+/**
+ *	Decode the element at p, which must be followed by at least one whole
+ *	element.
+ */
+static as_val*
+lazy_decode_next(const uint8_t* p, const uint8_t* end)
+{
+	const uint8_t* next = p;
+	
+	if (! lazy_skip(&next, end)) {
+		return NULL;
+	}
+	return lazy_decode(p, next);
+}
+
+/**
+ *	Position *pp at the first element of a raw list or map.
+ */
+static bool
+lazy_open(const as_bytes* b, lazy_kind kind, const uint8_t** pp, const uint8_t** end, uint32_t* count)
+{
+	if (! b || ! b->value) {
+		return false;
+	}
+	
+	*pp = b->value;
+	*end = b->value + b->size;
+	
+	lazy_item item;
+	
+	if (! lazy_read(pp, *end, &item) || item.kind != kind) {
+		return false;
+	}
+	*count = item.count;
+	return true;
+}
+
+typedef bool (*lazy_key_match)(const lazy_item* item, const void* key);
+
+static bool
+lazy_match_str(const lazy_item* item, const void* key)
+{
+	// Strings are packed as raw bytes prefixed with their as_bytes type.
+	const char* s = key;
+	size_t len = strlen(s);
+	
+	return item->kind == LAZY_RAW && item->raw_size == len + 1 &&
+		item->raw[0] == AS_BYTES_STRING && memcmp(item->raw + 1, s, len) == 0;
+}
+
+static bool
+lazy_match_int64(const lazy_item* item, const void* key)
+{
+	return item->kind == LAZY_INT && item->ival == *(const int64_t*)key;
+}
+
+static as_val*
+lazy_map_get(const as_bytes* b, lazy_key_match match, const void* key)
+{
+	const uint8_t* p;
+	const uint8_t* end;
+	uint32_t count;
+	
+	if (! lazy_open(b, LAZY_MAP, &p, &end, &count)) {
+		return NULL;
+	}
+	
+	lazy_item item;
+	
+	for (uint32_t i = 0; i < count; i++) {
+		const uint8_t* k = p;
+		
+		if (! lazy_read(&p, end, &item)) {
+			return NULL;
+		}
+		
+		if (item.kind == LAZY_ARRAY || item.kind == LAZY_MAP) {
+			// Container keys never match - skip them whole.
+			p = k;
+			
+			if (! lazy_skip(&p, end)) {
+				return NULL;
+			}
+		}
+		else if (match(&item, key)) {
+			return lazy_decode_next(p, end);
+		}
+		
+		if (! lazy_skip(&p, end)) {
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_bytes*
+as_lazy_fromval(const as_val* v)
+{
+	if (! v || v->type != AS_BYTES) {
+		return NULL;
+	}
+	
+	as_bytes* b = (as_bytes*)v;
+	return (b->type == AS_BYTES_LIST || b->type == AS_BYTES_MAP) ? b : NULL;
+}
+
+bool
+as_lazy_size(const as_bytes* b, uint32_t* size)
+{
+	const uint8_t* p;
+	const uint8_t* end;
+	
+	if (! b) {
+		return false;
+	}
+	return lazy_open(b, b->type == AS_BYTES_MAP ? LAZY_MAP : LAZY_ARRAY, &p, &end, size);
+}
+
+as_val*
+as_lazy_decode(const as_bytes* b)
+{
+	if (! b || ! b->value) {
+		return NULL;
+	}
+	return lazy_decode(b->value, b->value + b->size);
+}
+
+as_val*
+as_lazy_list_get(const as_bytes* b, uint32_t index)
+{
+	const uint8_t* p;
+	const uint8_t* end;
+	uint32_t count;
+	
+	if (! lazy_open(b, LAZY_ARRAY, &p, &end, &count) || index >= count) {
+		return NULL;
+	}
+	
+	for (uint32_t i = 0; i < index; i++) {
+		if (! lazy_skip(&p, end)) {
+			return NULL;
+		}
+	}
+	return lazy_decode_next(p, end);
+}
+
+as_val*
+as_lazy_map_get_str(const as_bytes* b, const char* key)
+{
+	return lazy_map_get(b, lazy_match_str, key);
+}
+
+as_val*
+as_lazy_map_get_int64(const as_bytes* b, int64_t key)
+{
+	return lazy_map_get(b, lazy_match_int64, &key);
+}
+
+as_val*
+as_lazy_record_get(as_record* rec, const as_bin_name name)
+{
+	as_val* v = (as_val*)as_record_get(rec, name);
+	as_bytes* b = as_lazy_fromval(v);
+	
+	if (! b) {
+		return v;
+	}
+	
+	as_val* decoded = as_lazy_decode(b);
+	
+	if (! decoded) {
+		return NULL;
+	}
+	
+	// Replaces and destroys the raw value.
+	as_record_set(rec, name, (as_bin_value*)decoded);
+	return decoded;
+}
@@ -0,0 +1,360 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_lua_cache.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_module.h>
+#include <aerospike/as_string.h>
+#include <aerospike/as_udf.h>
+#include <aerospike/mod_lua.h>
+#include <aerospike/mod_lua_config.h>
+#include <citrusleaf/cf_clock.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "ck_pr.h"
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+// Minimum milliseconds between file modification checks for a module.
+#define AS_LUA_CACHE_CHECK_MS 1000
+
+// Most user modules tracked. Further modules run untracked, as misses.
+#define AS_LUA_CACHE_MODULES_MAX 128
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef struct as_lua_module_s {
+	// Set once before the module is published.
+	char name[AS_UDF_FILE_NAME_SIZE];
+	// Only accessed under g_lua_lock.
+	time_t mtime;
+	// Time of last file check. Claimed with a CAS, so one thread checks.
+	uint64_t checked;
+	as_lua_pool pool;
+} as_lua_module;
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+// Serializes module loads and configuration. Executions don't take it.
+static pthread_mutex_t g_lua_lock = PTHREAD_MUTEX_INITIALIZER;
+static as_lua_module g_lua_modules[AS_LUA_CACHE_MODULES_MAX];
+static uint32_t g_lua_modules_size = 0;
+static bool g_lua_cache_enabled = false;
+static char g_lua_user_path[AS_CONFIG_PATH_MAX_SIZE];
+static as_lua_cache_stats g_lua_stats;
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static as_lua_module*
+as_lua_module_find(const char* name)
+{
+	// Modules are only appended, and never move.
+	uint32_t size = ck_pr_load_32(&g_lua_modules_size);
+	ck_pr_fence_load();
+	
+	for (uint32_t i = 0; i < size; i++) {
+		as_lua_module* m = &g_lua_modules[i];
+		
+		if (strcmp(m->name, name) == 0) {
+			return m;
+		}
+	}
+	return NULL;
+}
+
+static bool
+as_lua_module_stat(const char* name, time_t* mtime)
+{
+	char path[AS_CONFIG_PATH_MAX_SIZE + AS_UDF_FILE_NAME_SIZE + 8];
+	snprintf(path, sizeof(path), "%s/%s.lua", g_lua_user_path, name);
+	
+	struct stat st;
+	
+	if (stat(path, &st) != 0) {
+		return false;
+	}
+	*mtime = st.st_mtime;
+	return true;
+}
+
+static void
+as_lua_module_load(as_lua_module* m)
+{
+	// Caller must hold lock. States of the previous load are not pooled again.
+	as_lua_pool_reset(&m->pool);
+	
+	// Rebuild the module's precompiled Lua states.
+	char filename[AS_UDF_FILE_NAME_SIZE + 8];
+	snprintf(filename, sizeof(filename), "%s.lua", m->name);
+	
+	as_module_event e = {
+		.type = AS_MODULE_EVENT_FILE_ADD,
+		.data.filename = filename
+	};
+	as_module_update(&mod_lua, &e);
+}
+
+static as_lua_module*
+as_lua_module_add(const char* name, time_t mtime, uint64_t now)
+{
+	// Caller must hold lock.
+	uint32_t size = g_lua_modules_size;
+	
+	if (size == AS_LUA_CACHE_MODULES_MAX) {
+		return NULL;
+	}
+	
+	as_lua_module* m = &g_lua_modules[size];
+	as_strncpy(m->name, name, sizeof(m->name));
+	m->mtime = mtime;
+	m->checked = now;
+	m->pool.state = 0;
+	
+	// Publish module after its fields.
+	ck_pr_fence_store();
+	ck_pr_store_32(&g_lua_modules_size, size + 1);
+	return m;
+}
+
+static void
+as_lua_cache_warm(void)
+{
+	// Load every module in user path before the first query needs it.
+	DIR* dir = opendir(g_lua_user_path);
+	
+	if (! dir) {
+		return;
+	}
+	
+	uint64_t now = cf_getms();
+	struct dirent* entry;
+	
+	while ((entry = readdir(dir))) {
+		char* ext = strrchr(entry->d_name, '.');
+		
+		if (! ext || strcmp(ext, ".lua") != 0) {
+			continue;
+		}
+		
+		char name[AS_UDF_FILE_NAME_SIZE];
+		size_t len = ext - entry->d_name;
+		
+		if (len == 0 || len >= sizeof(name)) {
+			continue;
+		}
+		memcpy(name, entry->d_name, len);
+		name[len] = 0;
+		
+		time_t mtime;
+		
+		if (as_lua_module_find(name) || ! as_lua_module_stat(name, &mtime)) {
+			continue;
+		}
+		
+		as_lua_module* m = as_lua_module_add(name, mtime, now);
+		
+		if (m) {
+			as_lua_module_load(m);
+		}
+	}
+	closedir(dir);
+}
+
+static void
+as_lua_module_check(as_lua_module* m, time_t mtime, uint64_t now)
+{
+	// Reload module if its file changed since it was loaded.
+	pthread_mutex_lock(&g_lua_lock);
+	
+	if (m->mtime != mtime) {
+		as_log_debug("Reload changed lua module %s", m->name);
+		m->mtime = mtime;
+		as_lua_module_load(m);
+		ck_pr_inc_64(&g_lua_stats.invalidations);
+	}
+	ck_pr_store_64(&m->checked, now);
+	pthread_mutex_unlock(&g_lua_lock);
+}
+
+static uint32_t
+as_lua_module_take(as_lua_module* m)
+{
+	bool hit;
+	uint32_t ticket = as_lua_pool_take(&m->pool, &hit);
+	
+	if (hit) {
+		ck_pr_inc_64(&g_lua_stats.hits);
+	}
+	else {
+		ck_pr_inc_64(&g_lua_stats.misses);
+	}
+	return ticket;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+void
+as_lua_cache_configure(as_config_lua* config)
+{
+	mod_lua_config lua = {
+		.server_mode    = false,
+		.cache_enabled  = config->cache_enabled,
+		.system_path    = {0},
+		.user_path      = {0}
+	};
+	memcpy(lua.system_path, config->system_path, sizeof(lua.system_path));
+	memcpy(lua.user_path, config->user_path, sizeof(lua.user_path));
+	
+	pthread_mutex_lock(&g_lua_lock);
+	
+	as_module_configure(&mod_lua, &lua);
+	
+	// Configuration may point to a different path, so check known modules
+	// again on next use. Modules stay in place for concurrent executions.
+	uint32_t size = g_lua_modules_size;
+	
+	for (uint32_t i = 0; i < size; i++) {
+		as_lua_module* m = &g_lua_modules[i];
+		m->mtime = 0;
+		ck_pr_store_64(&m->checked, 0);
+	}
+	
+	memcpy(g_lua_user_path, config->user_path, sizeof(g_lua_user_path));
+	g_lua_cache_enabled = config->cache_enabled;
+	
+	if (g_lua_cache_enabled) {
+		as_lua_cache_warm();
+	}
+	pthread_mutex_unlock(&g_lua_lock);
+}
+
+uint32_t
+as_lua_cache_reserve(const char* module)
+{
+	if (! g_lua_cache_enabled) {
+		// Lua states are created for every execution.
+		ck_pr_inc_64(&g_lua_stats.misses);
+		return 0;
+	}
+	
+	uint64_t now = cf_getms();
+	as_lua_module* m = as_lua_module_find(module);
+	
+	if (m) {
+		uint64_t checked = ck_pr_load_64(&m->checked);
+		
+		// One thread per interval checks the file, others use the module.
+		if (now >= checked + AS_LUA_CACHE_CHECK_MS && ck_pr_cas_64(&m->checked, checked, now)) {
+			time_t mtime;
+			
+			if (! as_lua_module_stat(module, &mtime)) {
+				// File is gone. Let mod_lua resolve it.
+				ck_pr_inc_64(&g_lua_stats.misses);
+				return 0;
+			}
+			as_lua_module_check(m, mtime, now);
+		}
+		return as_lua_module_take(m);
+	}
+	
+	time_t mtime;
+	
+	if (! as_lua_module_stat(module, &mtime)) {
+		// Not a user module file. Let mod_lua resolve it.
+		ck_pr_inc_64(&g_lua_stats.misses);
+		return 0;
+	}
+	
+	pthread_mutex_lock(&g_lua_lock);
+	
+	// Another thread may have added the module meanwhile.
+	m = as_lua_module_find(module);
+	
+	if (! m) {
+		m = as_lua_module_add(module, mtime, now);
+		
+		if (m) {
+			as_lua_module_load(m);
+		}
+	}
+	pthread_mutex_unlock(&g_lua_lock);
+	
+	if (! m) {
+		// Too many modules to track.
+		ck_pr_inc_64(&g_lua_stats.misses);
+		return 0;
+	}
+	return as_lua_module_take(m);
+}
+
+void
+as_lua_cache_release(const char* module, uint32_t ticket)
+{
+	if (ticket == 0) {
+		return;
+	}
+	
+	as_lua_module* m = as_lua_module_find(module);
+	
+	if (m) {
+		as_lua_pool_put(&m->pool, ticket);
+	}
+}
+
+void
+as_lua_cache_invalidate(const char* filename)
+{
+	char name[AS_UDF_FILE_NAME_SIZE];
+	as_strncpy(name, filename, sizeof(name));
+	
+	char* ext = strrchr(name, '.');
+	
+	if (ext && strcmp(ext, ".lua") == 0) {
+		*ext = 0;
+	}
+	
+	pthread_mutex_lock(&g_lua_lock);
+	
+	as_lua_module* m = as_lua_module_find(name);
+	
+	if (m) {
+		// Force file check and reload on next use.
+		m->mtime = 0;
+		ck_pr_store_64(&m->checked, 0);
+	}
+	pthread_mutex_unlock(&g_lua_lock);
+}
+
+void
+as_lua_cache_get_stats(as_lua_cache_stats* stats)
+{
+	stats->hits = ck_pr_load_64(&g_lua_stats.hits);
+	stats->misses = ck_pr_load_64(&g_lua_stats.misses);
+	stats->invalidations = ck_pr_load_64(&g_lua_stats.invalidations);
+}
@@ -16,17 +16,22 @@
  */
 #include <aerospike/as_node.h>
 #include <aerospike/as_admin.h>
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_info.h>
 #include <aerospike/as_log_macros.h>
+#include <aerospike/as_slowops.h>
+#include <aerospike/as_socket_profile.h>
 #include <aerospike/as_string.h>
 #include <citrusleaf/cf_byte_order.h>
 #include <citrusleaf/cf_proto.h>
 #include <citrusleaf/cf_socket.h>
 #include <errno.h> //errno
+#include <pthread.h>
+#include <sched.h>
 
 // Replicas take ~2K per namespace, so this will cover most deployments:
-#define INFO_STACK_BUF_SIZE (16 * 1024)
+#define INFO_BUFFER_SIZE (16 * 1024)
 
 /******************************************************************************
  *	Function declarations.
@@ -42,7 +47,7 @@ as_partition_tables_update(struct as_cluster_s* cluster, as_node* node, char* bu
 as_node*
 as_node_create(as_cluster* cluster, const char* name, struct sockaddr_in* addr)
 {
-	as_node* node = cf_malloc(sizeof(as_node));
+	as_node* node = as_alloc_malloc(AS_ALLOC_TAG_CLUSTER, sizeof(as_node));
 
 	if (!node) {
 		return 0;
@@ -58,7 +63,21 @@ as_node_create(as_cluster* cluster, const char* name, struct sockaddr_in* addr)
 	as_vector_init(&node->addresses, sizeof(as_address), 2);
 	as_node_add_address(node, addr);
 		
-	node->conn_q = cf_queue_create(sizeof(int), true);
+	// Split the pool so threads on different CPUs don't contend on one queue.
+	uint32_t n_qs = cluster->conn_pools_per_node ? cluster->conn_pools_per_node : 1;
+	node->conn_qs = as_alloc_malloc(AS_ALLOC_TAG_CLUSTER, sizeof(cf_queue*) * n_qs);
+	
+	if (! node->conn_qs) {
+		as_vector_destroy(&node->addresses);
+		as_alloc_free(node);
+		return 0;
+	}
+	
+	for (uint32_t i = 0; i < n_qs; i++) {
+		node->conn_qs[i] = cf_queue_create(sizeof(int), true);
+	}
+	node->conn_qs_size = n_qs;
+	node->conn_q_limit = (cluster->conn_queue_size + n_qs - 1) / n_qs;
 	// node->conn_q_asyncfd = cf_queue_create(sizeof(int), true);
 	// node->asyncwork_q = cf_queue_create(sizeof(cl_async_work*), true);
 	
@@ -67,20 +86,27 @@ as_node_create(as_cluster* cluster, const char* name, struct sockaddr_in* addr)
 	node->failures = 0;
 	node->index = 0;
 	node->active = true;
+	
+	// Fetch replicas with the first status request.
+	node->partitions_changed = true;
+	node->info_buffer = 0;
+	node->info_buffer_size = 0;
 	return node;
 }
 
 void
 as_node_destroy(as_node* node)
 {
-	// Drain out the queue and close the FDs
+	// Drain out the queues and close the FDs
 	int rv;
-	do {
-		int	fd;
-		rv = cf_queue_pop(node->conn_q, &fd, CF_QUEUE_NOWAIT);
-		if (rv == CF_QUEUE_OK)
-			cf_close(fd);
-	} while (rv == CF_QUEUE_OK);
+	for (uint32_t i = 0; i < node->conn_qs_size; i++) {
+		do {
+			int	fd;
+			rv = cf_queue_pop(node->conn_qs[i], &fd, CF_QUEUE_NOWAIT);
+			if (rv == CF_QUEUE_OK)
+				cf_close(fd);
+		} while (rv == CF_QUEUE_OK);
+	}
 	
 	/*
 	 do {
@@ -108,7 +134,11 @@ as_node_destroy(as_node* node)
 	 */
 	
 	as_vector_destroy(&node->addresses);
-	cf_queue_destroy(node->conn_q);
+	
+	for (uint32_t i = 0; i < node->conn_qs_size; i++) {
+		cf_queue_destroy(node->conn_qs[i]);
+	}
+	as_alloc_free(node->conn_qs);
 	//cf_queue_destroy(node->conn_q_asyncfd);
 	//cf_queue_destroy(node->asyncwork_q);
 	
@@ -116,7 +146,8 @@ as_node_destroy(as_node* node)
 		cf_close(node->info_fd);
 	}
 
-	cf_free(node);
+	as_alloc_free(node->info_buffer);
+	as_alloc_free(node);
 }
 
 void
@@ -185,8 +216,10 @@ as_node_authenticate_connection(as_node* node, int* fd)
 }
 
 static int
-as_node_create_connection(as_node* node, int* fd)
+as_node_create_connection(as_node* node, int* fd, as_slowop* op)
 {
+	as_slowop_mark(op, AS_SLOWOP_CHECKOUT);
+	
 	// Create a non-blocking socket.
 	*fd = cf_socket_create_nb();
 	
@@ -196,12 +229,17 @@ as_node_create_connection(as_node* node, int* fd)
 		return AEROSPIKE_ERR_CLIENT;
 	}
 	
+	as_socket_profile_apply(&node->cluster->socket, *fd);
+	
 	// Try primary address.
 	as_address* primary = as_vector_get(&node->addresses, node->address_index);
 	
 	if (cf_socket_start_connect_nb(*fd, &primary->addr) == 0) {
 		// Connection started ok - we have our socket.
-		return as_node_authenticate_connection(node, fd);
+		as_slowop_mark(op, AS_SLOWOP_CONNECT);
+		int status = as_node_authenticate_connection(node, fd);
+		as_slowop_mark(op, AS_SLOWOP_AUTH);
+		return status;
 	}
 	
 	// Try other addresses.
@@ -217,7 +255,10 @@ as_node_create_connection(as_node* node, int* fd)
 				// It's just a hint, not a requirement to try this new address first.
 				as_log_debug("Change node address %s %s:%d", node->name, address->name, (int)cf_swap_from_be16(address->addr.sin_port));
 				ck_pr_store_32(&node->address_index, i);
-				return as_node_authenticate_connection(node, fd);
+				as_slowop_mark(op, AS_SLOWOP_CONNECT);
+				int status = as_node_authenticate_connection(node, fd);
+				as_slowop_mark(op, AS_SLOWOP_AUTH);
+				return status;
 			}
 		}
 	}
@@ -229,14 +270,64 @@ as_node_create_connection(as_node* node, int* fd)
 	return AEROSPIKE_ERR_CLUSTER;
 }
 
+/**
+ *	Index of the connection pool for the calling thread - the pool of the CPU
+ *	it runs on, so connections are reused where their socket state is cached.
+ */
+static inline uint32_t
+as_node_conn_q_index(as_node* node)
+{
+	if (node->conn_qs_size == 1) {
+		return 0;
+	}
+	
+#ifdef __linux__
+	int cpu = sched_getcpu();
+	
+	if (cpu >= 0) {
+		return (uint32_t)cpu % node->conn_qs_size;
+	}
+#endif
+	
+	// No CPU number - at least keep each thread on one pool.
+	uintptr_t self = (uintptr_t)pthread_self();
+	return (uint32_t)((self >> 12) ^ self) % node->conn_qs_size;
+}
+
+/**
+ *	Pop a cached FD, from the calling thread's pool first and then from the
+ *	others, so FDs don't pile up in pools of idle CPUs.
+ */
+static int
+as_node_pop_connection(as_node* node, int* fd)
+{
+	uint32_t index = as_node_conn_q_index(node);
+	
+	for (uint32_t i = 0; i < node->conn_qs_size; i++) {
+		int rv = cf_queue_pop(node->conn_qs[index], fd, CF_QUEUE_NOWAIT);
+		
+		if (rv != CF_QUEUE_EMPTY) {
+			return rv;
+		}
+		
+		if (++index == node->conn_qs_size) {
+			index = 0;
+		}
+	}
+	return CF_QUEUE_EMPTY;
+}
+
 int
 as_node_get_connection(as_node* node, int* fd)
 {
-	//cf_queue* q = asyncfd ? node->conn_q_asyncfd : node->conn_q;
-	cf_queue* q = node->conn_q;
-	
+	return as_node_get_connection_timed(node, fd, NULL);
+}
+
+int
+as_node_get_connection_timed(as_node* node, int* fd, as_slowop* op)
+{
 	while (1) {
-		int rv = cf_queue_pop(q, fd, CF_QUEUE_NOWAIT);
+		int rv = as_node_pop_connection(node, fd);
 		
 		if (rv == CF_QUEUE_OK) {
 			int rv2 = is_connected(*fd);
@@ -262,7 +353,7 @@ as_node_get_connection(as_node* node, int* fd)
 		}
 		else if (rv == CF_QUEUE_EMPTY) {
 			// We exhausted the queue. Try creating a fresh socket.
-			return as_node_create_connection(node, fd);
+			return as_node_create_connection(node, fd, op);
 		}
 		else {
 			as_log_error("Bad return value from cf_queue_pop");
@@ -275,10 +366,20 @@ as_node_get_connection(as_node* node, int* fd)
 void
 as_node_put_connection(as_node* node, int fd)
 {
-	cf_queue *q = node->conn_q;
-	if (! cf_queue_push_limit(q, &fd, 300)) {
-		cf_close(fd);
+	// Spill over to other pools when this CPU's pool is full, so the node
+	// still caches up to conn_queue_size FDs in total.
+	uint32_t index = as_node_conn_q_index(node);
+	
+	for (uint32_t i = 0; i < node->conn_qs_size; i++) {
+		if (cf_queue_push_limit(node->conn_qs[index], &fd, node->conn_q_limit)) {
+			return;
+		}
+		
+		if (++index == node->conn_qs_size) {
+			index = 0;
+		}
 	}
+	cf_close(fd);
 	
 	/*
 	if (asyncfd == true) {
@@ -299,7 +400,7 @@ as_node_get_info_connection(as_node* node)
 {
 	if (node->info_fd < 0) {
 		// Try to open a new socket.
-		return as_node_create_connection(node, &node->info_fd);
+		return as_node_create_connection(node, &node->info_fd, NULL);
 	}
 	return 0;
 }
@@ -313,34 +414,59 @@ as_node_close_info_connection(as_node* node)
 }
 
 static uint8_t*
-as_node_get_info(as_node* node, const char* names, size_t names_len, int timeout_ms, uint8_t* stack_buf)
+as_node_get_info_buffer(as_node* node, size_t size)
+{
+	if (size > node->info_buffer_size) {
+		// Round up, so a node's buffer settles after a few tends.
+		size_t capacity = (size + INFO_BUFFER_SIZE - 1) / INFO_BUFFER_SIZE * INFO_BUFFER_SIZE;
+		uint8_t* buf = as_alloc_malloc(AS_ALLOC_TAG_CLUSTER, capacity);
+		
+		if (! buf) {
+			as_log_error("Node %s failed allocation for info buffer", node->name);
+			return 0;
+		}
+		as_alloc_free(node->info_buffer);
+		node->info_buffer = buf;
+		node->info_buffer_size = (uint32_t)capacity;
+	}
+	return node->info_buffer;
+}
+
+static uint8_t*
+as_node_get_info(as_node* node, const char* names, size_t names_len, int timeout_ms)
 {
 	int fd = node->info_fd;
 	
 	// Prepare the write request buffer.
 	size_t write_size = sizeof(cl_proto) + names_len;
-	cl_proto* proto = (cl_proto*)stack_buf;
+	uint8_t* buf = as_node_get_info_buffer(node, write_size);
+	
+	if (! buf) {
+		return 0;
+	}
+	
+	cl_proto* proto = (cl_proto*)buf;
 	
 	proto->sz = names_len;
 	proto->version = CL_PROTO_VERSION;
 	proto->type = CL_PROTO_TYPE_INFO;
 	cl_proto_swap_to_be(proto);
 	
-	memcpy((void*)(stack_buf + sizeof(cl_proto)), (const void*)names, names_len);
+	memcpy((void*)(buf + sizeof(cl_proto)), (const void*)names, names_len);
 	
 	// Write the request. Note that timeout_ms is never 0.
-	if (cf_socket_write_timeout(fd, stack_buf, write_size, 0, timeout_ms) != 0) {
+	if (cf_socket_write_timeout(fd, buf, write_size, 0, timeout_ms) != 0) {
 		as_log_debug("Node %s failed info socket write", node->name);
 		return 0;
 	}
 	
 	// Reuse the buffer, read the response - first 8 bytes contains body size.
-	if (cf_socket_read_timeout(fd, stack_buf, sizeof(cl_proto), 0, timeout_ms) != 0) {
+	if (cf_socket_read_timeout(fd, buf, sizeof(cl_proto), 0, timeout_ms) != 0) {
 		as_log_debug("Node %s failed info socket read header", node->name);
 		return 0;
 	}
 	
-	proto = (cl_proto*)stack_buf;
+	proto = (cl_proto*)buf;
 	cl_proto_swap_from_be(proto);
 	
 	// Sanity check body size.
@@ -349,24 +475,19 @@ as_node_get_info(as_node* node, const char* names, size_t names_len, int timeout
 		return 0;
 	}
 	
-	// Allocate a buffer if the response is bigger than the stack buffer -
-	// caller must free it if this call succeeds. Note that proto is overwritten
-	// if stack_buf is used, so we save the sz field here.
+	// Grow the node's buffer if the response is bigger. The response stays
+	// valid until the next request on this node. Note that proto is
+	// overwritten, so we save the sz field here.
 	size_t proto_sz = proto->sz;
-	uint8_t* rbuf = proto_sz >= INFO_STACK_BUF_SIZE ? (uint8_t*)cf_malloc(proto_sz + 1) : stack_buf;
+	uint8_t* rbuf = as_node_get_info_buffer(node, proto_sz + 1);
 	
 	if (! rbuf) {
-		as_log_error("Node %s failed allocation for info response", node->name);
 		return 0;
 	}
 	
 	// Read the response body.
 	if (cf_socket_read_timeout(fd, rbuf, proto_sz, 0, timeout_ms) != 0) {
 		as_log_debug("Node %s failed info socket read body", node->name);
-		
-		if (rbuf != stack_buf) {
-			cf_free(rbuf);
-		}
 		return 0;
 	}
 	
@@ -525,6 +646,9 @@ as_node_process_response(as_cluster* cluster, as_node* node, as_vector* values,
 		else if (strcmp(nv->name, "services") == 0) {
 			as_node_add_friends(cluster, node, nv->value, friends);
 		}
+		else if (strncmp(nv->name, "replicas-", 9) == 0) {
+			// Requested up front - see as_node_process_partitions().
+		}
 		else {
 			as_log_warn("Node %s did not request info '%s'", node->name, nv->name);
 		}
@@ -547,6 +671,9 @@ as_node_process_partitions(as_cluster* cluster, as_node* node, as_vector* values
 		else if (strcmp(nv->name, "replicas-prole") == 0) {
 			as_partition_tables_update(cluster, node, nv->value, false);
 		}
+		else if (strcmp(nv->name, "node") == 0 || strcmp(nv->name, "services") == 0) {
+			// Node status requested with the replicas - already processed.
+		}
 		else {
 			as_log_warn("Node %s did not request info '%s'", node->name, nv->name);
 		}
@@ -554,10 +681,15 @@ as_node_process_partitions(as_cluster* cluster, as_node* node, as_vector* values
 }
 
 const char INFO_STR_CHECK[] = "node\npartition-generation\nservices\n";
+const char INFO_STR_CHECK_REPLICAS[] = "node\npartition-generation\nservices\nreplicas-master\nreplicas-prole\n";
 const char INFO_STR_GET_REPLICAS[] = "partition-generation\nreplicas-master\nreplicas-prole\n";
 
 /**
  *	Request current status from server node.
+ *
+ *	Replicas are requested in a second round trip when the partition generation
+ *	changes.  While partitions keep changing, replicas are requested with the
+ *	status instead, so each tend takes a single round trip.
  */
 bool
 as_node_refresh(as_cluster* cluster, as_node* node, as_vector* /* <as_friend> */ friends)
@@ -569,8 +701,10 @@ as_node_refresh(as_cluster* cluster, as_node* node, as_vector* /* <as_friend> */
 	}
 	
 	uint32_t info_timeout = cluster->conn_timeout_ms;
-	uint8_t stack_buf[INFO_STACK_BUF_SIZE];
-	uint8_t* buf = as_node_get_info(node, INFO_STR_CHECK, sizeof(INFO_STR_CHECK) - 1, info_timeout, stack_buf);
+	bool with_replicas = node->partitions_changed;
+	uint8_t* buf = with_replicas ?
+		as_node_get_info(node, INFO_STR_CHECK_REPLICAS, sizeof(INFO_STR_CHECK_REPLICAS) - 1, info_timeout) :
+		as_node_get_info(node, INFO_STR_CHECK, sizeof(INFO_STR_CHECK) - 1, info_timeout);
 	
 	if (! buf) {
 		as_node_close_info_connection(node);
@@ -578,37 +712,31 @@ as_node_refresh(as_cluster* cluster, as_node* node, as_vector* /* <as_friend> */
 	}
 	
 	as_vector values;
-	as_vector_inita(&values, sizeof(as_name_value), 4);
+	as_vector_inita(&values, sizeof(as_name_value), 6);
 	
 	as_info_parse_multi_response((char*)buf, &values);
 	
 	bool update_partitions;
 	bool status = as_node_process_response(cluster, node, &values, friends, &update_partitions);
-		
-	if (buf != stack_buf) {
-		cf_free(buf);
-	}
 	
-	if (status && update_partitions) {
-		buf = as_node_get_info(node, INFO_STR_GET_REPLICAS, sizeof(INFO_STR_GET_REPLICAS) - 1, info_timeout, stack_buf);
-		
-		if (! buf) {
-			as_node_close_info_connection(node);
-			as_vector_destroy(&values);
-			return false;
-		}
-		
-		as_vector_clear(&values);
-		
-		as_info_parse_multi_response((char*)buf, &values);
-
-		if (buf) {
-			as_node_process_partitions(cluster, node, &values);
+	// Unchanged replicas received with the status are simply dropped.
+	node->partitions_changed = status && update_partitions;
+	
+	if (node->partitions_changed) {
+		if (! with_replicas) {
+			// Overwrites the status response in the node's buffer - done with it.
+			buf = as_node_get_info(node, INFO_STR_GET_REPLICAS, sizeof(INFO_STR_GET_REPLICAS) - 1, info_timeout);
 			
-			if (buf != stack_buf) {
-				cf_free(buf);
+			if (! buf) {
+				as_node_close_info_connection(node);
+				as_vector_destroy(&values);
+				return false;
 			}
+			
+			as_vector_clear(&values);
+			as_info_parse_multi_response((char*)buf, &values);
 		}
+		as_node_process_partitions(cluster, node, &values);
 	}
 	
 	as_vector_destroy(&values);
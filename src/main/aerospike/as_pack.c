@@ -0,0 +1,327 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_pack.h>
+#include <aerospike/as_boolean.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_pair.h>
+#include <aerospike/as_string.h>
+#include <string.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef struct {
+	uint32_t size;
+	bool ok;
+} as_pack_sizer;
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline uint32_t
+as_pack_int64_size(int64_t v)
+{
+	if (v < -(1LL << 5)) {
+		if (v < -(1LL << 15)) {
+			return v < -(1LL << 31) ? 9 : 5;
+		}
+		return v < -(1LL << 7) ? 3 : 2;
+	}
+	
+	if (v < (1LL << 7)) {
+		return 1;
+	}
+	
+	if (v < (1LL << 16)) {
+		return v < (1LL << 8) ? 2 : 3;
+	}
+	return v < (1LL << 32) ? 5 : 9;
+}
+
+static inline uint32_t
+as_pack_raw_header_size(uint32_t len)
+{
+	return len < 32 ? 1 : len < 65536 ? 3 : 5;
+}
+
+static inline uint32_t
+as_pack_container_header_size(uint32_t n)
+{
+	return n < 16 ? 1 : n < 65536 ? 3 : 5;
+}
+
+static inline uint8_t*
+as_pack_be(uint8_t* p, uint64_t v, uint32_t n)
+{
+	for (uint32_t i = n; i > 0; i--) {
+		p[i - 1] = (uint8_t)v;
+		v >>= 8;
+	}
+	return p + n;
+}
+
+static uint8_t*
+as_pack_int64(uint8_t* p, int64_t v)
+{
+	if (v < -(1LL << 5)) {
+		if (v < -(1LL << 15)) {
+			if (v < -(1LL << 31)) {
+				*p++ = 0xd3;
+				return as_pack_be(p, (uint64_t)v, 8);
+			}
+			*p++ = 0xd2;
+			return as_pack_be(p, (uint64_t)v, 4);
+		}
+		
+		if (v < -(1LL << 7)) {
+			*p++ = 0xd1;
+			return as_pack_be(p, (uint64_t)v, 2);
+		}
+		*p++ = 0xd0;
+		return as_pack_be(p, (uint64_t)v, 1);
+	}
+	
+	if (v < (1LL << 7)) {
+		*p++ = (uint8_t)v;
+		return p;
+	}
+	
+	if (v < (1LL << 16)) {
+		if (v < (1LL << 8)) {
+			*p++ = 0xcc;
+			return as_pack_be(p, (uint64_t)v, 1);
+		}
+		*p++ = 0xcd;
+		return as_pack_be(p, (uint64_t)v, 2);
+	}
+	
+	if (v < (1LL << 32)) {
+		*p++ = 0xce;
+		return as_pack_be(p, (uint64_t)v, 4);
+	}
+	*p++ = 0xcf;
+	return as_pack_be(p, (uint64_t)v, 8);
+}
+
+static inline uint8_t*
+as_pack_header(uint8_t* p, uint32_t n, uint8_t fix, uint8_t fix_max, uint8_t type16)
+{
+	if (n < fix_max) {
+		*p++ = fix | (uint8_t)n;
+		return p;
+	}
+	
+	if (n < 65536) {
+		*p++ = type16;
+		return as_pack_be(p, n, 2);
+	}
+	*p++ = type16 + 1;
+	return as_pack_be(p, n, 4);
+}
+
+/**
+ *	Strings and blobs are packed as raw bytes, prefixed by their as_bytes
+ *	type, as the server expects.
+ */
+static inline uint8_t*
+as_pack_raw(uint8_t* p, uint8_t type, const uint8_t* data, uint32_t len)
+{
+	p = as_pack_header(p, len + 1, 0xa0, 32, 0xda);
+	*p++ = type;
+	memcpy(p, data, len);
+	return p + len;
+}
+
+static bool
+as_pack_size_list_cb(as_val* val, void* udata)
+{
+	as_pack_sizer* sizer = udata;
+	uint32_t size;
+	
+	if (! as_pack_size(val, &size)) {
+		sizer->ok = false;
+		return false;
+	}
+	sizer->size += size;
+	return true;
+}
+
+static bool
+as_pack_size_map_cb(const as_val* key, const as_val* val, void* udata)
+{
+	as_pack_sizer* sizer = udata;
+	uint32_t key_size;
+	uint32_t val_size;
+	
+	if (! as_pack_size(key, &key_size) || ! as_pack_size(val, &val_size)) {
+		sizer->ok = false;
+		return false;
+	}
+	sizer->size += key_size + val_size;
+	return true;
+}
+
+static bool
+as_pack_write_list_cb(as_val* val, void* udata)
+{
+	uint8_t** p = udata;
+	*p = as_pack_write(val, *p);
+	return true;
+}
+
+static bool
+as_pack_write_map_cb(const as_val* key, const as_val* val, void* udata)
+{
+	uint8_t** p = udata;
+	*p = as_pack_write(key, *p);
+	*p = as_pack_write(val, *p);
+	return true;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+bool
+as_pack_size(const as_val* val, uint32_t* size)
+{
+	if (! val) {
+		*size = 1;
+		return true;
+	}
+	
+	switch (val->type) {
+		case AS_NIL:
+		case AS_BOOLEAN:
+			*size = 1;
+			return true;
+			
+		case AS_INTEGER:
+			*size = as_pack_int64_size(as_integer_get((as_integer*)val));
+			return true;
+			
+		case AS_STRING: {
+			uint32_t len = (uint32_t)as_string_len((as_string*)val) + 1;
+			*size = as_pack_raw_header_size(len) + len;
+			return true;
+		}
+			
+		case AS_BYTES: {
+			uint32_t len = ((as_bytes*)val)->size + 1;
+			*size = as_pack_raw_header_size(len) + len;
+			return true;
+		}
+			
+		case AS_LIST: {
+			const as_list* list = (const as_list*)val;
+			as_pack_sizer sizer = {
+				.size = as_pack_container_header_size(as_list_size((as_list*)list)),
+				.ok = true
+			};
+			as_list_foreach(list, as_pack_size_list_cb, &sizer);
+			*size = sizer.size;
+			return sizer.ok;
+		}
+			
+		case AS_MAP: {
+			const as_map* map = (const as_map*)val;
+			as_pack_sizer sizer = {
+				.size = as_pack_container_header_size(as_map_size(map)),
+				.ok = true
+			};
+			as_map_foreach(map, as_pack_size_map_cb, &sizer);
+			*size = sizer.size;
+			return sizer.ok;
+		}
+			
+		case AS_PAIR: {
+			as_pair* pair = (as_pair*)val;
+			uint32_t size1;
+			uint32_t size2;
+			
+			if (! as_pack_size(as_pair_1(pair), &size1) || ! as_pack_size(as_pair_2(pair), &size2)) {
+				return false;
+			}
+			*size = 1 + size1 + size2;
+			return true;
+		}
+			
+		default:
+			return false;
+	}
+}
+
+uint8_t*
+as_pack_write(const as_val* val, uint8_t* p)
+{
+	if (! val) {
+		*p++ = 0xc0;
+		return p;
+	}
+	
+	switch (val->type) {
+		case AS_NIL:
+			*p++ = 0xc0;
+			return p;
+			
+		case AS_BOOLEAN:
+			*p++ = as_boolean_get((as_boolean*)val) ? 0xc3 : 0xc2;
+			return p;
+			
+		case AS_INTEGER:
+			return as_pack_int64(p, as_integer_get((as_integer*)val));
+			
+		case AS_STRING: {
+			as_string* s = (as_string*)val;
+			return as_pack_raw(p, AS_BYTES_STRING, (const uint8_t*)as_string_get(s), (uint32_t)as_string_len(s));
+		}
+			
+		case AS_BYTES: {
+			as_bytes* b = (as_bytes*)val;
+			return as_pack_raw(p, (uint8_t)b->type, b->value, b->size);
+		}
+			
+		case AS_LIST: {
+			const as_list* list = (const as_list*)val;
+			p = as_pack_header(p, as_list_size((as_list*)list), 0x90, 16, 0xdc);
+			as_list_foreach(list, as_pack_write_list_cb, &p);
+			return p;
+		}
+			
+		case AS_MAP: {
+			const as_map* map = (const as_map*)val;
+			p = as_pack_header(p, as_map_size(map), 0x80, 16, 0xde);
+			as_map_foreach(map, as_pack_write_map_cb, &p);
+			return p;
+		}
+			
+		case AS_PAIR: {
+			as_pair* pair = (as_pair*)val;
+			*p++ = 0x92;
+			p = as_pack_write(as_pair_1(pair), p);
+			return as_pack_write(as_pair_2(pair), p);
+		}
+			
+		default:
+			return p;
+	}
+}
@@ -16,6 +16,7 @@
  */
 #include <aerospike/as_partition.h>
 #include <aerospike/as_cluster.h>
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_log_macros.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_shm_cluster.h>
@@ -46,7 +47,7 @@ static as_partition_table*
 as_partition_table_create(const char* ns, uint32_t capacity)
 {
 	size_t len = sizeof(as_partition_table) + (sizeof(as_partition) * capacity);
-	as_partition_table* table = cf_malloc(len);
+	as_partition_table* table = as_alloc_malloc(AS_ALLOC_TAG_CLUSTER, len);
 	memset(table, 0, len);
 	as_strncpy(table->ns, ns, AS_MAX_NAMESPACE_SIZE);
 	table->size = capacity;
@@ -67,14 +68,14 @@ as_partition_table_destroy(as_partition_table* table)
 			as_node_release(p->prole);
 		}
 	}
-	cf_free(table);
+	as_alloc_free(table);
 }
 
 as_partition_tables*
 as_partition_tables_create(uint32_t capacity)
 {
 	size_t size = sizeof(as_partition_tables) + (sizeof(as_partition_table*) * capacity);
-	as_partition_tables* tables = cf_malloc(size);
+	as_partition_tables* tables = as_alloc_malloc(AS_ALLOC_TAG_CLUSTER, size);
 	memset(tables, 0, size);
 	tables->ref_count = 1;
 	tables->size = capacity;
@@ -107,56 +108,61 @@ reserve_node_alternate(as_cluster* cluster, as_node* chosen, as_node* alternate)
 }
 
 static uint32_t g_randomizer = 0;
+static uint32_t g_generation = 0;
 
 as_node*
-as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, const cf_digest* d, bool write, as_policy_replica replica)
+as_partition_get_node(as_cluster* cluster, as_partition* p, bool write, as_policy_replica replica)
 {
-	if (table) {
-		cl_partition_id partition_id = cl_partition_getid(cluster->n_partitions, d);
-		as_partition* p = &table->partitions[partition_id];
+	// Make volatile reference so changes to tend thread will be reflected in this thread.
+	as_node* master = ck_pr_load_ptr(&p->master);
 
-		// Make volatile reference so changes to tend thread will be reflected in this thread.
-		as_node* master = ck_pr_load_ptr(&p->master);
+	if (write) {
+		// Writes always go to master.
+		return reserve_node(cluster, master);
+	}
 
-		if (write) {
-			// Writes always go to master.
-			return reserve_node(cluster, master);
-		}
+	bool use_master_replica = true;
+	switch (replica) {
+		case AS_POLICY_REPLICA_MASTER:
+			use_master_replica = true;
+			break;
+		case AS_POLICY_REPLICA_ANY:
+			use_master_replica = false;
+			break;
+		default:
+			// (No policy supplied ~~ Use the default.)
+			break;
+	}
 
-		bool use_master_replica = true;
-		switch (replica) {
-			case AS_POLICY_REPLICA_MASTER:
-				use_master_replica = true;
-				break;
-			case AS_POLICY_REPLICA_ANY:
-				use_master_replica = false;
-				break;
-			default:
-				// (No policy supplied ~~ Use the default.)
-				break;
-		}
+	if (use_master_replica) {
+		return reserve_node(cluster, master);
+	} else {
+		as_node* prole = ck_pr_load_ptr(&p->prole);
 
-		if (use_master_replica) {
+		if (! prole) {
 			return reserve_node(cluster, master);
-		} else {
-			as_node* prole = ck_pr_load_ptr(&p->prole);
-
-			if (! prole) {
-				return reserve_node(cluster, master);
-			}
+		}
 
-			if (! master) {
-				return reserve_node(cluster, prole);
-			}
+		if (! master) {
+			return reserve_node(cluster, prole);
+		}
 
-			// Alternate between master and prole for reads.
-			uint32_t r = ck_pr_faa_32(&g_randomizer, 1);
-				
-			if (r & 1) {
-				return reserve_node_alternate(cluster, master, prole);
-			}
-			return reserve_node_alternate(cluster, prole, master);
+		// Alternate between master and prole for reads.
+		uint32_t r = ck_pr_faa_32(&g_randomizer, 1);
+			
+		if (r & 1) {
+			return reserve_node_alternate(cluster, master, prole);
 		}
+		return reserve_node_alternate(cluster, prole, master);
+	}
+}
+
+as_node*
+as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, const cf_digest* d, bool write, as_policy_replica replica)
+{
+	if (table) {
+		cl_partition_id partition_id = cl_partition_getid(cluster->n_partitions, d);
+		return as_partition_get_node(cluster, &table->partitions[partition_id], write, replica);
 	}
 	
 #ifdef DEBUG_VERBOSE
@@ -165,6 +171,86 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 	return as_node_get_random(cluster);
 }
 
+static inline as_node*
+reserve_active_node(as_node* node)
+{
+	if (node && ck_pr_load_8(&node->active)) {
+		as_node_reserve(node);
+		return node;
+	}
+	return 0;
+}
+
+void
+as_partition_table_get_owners(as_cluster* cluster, as_partition_table* table, const cf_digest* d, as_node** master, as_node** prole)
+{
+	if (! table) {
+		*master = 0;
+		*prole = 0;
+		return;
+	}
+	
+	cl_partition_id partition_id = cl_partition_getid(cluster->n_partitions, d);
+	as_partition* p = &table->partitions[partition_id];
+	
+	// Make volatile reference so changes to tend thread will be reflected in this thread.
+	*master = reserve_active_node(ck_pr_load_ptr(&p->master));
+	*prole = reserve_active_node(ck_pr_load_ptr(&p->prole));
+}
+
+as_node*
+as_partition_route_get_node(as_cluster* cluster, as_key_route* route, const char* ns, const cf_digest* d, bool write, as_policy_replica replica)
+{
+	// The tend thread publishes new tables before their generation.
+	uint32_t generation = ck_pr_load_32(&cluster->partition_generation);
+	ck_pr_fence_load();
+
+	// The hints may be shared by threads using the same key, so read them as
+	// a seqlock: a consistent snapshot has the same even seq before and after.
+	uint32_t seq = ck_pr_load_32(&route->seq);
+	ck_pr_fence_load();
+	as_partition_table* table = ck_pr_load_ptr(&route->table);
+	uint32_t partition_id = ck_pr_load_32(&route->partition_id);
+	uint32_t route_generation = ck_pr_load_32(&route->generation);
+	ck_pr_fence_load();
+
+	// The hints are only used for the namespace and partition they were
+	// resolved for, in case they were attached to another key.
+	cl_partition_id key_partition_id = cl_partition_getid(cluster->n_partitions, d);
+
+	if ((seq & 1) == 0 && ck_pr_load_32(&route->seq) == seq && route_generation == generation && table &&
+		partition_id == key_partition_id && strcmp(table->ns, ns) == 0) {
+		return as_partition_get_node(cluster, &table->partitions[partition_id], write, replica);
+	}
+
+	table = as_cluster_get_partition_table(cluster, ns);
+
+	if (! table) {
+		return as_partition_table_get_node(cluster, 0, d, write, replica);
+	}
+	partition_id = key_partition_id;
+
+	// Publish the hints only if no other thread is updating them. Otherwise
+	// the hints are simply not cached by this transaction.
+	if ((seq & 1) == 0 && ck_pr_cas_32(&route->seq, seq, seq + 1)) {
+		ck_pr_fence_store();
+		ck_pr_store_ptr(&route->table, table);
+		ck_pr_store_32(&route->partition_id, partition_id);
+		ck_pr_store_32(&route->generation, generation);
+		ck_pr_fence_store();
+		ck_pr_store_32(&route->seq, seq + 2);
+	}
+	return as_partition_get_node(cluster, &table->partitions[partition_id], write, replica);
+}
+
+uint32_t
+as_partition_generation_next(void)
+{
+	// Generations are unique across clusters, so hints resolved against one
+	// cluster are never mistaken as valid for another.
+	return ck_pr_faa_32(&g_generation, 1) + 1;
+}
+
 as_partition_table*
 as_partition_tables_get(as_partition_tables* tables, const char* ns)
 {
@@ -311,6 +397,10 @@ as_partition_tables_copy_add(as_cluster* cluster, as_partition_tables* tables_ol
 	// Replace tables with copy.
 	set_partition_tables(cluster, tables_new);
 	
+	// Invalidate routing hints cached in keys.
+	ck_pr_fence_store();
+	ck_pr_store_32(&cluster->partition_generation, as_partition_generation_next());
+	
 	// Put old tables on garbage collector stack.
 	as_gc_item item;
 	item.data = tables_old;
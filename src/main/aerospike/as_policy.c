@@ -50,6 +50,7 @@ as_policies_init(as_policies* p)
 	p->read.key = -1;
 	p->read.replica = -1;
 	p->read.consistency_level = -1;
+	p->read.deserialize = true;
 
 	p->write.timeout = -1;
 	p->write.retry = -1;
@@ -82,15 +83,20 @@ as_policies_init(as_policies* p)
 	p->info.check_bounds = true;
 
 	p->batch.timeout = -1;
+	p->batch.replica = -1;
+	p->batch.deserialize = true;
 
 	p->admin.timeout = -1;
 
 	// Scan timeout should not be tied to global timeout.
 	p->scan.timeout = 0;
 	p->scan.fail_on_cluster_change = false;
+	p->scan.throttle = NULL;
+	p->scan.deserialize = true;
 
 	// Query timeout should not be tied to global timeout.
 	p->query.timeout = 0;
+	p->query.parallel_reduce = false;
 
 	return p;
 }
@@ -130,6 +136,7 @@ as_policies_resolve(as_policies* p)
 	as_policy_resolve(p->info.timeout, p->timeout);
 
 	as_policy_resolve(p->batch.timeout, p->timeout);
+	as_policy_resolve(p->batch.replica, p->replica);
 
 	as_policy_resolve(p->admin.timeout, p->timeout);
 }
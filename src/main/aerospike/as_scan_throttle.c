@@ -0,0 +1,137 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_scan_throttle.h>
+#include <citrusleaf/cf_clock.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+// Longest single sleep, so waiting workers notice new limits promptly.
+#define THROTTLE_MAX_SLEEP_MS 100
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline double
+as_scan_throttle_fill(double tokens, uint32_t per_sec, uint64_t elapsed_ms)
+{
+	if (per_sec == 0) {
+		return 0;
+	}
+	tokens += (double)per_sec * elapsed_ms / 1000;
+	
+	// Allow at most one second of burst.
+	return tokens > per_sec ? per_sec : tokens;
+}
+
+static void
+as_scan_throttle_refill(as_scan_throttle* throttle)
+{
+	uint64_t now = cf_getms();
+	uint64_t elapsed_ms = now > throttle->refill_ms ? now - throttle->refill_ms : 0;
+	
+	throttle->refill_ms = now;
+	throttle->records = as_scan_throttle_fill(throttle->records, throttle->records_per_sec, elapsed_ms);
+	throttle->bytes = as_scan_throttle_fill(throttle->bytes, throttle->bytes_per_sec, elapsed_ms);
+}
+
+static inline uint64_t
+as_scan_throttle_debt_ms(double tokens, uint32_t per_sec)
+{
+	if (per_sec == 0 || tokens >= 0) {
+		return 0;
+	}
+	return (uint64_t)(-tokens * 1000 / per_sec) + 1;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_scan_throttle*
+as_scan_throttle_init(as_scan_throttle* throttle, uint32_t records_per_sec, uint32_t bytes_per_sec)
+{
+	pthread_mutex_init(&throttle->lock, NULL);
+	throttle->records_per_sec = records_per_sec;
+	throttle->bytes_per_sec = bytes_per_sec;
+	throttle->records = 0;
+	throttle->bytes = 0;
+	throttle->refill_ms = cf_getms();
+	return throttle;
+}
+
+void
+as_scan_throttle_set(as_scan_throttle* throttle, uint32_t records_per_sec, uint32_t bytes_per_sec)
+{
+	pthread_mutex_lock(&throttle->lock);
+	
+	// Credit time elapsed under the old limits before switching.
+	as_scan_throttle_refill(throttle);
+	throttle->records_per_sec = records_per_sec;
+	throttle->bytes_per_sec = bytes_per_sec;
+	throttle->records = as_scan_throttle_fill(throttle->records, records_per_sec, 0);
+	throttle->bytes = as_scan_throttle_fill(throttle->bytes, bytes_per_sec, 0);
+	
+	pthread_mutex_unlock(&throttle->lock);
+}
+
+void
+as_scan_throttle_destroy(as_scan_throttle* throttle)
+{
+	pthread_mutex_destroy(&throttle->lock);
+}
+
+void
+as_scan_throttle_consume(as_scan_throttle* throttle, uint32_t n_records, uint32_t n_bytes)
+{
+	pthread_mutex_lock(&throttle->lock);
+	as_scan_throttle_refill(throttle);
+	
+	if (throttle->records_per_sec) {
+		throttle->records -= n_records;
+	}
+	
+	if (throttle->bytes_per_sec) {
+		throttle->bytes -= n_bytes;
+	}
+	
+	while (true) {
+		uint64_t wait_ms = as_scan_throttle_debt_ms(throttle->records, throttle->records_per_sec);
+		uint64_t bytes_ms = as_scan_throttle_debt_ms(throttle->bytes, throttle->bytes_per_sec);
+		
+		if (bytes_ms > wait_ms) {
+			wait_ms = bytes_ms;
+		}
+		pthread_mutex_unlock(&throttle->lock);
+		
+		if (wait_ms == 0) {
+			return;
+		}
+		
+		if (wait_ms > THROTTLE_MAX_SLEEP_MS) {
+			wait_ms = THROTTLE_MAX_SLEEP_MS;
+		}
+		usleep(wait_ms * 1000);
+		
+		pthread_mutex_lock(&throttle->lock);
+		as_scan_throttle_refill(throttle);
+	}
+}
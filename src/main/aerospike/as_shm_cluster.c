@@ -565,7 +565,9 @@ static void
 as_shm_wait_till_ready(as_cluster* cluster, as_cluster_shm* cluster_shm)
 {
 	// Wait till cluster is initialized or connection timeout is reached.
-	uint32_t interval_micros = 200 * 1000;  // 200 milliseconds
+	// The ready flag is set by another process, so it can't be signaled.
+	// Start with a short poll interval and back off up to 200 milliseconds.
+	uint32_t interval_micros = 5 * 1000;
 	uint64_t limit = cf_getms() + cluster->conn_timeout_ms;
 	
 	do {
@@ -574,6 +576,10 @@ as_shm_wait_till_ready(as_cluster* cluster, as_cluster_shm* cluster_shm)
 		if (ck_pr_load_8(&cluster_shm->ready)) {
 			break;
 		}
+		
+		if (interval_micros < 200 * 1000) {
+			interval_micros *= 2;
+		}
 	} while (cf_getms() < limit);
 }
 
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_slowops.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_log_macros.h>
+#include <citrusleaf/alloc.h>
+#include <stdio.h>
+#include "ck_pr.h"
+
+/******************************************************************************
+ *	STATIC VARIABLES
+ *****************************************************************************/
+
+static const char* as_slowop_stage_names[] = {
+	"partition",
+	"checkout",
+	"connect",
+	"auth",
+	"write",
+	"first-byte",
+	"body",
+	"parse",
+	"retry-wait"
+};
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void
+as_slowops_log(as_slowops* slowops, const as_slowop* op)
+{
+	uint64_t now = cf_getms();
+	uint64_t last = ck_pr_load_64(&slowops->log_ms);
+	
+	if (now - last < slowops->log_interval_ms || ! ck_pr_cas_64(&slowops->log_ms, last, now)) {
+		ck_pr_inc_32(&slowops->log_suppressed);
+		return;
+	}
+	uint32_t suppressed = ck_pr_fas_32(&slowops->log_suppressed, 0);
+	
+	char digest[CF_DIGEST_KEY_SZ * 2 + 1];
+	
+	for (uint32_t i = 0; i < CF_DIGEST_KEY_SZ; i++) {
+		sprintf(&digest[i * 2], "%02x", op->digest.digest[i]);
+	}
+	
+	char stages[256] = "";
+	int len = 0;
+	
+	for (uint32_t i = 0; i < AS_SLOWOP_STAGE_MAX && len < (int)sizeof(stages); i++) {
+		if (op->stage_us[i]) {
+			len += snprintf(&stages[len], sizeof(stages) - len, " %s %u", as_slowop_stage_names[i], op->stage_us[i]);
+		}
+	}
+	
+	char nodes[AS_SLOWOP_MAX_NODES * AS_NODE_NAME_MAX_SIZE] = "";
+	len = 0;
+	
+	for (uint32_t i = 0; i < op->n_nodes; i++) {
+		len += snprintf(&nodes[len], sizeof(nodes) - len, i ? ",%s" : "%s", op->nodes[i]);
+	}
+	
+	as_log_warn("Slow %s %s:%s %u us rv %d tries %u nodes %s stages (us):%s (%u more not logged)",
+		op->write ? "write" : "read", op->ns, digest, op->total_us, op->result, op->tries, nodes,
+		stages, suppressed);
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_slowops*
+as_slowops_create(const as_config_slowops* config)
+{
+	if (! config->enabled) {
+		return NULL;
+	}
+	
+	uint32_t capacity = 1;
+	
+	while (capacity < config->capacity) {
+		capacity <<= 1;
+	}
+	
+	size_t size = sizeof(as_slowops) + capacity * sizeof(as_slowops_slot);
+	as_slowops* slowops = cf_malloc(size);
+	
+	if (! slowops) {
+		return NULL;
+	}
+	memset(slowops, 0, size);
+	slowops->threshold_us = config->threshold_us;
+	slowops->log_interval_ms = config->log_interval_ms;
+	slowops->capacity = capacity;
+	return slowops;
+}
+
+void
+as_slowops_destroy(as_slowops* slowops)
+{
+	cf_free(slowops);
+}
+
+void
+as_slowops_end(as_slowops* slowops, as_slowop* op, int result)
+{
+	uint64_t total = cf_getus() - op->mark_us;
+	
+	for (uint32_t i = 0; i < AS_SLOWOP_STAGE_MAX; i++) {
+		total += op->stage_us[i];
+	}
+	op->total_us = total > UINT32_MAX ? UINT32_MAX : (uint32_t)total;
+	
+	if (op->total_us < slowops->threshold_us) {
+		return;
+	}
+	op->result = result;
+	
+	uint64_t pos = ck_pr_faa_64(&slowops->head, 1);
+	as_slowops_slot* slot = &slowops->slots[pos & (slowops->capacity - 1)];
+	uint64_t seq = ck_pr_load_64(&slot->seq);
+	
+	// Claim the slot from its last published operation. If a writer of an
+	// earlier lap is still copying, or a later lap already claimed the slot,
+	// drop this operation rather than write over the other one.
+	if (! (seq & 1) && seq < pos * 2 + 1 && ck_pr_cas_64(&slot->seq, seq, pos * 2 + 1)) {
+		ck_pr_fence_store();
+		memcpy(&slot->op, op, sizeof(as_slowop));
+		ck_pr_fence_store();
+		ck_pr_store_64(&slot->seq, pos * 2 + 2);
+	}
+	else {
+		// Mark the position dropped, so readers don't wait for it.
+		uint64_t dropped;
+		
+		do {
+			dropped = ck_pr_load_64(&slot->dropped);
+		} while (dropped <= pos && ! ck_pr_cas_64(&slot->dropped, dropped, pos + 1));
+	}
+	
+	if (slowops->log_interval_ms) {
+		as_slowops_log(slowops, op);
+	}
+}
+
+as_status
+aerospike_slowops_get(aerospike* as, as_error* err, as_slowop* ops, uint32_t* n_ops, uint64_t* cursor)
+{
+	as_error_reset(err);
+	
+	as_cluster* cluster = as->cluster;
+	as_slowops* slowops = cluster ? cluster->slowops : NULL;
+	
+	if (! slowops) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "Slow operation sampling is not enabled");
+	}
+	
+	uint64_t head = ck_pr_load_64(&slowops->head);
+	uint64_t pos = *cursor;
+	
+	if (head > slowops->capacity && pos < head - slowops->capacity) {
+		// Older operations have been overwritten.
+		pos = head - slowops->capacity;
+	}
+	
+	uint32_t n = 0;
+	
+	for (; pos < head && n < *n_ops; pos++) {
+		as_slowops_slot* slot = &slowops->slots[pos & (slowops->capacity - 1)];
+		uint64_t seq = ck_pr_load_64(&slot->seq);
+		
+		if (seq < pos * 2 + 2) {
+			if (ck_pr_load_64(&slot->dropped) > pos) {
+				// Its writer found the slot busy and dropped it.
+				continue;
+			}
+			// Still being written - pick it up on the next call.
+			break;
+		}
+		
+		if (seq > pos * 2 + 2) {
+			// Overwritten by a newer operation.
+			continue;
+		}
+		ck_pr_fence_load();
+		memcpy(&ops[n], &slot->op, sizeof(as_slowop));
+		ck_pr_fence_load();
+		
+		if (ck_pr_load_64(&slot->seq) == seq) {
+			n++;
+		}
+	}
+	*n_ops = n;
+	*cursor = pos;
+	return AEROSPIKE_OK;
+}
+
+const char*
+as_slowop_stage_name(as_slowop_stage stage)
+{
+	return stage < AS_SLOWOP_STAGE_MAX ? as_slowop_stage_names[stage] : "unknown";
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_socket_profile.h>
+#include <aerospike/as_log_macros.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <time.h>
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static const as_config_socket*
+as_socket_profile_preset(as_socket_profile profile)
+{
+	static const as_config_socket latency = {
+		.profile = AS_SOCKET_PROFILE_LATENCY,
+		.busy_poll_us = 50,
+		.priority = 6,
+		.quickack = true,
+		.spin_us = 50
+	};
+	
+	static const as_config_socket throughput = {
+		.profile = AS_SOCKET_PROFILE_THROUGHPUT,
+		.rcvbuf_size = 4 * 1024 * 1024,
+		.sndbuf_size = 1024 * 1024
+	};
+	
+	static const as_config_socket none = {
+		.profile = AS_SOCKET_PROFILE_DEFAULT
+	};
+	
+	switch (profile) {
+		case AS_SOCKET_PROFILE_LATENCY:
+			return &latency;
+		case AS_SOCKET_PROFILE_THROUGHPUT:
+			return &throughput;
+		default:
+			return &none;
+	}
+}
+
+static inline void
+as_socket_set_int(int fd, int level, int name, int value, const char* desc)
+{
+	if (setsockopt(fd, level, name, &value, sizeof(value)) != 0) {
+		as_log_debug("Failed to set %s to %d on fd %d: errno %d", desc, value, fd, errno);
+	}
+}
+
+static inline uint64_t
+as_socket_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+void
+as_socket_profile_resolve(const as_config_socket* config, as_config_socket* resolved)
+{
+	const as_config_socket* preset = as_socket_profile_preset(config->profile);
+	
+	resolved->profile = config->profile;
+	resolved->busy_poll_us = config->busy_poll_us ? config->busy_poll_us : preset->busy_poll_us;
+	resolved->rcvbuf_size = config->rcvbuf_size ? config->rcvbuf_size : preset->rcvbuf_size;
+	resolved->sndbuf_size = config->sndbuf_size ? config->sndbuf_size : preset->sndbuf_size;
+	resolved->priority = config->priority ? config->priority : preset->priority;
+	resolved->quickack = config->quickack || preset->quickack;
+	resolved->spin_us = config->spin_us ? config->spin_us : preset->spin_us;
+}
+
+void
+as_socket_profile_apply(const as_config_socket* config, int fd)
+{
+	// Buffer sizes must be set before connecting to affect the TCP window.
+	if (config->rcvbuf_size) {
+		as_socket_set_int(fd, SOL_SOCKET, SO_RCVBUF, (int)config->rcvbuf_size, "SO_RCVBUF");
+	}
+	
+	if (config->sndbuf_size) {
+		as_socket_set_int(fd, SOL_SOCKET, SO_SNDBUF, (int)config->sndbuf_size, "SO_SNDBUF");
+	}
+	
+#ifdef SO_BUSY_POLL
+	if (config->busy_poll_us) {
+		as_socket_set_int(fd, SOL_SOCKET, SO_BUSY_POLL, (int)config->busy_poll_us, "SO_BUSY_POLL");
+	}
+#endif
+	
+#ifdef SO_PRIORITY
+	if (config->priority) {
+		as_socket_set_int(fd, SOL_SOCKET, SO_PRIORITY, (int)config->priority, "SO_PRIORITY");
+	}
+#endif
+	
+#ifdef TCP_QUICKACK
+	if (config->quickack) {
+		as_socket_set_int(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+	}
+#endif
+}
+
+void
+as_socket_profile_spin(const as_config_socket* config, int fd)
+{
+#ifdef TCP_QUICKACK
+	// The kernel drops out of quick ACK mode on its own - re-arm it.
+	if (config->quickack) {
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+	}
+#endif
+	
+	if (config->spin_us == 0) {
+		return;
+	}
+	
+	uint64_t deadline = as_socket_now_us() + config->spin_us;
+	uint8_t b;
+	
+	do {
+		ssize_t rv = recv(fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+		
+		// Data, closed or failed - let the blocking read handle it.
+		if (rv >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+			return;
+		}
+	} while (as_socket_now_us() < deadline);
+}
@@ -26,8 +26,13 @@
 #include <inttypes.h> // PRIu64
 #include <signal.h>
 
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_cluster.h>
+#include <aerospike/as_hotkeys.h>
 #include <aerospike/as_log_macros.h>
+#include <aerospike/as_pack.h>
+#include <aerospike/as_slowops.h>
+#include <aerospike/as_socket_profile.h>
 
 #include <citrusleaf/cf_byte_order.h>
 #include <citrusleaf/cf_atomic.h>
@@ -42,20 +47,6 @@
 
 // #define DEBUG 1
 // #define DEBUG_VERBOSE 1
-// #define DEBUG_TIME 1 // debugs involving timing
-
-#ifdef DEBUG_TIME
-static void debug_printf(long before_write_time, long after_write_time, long before_read_header_time, long after_read_header_time, 
-		long before_read_body_time, long after_read_body_time, long deadline_ms, int progress_timeout_ms)
-{
-	as_log_info("tid %zu - Before Write - deadline %"PRIu64" progress_timeout %d now is %"PRIu64, (uint64_t)pthread_self(), deadline_ms, progress_timeout_ms, before_write_time);
-	as_log_info("tid %zu - After Write - now is %"PRIu64, (uint64_t)pthread_self(), after_write_time);
-	as_log_info("tid %zu - Before Read header - deadline %"PRIu64" progress_timeout %d now is %"PRIu64, (uint64_t)pthread_self(), deadline_ms, progress_timeout_ms, before_read_header_time);
-	as_log_info("tid %zu - After Read header - now is %"PRIu64, (uint64_t)pthread_self(), after_read_header_time);
-	as_log_info("tid %zu - Before Read body - deadline %"PRIu64" progress_timeout %d now is %"PRIu64, (uint64_t)pthread_self(), deadline_ms, progress_timeout_ms, before_read_body_time);
-	as_log_info("tid %zu - After Read body - now is %"PRIu64, (uint64_t)pthread_self(), after_read_body_time);
-}
-#endif
 
 //
 // Citrusleaf Object calls
@@ -116,6 +107,16 @@ void citrusleaf_object_init_blob_handoff(cl_object *o, void *blob, size_t len, c
 	o->free = o->u.blob = blob;
 }
 
+// Defer packing val until the message is compiled. val is borrowed, so must
+// outlive the object. packed_len is from as_pack_size().
+void citrusleaf_object_init_val(cl_object *o, const struct as_val_s *val, size_t packed_len, cl_type t)
+{
+	o->type = t == CL_MAP ? CL_VAL_MAP : CL_VAL_LIST;
+	o->sz = packed_len;
+	o->u.blob = (void *)val;
+	o->free = NULL;
+}
+
 // TODO - is this even used?
 void citrusleaf_object_init_blob_type(cl_object *o, int blob_type, void *blob, size_t len)
 {
@@ -184,6 +185,16 @@ int citrusleaf_copy_object(cl_object *destobj, cl_object *srcobj)
 			}
 			memcpy(destobj->u.blob, srcobj->u.blob, destobj->sz);
 			break;
+		case CL_VAL_MAP:
+		case CL_VAL_LIST:
+			// The copy may outlive the value, so pack it now.
+			destobj->type = srcobj->type == CL_VAL_MAP ? CL_MAP : CL_LIST;
+			destobj->free = destobj->u.blob = malloc(destobj->sz);
+			if (destobj->free == NULL) {
+				return -1;
+			}
+			as_pack_write((const as_val *)srcobj->u.blob, destobj->u.blob);
+			break;
 		default:
 			as_log_error("Encountered an unknown bin type %d", srcobj->type);
 			return -1;
@@ -637,6 +648,8 @@ cl_value_to_op_get_size(cl_bin *v, size_t *sz)
 		case CL_CSHARP_BLOB:
 		case CL_PHP_BLOB:
 		case CL_LUA_BLOB:
+		case CL_VAL_MAP:
+		case CL_VAL_LIST:
 			*sz += v->object.sz;
 			break;
 		default:
@@ -668,6 +681,8 @@ cl_object_get_size(cl_object *obj, size_t *sz)
 		case CL_CSHARP_BLOB:
 		case CL_PHP_BLOB:
 		case CL_LUA_BLOB:
+		case CL_VAL_MAP:
+		case CL_VAL_LIST:
 			*sz += obj->sz;
 			break;
 		default:
@@ -677,67 +692,92 @@ cl_object_get_size(cl_object *obj, size_t *sz)
 	return(0);
 }
 
-// Lay an C structure bin into network order operation
+// Map an API operator to the wire protocol op code
 
-int
-cl_value_to_op(cl_bin *v, cl_operator operator, cl_operation *operation, cl_msg_op *op)
+static int
+cl_operator_to_msg_op(cl_operator operator, uint8_t *msg_op)
 {
-	cl_bin *bin = v?v:&operation->bin;
-	int bin_len = (int)strlen(bin->bin_name);
-	op->op_sz = sizeof(cl_msg_op) + bin_len - sizeof(uint32_t);
-	op->name_sz = bin_len;
-	op->version = 0;
-	memcpy(op->name, bin->bin_name, bin_len);
-
-	cl_operator tmpOp = 0;
-	cl_bin      *tmpValue = 0;
-	
-	if( v ){
-		tmpOp = operator;
-		tmpValue = v;
-	}else if( operation ){
-		tmpOp = operation->op;
-		tmpValue = &(operation->bin);
-	}
-
-	switch(tmpOp) {
+	switch(operator) {
 		case CL_OP_WRITE:
-			op->op = CL_MSG_OP_WRITE;
+			*msg_op = CL_MSG_OP_WRITE;
 			break;
 		case CL_OP_READ:
-			op->op = CL_MSG_OP_READ;
+			*msg_op = CL_MSG_OP_READ;
 			break;
 		case CL_OP_INCR:
-			op->op = CL_MSG_OP_INCR;
+			*msg_op = CL_MSG_OP_INCR;
 			break;
 		case CL_OP_MC_INCR:
-			op->op = CL_MSG_OP_MC_INCR;
+			*msg_op = CL_MSG_OP_MC_INCR;
 			break;
 		case CL_OP_APPEND:
-			op->op = CL_MSG_OP_APPEND;
+			*msg_op = CL_MSG_OP_APPEND;
 			break;
 		case CL_OP_PREPEND:
-			op->op = CL_MSG_OP_PREPEND;
+			*msg_op = CL_MSG_OP_PREPEND;
 			break;
 		case CL_OP_MC_APPEND:
-			op->op = CL_MSG_OP_MC_APPEND;
+			*msg_op = CL_MSG_OP_MC_APPEND;
 			break;
 		case CL_OP_MC_PREPEND:
-			op->op = CL_MSG_OP_MC_PREPEND;
+			*msg_op = CL_MSG_OP_MC_PREPEND;
 			break;
 		case CL_OP_TOUCH:
-			op->op = CL_MSG_OP_TOUCH;
+			*msg_op = CL_MSG_OP_TOUCH;
 			break;
 		case CL_OP_MC_TOUCH:
-			op->op = CL_MSG_OP_MC_TOUCH;
+			*msg_op = CL_MSG_OP_MC_TOUCH;
 			break;
 		default:
-			as_log_error("API user requested unknown operation type %d, fail", (int)tmpOp);
+			as_log_error("API user requested unknown operation type %d, fail", (int)operator);
 			return(-1);
 	}
+	return(0);
+}
+
+// The particle type the server knows the object by.
+static inline uint8_t
+cl_object_wire_type(const cl_object *obj)
+{
+	switch(obj->type) {
+		case CL_VAL_MAP:
+			return CL_MAP;
+		case CL_VAL_LIST:
+			return CL_LIST;
+		default:
+			return (uint8_t)obj->type;
+	}
+}
+
+// Lay an C structure bin into network order operation
+
+int
+cl_value_to_op(cl_bin *v, cl_operator operator, cl_operation *operation, cl_msg_op *op)
+{
+	cl_bin *bin = v?v:&operation->bin;
+	int bin_len = (int)strlen(bin->bin_name);
+	op->op_sz = sizeof(cl_msg_op) + bin_len - sizeof(uint32_t);
+	op->name_sz = bin_len;
+	op->version = 0;
+	memcpy(op->name, bin->bin_name, bin_len);
+
+	cl_operator tmpOp = 0;
+	cl_bin      *tmpValue = 0;
+	
+	if( v ){
+		tmpOp = operator;
+		tmpValue = v;
+	}else if( operation ){
+		tmpOp = operation->op;
+		tmpValue = &(operation->bin);
+	}
+
+	if (cl_operator_to_msg_op(tmpOp, &op->op) != 0) {
+		return(-1);
+	}
 
 	uint8_t *data = cl_msg_op_get_value_p(op);
-	op->particle_type = tmpValue->object.type;
+	op->particle_type = cl_object_wire_type(&tmpValue->object);
 	switch(tmpValue->object.type) {
 		case CL_NULL:
 			break;
@@ -764,6 +804,11 @@ cl_value_to_op(cl_bin *v, cl_operator operator, cl_operation *operation, cl_msg_
 				memcpy(data, tmpValue->object.u.blob, tmpValue->object.sz);
 			}
 			break;
+		case CL_VAL_MAP:
+		case CL_VAL_LIST:
+			op->op_sz += tmpValue->object.sz;
+			as_pack_write((const as_val *)tmpValue->object.u.blob, data);
+			break;
 		default:
 #ifdef DEBUG_VERBOSE
 			as_log_debug("internal error value_to_op has unknown value type %d",tmpValue->object.type);
@@ -799,6 +844,11 @@ cl_object_to_buf (cl_object *obj, uint8_t *data)
 			sz += obj->sz;
 			memcpy(data, obj->u.blob, obj->sz);
 			break;
+		case CL_VAL_MAP:
+		case CL_VAL_LIST:
+			sz += obj->sz;
+			as_pack_write((const as_val *)obj->u.blob, data);
+			break;
 		default:
 #ifdef DEBUG_VERBOSE
 			as_log_error("internal error value_to_op has unknown value type %d", obj->type);
@@ -807,6 +857,43 @@ cl_object_to_buf (cl_object *obj, uint8_t *data)
 	}
 	return(0);
 }
+
+//
+// Fold the write parameters into the info bits, returning the generation to
+// put in the header.
+//
+
+static uint32_t
+cl_write_parameters_to_info(const cl_write_parameters *cl_w_p, uint *info2, uint *info3)
+{
+	uint32_t generation = 0;
+	if (cl_w_p) {
+		if (cl_w_p->unique) {
+			*info2 |= CL_MSG_INFO2_CREATE_ONLY;
+		} else if (cl_w_p->unique_bin) {
+			*info2 |= CL_MSG_INFO2_BIN_CREATE_ONLY;
+		} else if (cl_w_p->update_only) {
+			*info3 |= CL_MSG_INFO3_UPDATE_ONLY;
+		} else if (cl_w_p->create_or_replace) {
+			*info3 |= CL_MSG_INFO3_CREATE_OR_REPLACE;
+		} else if (cl_w_p->replace_only) {
+			*info3 |= CL_MSG_INFO3_REPLACE_ONLY;
+		} else if (cl_w_p->bin_replace_only) {
+			*info3 |= CL_MSG_INFO3_BIN_REPLACE_ONLY;
+		} else if (cl_w_p->use_generation) {
+			*info2 |= CL_MSG_INFO2_GENERATION;
+			generation = cl_w_p->generation;
+		} else if (cl_w_p->use_generation_gt) {
+			*info2 |= CL_MSG_INFO2_GENERATION_GT;
+			generation = cl_w_p->generation;
+		} else if (cl_w_p->use_generation_dup) {
+			*info2 |= CL_MSG_INFO2_GENERATION_DUP;
+			generation = cl_w_p->generation;
+		}
+	}
+	return(generation);
+}
+
 //
 // n_values can be passed in 0, and then values is undefined / probably 0.
 //
@@ -863,7 +950,7 @@ cl_compile(uint info1, uint info2, uint info3, const char *ns, const char *set,
 	uint8_t	*buf;
 	uint8_t *mbuf = 0;
 	if ((*buf_r) && (msg_sz > *buf_sz_r)) {
-		mbuf = buf = malloc(msg_sz);
+		mbuf = buf = as_alloc_malloc(AS_ALLOC_TAG_WIRE, msg_sz);
 		if (!buf) 			return(-1);
 		*buf_r = buf;
 	}
@@ -876,32 +963,7 @@ cl_compile(uint info1, uint info2, uint info3, const char *ns, const char *set,
 	memset(buf, 0, msg_sz);
 	
 	// lay in some parameters
-	uint32_t generation = 0;
-	if (cl_w_p) {
-		if (cl_w_p->unique) {
-			info2 |= CL_MSG_INFO2_CREATE_ONLY;
-		} else if (cl_w_p->unique_bin) {
-			info2 |= CL_MSG_INFO2_BIN_CREATE_ONLY;
-		} else if (cl_w_p->update_only) {
-			info3 |= CL_MSG_INFO3_UPDATE_ONLY;
-		} else if (cl_w_p->create_or_replace) {
-			info3 |= CL_MSG_INFO3_CREATE_OR_REPLACE;
-		} else if (cl_w_p->replace_only) {
-			info3 |= CL_MSG_INFO3_REPLACE_ONLY;
-		} else if (cl_w_p->bin_replace_only) {
-			info3 |= CL_MSG_INFO3_BIN_REPLACE_ONLY;
-		} else if (cl_w_p->use_generation) {
-			info2 |= CL_MSG_INFO2_GENERATION;
-			generation = cl_w_p->generation;
-		} else if (cl_w_p->use_generation_gt) {
-			info2 |= CL_MSG_INFO2_GENERATION_GT;
-			generation = cl_w_p->generation;
-		} else if (cl_w_p->use_generation_dup) {
-			info2 |= CL_MSG_INFO2_GENERATION_DUP;
-			generation = cl_w_p->generation;
-		}
-	}
-
+	uint32_t generation = cl_write_parameters_to_info(cl_w_p, &info2, &info3);
 	uint32_t record_ttl = cl_w_p ? cl_w_p->record_ttl : 0;
 	uint32_t transaction_ttl = cl_w_p ? cl_w_p->timeout_ms : 0;
 
@@ -912,7 +974,7 @@ cl_compile(uint info1, uint info2, uint info3, const char *ns, const char *set,
 	// now the fields
 	buf = write_fields(buf, ns, ns_len, set, set_len, key, digest, d_ret, trid,scan_param_field, call, udf_type);
 	if (!buf) {
-		if (mbuf)	free(mbuf);
+		if (mbuf)	as_alloc_free(mbuf);
 		return(-1);
 	}
 
@@ -1083,27 +1145,105 @@ set_object(cl_msg_op *op, cl_object *obj)
 	return(rv);
 }
 
-// Search through the value list and set the pre-existing correct one.
-static int
-set_value_search(cl_msg_op *op, cl_bin *values, int n_values)
+// Most caller bins a name hash is built for - larger lists are searched.
+#define BIN_INDEX_MAX_VALUES 128
+#define BIN_INDEX_MAX_SLOTS (BIN_INDEX_MAX_VALUES * 2)
+
+// Finds the caller's bin for each returned op. The server returns bins in
+// the order requested, so the bin after the last match is tried first, and a
+// hash of the caller's names is only built when that fails.
+typedef struct bin_index_s {
+	cl_bin		*values;
+	int			n_values;
+	int			next;
+	int			n_slots;	// 0 until the hash is built
+	int16_t		slots[BIN_INDEX_MAX_SLOTS];	// value index + 1, 0 if empty
+} bin_index;
+
+static inline bool
+bin_name_equals(const cl_bin *value, const cl_msg_op *op)
 {
-	int i;
-	cl_bin *value = 0;
+	return op->name_sz < sizeof(value->bin_name) && value->bin_name[op->name_sz] == 0 &&
+			memcmp(value->bin_name, op->name, op->name_sz) == 0;
+}
 
-	for (i = 0; i < n_values; i++) {
-		value = &values[i];
+static inline uint32_t
+bin_name_hash(const uint8_t *name, size_t name_sz)
+{
+	// FNV-1a
+	uint32_t h = 2166136261;
 
-		if (memcmp(value->bin_name, op->name, op->name_sz) == 0) {
-			break;
+	for (size_t i = 0; i < name_sz; i++) {
+		h = (h ^ name[i]) * 16777619;
+	}
+	return h;
+}
+
+static inline void
+bin_index_init(bin_index *index, cl_bin *values, int n_values)
+{
+	index->values = values;
+	index->n_values = n_values;
+	index->next = 0;
+	index->n_slots = 0;
+}
+
+static void
+bin_index_build(bin_index *index)
+{
+	int n_slots = 8;
+
+	while (n_slots < index->n_values * 2) {
+		n_slots *= 2;
+	}
+
+	memset(index->slots, 0, sizeof(int16_t) * n_slots);
+
+	for (int i = 0; i < index->n_values; i++) {
+		const char *name = index->values[i].bin_name;
+		uint32_t slot = bin_name_hash((const uint8_t *)name, strlen(name)) & (n_slots - 1);
+
+		while (index->slots[slot]) {
+			slot = (slot + 1) & (n_slots - 1);
 		}
+		index->slots[slot] = (int16_t)(i + 1);
 	}
+	index->n_slots = n_slots;
+}
 
-	if (i == n_values) {
-		return(-1);
+static cl_bin *
+bin_index_find(bin_index *index, const cl_msg_op *op)
+{
+	if (index->next < index->n_values && bin_name_equals(&index->values[index->next], op)) {
+		return &index->values[index->next++];
 	}
 
-	set_object(op, &value->object);
-	return(0);
+	if (index->n_values > BIN_INDEX_MAX_VALUES) {
+		for (int i = 0; i < index->n_values; i++) {
+			if (bin_name_equals(&index->values[i], op)) {
+				index->next = i + 1;
+				return &index->values[i];
+			}
+		}
+		return NULL;
+	}
+
+	if (index->n_slots == 0) {
+		bin_index_build(index);
+	}
+
+	uint32_t slot = bin_name_hash(op->name, op->name_sz) & (index->n_slots - 1);
+
+	while (index->slots[slot]) {
+		int i = index->slots[slot] - 1;
+
+		if (bin_name_equals(&index->values[i], op)) {
+			index->next = i + 1;
+			return &index->values[i];
+		}
+		slot = (slot + 1) & (index->n_slots - 1);
+	}
+	return NULL;
 }
 
 //
@@ -1206,13 +1346,21 @@ cl_parse(cl_msg *msg, uint8_t *buf, size_t buf_len, cl_bin **values_r,
 		}
 		else {
 			// If we already have our filled-out value structure, just copy in.
+			bin_index index;
+			bin_index_init(&index, *values_r, *n_values_r);
+
 			for (i = 0; i < msg->n_ops; i++) {
 				if (buf_lim < buf + sizeof(cl_msg_op)) {
 					return(-1);
 				}
 
 				cl_msg_swap_op_from_be(op);
-				set_value_search(op, *values_r, *n_values_r);
+
+				cl_bin *value = bin_index_find(&index, op);
+
+				if (value) {
+					set_object(op, &value->object);
+				}
 				op = cl_msg_op_get_next(op);
 			}
 		}
@@ -1223,35 +1371,22 @@ cl_parse(cl_msg *msg, uint8_t *buf, size_t buf_len, cl_bin **values_r,
 
 
 //
-// Omnibus (!beep!! !beep!!) internal function that the externals can map to
-// If you don't want any values back, pass the values and n_values pointers as null
-//
-// WARNING - this parsing system relied on the length of cl_msg, which is
-// clumsy and against the spirit of the protocol. The length of cl_msg is specified
-// in the protocol, and the length of the message is defined - it should all be used.
-//
-// EITHER set + key must be set, or digest must be set! not both!
+// Send a compiled request to the node owning the digest, retrying according
+// to the write policy, and parse the response. The request buffer belongs to
+// the caller. If route is set, it caches the digest's partition for the next
+// request with the same key.
 //
-// Similarly, either values or operations must be set, but not both.
 
-int
-do_the_full_monte(as_cluster *asc, int info1, int info2, int info3, const char *ns, const char *set, const cl_object *key,
-	const cf_digest *digest, cl_bin **values, cl_operator operator, cl_operation **operations, int *n_values, 
-	uint32_t *cl_gen, const cl_write_parameters *cl_w_p, uint64_t *trid, char **setname_r, as_call * call, uint32_t* cl_ttl,
-	as_policy_replica replica)
+static int
+cl_send_request(as_cluster *asc, int info2, const char *ns, const cf_digest *d, uint8_t *wr_buf, size_t wr_buf_sz,
+	cl_bin **values, int *n_values, uint32_t *cl_gen, const cl_write_parameters *cl_w_p, uint64_t *trid,
+	char **setname_r, uint32_t* cl_ttl, as_policy_replica replica, as_key_route *route)
 {
 	int rv = -1;
-#ifdef DEBUG_HISTOGRAM
-    uint64_t start_time = cf_getms();
-#endif
 
 	uint8_t		rd_stack_buf[STACK_BUF_SZ];
 	uint8_t		*rd_buf = rd_stack_buf;
 	size_t		rd_buf_sz = 0;
-    
-	uint8_t		wr_stack_buf[STACK_BUF_SZ];
-	uint8_t		*wr_buf = wr_stack_buf;
-	size_t		wr_buf_sz = sizeof(wr_stack_buf);
 
 	as_msg 		msg;
     
@@ -1261,42 +1396,20 @@ do_the_full_monte(as_cluster *asc, int info1, int info2, int info3, const char *
 	
 	int fd = -1;
 
-//	if( *values ){
-//		dump_values(*values, null, *n_values);
-//	}else if( *operations ){
-//		dump_values(null, *operations, *n_values);
-//	}
-
-	cf_digest d_ret;
-	if (n_values && ( values || operations) ){
-		if (cl_compile(info1, info2, info3, ns, set, key, digest, values?*values:NULL, operator, operations?*operations:NULL,
-				*n_values , &wr_buf, &wr_buf_sz, cl_w_p, &d_ret, *trid, NULL, call, 0 /* udf_type */)) {
-			return(rv);
-		}
-		if (operations) {
-			// Force results of operations returned in response to be malloc'd.
-			*n_values = 0;
-		}
-	}else{
-		if (cl_compile(info1, info2, info3, ns, set, key, digest, 0, 0, 0, 0, &wr_buf, &wr_buf_sz, cl_w_p, &d_ret, *trid, NULL, call, 0 /*udf_type*/)) {
-			return(rv);
-		}
-	}
-
 #ifdef DEBUG_VERBOSE
 	dump_buf("sending request to cluster:", wr_buf, wr_buf_sz);
 #endif
 
 	int try = 0;
 
-#ifdef DEBUG_TIME
-	uint64_t before_write_time = 0;
-	uint64_t after_write_time = 0;
-	uint64_t before_read_header_time = 0;
-	uint64_t after_read_header_time = 0;
-	uint64_t before_read_body_time = 0;
-	uint64_t after_read_body_time = 0;
-#endif
+	// Time the stages of this request if slow operations are sampled.
+	as_slowop op_buf;
+	as_slowop *op = 0;
+
+	if (asc->slowops) {
+		op = &op_buf;
+		as_slowop_begin(op, ns, d, info2 & CL_MSG_INFO2_WRITE ? true : false);
+	}
 
     deadline_ms = 0;
     progress_timeout_ms = 0;
@@ -1316,15 +1429,6 @@ do_the_full_monte(as_cluster *asc, int info1, int info2, int info3, const char *
 	// retry request based on the write_policy
 	do {
 
-#ifdef DEBUG_TIME
-		before_write_time = 0;
-		after_write_time = 0;
-		before_read_header_time = 0;
-		after_read_header_time = 0;
-		before_read_body_time = 0;
-		after_read_body_time = 0;
-#endif
-        
 #ifdef DEBUG_VERBOSE
 		if (try > 0)
 			as_log_debug("request retrying try %d tid %zu", try, (uint64_t)pthread_self());
@@ -1332,39 +1436,35 @@ do_the_full_monte(as_cluster *asc, int info1, int info2, int info3, const char *
 		try++;
 		
 		// Get an FD from a cluster
-		node = as_node_get(asc, ns, &d_ret, info2 & CL_MSG_INFO2_WRITE ? true : false, replica);
+		node = as_node_get_routed(asc, route, ns, d, info2 & CL_MSG_INFO2_WRITE ? true : false, replica);
+		as_slowop_mark(op, AS_SLOWOP_PARTITION);
 		if (!node) {
 #ifdef DEBUG_VERBOSE
 			as_log_debug("warning: no healthy nodes in cluster, retrying");
 #endif
 			usleep(10000);
+			as_slowop_mark(op, AS_SLOWOP_RETRY_WAIT);
 			goto Retry;
 		}
+		as_slowop_add_node(op, node);
 		
-		rv = as_node_get_connection(node, &fd);
+		rv = as_node_get_connection_timed(node, &fd, op);
+		as_slowop_mark(op, AS_SLOWOP_CHECKOUT);
 		if (rv) {
 			usleep(1000);
+			as_slowop_mark(op, AS_SLOWOP_RETRY_WAIT);
 			goto Retry;
 		}
 		
 		// send it to the cluster - non blocking socket, but we're blocking
 
-#ifdef DEBUG_TIME
-        before_write_time = cf_getms();
-#endif
 		rv = cf_socket_write_timeout(fd, wr_buf, wr_buf_sz, deadline_ms, progress_timeout_ms);
-#ifdef DEBUG_TIME
-        after_write_time = cf_getms();
-#endif
+		as_slowop_mark(op, AS_SLOWOP_WRITE);
 
 		if (rv != 0) {
 #ifdef DEBUG_VERBOSE
 			as_log_debug("Citrusleaf: write timeout or error when writing header to server - %d fd %d errno %d (tid %zu)",rv,fd,errno,(uint64_t)pthread_self());
 #endif
-#ifdef DEBUG_TIME
-            debug_printf(before_write_time, after_write_time, before_read_header_time, after_read_header_time, before_read_body_time, after_read_body_time,
-                         deadline_ms, progress_timeout_ms);
-#endif
 
 			goto Retry;
 		}
@@ -1372,25 +1472,20 @@ do_the_full_monte(as_cluster *asc, int info1, int info2, int info3, const char *
 #ifdef DEBUG_VERBOSE
 		memset(&msg, 0, sizeof(as_msg));
 #endif
-#ifdef DEBUG_TIME
-        before_read_header_time = cf_getms();
-#endif
+		
+		// Spin briefly first if configured - fast responses then skip the
+		// kernel sleep and wakeup.
+		as_socket_profile_spin(&asc->socket, fd);
 		
 		// Now turn around and read into this fine cl_msg, which is the short header
 		rv = cf_socket_read_timeout(fd, (uint8_t *) &msg, sizeof(as_msg), deadline_ms, progress_timeout_ms);
-#ifdef DEBUG_TIME
-        after_read_header_time = cf_getms();
-#endif
+		as_slowop_mark(op, AS_SLOWOP_FIRST_BYTE);
 
 		if (rv) {
 
 #ifdef DEBUG_VERBOSE            
 			as_log_debug("Citrusleaf: error when reading header from server - rv %d fd %d", rv, fd);
 #endif
-#ifdef DEBUG_TIME
-            debug_printf(before_write_time, after_write_time, before_read_header_time, after_read_header_time, before_read_body_time, after_read_body_time,
-                         deadline_ms, progress_timeout_ms);
-#endif            
 			rv = AEROSPIKE_ERR_TIMEOUT;
 			goto Retry;
 	
@@ -1414,31 +1509,22 @@ do_the_full_monte(as_cluster *asc, int info1, int info2, int info3, const char *
 		rd_buf_sz =  msg.proto.sz  - msg.m.header_sz;
 		if (rd_buf_sz > 0) {
 			if (rd_buf_sz > sizeof(rd_stack_buf)) {
-				rd_buf = malloc(rd_buf_sz);
+				rd_buf = as_alloc_malloc(AS_ALLOC_TAG_WIRE, rd_buf_sz);
 				if (!rd_buf) {
                     as_log_error("malloc fail: trying %zu", rd_buf_sz);
                     rv = -1; 
                     goto Error; 
                 }
 			}
-#ifdef DEBUG_TIME
-        before_read_body_time = cf_getms();
-#endif            
 			rv = cf_socket_read_timeout(fd, rd_buf, rd_buf_sz, deadline_ms, progress_timeout_ms);
-#ifdef DEBUG_TIME
-        after_read_body_time = cf_getms();
-#endif
+			as_slowop_mark(op, AS_SLOWOP_BODY);
 			if (rv) {
-				if (rd_buf != rd_stack_buf) { free(rd_buf); }
+				if (rd_buf != rd_stack_buf) { as_alloc_free(rd_buf); }
                 rd_buf = 0;
                 
 #ifdef DEBUG_VERBOSE            
                 as_log_debug("Citrusleaf: error when reading from server - rv %d fd %d", rv, fd);
 #endif
-#ifdef DEBUG_TIME
-				debug_printf(before_write_time, after_write_time, before_read_header_time, after_read_header_time, before_read_body_time, after_read_body_time, 
-                             deadline_ms, progress_timeout_ms);
-#endif
 
 				rv = AEROSPIKE_ERR_TIMEOUT;
 				goto Retry;
@@ -1485,8 +1571,12 @@ Error:
 
     if (fd != -1)   cf_close(fd);
 
-	if (wr_buf != wr_stack_buf)		free(wr_buf);
-	if (rd_buf && (rd_buf != rd_stack_buf))		free(rd_buf);
+	if (rd_buf && (rd_buf != rd_stack_buf))		as_alloc_free(rd_buf);
+
+	if (op) {
+		op->tries = try;
+		as_slowops_end(asc->slowops, op, rv);
+	}
 
 	return(rv);
     
@@ -1494,8 +1584,6 @@ Ok:
 
 	as_node_put_connection(node, fd);
 	as_node_release(node);
-   
-	if (wr_buf != wr_stack_buf)		free(wr_buf);
 
 	if (rd_buf) {
 		if (0 != cl_parse(&msg.m, rd_buf, rd_buf_sz, values, n_values, trid, setname_r)) {
@@ -1514,7 +1602,13 @@ Ok:
     else {
         rv = AEROSPIKE_ERR_SERVER;
     }    
-	if (rd_buf && (rd_buf != rd_stack_buf))		free(rd_buf);
+	if (rd_buf && (rd_buf != rd_stack_buf))		as_alloc_free(rd_buf);
+	
+	if (op) {
+		as_slowop_mark(op, AS_SLOWOP_PARSE);
+		op->tries = try;
+		as_slowops_end(asc->slowops, op, rv);
+	}
 	
 	// if (rv == 0 && (values || operations) && n_values) {
 	// 	for (int i=0;i<*n_values;i++) {
@@ -1536,6 +1630,67 @@ Ok:
 	return(rv);
 }
 
+//
+// Omnibus (!beep!! !beep!!) internal function that the externals can map to
+// If you don't want any values back, pass the values and n_values pointers as null
+//
+// WARNING - this parsing system relied on the length of cl_msg, which is
+// clumsy and against the spirit of the protocol. The length of cl_msg is specified
+// in the protocol, and the length of the message is defined - it should all be used.
+//
+// EITHER set + key must be set, or digest must be set! not both!
+//
+// Similarly, either values or operations must be set, but not both.
+
+int
+do_the_full_monte(as_cluster *asc, int info1, int info2, int info3, const char *ns, const char *set, const cl_object *key,
+	const cf_digest *digest, cl_bin **values, cl_operator operator, cl_operation **operations, int *n_values, 
+	uint32_t *cl_gen, const cl_write_parameters *cl_w_p, uint64_t *trid, char **setname_r, as_call * call, uint32_t* cl_ttl,
+	as_policy_replica replica, as_key_route *route)
+{
+	int rv = -1;
+#ifdef DEBUG_HISTOGRAM
+    uint64_t start_time = cf_getms();
+#endif
+
+	uint8_t		wr_stack_buf[STACK_BUF_SZ];
+	uint8_t		*wr_buf = wr_stack_buf;
+	size_t		wr_buf_sz = sizeof(wr_stack_buf);
+
+//	if( *values ){
+//		dump_values(*values, null, *n_values);
+//	}else if( *operations ){
+//		dump_values(null, *operations, *n_values);
+//	}
+
+	cf_digest d_ret;
+	if (n_values && ( values || operations) ){
+		if (cl_compile(info1, info2, info3, ns, set, key, digest, values?*values:NULL, operator, operations?*operations:NULL,
+				*n_values , &wr_buf, &wr_buf_sz, cl_w_p, &d_ret, *trid, NULL, call, 0 /* udf_type */)) {
+			return(rv);
+		}
+		if (operations) {
+			// Force results of operations returned in response to be malloc'd.
+			*n_values = 0;
+		}
+	}else{
+		if (cl_compile(info1, info2, info3, ns, set, key, digest, 0, 0, 0, 0, &wr_buf, &wr_buf_sz, cl_w_p, &d_ret, *trid, NULL, call, 0 /*udf_type*/)) {
+			return(rv);
+		}
+	}
+
+	if (asc->hotkeys) {
+		as_hotkeys_sample(asc->hotkeys, ns, set, &d_ret, info2 & CL_MSG_INFO2_WRITE ? true : false);
+	}
+
+	rv = cl_send_request(asc, info2, ns, &d_ret, wr_buf, wr_buf_sz, values, n_values, cl_gen, cl_w_p, trid,
+			setname_r, cl_ttl, replica, route);
+
+	if (wr_buf != wr_stack_buf)		as_alloc_free(wr_buf);
+
+	return(rv);
+}
+
 
 //
 // head functions
@@ -1544,9 +1699,9 @@ Ok:
 
 
 extern cl_rv
-citrusleaf_get(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+citrusleaf_get_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
 		const cf_digest *digest, cl_bin *values, int n_values, int timeout_ms,
-		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica)
+		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica, as_key_route *route)
 {
 	uint64_t trid=0;
 	cl_write_parameters cl_w_p;
@@ -1554,7 +1709,16 @@ citrusleaf_get(as_cluster *asc, const char *ns, const char *set, const cl_object
 	cl_w_p.timeout_ms = timeout_ms;
 
 	return( do_the_full_monte( asc, CL_MSG_INFO1_READ | consistency_level, 0, 0, ns, set, key, digest, &values,
-			CL_OP_READ, 0, &n_values, cl_gen, &cl_w_p, &trid, NULL, NULL, cl_ttl, replica) );
+			CL_OP_READ, 0, &n_values, cl_gen, &cl_w_p, &trid, NULL, NULL, cl_ttl, replica, route) );
+}
+
+extern cl_rv
+citrusleaf_get(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+		const cf_digest *digest, cl_bin *values, int n_values, int timeout_ms,
+		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica)
+{
+	return( citrusleaf_get_route(asc, ns, set, key, digest, values, n_values, timeout_ms, cl_gen, cl_ttl,
+			consistency_level, replica, NULL) );
 }
 
 extern cl_rv
@@ -1568,18 +1732,25 @@ citrusleaf_get_digest(as_cluster *asc, const char *ns, const cf_digest *digest,
 	cl_w_p.timeout_ms = timeout_ms;
 
 	return( do_the_full_monte( asc, CL_MSG_INFO1_READ | consistency_level, 0, 0, ns, 0,0, digest, &values,
-			CL_OP_READ, 0, &n_values, cl_gen, &cl_w_p, &trid, NULL, NULL, cl_ttl, replica) );
+			CL_OP_READ, 0, &n_values, cl_gen, &cl_w_p, &trid, NULL, NULL, cl_ttl, replica, NULL) );
 }
 
 
 extern cl_rv
-citrusleaf_put(as_cluster *asc, const char *ns, const char *set, const cl_object *key, const cf_digest *digest,
-		const cl_bin *values, int n_values, const cl_write_parameters *cl_w_p, int commit_level)
+citrusleaf_put_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key, const cf_digest *digest,
+		const cl_bin *values, int n_values, const cl_write_parameters *cl_w_p, int commit_level, as_key_route *route)
 {
 	uint64_t trid=0;
 	return( do_the_full_monte( asc, 0, CL_MSG_INFO2_WRITE, commit_level, ns, set, key, digest,
 			(cl_bin **) &values, CL_OP_WRITE, 0, &n_values, NULL, cl_w_p,
-			&trid, NULL, NULL, NULL, -1) );
+			&trid, NULL, NULL, NULL, -1, route) );
+}
+
+extern cl_rv
+citrusleaf_put(as_cluster *asc, const char *ns, const char *set, const cl_object *key, const cf_digest *digest,
+		const cl_bin *values, int n_values, const cl_write_parameters *cl_w_p, int commit_level)
+{
+	return( citrusleaf_put_route(asc, ns, set, key, digest, values, n_values, cl_w_p, commit_level, NULL) );
 }
 
 extern cl_rv
@@ -1589,7 +1760,7 @@ citrusleaf_put_digest(as_cluster *asc, const char *ns, const cf_digest *digest,
 	uint64_t trid=0;
 	return( do_the_full_monte( asc, 0, CL_MSG_INFO2_WRITE, commit_level, ns, 0, 0, digest,
 			(cl_bin **) &values, CL_OP_WRITE, 0, &n_values, NULL, cl_w_p,
-			&trid, NULL, NULL, NULL, -1) );
+			&trid, NULL, NULL, NULL, -1, NULL) );
 }
 
 extern cl_rv
@@ -1599,7 +1770,7 @@ citrusleaf_put_digest_with_setname(as_cluster *asc, const char *ns, const char *
 	uint64_t trid=0;
 	return( do_the_full_monte( asc, 0, CL_MSG_INFO2_WRITE, commit_level, ns, set, 0, digest,
 			(cl_bin **) &values, CL_OP_WRITE, 0, &n_values, NULL, cl_w_p,
-			&trid, NULL, NULL, NULL, -1) );
+			&trid, NULL, NULL, NULL, -1, NULL) );
 }
 
 extern cl_rv
@@ -1609,16 +1780,23 @@ citrusleaf_restore(as_cluster *asc, const char *ns, const char *set, const cl_ob
 	uint64_t trid=0;
 	return( do_the_full_monte( asc, 0, CL_MSG_INFO2_WRITE, commit_level, ns, set, key, digest,
 			(cl_bin **) &values, CL_OP_WRITE, 0, &n_values, NULL, cl_w_p,
-			&trid, NULL, NULL, NULL, -1) );
+			&trid, NULL, NULL, NULL, -1, NULL) );
 }
 
 extern cl_rv
-citrusleaf_delete(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
-		const cf_digest *digest, const cl_write_parameters *cl_w_p, int commit_level)
+citrusleaf_delete_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+		const cf_digest *digest, const cl_write_parameters *cl_w_p, int commit_level, as_key_route *route)
 {
 	uint64_t trid=0;
 	return( do_the_full_monte( asc, 0, CL_MSG_INFO2_DELETE | CL_MSG_INFO2_WRITE, commit_level,
-			ns, set, key, digest, 0, 0, 0, 0, NULL, cl_w_p, &trid, NULL, NULL, NULL, -1) );
+			ns, set, key, digest, 0, 0, 0, 0, NULL, cl_w_p, &trid, NULL, NULL, NULL, -1, route) );
+}
+
+extern cl_rv
+citrusleaf_delete(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+		const cf_digest *digest, const cl_write_parameters *cl_w_p, int commit_level)
+{
+	return( citrusleaf_delete_route(asc, ns, set, key, digest, cl_w_p, commit_level, NULL) );
 }
 
 extern cl_rv
@@ -1626,7 +1804,7 @@ citrusleaf_delete_digest(as_cluster *asc, const char *ns, const cf_digest *diges
 {
 	uint64_t trid=0;
 	return( do_the_full_monte( asc, 0, CL_MSG_INFO2_DELETE | CL_MSG_INFO2_WRITE, commit_level,
-			ns, 0, 0, digest, 0, 0, 0, 0, NULL, cl_w_p, &trid, NULL, NULL, NULL, -1) );
+			ns, 0, 0, digest, 0, 0, 0, 0, NULL, cl_w_p, &trid, NULL, NULL, NULL, -1, NULL) );
 }
 
 
@@ -1636,9 +1814,9 @@ citrusleaf_delete_digest(as_cluster *asc, const char *ns, const cf_digest *diges
 //
 
 extern cl_rv
-citrusleaf_exists_key(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+citrusleaf_exists_key_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
 		const cf_digest *digest, cl_bin *values, int n_values, int timeout_ms,
-		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica)
+		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica, as_key_route *route)
 {
 	uint64_t trid=0;
 	cl_write_parameters cl_w_p;
@@ -1647,7 +1825,16 @@ citrusleaf_exists_key(as_cluster *asc, const char *ns, const char *set, const cl
 
 	return( do_the_full_monte( asc, CL_MSG_INFO1_READ | CL_MSG_INFO1_GET_NOBINDATA | consistency_level, 0, 0,
 			ns, set, key, digest, &values, CL_OP_READ, 0, &n_values, cl_gen,
-			&cl_w_p, &trid, NULL, NULL, cl_ttl, replica) );
+			&cl_w_p, &trid, NULL, NULL, cl_ttl, replica, route) );
+}
+
+extern cl_rv
+citrusleaf_exists_key(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+		const cf_digest *digest, cl_bin *values, int n_values, int timeout_ms,
+		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica)
+{
+	return( citrusleaf_exists_key_route(asc, ns, set, key, digest, values, n_values, timeout_ms, cl_gen, cl_ttl,
+			consistency_level, replica, NULL) );
 }
 
 extern cl_rv
@@ -1662,14 +1849,14 @@ citrusleaf_exists_digest(as_cluster *asc, const char *ns, const cf_digest *diges
 
 	return( do_the_full_monte( asc, CL_MSG_INFO1_READ | CL_MSG_INFO1_GET_NOBINDATA | consistency_level, 0, 0,
 			ns, 0,0, digest, &values, CL_OP_READ, 0, &n_values, cl_gen,
-			&cl_w_p, &trid, NULL, NULL, cl_ttl, replica) );
+			&cl_w_p, &trid, NULL, NULL, cl_ttl, replica, NULL) );
 }
 
 
 extern cl_rv
-citrusleaf_get_all(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+citrusleaf_get_all_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
 		const cf_digest *digest, cl_bin **values, int *n_values, int timeout_ms,
-		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica)
+		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica, as_key_route *route)
 {
 	if ((values == 0) || (n_values == 0)) {
 		as_log_error("citrusleaf_get_all: illegal parameters passed");
@@ -1686,7 +1873,16 @@ citrusleaf_get_all(as_cluster *asc, const char *ns, const char *set, const cl_ob
 	
 	return( do_the_full_monte( asc, CL_MSG_INFO1_READ | CL_MSG_INFO1_GET_ALL | consistency_level, 0, 0,
 			ns, set, key, digest, values, CL_OP_READ, 0, n_values,
-			cl_gen, &cl_w_p, &trid, NULL, NULL, cl_ttl, replica) );
+			cl_gen, &cl_w_p, &trid, NULL, NULL, cl_ttl, replica, route) );
+}
+
+extern cl_rv
+citrusleaf_get_all(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+		const cf_digest *digest, cl_bin **values, int *n_values, int timeout_ms,
+		uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level, as_policy_replica replica)
+{
+	return( citrusleaf_get_all_route(asc, ns, set, key, digest, values, n_values, timeout_ms, cl_gen, cl_ttl,
+			consistency_level, replica, NULL) );
 }
 
 extern cl_rv
@@ -1715,7 +1911,7 @@ citrusleaf_get_all_digest_getsetname(as_cluster *asc, const char *ns, const cf_d
 	}
 	
 	return( do_the_full_monte( asc, info1, 0, 0, ns, 0, 0, digest, values,
-			CL_OP_READ, 0, n_values, cl_gen, &cl_w_p, &trid, setname, NULL, cl_ttl, replica) );
+			CL_OP_READ, 0, n_values, cl_gen, &cl_w_p, &trid, setname, NULL, cl_ttl, replica, NULL) );
 }
 
 extern cl_rv
@@ -1770,18 +1966,16 @@ citrusleaf_calculate_digest(const char *set, const cl_object *key, cf_digest *di
 }
 
 
-extern cl_rv
-citrusleaf_operate(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
-		cf_digest *digest, cl_bin **values, cl_operation *operations, int *n_values,
-		const cl_write_parameters *cl_w_p, uint32_t *generation, uint32_t* ttl, int consistency_level, int commit_level,
-		as_policy_replica replica)
-{
-	// see if there are any read or write bits ---
-	//   (this is slightly obscure c usage....)
-	int info1 = 0, info2 = 0, info3 = 0;
-	uint64_t trid = 0;
+//
+// See if there are any read or write bits in a set of operations ---
+//   (this is slightly obscure c usage....)
+//
 
-	for (int i = 0; i < *n_values; i++) {
+static void
+cl_operations_to_info(const cl_operation *operations, int n_operations, int consistency_level, int commit_level,
+	int *info1, int *info2, int *info3)
+{
+	for (int i = 0; i < n_operations; i++) {
 		switch (operations[i].op) {
 		case CL_OP_WRITE:
 		case CL_OP_MC_INCR:
@@ -1792,23 +1986,194 @@ citrusleaf_operate(as_cluster *asc, const char *ns, const char *set, const cl_ob
 		case CL_OP_MC_PREPEND:
 		case CL_OP_MC_TOUCH:
 		case CL_OP_TOUCH:
-			info2 = CL_MSG_INFO2_WRITE;
-			info3 = commit_level;
+			*info2 = CL_MSG_INFO2_WRITE;
+			*info3 = commit_level;
 			break;
 		case CL_OP_READ:
-			info1 = CL_MSG_INFO1_READ | consistency_level;
+			*info1 = CL_MSG_INFO1_READ | consistency_level;
 			break;
 		default:
 			break;
 		}
 		
-		if (info1 && info2) break;
+		if (*info1 && *info2) break;
 	}
+}
+
+extern cl_rv
+citrusleaf_operate_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+		cf_digest *digest, cl_bin **values, cl_operation *operations, int *n_values,
+		const cl_write_parameters *cl_w_p, uint32_t *generation, uint32_t* ttl, int consistency_level, int commit_level,
+		as_policy_replica replica, as_key_route *route)
+{
+	int info1 = 0, info2 = 0, info3 = 0;
+	uint64_t trid = 0;
+
+	cl_operations_to_info(operations, *n_values, consistency_level, commit_level, &info1, &info2, &info3);
 
 	*values = 0;
 
 	return( do_the_full_monte( asc, info1, info2, info3, ns, set, key, digest, values, 0,
-			&operations, n_values, generation, cl_w_p, &trid, NULL, NULL, ttl, replica) );
+			&operations, n_values, generation, cl_w_p, &trid, NULL, NULL, ttl, replica, route) );
+}
+
+extern cl_rv
+citrusleaf_operate(as_cluster *asc, const char *ns, const char *set, const cl_object *key,
+		cf_digest *digest, cl_bin **values, cl_operation *operations, int *n_values,
+		const cl_write_parameters *cl_w_p, uint32_t *generation, uint32_t* ttl, int consistency_level, int commit_level,
+		as_policy_replica replica)
+{
+	return( citrusleaf_operate_route(asc, ns, set, key, digest, values, operations, n_values, cl_w_p, generation, ttl,
+			consistency_level, commit_level, replica, NULL) );
+}
+
+//
+// Operate templates - the op headers and bin names of a fixed set of
+// operations are laid out once, so that repeated operate calls only have to
+// write the key, digest and values into the request.
+//
+
+int
+citrusleaf_operate_template_init(cl_operate_template *tmpl, const cl_operation *operations, int n_operations,
+		int consistency_level, int commit_level)
+{
+	memset(tmpl, 0, sizeof(cl_operate_template));
+
+	size_t ops_sz = 0;
+	for (int i = 0; i < n_operations; i++) {
+		ops_sz += sizeof(cl_msg_op) + strlen(operations[i].bin.bin_name);
+	}
+
+	uint8_t *buf = as_alloc_malloc(AS_ALLOC_TAG_WIRE, ops_sz ? ops_sz : 1);
+	if (!buf) {
+		return(-1);
+	}
+	memset(buf, 0, ops_sz);
+
+	// Lay out each op header with its name. The op size and particle type
+	// depend on the value and are filled in per request.
+	uint8_t *p = buf;
+	for (int i = 0; i < n_operations; i++) {
+		cl_msg_op *op = (cl_msg_op *) p;
+		size_t name_sz = strlen(operations[i].bin.bin_name);
+		if (cl_operator_to_msg_op(operations[i].op, &op->op) != 0) {
+			as_alloc_free(buf);
+			return(-1);
+		}
+		op->version = 0;
+		op->name_sz = (uint8_t)name_sz;
+		memcpy(op->name, operations[i].bin.bin_name, name_sz);
+		p += sizeof(cl_msg_op) + name_sz;
+	}
+
+	cl_operations_to_info(operations, n_operations, consistency_level, commit_level,
+			&tmpl->info1, &tmpl->info2, &tmpl->info3);
+
+	tmpl->ops = buf;
+	tmpl->ops_sz = ops_sz;
+	tmpl->n_ops = n_operations;
+	return(0);
+}
+
+void
+citrusleaf_operate_template_destroy(cl_operate_template *tmpl)
+{
+	if (tmpl->ops) {
+		as_alloc_free(tmpl->ops);
+		tmpl->ops = NULL;
+	}
+	tmpl->ops_sz = 0;
+	tmpl->n_ops = 0;
+}
+
+extern cl_rv
+citrusleaf_operate_template_route(as_cluster *asc, const cl_operate_template *tmpl, const char *ns, const char *set,
+		const cl_object *key, cf_digest *digest, cl_object *objects, cl_bin **values, int *n_values,
+		const cl_write_parameters *cl_w_p, uint32_t *generation, uint32_t* ttl, as_policy_replica replica, as_key_route *route)
+{
+	int		ns_len = ns ? (int)strlen(ns) : 0;
+	int		set_len = set ? (int)strlen(set) : 0;
+	uint64_t trid = 0;
+
+	// determine the size - only the values vary in the ops
+	size_t	msg_sz = sizeof(as_msg) + tmpl->ops_sz;
+	if (ns)     msg_sz += sizeof(cl_msg_field) + ns_len;
+	if (set)    msg_sz += sizeof(cl_msg_field) + set_len;
+	if (key)    msg_sz += sizeof(cl_msg_field) + 1 + key->sz;
+	if (digest) msg_sz += sizeof(cl_msg_field) + 1 + sizeof(cf_digest);
+
+	for (int i = 0; i < tmpl->n_ops; i++) {
+		if (0 != cl_object_get_size(&objects[i], &msg_sz)) {
+			as_log_error("illegal parameter: bad type %d write op %d", objects[i].type, i);
+			return(-1);
+		}
+	}
+
+	uint8_t		wr_stack_buf[STACK_BUF_SZ];
+	uint8_t		*wr_buf = wr_stack_buf;
+
+	if (msg_sz > sizeof(wr_stack_buf)) {
+		wr_buf = as_alloc_malloc(AS_ALLOC_TAG_WIRE, msg_sz);
+		if (!wr_buf) {
+			return(-1);
+		}
+	}
+
+	uint info2 = tmpl->info2;
+	uint info3 = tmpl->info3;
+	uint32_t gen = cl_write_parameters_to_info(cl_w_p, &info2, &info3);
+	uint32_t record_ttl = cl_w_p ? cl_w_p->record_ttl : 0;
+	uint32_t transaction_ttl = cl_w_p ? cl_w_p->timeout_ms : 0;
+	int n_fields = (ns ? 1 : 0) + (set ? 1 : 0) + (key ? 1 : 0) + (digest ? 1 : 0);
+
+	cf_digest d_ret;
+	uint8_t *buf = cl_write_header(wr_buf, msg_sz, tmpl->info1, info2, info3, gen, record_ttl, transaction_ttl,
+			n_fields, tmpl->n_ops);
+	buf = write_fields(buf, ns, ns_len, set, set_len, key, digest, &d_ret, trid, NULL, NULL, 0);
+	if (!buf) {
+		if (wr_buf != wr_stack_buf)		as_alloc_free(wr_buf);
+		return(-1);
+	}
+
+	// copy in the pre-encoded op headers, patching in the values
+	const uint8_t *t = tmpl->ops;
+	for (int i = 0; i < tmpl->n_ops; i++) {
+		const cl_msg_op *top = (const cl_msg_op *) t;
+		size_t hdr_sz = sizeof(cl_msg_op) + top->name_sz;
+		cl_msg_op *op = (cl_msg_op *) buf;
+
+		memcpy(op, top, hdr_sz);
+
+		size_t value_sz = 0;
+		cl_object_get_size(&objects[i], &value_sz);
+		cl_object_to_buf(&objects[i], buf + hdr_sz);
+		op->particle_type = cl_object_wire_type(&objects[i]);
+		op->op_sz = (uint32_t)(hdr_sz - sizeof(uint32_t) + value_sz);
+
+		buf += hdr_sz + value_sz;
+		cl_msg_swap_op_to_be(op);
+		t += hdr_sz;
+	}
+
+	// Force results of operations returned in response to be malloc'd.
+	*values = 0;
+	*n_values = 0;
+
+	int rv = cl_send_request(asc, info2, ns, &d_ret, wr_buf, msg_sz, values, n_values, generation, cl_w_p, &trid,
+			NULL, ttl, replica, route);
+
+	if (wr_buf != wr_stack_buf)		as_alloc_free(wr_buf);
+
+	return(rv);
+}
+
+extern cl_rv
+citrusleaf_operate_template(as_cluster *asc, const cl_operate_template *tmpl, const char *ns, const char *set,
+		const cl_object *key, cf_digest *digest, cl_object *objects, cl_bin **values, int *n_values,
+		const cl_write_parameters *cl_w_p, uint32_t *generation, uint32_t* ttl, as_policy_replica replica)
+{
+	return( citrusleaf_operate_template_route(asc, tmpl, ns, set, key, digest, objects, values, n_values, cl_w_p,
+			generation, ttl, replica, NULL) );
 }
 
 //
@@ -24,9 +24,12 @@
 #include <fcntl.h>
 #include <zlib.h>
 
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_log_macros.h>
+#include <aerospike/as_status.h>
 
+#include <citrusleaf/cf_clock.h>
 #include <citrusleaf/cf_socket.h>
 #include <citrusleaf/cf_proto.h>
 
@@ -61,7 +64,7 @@ batch_decompress(uint8_t *in_buf, size_t in_sz, uint8_t **out_buf, size_t *out_s
     
     // first 8 bytes are the inflated size, allows efficient alloc (round up: the buf likes that)
     size_t  	b_sz_alloc = *(uint64_t *)in_buf;
-    uint8_t 	*b = malloc(b_sz_alloc);
+    uint8_t 	*b = as_alloc_malloc(AS_ALLOC_TAG_BATCH, b_sz_alloc);
     if (0 == b) {
     	as_log_error("batch_decompress: could not malloc %"PRIu64" bytes", b_sz_alloc);
     	inflateEnd(&strm);
@@ -78,7 +81,7 @@ batch_decompress(uint8_t *in_buf, size_t in_sz, uint8_t **out_buf, size_t *out_s
 
 	if (rv != Z_STREAM_END) {
 		as_log_error("could not deflate data: zlib error %d (check zlib.h)", rv);
-		free(b);
+		as_alloc_free(b);
 		inflateEnd(&strm);
 		return(-1);
 	}
@@ -93,8 +96,7 @@ batch_decompress(uint8_t *in_buf, size_t in_sz, uint8_t **out_buf, size_t *out_s
 
 
 static uint8_t *
-write_fields_batch_digests(uint8_t *buf, char *ns, int ns_len, cf_digest *digests, as_node **nodes, int n_digests, 
-	int n_my_digests, as_node *my_node )
+write_fields_batch_digests(uint8_t *buf, char *ns, int ns_len, cf_digest *digests, const int *indexes, int n_indexes)
 {
 	
 	// lay out the fields
@@ -111,14 +113,12 @@ write_fields_batch_digests(uint8_t *buf, char *ns, int ns_len, cf_digest *digest
 	}
 
 	mf->type = CL_MSG_FIELD_TYPE_DIGEST_RIPE_ARRAY;
-	int digest_sz = sizeof(cf_digest) * n_my_digests;
+	int digest_sz = sizeof(cf_digest) * n_indexes;
 	mf->field_sz = digest_sz + 1;
 	uint8_t *b = mf->data;
-	for (int i=0;i<n_digests;i++) {
-		if (nodes[i] == my_node) { 
-			memcpy(b, &digests[i], sizeof(cf_digest));
-			b += sizeof(cf_digest);
-		}
+	for (int i=0;i<n_indexes;i++) {
+		memcpy(b, &digests[indexes[i]], sizeof(cf_digest));
+		b += sizeof(cf_digest);
 	}
 		
 	mf_tmp = cl_msg_field_get_next(mf);
@@ -130,7 +130,7 @@ write_fields_batch_digests(uint8_t *buf, char *ns, int ns_len, cf_digest *digest
 
 
 static int
-batch_compile(uint info1, uint info2, char *ns, cf_digest *digests, as_node **nodes, int n_digests, as_node *my_node, int n_my_digests, cl_bin *values, cl_operator operator, cl_operation *operations, int n_values,  
+batch_compile(uint info1, uint info2, char *ns, cf_digest *digests, const int *indexes, int n_indexes, cl_bin *values, cl_operator operator, cl_operation *operations, int n_values,  
 	uint8_t **buf_r, size_t *buf_sz_r, const cl_write_parameters *cl_w_p)
 {
 	// I hate strlen
@@ -141,7 +141,7 @@ batch_compile(uint info1, uint info2, char *ns, cf_digest *digests, as_node **no
 	size_t	msg_sz = sizeof(as_msg); // header
 	// fields
 	if (ns) msg_sz += ns_len + sizeof(cl_msg_field);
-	msg_sz += sizeof(cl_msg_field) + 1 + (sizeof(cf_digest) * n_my_digests);
+	msg_sz += sizeof(cl_msg_field) + 1 + (sizeof(cf_digest) * n_indexes);
 	// ops
 	for (i=0;i<n_values;i++) {
 		msg_sz += sizeof(cl_msg_op) + strlen(values[i].bin_name);
@@ -156,7 +156,7 @@ batch_compile(uint info1, uint info2, char *ns, cf_digest *digests, as_node **no
 	uint8_t	*buf;
 	uint8_t *mbuf = 0;
 	if ((*buf_r) && (msg_sz > *buf_sz_r)) {
-		mbuf = buf = malloc(msg_sz);
+		mbuf = buf = as_alloc_malloc(AS_ALLOC_TAG_BATCH, msg_sz);
 		if (!buf) 			return(-1);
 		*buf_r = buf;
 	}
@@ -212,9 +212,9 @@ batch_compile(uint info1, uint info2, char *ns, cf_digest *digests, as_node **no
 	buf = cl_write_header(buf, msg_sz, info1, info2, info3, generation, record_ttl, transaction_ttl, n_fields, n_values);
 		
 	// now the fields
-	buf = write_fields_batch_digests(buf, ns, ns_len, digests, nodes, n_digests, n_my_digests, my_node);
+	buf = write_fields_batch_digests(buf, ns, ns_len, digests, indexes, n_indexes);
 	if (!buf) {
-		if (mbuf)	free(mbuf);
+		if (mbuf)	as_alloc_free(mbuf);
 		return(-1);
 	}
 
@@ -246,25 +246,25 @@ batch_compile(uint info1, uint info2, char *ns, cf_digest *digests, as_node **no
 #define STACK_BINS 100
 
 //
-// do_batch_monte(as_cluster *asc, int info1, int info2, const char *ns, const cf_digest *digests, const cf_node *nodes, int n_digests,
-//					cf_node node, citrusleaf_get_many_cb cb, void *udata)
+// do_batch_monte(as_cluster *asc, int info1, int info2, const char *ns, const cf_digest *digests, const int *indexes, int n_indexes,
+//					as_node *node, citrusleaf_get_many_cb cb, void *udata)
 //
 // asc - cluster to send to 
 // info1 - INFO1 options
 // info2 - INFO2 options
 // ns - namespace for all the digests
-// digests - array of digests to fetch
-// nodes - array of nodes for those digests
-// n_digests - size of the two preceeding arrays
-// node - node of this particular request (thus will send a subset of digests)
+// digests - array of all the digests of the batch
+// indexes - indexes of the digests to fetch from this node
+// n_indexes - size of the preceeding array
+// node - node of this particular request
 // cb - callback that gets called back MULTITHREADED when data arrives
 // udata - user data for the callback
 //
 
 static int
-do_batch_monte(as_cluster *asc, int info1, int info2, char *ns, cf_digest *digests, as_node **nodes, 
-	int n_digests, cl_bin *bins, cl_operator operator, cl_operation *operations, int n_ops,
-	as_node *node, int n_node_digests, citrusleaf_get_many_cb cb, void *udata)
+do_batch_monte(as_cluster *asc, int info1, int info2, char *ns, cf_digest *digests, const int *indexes, 
+	int n_indexes, cl_bin *bins, cl_operator operator, cl_operation *operations, int n_ops,
+	as_node *node, citrusleaf_get_many_cb cb, void *udata)
 {
 	int rv = -1;
 
@@ -277,7 +277,7 @@ do_batch_monte(as_cluster *asc, int info1, int info2, char *ns, cf_digest *diges
 
 	// we have a list of many keys
 //	if (0 == bins && CL_MSG_INFO1_READ == info1) info1 |= CL_MSG_INFO1_GET_ALL;
-	rv = batch_compile(info1, info2, ns, digests, nodes, n_digests, node, n_node_digests, bins, operator, operations, n_ops, 
+	rv = batch_compile(info1, info2, ns, digests, indexes, n_indexes, bins, operator, operations, n_ops, 
 		&wr_buf, &wr_buf_sz, 0);
 	if (rv != 0) {
 		as_log_error("do batch monte: batch compile failed: some kind of intermediate error");
@@ -334,7 +334,7 @@ do_batch_monte(as_cluster *asc, int info1, int info2, char *ns, cf_digest *diges
 		if (rd_buf_sz > 0) {
                                                          
 			if (rd_buf_sz > sizeof(rd_stack_buf))
-				rd_buf = malloc(rd_buf_sz);
+				rd_buf = as_alloc_malloc(AS_ALLOC_TAG_BATCH, rd_buf_sz);
 			else
 				rd_buf = rd_stack_buf;
 			if (rd_buf == NULL) {
@@ -344,7 +344,7 @@ do_batch_monte(as_cluster *asc, int info1, int info2, char *ns, cf_digest *diges
 
 			if ((rv = cf_socket_read_forever(fd, rd_buf, rd_buf_sz))) {
 				as_log_error("network error: errno %d fd %d", rv, fd);
-				if (rd_buf != rd_stack_buf)	{ free(rd_buf); }
+				if (rd_buf != rd_stack_buf)	{ as_alloc_free(rd_buf); }
 				cf_close(fd);
 				return(-1);
 			}
@@ -362,12 +362,12 @@ do_batch_monte(as_cluster *asc, int info1, int info2, char *ns, cf_digest *diges
 			rv = batch_decompress(rd_buf, rd_buf_sz, &new_rd_buf, &new_rd_buf_sz);
 			if (rv != 0) {
 				as_log_error("could not decompress compressed message: error %d", rv);
-				if (rd_buf != rd_stack_buf)	{ free(rd_buf); }
+				if (rd_buf != rd_stack_buf)	{ as_alloc_free(rd_buf); }
 				cf_close(fd);
 				return -1;
 			}				
 				
-			if (rd_buf != rd_stack_buf)	{ free(rd_buf); }
+			if (rd_buf != rd_stack_buf)	{ as_alloc_free(rd_buf); }
 			rd_buf = new_rd_buf;
 			rd_buf_sz = new_rd_buf_sz;
 			
@@ -504,14 +504,14 @@ do_batch_monte(as_cluster *asc, int info1, int info2, char *ns, cf_digest *diges
 		}
 		
 		if (rd_buf && (rd_buf != rd_stack_buf))	{
-			free(rd_buf);
+			as_alloc_free(rd_buf);
 			rd_buf = 0;
 		}
 
 	} while ( done == false );
 
 	if (wr_buf != wr_stack_buf) {
-		free(wr_buf);
+		as_alloc_free(wr_buf);
 		wr_buf = 0;
 	}
 
@@ -538,6 +538,30 @@ do_batch_monte(as_cluster *asc, int info1, int info2, char *ns, cf_digest *diges
 // These externally visible functions are exposed through citrusleaf.h
 //
 
+// Per-key state of a batch request, shared by the worker threads of each
+// round. A worker only touches the keys currently assigned to its node.
+typedef struct {
+	const cf_digest	*digests;
+	as_node			**nodes;		// current owner of each key, NULL once final
+	int				*results;		// last error reported for each key
+	bool			*done;			// response delivered for each key
+	int				*order;			// key indexes grouped by node, per round
+	int				*buckets;		// digest hash index - first key in bucket
+	int				*next;			// digest hash index - next key in bucket
+	uint32_t		n_buckets;		// power of 2
+	int				n_digests;
+	uint8_t			*stack_buf;		// caller's buffer, used for small batches
+	citrusleaf_get_many_cb cb;
+	void			*udata;
+} batch_state;
+
+// Passed to do_batch_monte() as callback user data, so responses can be
+// matched to keys of the node that returned them.
+typedef struct {
+	batch_state	*state;
+	as_node		*node;
+} batch_node_ctx;
+
 typedef struct {
 	
 	// these sections are the same for the same query
@@ -546,21 +570,19 @@ typedef struct {
 	int          info2;
 	char 		*ns;
 	cf_digest 	*digests; 
-	as_node **nodes;
-	int 		n_digests; 
 	bool 		get_key;
 	cl_bin 		*bins;         // Bins. If this is used, 'operation' should be null, and 'operator' should be the operation to be used on the bins
 	cl_operator     operator;      // Operator.  The single operator used on all the bins, if bins is non-null
 	cl_operation    *operations;   // Operations.  Set of operations (bins + operators).  Should be used if bins is not used.
 	int		n_ops;          // Number of operations (count of elements in 'bins' or count of elements in 'operations', depending on which is used. 
-	citrusleaf_get_many_cb cb; 
-	void *udata;
+	batch_state *state;
 
 	cf_queue *complete_q;
 	
 	// this is different for every work
 	as_node *my_node;				
-	int				my_node_digest_count;
+	const int		*indexes;		// indexes of the digests on my_node
+	int				n_indexes;
 	
 	int 			index; // debug only
 	
@@ -569,8 +591,151 @@ typedef struct {
 typedef struct {
 	int result;
 	as_node* my_node;
+	const int* indexes;
+	int n_indexes;
 } work_complete;
 
+static inline uint32_t
+batch_digest_hash(const cf_digest *d, uint32_t n_buckets)
+{
+	// Digests are uniformly distributed - any 4 bytes make a good hash.
+	uint32_t h;
+	memcpy(&h, (const uint8_t *)d + 8, sizeof(h));
+	return h & (n_buckets - 1);
+}
+
+#define BATCH_STATE_STACK_SZ 2048
+
+static int
+batch_state_init(batch_state *state, const cf_digest *digests, int n_digests, citrusleaf_get_many_cb cb, void *udata,
+	uint8_t *stack_buf)
+{
+	uint32_t n_buckets = 1;
+	while (n_buckets < (uint32_t)n_digests) {
+		n_buckets <<= 1;
+	}
+
+	// one allocation for all the per-key arrays
+	size_t sz = (sizeof(as_node *) + (sizeof(int) * 3) + sizeof(bool)) * n_digests + sizeof(int) * n_buckets;
+	uint8_t *p = stack_buf;
+	if (sz > BATCH_STATE_STACK_SZ) {
+		p = as_alloc_malloc(AS_ALLOC_TAG_BATCH, sz);
+		if (!p) {
+			return(-1);
+		}
+	}
+
+	state->nodes = (as_node **) p;
+	p += sizeof(as_node *) * n_digests;
+	state->results = (int *) p;
+	p += sizeof(int) * n_digests;
+	state->order = (int *) p;
+	p += sizeof(int) * n_digests;
+	state->next = (int *) p;
+	p += sizeof(int) * n_digests;
+	state->buckets = (int *) p;
+	p += sizeof(int) * n_buckets;
+	state->done = (bool *) p;
+
+	state->digests = digests;
+	state->n_digests = n_digests;
+	state->n_buckets = n_buckets;
+	state->stack_buf = stack_buf;
+	state->cb = cb;
+	state->udata = udata;
+
+	memset(state->buckets, 0xff, sizeof(int) * n_buckets);
+
+	// insert in reverse, so duplicate digests are matched in request order
+	for (int i = n_digests - 1; i >= 0; i--) {
+		uint32_t b = batch_digest_hash(&digests[i], n_buckets);
+		state->next[i] = state->buckets[b];
+		state->buckets[b] = i;
+		state->nodes[i] = NULL;
+		state->results[i] = -1; // no response yet
+		state->done[i] = false;
+	}
+	return(0);
+}
+
+static void
+batch_state_destroy(batch_state *state)
+{
+	for (int i = 0; i < state->n_digests; i++) {
+		if (state->nodes[i]) {
+			as_node_release(state->nodes[i]);
+		}
+	}
+	// all the per-key arrays were allocated with the node array
+	if ((uint8_t *) state->nodes != state->stack_buf) {
+		as_alloc_free(state->nodes);
+	}
+}
+
+//
+// Find the first key with this digest that is waiting on a response from
+// this node. Returns -1 if there is none.
+//
+static int
+batch_state_find(batch_state *state, const cf_digest *d, as_node *node)
+{
+	int i = state->buckets[batch_digest_hash(d, state->n_buckets)];
+
+	while (i >= 0) {
+		if (state->nodes[i] == node && ! state->done[i] &&
+				memcmp(&state->digests[i], d, sizeof(cf_digest)) == 0) {
+			return i;
+		}
+		i = state->next[i];
+	}
+	return -1;
+}
+
+static int
+batch_record_cb(char *ns, cf_digest *keyd, char *set, cl_object *key, int result,
+		uint32_t generation, uint32_t ttl, cl_bin *bins, uint16_t n_bins, void *udata)
+{
+	batch_node_ctx *ctx = (batch_node_ctx *) udata;
+	batch_state *state = ctx->state;
+
+	int i = batch_state_find(state, keyd, ctx->node);
+	if (i >= 0) {
+		state->done[i] = true;
+		state->results[i] = result;
+	}
+
+	if (! state->cb) {
+		return 0;
+	}
+	return (*state->cb)(ns, keyd, set, key, result, generation, ttl, bins, n_bins, state->udata);
+}
+
+//
+// Errors that may clear up when the keys are sent to their current owners.
+//
+static inline bool
+batch_result_retryable(int result)
+{
+	return result < 0 || result == AEROSPIKE_ERR_CLUSTER_CHANGE ||
+		result == AEROSPIKE_ERR_TIMEOUT || result == AEROSPIKE_ERR_CLUSTER;
+}
+
+//
+// Send the keys of work's node, on the calling thread.
+//
+static int
+batch_run(digest_work *work)
+{
+	batch_node_ctx ctx;
+	ctx.state = work->state;
+	ctx.node = work->my_node;
+
+	return do_batch_monte( work->asc, work->info1, work->info2, work->ns,
+			work->digests, work->indexes, work->n_indexes, work->bins,
+			work->operator, work->operations, work->n_ops, work->my_node,
+			batch_record_cb, &ctx );
+}
+
 static void *
 batch_worker_fn(void* pv_asc)
 {
@@ -591,10 +756,9 @@ batch_worker_fn(void* pv_asc)
 		work_complete wc;
 
 		wc.my_node = work.my_node;
-		wc.result = do_batch_monte( work.asc, work.info1, work.info2, work.ns,
-				work.digests, work.nodes, work.n_digests, work.bins,
-				work.operator, work.operations, work.n_ops, work.my_node,
-				work.my_node_digest_count, work.cb, work.udata );
+		wc.indexes = work.indexes;
+		wc.n_indexes = work.n_indexes;
+		wc.result = batch_run(&work);
 
 		cf_queue_push(work.complete_q, (void *) &wc);
 	}
@@ -603,66 +767,331 @@ batch_worker_fn(void* pv_asc)
 }
 
 
-#define MAX_NODES 128
+// Keys assigned to a node, and where they start in the per-round key order.
+typedef struct {
+	as_node	*node;
+	int		count;
+	int		offset;
+} batch_node_entry;
+
+#define BATCH_NODE_MAP_STACK 32
+
+// Open addressed hash map from node to its keys - grows with the cluster.
+typedef struct {
+	batch_node_entry	*entries;	// node is NULL in empty slots
+	uint32_t			capacity;	// power of 2
+	uint32_t			size;
+	batch_node_entry	stack_entries[BATCH_NODE_MAP_STACK];
+} batch_node_map;
+
+static inline void
+batch_node_map_init(batch_node_map *map)
+{
+	map->entries = map->stack_entries;
+	map->capacity = BATCH_NODE_MAP_STACK;
+	map->size = 0;
+	memset(map->stack_entries, 0, sizeof(map->stack_entries));
+}
+
+static inline void
+batch_node_map_destroy(batch_node_map *map)
+{
+	if (map->entries != map->stack_entries) {
+		as_alloc_free(map->entries);
+	}
+}
+
+static inline batch_node_entry *
+batch_node_map_slot(batch_node_entry *entries, uint32_t capacity, const as_node *node)
+{
+	// Fibonacci hash of the address, dropping the allocation alignment bits.
+	uint32_t i = (uint32_t)(((uintptr_t)node >> 4) * 2654435761u) & (capacity - 1);
+
+	while (entries[i].node && entries[i].node != node) {
+		i = (i + 1) & (capacity - 1);
+	}
+	return &entries[i];
+}
+
+//
+// Get a node's entry, adding it if needed. Returns NULL if the map can't grow.
+//
+static batch_node_entry *
+batch_node_map_get(batch_node_map *map, as_node *node)
+{
+	batch_node_entry *e = batch_node_map_slot(map->entries, map->capacity, node);
+	if (e->node) {
+		return e;
+	}
+
+	// keep the map at most half full
+	if ((map->size + 1) * 2 > map->capacity) {
+		uint32_t capacity = map->capacity * 2;
+		batch_node_entry *entries = as_alloc_malloc(AS_ALLOC_TAG_BATCH, sizeof(batch_node_entry) * capacity);
+		if (!entries) {
+			return NULL;
+		}
+		memset(entries, 0, sizeof(batch_node_entry) * capacity);
+
+		for (uint32_t i = 0; i < map->capacity; i++) {
+			if (map->entries[i].node) {
+				*batch_node_map_slot(entries, capacity, map->entries[i].node) = map->entries[i];
+			}
+		}
+		batch_node_map_destroy(map);
+		map->entries = entries;
+		map->capacity = capacity;
+		e = batch_node_map_slot(entries, capacity, node);
+	}
+
+	e->node = node;
+	e->count = 0;
+	e->offset = 0;
+	map->size++;
+	return e;
+}
+
+//
+// Pick the owner of a key's partition with the fewest keys assigned so far.
+// Falls back to the master (or any node) if the partition has no active prole.
+//
+static as_node *
+batch_get_node_spread(as_cluster *asc, as_partition_table *table, const cf_digest *d, batch_node_map *loads)
+{
+	as_node *master;
+	as_node *prole;
+	as_partition_table_get_owners(asc, table, d, &master, &prole);
+
+	as_node *node;
+	if (master && prole) {
+		batch_node_entry *m = batch_node_map_get(loads, master);
+		batch_node_entry *p = m ? batch_node_map_get(loads, prole) : NULL;
+
+		// the map may have grown - look the master up again
+		if (p) {
+			m = batch_node_map_get(loads, master);
+		}
+
+		if (p && p->count < m->count) {
+			as_node_release(master);
+			node = prole;
+		}
+		else {
+			as_node_release(prole);
+			node = master;
+		}
+	}
+	else if (master || prole) {
+		node = master ? master : prole;
+	}
+	else {
+		return as_partition_table_get_node(asc, table, d, true, -1);
+	}
+
+	batch_node_entry *e = batch_node_map_get(loads, node);
+	if (e) {
+		e->count++;
+	}
+	return node;
+}
+
+// Number of times keys on a failed node are re-routed, deadline permitting.
+#define BATCH_MAX_RETRIES 2
+
+// Pause before re-routing, giving the tend thread a chance to pick up a new
+// partition map.
+#define BATCH_RETRY_SLEEP_MS 10
+
+//
+// Give the keys of a failed node that got no response the node's error.
+// Returns true if they are worth sending again.
+//
+static bool
+batch_node_failed(batch_state *state, as_node *node, const int *indexes, int n_indexes, int result)
+{
+	as_log_warn("Batch node %s retcode error: %d", node->name, result);
+
+	bool pending = false;
+	for (int i = 0; i < n_indexes; i++) {
+		if (! state->done[indexes[i]]) {
+			state->results[indexes[i]] = result;
+			pending = true;
+		}
+	}
+	return pending && batch_result_retryable(result);
+}
+
+//
+// Send every key that has an owner to that node, and wait for all the nodes
+// to finish. Keys on nodes that fail get the node's error as their result.
+// Returns true if any node failed with an error worth retrying.
+//
+static bool
+batch_dispatch(as_cluster *asc, digest_work *work, batch_state *state)
+{
+	int n_digests = state->n_digests;
+	as_node **nodes = state->nodes;
+
+	//
+	// Group keys by node: count the keys of each node, then bucket sort the
+	// key indexes so each node's keys are contiguous.
+	//
+	batch_node_map map;
+	batch_node_map_init(&map);
+
+	for (int i = 0; i < n_digests; i++) {
+		if (! nodes[i]) {
+			continue;
+		}
+
+		batch_node_entry *e = batch_node_map_get(&map, nodes[i]);
+		if (!e) {
+			as_log_error("allocation failed");
+			batch_node_map_destroy(&map);
+
+			for (int j = 0; j < n_digests; j++) {
+				if (nodes[j]) {
+					state->results[j] = -1;
+					as_node_release(nodes[j]);
+					nodes[j] = NULL;
+				}
+			}
+			return false;
+		}
+		e->count++;
+	}
+
+	int offset = 0;
+	for (uint32_t i = 0; i < map.capacity; i++) {
+		batch_node_entry *e = &map.entries[i];
+		if (e->node) {
+			e->offset = offset;
+			offset += e->count;
+			e->count = 0;
+		}
+	}
+
+	for (int i = 0; i < n_digests; i++) {
+		if (nodes[i]) {
+			batch_node_entry *e = batch_node_map_slot(map.entries, map.capacity, nodes[i]);
+			state->order[e->offset + e->count++] = i;
+		}
+	}
+
+	bool retry = false;
+
+	if (map.size == 1) {
+		//
+		// Run on the caller thread - the hop to a worker and back costs
+		// more than it saves when there is no other node to overlap with.
+		// Several nodes always go to the workers, so they run in parallel.
+		//
+		for (uint32_t i = 0; i < map.capacity; i++) {
+			batch_node_entry *e = &map.entries[i];
+			if (! e->node) {
+				continue;
+			}
+
+			work->my_node = e->node;
+			work->indexes = &state->order[e->offset];
+			work->n_indexes = e->count;
+
+			int result = batch_run(work);
+			if (result != 0 && batch_node_failed(state, e->node, work->indexes, e->count, result)) {
+				retry = true;
+			}
+		}
+	}
+	else {
+		if (! work->complete_q) {
+			work->complete_q = cf_queue_create(sizeof(work_complete), true);
+		}
+
+		//
+		// dispatch work to the worker queue to allow the transactions in parallel
+		//
+		int n = 0;
+		for (uint32_t i = 0; i < map.capacity; i++) {
+			batch_node_entry *e = &map.entries[i];
+			if (! e->node) {
+				continue;
+			}
+
+			// fill in per-request specifics
+			work->my_node = e->node;
+			work->indexes = &state->order[e->offset];
+			work->n_indexes = e->count;
+			work->index = n++;
+
+			// dispatch - copies data
+			cf_queue_push(asc->batch_q, work);
+		}
 
+		// wait for the work to complete
+		for (uint32_t i = 0; i < map.size; i++) {
+			work_complete wc;
+			cf_queue_pop(work->complete_q, &wc, CF_QUEUE_FOREVER);
+			if (wc.result != 0 && batch_node_failed(state, wc.my_node, wc.indexes, wc.n_indexes, wc.result)) {
+				retry = true;
+			}
+		}
+	}
+
+	batch_node_map_destroy(&map);
+
+	// Keys that got a response or a final error no longer need their node.
+	for (int i = 0; i < n_digests; i++) {
+		if (nodes[i] && (state->done[i] || (state->results[i] != -1 &&
+				! batch_result_retryable(state->results[i])))) {
+			as_node_release(nodes[i]);
+			nodes[i] = NULL;
+		}
+	}
+	return retry;
+}
 
 cl_rv
 citrusleaf_batch_read(as_cluster *asc, char *ns, const cf_digest *digests, int n_digests,
-		cl_bin *bins, int n_bins, bool get_bin_data, citrusleaf_get_many_cb cb, void *udata)
+		cl_bin *bins, int n_bins, bool get_bin_data, int timeout_ms, as_policy_replica replica,
+		citrusleaf_get_many_cb cb, void *udata)
 {
-	// fast path: if there's only one node, or the number of digests is super short, just dispatch to the server directly
-
-	// TODO FAST PATH
+	uint64_t deadline_ms = timeout_ms > 0 ? cf_getms() + timeout_ms : 0;
 
 	//
-	// allocate the digest-node array, and populate it
+	// allocate the per-key state, and populate the digest-node array
 	// 
-	as_node **nodes = malloc( sizeof(as_node *)  * n_digests);
-	if (!nodes) {
+	uint64_t state_stack_buf[BATCH_STATE_STACK_SZ / sizeof(uint64_t)];
+	batch_state state;
+	if (batch_state_init(&state, digests, n_digests, cb, udata, (uint8_t *) state_stack_buf) != 0) {
 		as_log_error("allocation failed");
 		return(-1);
 	}
+	as_node **nodes = state.nodes;
 	
 	// loop through all digests and determine a node
 	as_partition_table* table = as_cluster_get_partition_table(asc, ns);
+	batch_node_map loads;
+	batch_node_map_init(&loads);
 	
 	for (int i = 0; i < n_digests; i++) {
-		// Must use write mode to get master paritition since batch doesn't proxy.
-		nodes[i] = as_partition_table_get_node(asc, table, &digests[i], true, -1);
+		if (replica == AS_POLICY_REPLICA_ANY) {
+			// Proles hold the same data, so reads may be spread across them.
+			nodes[i] = batch_get_node_spread(asc, table, &digests[i], &loads);
+		}
+		else {
+			// Must use write mode to get master paritition since batch doesn't proxy.
+			nodes[i] = as_partition_table_get_node(asc, table, &digests[i], true, -1);
+		}
 		
 		if (nodes[i] == 0) {
 			as_log_error("index %d: can't get any node", i);
-			
-			// Release previous nodes just reserved.
-			for (int j = 0; j < i; j++) {
-				as_node_release(nodes[j]);
-			}
-			free(nodes);
+			batch_node_map_destroy(&loads);
+			batch_state_destroy(&state);
 			return(-1);
 		}
 	}
+	batch_node_map_destroy(&loads);
 
-	// find unique set
-	as_node *unique_nodes[MAX_NODES];
-	int				unique_nodes_count[MAX_NODES];
-	int 			n_nodes = 0;
-	for (int i=0;i<n_digests;i++) {
-		// look to see if nodes[i] is in the unique list
-		int j;
-		for (j=0;j<n_nodes;j++) {
-			if (unique_nodes[j] == nodes[i]) {
-				unique_nodes_count[j]++;
-				break;
-			}
-		}
-		// not found, insert in nodes list
-		if (j == n_nodes) {
-			unique_nodes[n_nodes] = nodes[i];
-			unique_nodes_count[n_nodes] = 1;
-			n_nodes++;
-		}
-	}
-	
 	// 
 	// Note:  The digest exists case does not retrieve bin data.
 	//
@@ -672,55 +1101,65 @@ citrusleaf_batch_read(as_cluster *asc, char *ns, const cf_digest *digests, int n
 	work.info2 = 0;
 	work.ns = ns;
 	work.digests = (cf_digest *) digests; // discarding const to make compiler happy
-	work.nodes = nodes;
-	work.n_digests = n_digests;
 	work.get_key = false; // we don't use this
 	work.bins = bins;
 	work.operator = CL_OP_READ;
 	work.operations = 0;
 	work.n_ops = n_bins;
-	work.cb = cb;
-	work.udata = udata;
+	work.state = &state;
+	work.index = 0;
 	
-	work.complete_q = cf_queue_create(sizeof(int),true);
+	// only created if work goes to the worker threads
+	work.complete_q = NULL;
+
 	//
-	// dispatch work to the worker queue to allow the transactions in parallel
+	// Only keys on failed nodes are sent again, after re-resolving them
+	// against the current partition map. Keys that already got a response
+	// are never re-sent.
 	//
-	for (int i=0;i<n_nodes;i++) {
-		
-		// fill in per-request specifics
-		work.my_node = unique_nodes[i];
-		work.my_node_digest_count = unique_nodes_count[i];
-		work.index = i;
-		
-		// dispatch - copies data
-		cf_queue_push(asc->batch_q, &work);
+	for (int attempt = 0; batch_dispatch(asc, &work, &state); attempt++) {
+		if (attempt >= BATCH_MAX_RETRIES) {
+			break;
+		}
+
+		uint64_t now = cf_getms();
+		if (deadline_ms && now + BATCH_RETRY_SLEEP_MS >= deadline_ms) {
+			break;
+		}
+		usleep(BATCH_RETRY_SLEEP_MS * 1000);
+
+		table = as_cluster_get_partition_table(asc, ns);
+
+		for (int i = 0; i < n_digests; i++) {
+			if (! nodes[i]) {
+				continue;
+			}
+			// Re-sent keys always go to the master, in case a prole failed.
+			as_node_release(nodes[i]);
+			nodes[i] = as_partition_table_get_node(asc, table, &digests[i], true, -1);
+			if (! nodes[i]) {
+				state.results[i] = -1;
+			}
+		}
 	}
 	
-	// wait for the work to complete
+	// Report the final status of every key that never got a response.
 	int retval = 0;
-	for (int i=0;i<n_nodes;i++) {
-		work_complete wc;
-		cf_queue_pop(work.complete_q, &wc, CF_QUEUE_FOREVER);
-		if (wc.result != 0) {
-			as_log_error("Node %d retcode error: %d", i, wc.result);
-			// Find all the records we were looking for on this node.
-			for (int j = 0; j < n_digests; j++) {
-				if (nodes[j] == wc.my_node) {
-					as_log_error("   rec %d", j);
-					cb(ns, &work.digests[j], NULL, NULL, wc.result, 0, 0, NULL, 0, udata);
-				}
+	for (int i = 0; i < n_digests; i++) {
+		if (! state.done[i]) {
+			as_log_error("   rec %d: error %d", i, state.results[i]);
+			if (cb) {
+				cb(ns, &work.digests[i], NULL, NULL, state.results[i], 0, 0, NULL, 0, udata);
 			}
-			retval = wc.result;
+			retval = state.results[i];
 		}
 	}
 	
 	// free and return what needs freeing and putting
-	cf_queue_destroy(work.complete_q);
-	for (int i=0;i<n_digests;i++) {
-		as_node_release(nodes[i]);
+	if (work.complete_q) {
+		cf_queue_destroy(work.complete_q);
 	}
-	free(nodes);
+	batch_state_destroy(&state);
 	return retval;
 }
 
@@ -33,10 +33,12 @@
 #include <citrusleaf/cf_vector.h>
 
 #include <aerospike/as_aerospike.h>
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_module.h>
 #include <aerospike/as_msgpack.h>
 #include <aerospike/as_list.h>
 #include <aerospike/as_log_macros.h>
+#include <aerospike/as_lua_cache.h>
 #include <aerospike/as_record.h>
 #include <aerospike/as_serializer.h>
 #include <aerospike/as_string.h>
@@ -101,6 +103,7 @@ typedef struct {
 	cf_queue              * complete_q;
 	bool                    abort;
     as_val                * err_val;
+    const cl_query_udf    * reduce_udf;  // Set when each node's stream is reduced on the worker
 } cl_query_task;
 
 
@@ -437,14 +440,14 @@ static int query_compile(const cl_query * query, uint8_t ** buf_r, size_t * buf_
     // get a buffer to write to.
     uint8_t *buf; uint8_t *mbuf = 0;
     if ((*buf_r) && (msg_sz > *buf_sz_r)) { 
-        mbuf   = buf = malloc(msg_sz); if (!buf) return(-1);
+        mbuf   = buf = as_alloc_malloc(AS_ALLOC_TAG_QUERY, msg_sz); if (!buf) return(-1);
         *buf_r = buf;
     } else buf = *buf_r;
     *buf_sz_r  = msg_sz;
     memset(buf, 0, msg_sz);  // NOTE: this line is debug - shouldn't be required
 
     // write the headers
-    int info1      = CL_MSG_INFO1_READ;
+    int info1      = CL_MSG_INFO1_READ | (query->no_bins ? CL_MSG_INFO1_GET_NOBINDATA : 0);
     int info2      = 0;
     int info3      = 0;
     buf = cl_write_header(buf, msg_sz, info1, info2, info3, 0, 0, 0,
@@ -561,7 +564,7 @@ static int query_compile(const cl_query * query, uint8_t ** buf_r, size_t * buf_
 
     if (!buf) { 
         if (mbuf) {
-            free(mbuf); 
+            as_alloc_free(mbuf); 
         }
         as_buffer_destroy(&argbuffer);
         return AEROSPIKE_ERR_CLIENT;
@@ -687,7 +690,7 @@ int process_query_result(cl_msg *msg, cl_record *cl_rec, cl_query_task *task, in
 	record->ttl = cf_server_void_time_to_ttl(msg->record_ttl);
 	record->gen = msg->generation;
 
-	clbins_to_asrecord(cl_rec->bins, msg->n_ops, record);
+	clbins_to_asrecord(cl_rec->bins, msg->n_ops, record, true);
 
 	// TODO:
 	//      Fix the following block of code. It is really lame 
@@ -826,7 +829,7 @@ static int cl_query_worker_do(as_node * node, cl_query_task * task) {
         if (rd_buf_sz > 0) {
 
             if (rd_buf_sz > sizeof(rd_stack_buf)){
-                rd_buf = malloc(rd_buf_sz);
+                rd_buf = as_alloc_malloc(AS_ALLOC_TAG_QUERY, rd_buf_sz);
             }
             else {
                 rd_buf = rd_stack_buf;
@@ -836,7 +839,7 @@ static int cl_query_worker_do(as_node * node, cl_query_task * task) {
 
             if ( (rc = cf_socket_read_forever(fd, rd_buf, rd_buf_sz)) ) {
                 LOG("[ERROR] cl_query_worker_do: network error: errno %d fd %d\n", rc, fd);
-                if ( rd_buf != rd_stack_buf ) free(rd_buf);
+                if ( rd_buf != rd_stack_buf ) as_alloc_free(rd_buf);
                 return AEROSPIKE_ERR_CLIENT;
             }
         }
@@ -981,7 +984,7 @@ static int cl_query_worker_do(as_node * node, cl_query_task * task) {
 		}
 
         if (rd_buf && (rd_buf != rd_stack_buf))    {
-            free(rd_buf);
+            as_alloc_free(rd_buf);
             rd_buf = 0;
         }
 
@@ -1005,6 +1008,9 @@ Final:
     return rc;
 }
 
+static int cl_query_worker_reduce(as_node * node, cl_query_task * task);
+static int citrusleaf_query_foreach_callback_stream(as_val * v, void * udata);
+
 static void * cl_query_worker(void * pv_asc) {
 	as_cluster* asc = (as_cluster*)pv_asc;
 
@@ -1036,7 +1042,12 @@ static void * cl_query_worker(void * pv_asc) {
         as_node * node = as_node_get_by_name(task.asc, task.node_name);
         if ( node ) {
             LOG("[DEBUG] cl_query_worker: working\n");
-            rc_fail.rc = cl_query_worker_do(node, &task);
+            if ( task.reduce_udf ) {
+                rc_fail.rc = cl_query_worker_reduce(node, &task);
+            }
+            else {
+                rc_fail.rc = cl_query_worker_do(node, &task);
+            }
 			as_node_release(node);
         }
         if (task.err_val) {
@@ -1109,6 +1120,21 @@ static as_stream * callback_stream_init(as_stream * stream, callback_stream_sour
     return stream;
 }
 
+// Forwards per-node partial reduce results into the shared result stream.
+// The end of a node's results is not the end of the query, so it is dropped.
+static as_stream_status partial_stream_write(const as_stream * s, as_val * val) {
+    if ( val == NULL ) {
+        return AS_STREAM_OK;
+    }
+    return as_stream_write((as_stream *) as_stream_source(s), val);
+}
+
+static const as_stream_hooks partial_stream_hooks = {
+    .destroy  = callback_stream_destroy,
+    .read     = NULL,
+    .write    = partial_stream_write
+};
+
 
 
 static cl_rv cl_query_udf_init(cl_query_udf * udf, cl_query_udf_type type, const char * filename, const char * function, as_list * arglist) {
@@ -1169,6 +1195,99 @@ static const as_aerospike_hooks query_aerospike_hooks = {
     .log = query_aerospike_log,
 };
 
+static as_aerospike query_aerospike;
+static pthread_once_t query_aerospike_once = PTHREAD_ONCE_INIT;
+
+static void query_aerospike_init(void) {
+    as_aerospike_init(&query_aerospike, NULL, &query_aerospike_hooks);
+}
+
+// Build the error value returned for a failed client-side stream UDF.
+static as_val * query_udf_error(int ret, as_result * res) {
+    char *rs = as_module_err_string(ret);
+    as_val * vp = NULL;
+    if (res->value != NULL) {
+        switch (as_val_type(res->value)) {
+            case AS_STRING: {
+                as_string * lua_s   = as_string_fromval(res->value);
+                char *      lua_err  = (char *) as_string_tostring(lua_s);
+                if (lua_err != NULL) {
+                    int l_rs_len = (int)strlen(rs);
+                    rs = cf_realloc(rs,l_rs_len + strlen(lua_err) + 4);
+                    sprintf(&rs[l_rs_len]," : %s",lua_err);
+                }
+                vp = (as_val *) as_string_new(rs, true);
+                break;
+                }    
+            default:
+                LOG("[WARNING] unknown stack as_val type\n");
+                break;
+        }    
+    }    
+    if (vp == NULL) {
+        cf_free(rs);
+    }
+    return vp;
+}
+
+/*
+ * Run the node query into a private stream, then apply the stream UDF to it on
+ * this worker thread. Only the node's partial result reaches the shared stream,
+ * which is merged by the final reduce in citrusleaf_query_foreach().
+ */
+static int cl_query_worker_reduce(as_node * node, cl_query_task * task) {
+
+    cf_queue * node_q = cf_queue_create(sizeof(void *), true);
+
+    as_stream node_stream;
+    as_stream_init(&node_stream, node_q, &queue_stream_hooks);
+
+    cl_query_task node_task = *task;
+    node_task.udata = &node_stream;
+    node_task.callback = citrusleaf_query_foreach_callback_stream;
+
+    int rc = cl_query_worker_do(node, &node_task);
+    task->err_val = node_task.err_val;
+
+    if ( rc == AEROSPIKE_OK ) {
+        as_stream_write(&node_stream, AS_STREAM_END);
+
+        pthread_once(&query_aerospike_once, query_aerospike_init);
+
+        as_udf_context ctx = {
+            .as = &query_aerospike,
+            .timer = NULL,
+            .memtracker = NULL
+        };
+
+        as_stream ostream;
+        as_stream_init(&ostream, task->udata, &partial_stream_hooks);
+
+        as_result res;
+        as_result_init(&res);
+        uint32_t ticket = as_lua_cache_reserve(task->reduce_udf->filename);
+        int ret = as_module_apply_stream(&mod_lua, &ctx, task->reduce_udf->filename, task->reduce_udf->function, &node_stream, task->reduce_udf->arglist, &ostream, &res);
+        as_lua_cache_release(task->reduce_udf->filename, ticket);
+
+        if ( ret != 0 ) {
+            rc = AEROSPIKE_ERR_UDF;
+            task->err_val = query_udf_error(ret, &res);
+        }
+        as_result_destroy(&res);
+    }
+
+    // Values read by the UDF were pushed back onto the queue, so free them here.
+    as_val * val = NULL;
+    while (CF_QUEUE_OK == cf_queue_pop(node_q, &val, CF_QUEUE_NOWAIT)) {
+        if ( val ) {
+            as_val_destroy(val);
+        }
+        val = NULL;
+    }
+    cf_queue_destroy(node_q);
+    return rc;
+}
+
 
 static cl_rv cl_query_execute(as_cluster * cluster, const cl_query * query, void * udata, int (* callback)(as_val *, void *), as_val ** err_val) {
 
@@ -1194,9 +1313,14 @@ static cl_rv cl_query_execute(as_cluster * cluster, const cl_query * query, void
         .udata              = udata,
         .callback           = callback,
 		.abort              = false,
-        .err_val            = NULL
+        .err_val            = NULL,
+        .reduce_udf         = NULL
     };
 
+    if ( query->parallel_reduce && query->udf.type == AS_UDF_CALLTYPE_STREAM ) {
+        task.reduce_udf = &query->udf;
+    }
+
     char *node_names    = NULL;    
     int   node_count    = 0;
 
@@ -1242,7 +1366,7 @@ static cl_rv cl_query_execute(as_cluster * cluster, const cl_query * query, void
     }
 
     if ( wr_buf && (wr_buf != wr_stack_buf) ) { 
-        free(wr_buf); 
+        as_alloc_free(wr_buf); 
         wr_buf = 0;
     }
 
@@ -1481,9 +1605,7 @@ cl_rv citrusleaf_query_foreach(as_cluster * cluster, const cl_query * query, voi
     if ( query->udf.type == AS_UDF_CALLTYPE_STREAM ) {
 
         // Setup as_aerospike, so we can get log() function.
-        // TODO: this should occur only once
-        as_aerospike as;
-        as_aerospike_init(&as, NULL, &query_aerospike_hooks);
+        pthread_once(&query_aerospike_once, query_aerospike_init);
 
         // stream for results from each node
         as_stream queue_stream;
@@ -1500,7 +1622,7 @@ cl_rv citrusleaf_query_foreach(as_cluster * cluster, const cl_query * query, voi
         if ( rc == AEROSPIKE_OK ) {
 
         	as_udf_context ctx = {
-        		.as = &as,
+        		.as = &query_aerospike,
         		.timer = NULL,
         		.memtracker = NULL
         	};
@@ -1508,29 +1630,12 @@ cl_rv citrusleaf_query_foreach(as_cluster * cluster, const cl_query * query, voi
             // Apply the UDF to the result stream
             as_result   res;
             as_result_init(&res);
+            uint32_t ticket = as_lua_cache_reserve(query->udf.filename);
             int ret = as_module_apply_stream(&mod_lua, &ctx, query->udf.filename, query->udf.function, &queue_stream, query->udf.arglist, &ostream, &res); //
+            as_lua_cache_release(query->udf.filename, ticket);
             if (ret != 0 && err_val) { 
                 rc = AEROSPIKE_ERR_UDF;
-                char *rs = as_module_err_string(ret);
-                as_val * vp = NULL;
-                if (res.value != NULL) {
-                    switch (as_val_type(res.value)) {
-                        case AS_STRING: {
-                            as_string * lua_s   = as_string_fromval(res.value);
-                            char *      lua_err  = (char *) as_string_tostring(lua_s);
-                            if (lua_err != NULL) {
-                                int l_rs_len = (int)strlen(rs);
-                                rs = cf_realloc(rs,l_rs_len + strlen(lua_err) + 4);
-                                sprintf(&rs[l_rs_len]," : %s",lua_err);
-                            }
-                            vp = (as_val *) as_string_new(rs, true);
-                            break;
-                            }    
-                        default:
-                            LOG("[WARNING] unknown stack as_val type\n");
-                            break;
-                    }    
-                }    
+                as_val * vp = query_udf_error(ret, &res);
                 if (vp != NULL) {
                     *err_val = vp;
                 }    
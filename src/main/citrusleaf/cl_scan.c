@@ -25,9 +25,11 @@
 #include <zlib.h>
 #include <time.h> // for job ID
 
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_log_macros.h>
+#include <aerospike/as_scan_throttle.h>
 
 #include <citrusleaf/cf_atomic.h>
 #include <citrusleaf/cf_byte_order.h>
@@ -139,7 +141,7 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 		return(-1);
 	}
 	if (wr_buf != wr_stack_buf) {
-		free(wr_buf);
+		as_alloc_free(wr_buf);
 		wr_buf = 0;
 	}
 
@@ -182,7 +184,7 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 //            as_log_debug("message read: size %u",(uint)proto.sz);
 
 			if (rd_buf_sz > sizeof(rd_stack_buf))
-				rd_buf = malloc(rd_buf_sz);
+				rd_buf = as_alloc_malloc(AS_ALLOC_TAG_SCAN, rd_buf_sz);
 			else
 				rd_buf = rd_stack_buf;
 			if (rd_buf == NULL) {
@@ -193,7 +195,7 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 
 			if ((rv = cf_socket_read_forever(fd, rd_buf, rd_buf_sz))) {
 				as_log_error("network error: errno %d fd %d", rv, fd);
-				if (rd_buf != rd_stack_buf)	{ free(rd_buf); }
+				if (rd_buf != rd_stack_buf)	{ as_alloc_free(rd_buf); }
 				cf_close(fd);
 				as_node_release(node);
 				return(-1);
@@ -209,6 +211,7 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 		uint pos = 0;
 		cl_bin stack_bins[STACK_BINS];
 		cl_bin *bins_local;
+		uint32_t n_records = 0;
 		
 		while (pos < rd_buf_sz) {
 
@@ -311,7 +314,14 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 				dump_buf("individual op (host order)", (uint8_t *) op, op->op_sz + sizeof(uint32_t));
 #endif	
 
-				cl_set_value_particular(op, &bins_local[i]);
+				if (scan_opt && scan_opt->columns) {
+					// Decode straight from the read buffer - no cl_bin copies.
+					as_columns_builder_bin(scan_opt->columns, op->name, op->name_sz, op->particle_type,
+							cl_msg_op_get_value_p(op), cl_msg_op_get_value_sz(op));
+				}
+				else {
+					cl_set_value_particular(op, &bins_local[i]);
+				}
 				op = cl_msg_op_get_next(op);
 			}
 			buf = (uint8_t *) op;
@@ -331,9 +341,15 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 			}
 			else if ((msg->n_ops) || (operation_info & CL_MSG_INFO1_GET_NOBINDATA)) {
 				// got one good value? call it a success!
-				rv = (*cb)(ns_ret, keyd, set_ret, &key, CL_RESULT_OK, msg->generation,
-						cf_server_void_time_to_ttl(msg->record_ttl), bins_local,
-						msg->n_ops, udata);
+				if (scan_opt && scan_opt->columns) {
+					rv = as_columns_builder_row(scan_opt->columns);
+				}
+				else {
+					rv = (*cb)(ns_ret, keyd, set_ret, &key, CL_RESULT_OK, msg->generation,
+							cf_server_void_time_to_ttl(msg->record_ttl), bins_local,
+							msg->n_ops, udata);
+				}
+				n_records++;
 				// To be cleaned up.   
 				if (rv) {
 
@@ -343,7 +359,7 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 					}
 
 					if (rd_buf && (rd_buf != rd_stack_buf))	{
-						free(rd_buf);
+						as_alloc_free(rd_buf);
 						rd_buf = 0;
 					}
 
@@ -371,7 +387,7 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 		}
 		
 		if (rd_buf && (rd_buf != rd_stack_buf))	{
-			free(rd_buf);
+			as_alloc_free(rd_buf);
 			rd_buf = 0;
 		}
 		
@@ -382,6 +398,12 @@ do_scan_monte(as_cluster *asc, char *node_name, uint operation_info, uint operat
 			return (rv);
 		}
 
+		// Don't read more until the throttle allows it - the server is then
+		// slowed by TCP back-pressure.
+		if (scan_opt && scan_opt->throttle && ! done) {
+			as_scan_throttle_consume(scan_opt->throttle, n_records, (uint32_t)rd_buf_sz);
+		}
+
 	} while ( done == false );
 
 	as_node_put_connection(node, fd);
@@ -460,7 +482,7 @@ scan_node_worker(void *udata)
 
 	// Free only the overall scan definition structure. We cannot free the 
 	// fixed component because it is shared by the threads
-	free(wd);
+	as_alloc_free(wd);
 	return NULL;
 }
 
@@ -490,7 +512,7 @@ citrusleaf_scan_all_nodes (as_cluster *asc, char *ns, char *set, cl_bin *bins, i
 		char *nptr = node_names;
 
 		// Setup the fixed component of the scan definition which is common for all threads
-		scan_node_worker_fixed_def *fd = (scan_node_worker_fixed_def *)malloc(sizeof(scan_node_worker_fixed_def));
+		scan_node_worker_fixed_def *fd = as_alloc_malloc(AS_ALLOC_TAG_SCAN, sizeof(scan_node_worker_fixed_def));
 		fd->asc = asc;
 		fd->ns = ns;
 		fd->set = set;
@@ -506,13 +528,13 @@ citrusleaf_scan_all_nodes (as_cluster *asc, char *ns, char *set, cl_bin *bins, i
 		// Spawn one thread for each of the nodes in the cluster.
 		// Duplicate the scan definition and send to each worker thread.
 		for (int i=0; i<n_nodes; i++) {
-			scan_node_worker_scandef *wd = (scan_node_worker_scandef *)malloc(sizeof(scan_node_worker_scandef));
+			scan_node_worker_scandef *wd = as_alloc_malloc(AS_ALLOC_TAG_SCAN, sizeof(scan_node_worker_scandef));
 			wd->fd = fd;
 			wd->nptr = nptr;
 			if (pthread_create(&node_pthreads[i], 0, scan_node_worker, wd) != 0) {
 				as_log_error("citrusleaf scan all nodes: Failed to create worker thread to scan nodes in parallel");
-				free(fd);
-				free(wd);
+				as_alloc_free(fd);
+				as_alloc_free(wd);
 				free(node_names);
 				return NULL;
 			}
@@ -526,7 +548,7 @@ citrusleaf_scan_all_nodes (as_cluster *asc, char *ns, char *set, cl_bin *bins, i
 		}
 
 		// Once all the threads are done, we can free up the fixed definition part.
-		free(fd);
+		as_alloc_free(fd);
 	} else {
 		char *nptr = node_names;
 		for (int i=0;i< n_nodes; i++) {
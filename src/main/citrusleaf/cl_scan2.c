@@ -33,9 +33,11 @@
 #include <citrusleaf/cf_proto.h>
 
 #include <aerospike/as_aerospike.h>
+#include <aerospike/as_allocator.h>
 #include <aerospike/as_list.h>
 #include <aerospike/as_module.h>
 #include <aerospike/as_msgpack.h>
+#include <aerospike/as_scan_throttle.h>
 #include <aerospike/as_serializer.h>
 #include <aerospike/as_string.h>
 
@@ -92,6 +94,7 @@ typedef struct {
     int                     (* callback)(as_val *, void *);
 	uint64_t 				job_id;
 	udf_execution_type		type;
+	as_scan_throttle      * throttle;
 	cf_queue              * complete_q;
 } cl_scan_task;
 
@@ -264,7 +267,7 @@ static int cl_scan_worker_do(as_node * node, cl_scan_task * task) {
         if (rd_buf_sz > 0) {
 
             if (rd_buf_sz > sizeof(rd_stack_buf)){
-                rd_buf = malloc(rd_buf_sz);
+                rd_buf = as_alloc_malloc(AS_ALLOC_TAG_SCAN, rd_buf_sz);
             }
             else {
                 rd_buf = rd_stack_buf;
@@ -277,7 +280,7 @@ static int cl_scan_worker_do(as_node * node, cl_scan_task * task) {
 
             if ( (rc = cf_socket_read_forever(fd, rd_buf, rd_buf_sz)) ) {
                 LOG("[ERROR] cl_scan_worker_do: network error: errno %d fd %d node name %s\n", rc, fd, node->name);
-                if ( rd_buf != rd_stack_buf ) free(rd_buf);
+                if ( rd_buf != rd_stack_buf ) as_alloc_free(rd_buf);
                 cf_close(fd);
                 return AEROSPIKE_ERR_CLIENT;
             }
@@ -288,6 +291,7 @@ static int cl_scan_worker_do(as_node * node, cl_scan_task * task) {
         uint        pos = 0;
         cl_bin      stack_bins[STACK_BINS];
         cl_bin *    bins;
+        uint32_t    n_records = 0;
 
         while (pos < rd_buf_sz) {
 
@@ -410,6 +414,7 @@ static int cl_scan_worker_do(as_node * node, cl_scan_task * task) {
 
                 }
 
+                n_records++;
                 rc = AEROSPIKE_OK;
             }
 
@@ -434,10 +439,16 @@ static int cl_scan_worker_do(as_node * node, cl_scan_task * task) {
         }
 
         if (rd_buf && (rd_buf != rd_stack_buf))    {
-            free(rd_buf);
+            as_alloc_free(rd_buf);
             rd_buf = 0;
         }
 
+        // Don't read more until the throttle allows it - the server is then
+        // slowed by TCP back-pressure.
+        if (task->throttle && ! done) {
+            as_scan_throttle_consume(task->throttle, n_records, (uint32_t) rd_buf_sz);
+        }
+
     } while ( done == false );
     as_node_put_connection(node, fd);
 
@@ -500,6 +511,7 @@ cl_rv cl_scan_params_init(cl_scan_params * oparams, cl_scan_params *iparams) {
     oparams->priority = iparams ? iparams->priority : CL_SCAN_PRIORITY_AUTO;
     //    oparams->threads_per_node = iparams ? iparams->threads_per_node : 1;
     oparams->pct = iparams ? iparams->pct : 100;
+    oparams->throttle = iparams ? iparams->throttle : NULL;
     return AEROSPIKE_OK;
 }
 
@@ -619,6 +631,7 @@ cf_vector * cl_scan_execute(as_cluster * cluster, const cl_scan * scan, char * n
         .callback           = callback,
         .job_id                = scan->job_id,
         .type                = scan->udf.type,
+        .throttle            = scan->params.throttle,
     };
 
     task.complete_q      = cf_queue_create(sizeof(cl_node_response), true);
@@ -667,7 +680,7 @@ cf_vector * cl_scan_execute(as_cluster * cluster, const cl_scan * scan, char * n
 
 Cleanup:
     if ( wr_buf && (wr_buf != wr_stack_buf) ) { 
-        free(wr_buf); 
+        as_alloc_free(wr_buf); 
         wr_buf = 0;
     }
     cf_queue_destroy(task.complete_q);
@@ -145,7 +145,35 @@ int cl_do_async_monte(as_cluster *asc, int info1, int info2, const char *ns, con
 int do_the_full_monte(as_cluster *asc, int info1, int info2, int info3, const char *ns, const char *set, const cl_object *key,
 	const cf_digest *digest, cl_bin **values, cl_operator operator, cl_operation **operations, int *n_values, 
 	uint32_t *cl_gen, const cl_write_parameters *cl_w_p, uint64_t *trid, char **setname_r, as_call * call, uint32_t* cl_ttl,
-	as_policy_replica replica);
+	as_policy_replica replica, as_key_route *route);
+
+// Key based requests that use and refresh the routing hints of a key. The
+// public citrusleaf_* calls are the same requests with no hints.
+cl_rv citrusleaf_get_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key, const cf_digest *d,
+	cl_bin *bins, int n_bins, int timeout_ms, uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level,
+	as_policy_replica replica, as_key_route *route);
+
+cl_rv citrusleaf_get_all_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key, const cf_digest *d,
+	cl_bin **bins, int *n_bins, int timeout_ms, uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level,
+	as_policy_replica replica, as_key_route *route);
+
+cl_rv citrusleaf_exists_key_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key, const cf_digest *d,
+	cl_bin *bins, int n_bins, int timeout_ms, uint32_t *cl_gen, uint32_t* cl_ttl, int consistency_level,
+	as_policy_replica replica, as_key_route *route);
+
+cl_rv citrusleaf_put_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key, const cf_digest *d,
+	const cl_bin *bins, int n_bins, const cl_write_parameters *cl_w_p, int commit_level, as_key_route *route);
+
+cl_rv citrusleaf_delete_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key, const cf_digest *d,
+	const cl_write_parameters *cl_w_p, int commit_level, as_key_route *route);
+
+cl_rv citrusleaf_operate_route(as_cluster *asc, const char *ns, const char *set, const cl_object *key, cf_digest *d,
+	cl_bin **values, cl_operation *operations, int *n_values, const cl_write_parameters *cl_w_p, uint32_t *generation,
+	uint32_t* ttl, int consistency_level, int commit_level, as_policy_replica replica, as_key_route *route);
+
+cl_rv citrusleaf_operate_template_route(as_cluster *asc, const cl_operate_template *tmpl, const char *ns, const char *set,
+	const cl_object *key, cf_digest *d, cl_object *objects, cl_bin **values, int *n_values,
+	const cl_write_parameters *cl_w_p, uint32_t *generation, uint32_t* ttl, as_policy_replica replica, as_key_route *route);
 
 int cl_compile(uint info1, uint info2, uint info3, const char *ns, const char *set, const cl_object *key, const cf_digest *digest,
 	cl_bin *values, cl_operator operator, cl_operation *operations, int n_values,  
@@ -30,7 +30,12 @@
 #include <aerospike/as_map.h>
 #include <aerospike/as_hashmap.h>
 #include <aerospike/as_val.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_node.h>
+#include <citrusleaf/cf_queue.h>
 #include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include "../test.h"
@@ -96,6 +101,74 @@ bool batch_get_1_callback(const as_batch_read * results, uint32_t n, void * udat
     return true;
 }
 
+bool batch_get_raw_list_callback(const as_batch_read * results, uint32_t n, void * udata)
+{
+    batch_read_data * data = (batch_read_data *) udata;
+
+    data->total = n;
+
+    for (uint32_t i = 0; i < n; i++) {
+
+        if (results[i].result != AEROSPIKE_OK) {
+            data->errors++;
+            data->last_error = results[i].result;
+            continue;
+        }
+        data->found++;
+
+        // Every slot, including the copies of a duplicate key, keeps the
+        // raw list type.
+        as_bytes * b = as_record_get_bytes(&results[i].record, "l");
+        if ( !b || as_bytes_get_type(b) != AS_BYTES_LIST ) {
+            warn("slot(%d) is not a raw list", i);
+            data->errors++;
+            data->last_error = -2;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Replace the pooled connections of every node with one whose reply is not a
+ * valid proto header, so the first request to each node fails with a network
+ * error. Returns the number of peer sockets, which the caller closes.
+ */
+static int batch_break_connections(int * peers, int max)
+{
+    as_nodes * nodes = as_nodes_reserve(as->cluster);
+    int n = 0;
+
+    for (uint32_t i = 0; i < nodes->size && n < max; i++) {
+        as_node * node = nodes->array[i];
+        int fd;
+
+        for (uint32_t q = 0; q < node->conn_qs_size; q++) {
+            while (cf_queue_pop(node->conn_qs[q], &fd, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+                close(fd);
+            }
+        }
+
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+            break;
+        }
+
+        uint8_t garbage[8];
+        memset(garbage, 0xff, sizeof(garbage));
+        if (write(sv[1], garbage, sizeof(garbage)) != sizeof(garbage)) {
+            close(sv[0]);
+            close(sv[1]);
+            break;
+        }
+
+        as_node_put_connection(node, sv[0]);
+        peers[n++] = sv[1];
+    }
+
+    as_nodes_release(nodes);
+    return n;
+}
 
 /******************************************************************************
  * TEST CASES
@@ -148,6 +221,165 @@ TEST( batch_get_1 , "Simple" )
     assert_int_eq( data.errors , 0 );
 }
 
+TEST( batch_get_replica_any , "Spread across replicas" )
+{
+    as_error err;
+
+    as_batch batch;
+    as_batch_inita(&batch, N_KEYS);
+
+    for (uint32_t i = 0; i < N_KEYS; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, i+1);
+    }
+
+    as_policy_batch policy;
+    as_policy_batch_init(&policy);
+    policy.replica = AS_POLICY_REPLICA_ANY;
+
+    batch_read_data data = {0};
+
+    aerospike_batch_get(as, &err, &policy, &batch, batch_get_1_callback, &data);
+    if ( err.code != AEROSPIKE_OK ) {
+        info("error(%d): %s", err.code, err.message);
+    }
+    assert_int_eq( err.code , AEROSPIKE_OK );
+
+    assert_int_eq( data.found , N_KEYS );
+    assert_int_eq( data.errors , 0 );
+}
+
+TEST( batch_get_small , "Small batch" )
+{
+    as_error err;
+
+    as_batch batch;
+    as_batch_inita(&batch, 3);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, i+1);
+    }
+
+    batch_read_data data = {0};
+
+    aerospike_batch_get(as, &err, NULL, &batch, batch_get_1_callback, &data);
+    if ( err.code != AEROSPIKE_OK ) {
+        info("error(%d): %s", err.code, err.message);
+    }
+    assert_int_eq( err.code , AEROSPIKE_OK );
+
+    assert_int_eq( data.found , 3 );
+    assert_int_eq( data.errors , 0 );
+}
+
+TEST( batch_get_duplicates , "Duplicate keys" )
+{
+    as_error err;
+
+    int64_t keys[] = {1, 2, 1, 3, 1, 2};
+    uint32_t n_keys = sizeof(keys) / sizeof(keys[0]);
+
+    as_batch batch;
+    as_batch_inita(&batch, n_keys);
+
+    for (uint32_t i = 0; i < n_keys; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, keys[i]);
+    }
+
+    batch_read_data data = {0};
+
+    aerospike_batch_get(as, &err, NULL, &batch, batch_get_1_callback, &data);
+    if ( err.code != AEROSPIKE_OK ) {
+        info("error(%d): %s", err.code, err.message);
+    }
+    assert_int_eq( err.code , AEROSPIKE_OK );
+
+    assert_int_eq( data.found , n_keys );
+    assert_int_eq( data.errors , 0 );
+}
+
+TEST( batch_get_duplicates_raw , "Duplicate keys with a raw list bin" )
+{
+    as_error err;
+
+    as_key key;
+    as_key_init_int64(&key, NAMESPACE, SET, N_KEYS + 1);
+
+    as_arraylist list;
+    as_arraylist_init(&list, 3, 0);
+    as_arraylist_append_int64(&list, 1);
+    as_arraylist_append_int64(&list, 2);
+    as_arraylist_append_int64(&list, 3);
+
+    as_record rec;
+    as_record_inita(&rec, 1);
+    as_record_set_list(&rec, "l", (as_list *) &list);
+
+    aerospike_key_put(as, &err, NULL, &key, &rec);
+    as_record_destroy(&rec);
+    assert_int_eq( err.code , AEROSPIKE_OK );
+
+    uint32_t n_keys = 3;
+
+    as_batch batch;
+    as_batch_inita(&batch, n_keys);
+
+    for (uint32_t i = 0; i < n_keys; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, N_KEYS + 1);
+    }
+
+    as_policy_batch policy;
+    as_policy_batch_init(&policy);
+    policy.deserialize = false;
+
+    batch_read_data data = {0};
+
+    aerospike_batch_get(as, &err, &policy, &batch, batch_get_raw_list_callback, &data);
+    if ( err.code != AEROSPIKE_OK ) {
+        info("error(%d): %s", err.code, err.message);
+    }
+
+    as_error err2;
+    aerospike_key_remove(as, &err2, NULL, &key);
+
+    assert_int_eq( err.code , AEROSPIKE_OK );
+    assert_int_eq( data.found , n_keys );
+    assert_int_eq( data.errors , 0 );
+}
+
+TEST( batch_get_retry , "Keys of a failed node are sent again" )
+{
+    as_error err;
+
+    as_batch batch;
+    as_batch_inita(&batch, N_KEYS);
+
+    for (uint32_t i = 0; i < N_KEYS; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, i+1);
+    }
+
+    int peers[64];
+    int n_peers = batch_break_connections(peers, 64);
+
+    batch_read_data data = {0};
+
+    aerospike_batch_get(as, &err, NULL, &batch, batch_get_1_callback, &data);
+
+    for (int i = 0; i < n_peers; i++) {
+        close(peers[i]);
+    }
+
+    if ( err.code != AEROSPIKE_OK ) {
+        info("error(%d): %s", err.code, err.message);
+    }
+    assert_int_ne( n_peers , 0 );
+    assert_int_eq( err.code , AEROSPIKE_OK );
+
+    // Every key is reported once, after the retry.
+    assert_int_eq( data.total , N_KEYS );
+    assert_int_eq( data.found , N_KEYS );
+    assert_int_eq( data.errors , 0 );
+}
+
 TEST( batch_get_post , "Post: Remove Records" )
 {
     as_error err;
@@ -229,6 +461,11 @@ TEST( multithreaded_batch_get , "Batch Get - with multiple threads ")
 SUITE( batch_get, "aerospike_batch_get tests" ) {
     suite_add( batch_get_pre );
     suite_add( batch_get_1 );
+    suite_add( batch_get_replica_any );
+    suite_add( batch_get_small );
+    suite_add( batch_get_duplicates );
+    suite_add( batch_get_duplicates_raw );
+    suite_add( batch_get_retry );
     suite_add( multithreaded_batch_get );
     suite_add( batch_get_post );
 }
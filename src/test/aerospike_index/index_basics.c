@@ -29,6 +29,8 @@
 #include <aerospike/as_hashmap.h>
 #include <aerospike/as_val.h>
 
+#include <unistd.h>
+
 #include "../test.h"
 
 /******************************************************************************
@@ -46,6 +48,11 @@ extern aerospike * as;
  * STATIC FUNCTIONS
  *****************************************************************************/
 
+static void
+index_done_listener(as_status status, void * udata)
+{
+	*(as_status *) udata = status;
+}
 
 /******************************************************************************
  * TEST CASES
@@ -78,6 +85,37 @@ TEST( index_basics_drop , "Drop index" ) {
 
 }
 
+TEST( index_basics_watch , "Wait and listen on concurrent index builds" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_index_task task1;
+	as_index_task task2;
+
+	as_status status = aerospike_index_create(as, &err, &task1, NULL, "test", "test", "watch_bin1", "idx_test_watch_bin1", AS_INDEX_NUMERIC);
+	assert_int_eq( status , AEROSPIKE_OK );
+
+	status = aerospike_index_create(as, &err, &task2, NULL, "test", "test", "watch_bin2", "idx_test_watch_bin2", AS_INDEX_STRING);
+	assert_int_eq( status , AEROSPIKE_OK );
+
+	volatile as_status listened = AEROSPIKE_ERR;
+	status = aerospike_index_create_listen(&err, &task1, 100, index_done_listener, (void *) &listened);
+	assert_int_eq( status , AEROSPIKE_OK );
+
+	status = aerospike_index_create_wait(&err, &task2, 100);
+	assert_int_eq( status , AEROSPIKE_OK );
+	assert_true( task2.done );
+
+	// Both jobs are polled in the same sweep, so the listener should follow shortly.
+	for (int i = 0; i < 50 && listened != AEROSPIKE_OK; i++) {
+		usleep(100 * 1000);
+	}
+	assert_int_eq( listened , AEROSPIKE_OK );
+
+	aerospike_index_remove(as, &err, NULL, "test", "idx_test_watch_bin1");
+	aerospike_index_remove(as, &err, NULL, "test", "idx_test_watch_bin2");
+}
 
 /******************************************************************************
  * TEST SUITE
@@ -86,4 +124,5 @@ TEST( index_basics_drop , "Drop index" ) {
 SUITE( index_basics, "aerospike_sindex basic tests" ) {
     suite_add( index_basics_create );
     suite_add( index_basics_drop );
+    suite_add( index_basics_watch );
 }
@@ -17,7 +17,9 @@
 #include <aerospike/aerospike.h>
 #include <aerospike/aerospike_info.h>
 
+#include <aerospike/as_cluster.h>
 #include <aerospike/as_node.h>
+#include <aerospike/as_partition.h>
 #include <aerospike/as_error.h>
 #include <aerospike/as_status.h>
 
@@ -30,6 +32,8 @@
 #include <aerospike/as_hashmap.h>
 #include <aerospike/as_val.h>
 
+#include <unistd.h>
+
 #include "../test.h"
 #include "../aerospike_test.h"
 
@@ -144,6 +148,55 @@ TEST( info_basics_features , "features" ) {
 	res = NULL;
 }
 
+TEST( info_basics_replicas , "tend: replicas received with the node status" ) {
+
+	as_cluster * cluster = as->cluster;
+
+	// Pretend the partition generation changed on the last tend of every
+	// node, so the next tend asks for the replicas with the status.
+	as_nodes * nodes = as_nodes_reserve(cluster);
+	assert_int_ne( nodes->size, 0 );
+
+	for ( uint32_t i = 0; i < nodes->size; i++ ) {
+		nodes->array[i]->partitions_changed = true;
+	}
+
+	// The generation did not change, so the replicas are dropped and the
+	// flag clears after one tend.
+	uint32_t changed = nodes->size;
+
+	for ( int tends = 0; tends < 5 && changed; tends++ ) {
+		usleep(cluster->tend_interval * 1000);
+		changed = 0;
+
+		for ( uint32_t i = 0; i < nodes->size; i++ ) {
+			if ( nodes->array[i]->partitions_changed ) {
+				changed++;
+			}
+		}
+	}
+
+	for ( uint32_t i = 0; i < nodes->size; i++ ) {
+		as_node * node = nodes->array[i];
+
+		// Info responses are read into a per-node buffer grown in 16K steps.
+		assert_not_null( node->info_buffer );
+		assert_int_ne( node->info_buffer_size, 0 );
+		assert_int_eq( node->info_buffer_size % (16 * 1024), 0 );
+	}
+	as_nodes_release(nodes);
+
+	assert_int_eq( changed, 0 );
+
+	// Every partition is still mapped to a master.
+	as_partition_table * table = as_cluster_get_partition_table(cluster, "test");
+	assert_not_null( table );
+
+	for ( uint32_t i = 0; i < table->size; i++ ) {
+		assert_not_null( table->partitions[i].master );
+	}
+}
+
 /******************************************************************************
  * TEST SUITE
  *****************************************************************************/
@@ -151,4 +204,5 @@ TEST( info_basics_features , "features" ) {
 SUITE( info_basics, "aerospike_info basic tests" ) {
 	suite_add( info_basics_help );
 	suite_add( info_basics_features );
+	suite_add( info_basics_replicas );
 }
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_socket_profile.h>
+
+#include <citrusleaf/cf_queue.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NODE_POOLS 4
+#define NODE_CONNS 8
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+// A node of a cluster which is never tended, so its pools only hold the
+// socket pairs put by the test. Nothing listens on port 1, so a connection
+// the pools can't supply fails instead of reaching a server.
+static as_node * node_create(as_cluster * cluster)
+{
+	memset(cluster, 0, sizeof(as_cluster));
+	cluster->conn_queue_size = NODE_CONNS;
+	cluster->conn_pools_per_node = NODE_POOLS;
+	cluster->conn_timeout_ms = 100;
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(1);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	return as_node_create(cluster, "BB9000000000000", &addr);
+}
+
+static uint64_t node_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t node_cached(as_node * node)
+{
+	uint32_t n = 0;
+
+	for ( uint32_t i = 0; i < node->conn_qs_size; i++ ) {
+		n += cf_queue_sz(node->conn_qs[i]);
+	}
+	return n;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( info_node_pools_spill , "connection pools: a full pool spills to the others" ) {
+
+	as_cluster cluster;
+	as_node * node = node_create(&cluster);
+	assert_not_null( node );
+	assert_int_eq( node->conn_qs_size, NODE_POOLS );
+	assert_int_eq( node->conn_q_limit, NODE_CONNS / NODE_POOLS );
+
+	int peers[NODE_CONNS + 1];
+
+	for ( int i = 0; i < NODE_CONNS + 1; i++ ) {
+		int sv[2];
+		assert_int_eq( socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0 );
+		as_node_put_connection(node, sv[0]);
+		peers[i] = sv[1];
+	}
+
+	// All pools together still cache conn_queue_size connections.
+	assert_int_eq( node_cached(node), NODE_CONNS );
+
+	for ( uint32_t i = 0; i < node->conn_qs_size; i++ ) {
+		assert_int_eq( (uint32_t)cf_queue_sz(node->conn_qs[i]), node->conn_q_limit );
+	}
+
+	// The connection beyond that was closed.
+	char c;
+	ssize_t rv = recv(peers[NODE_CONNS], &c, 1, MSG_DONTWAIT);
+
+	for ( int i = 0; i < NODE_CONNS + 1; i++ ) {
+		close(peers[i]);
+	}
+	as_node_destroy(node);
+
+	assert_int_eq( rv, 0 );
+}
+
+TEST( info_node_pools_steal , "connection pools: an empty pool steals from the others" ) {
+
+	as_cluster cluster;
+	as_node * node = node_create(&cluster);
+	assert_not_null( node );
+
+	int fds[NODE_CONNS];
+	int peers[NODE_CONNS];
+
+	for ( int i = 0; i < NODE_CONNS; i++ ) {
+		int sv[2];
+		assert_int_eq( socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0 );
+		as_node_put_connection(node, sv[0]);
+		fds[i] = sv[0];
+		peers[i] = sv[1];
+	}
+
+	// This thread's pool holds at most conn_q_limit connections. The rest
+	// must come from other pools rather than new sockets.
+	int taken[NODE_CONNS];
+	uint32_t n_taken = 0;
+	uint32_t pooled = 0;
+
+	while ( n_taken < NODE_CONNS ) {
+		int fd = -1;
+
+		if ( as_node_get_connection(node, &fd) != 0 ) {
+			break;
+		}
+		taken[n_taken++] = fd;
+
+		for ( int j = 0; j < NODE_CONNS; j++ ) {
+			if ( fds[j] == fd ) {
+				fds[j] = -1;
+				pooled++;
+				break;
+			}
+		}
+	}
+
+	uint32_t left = node_cached(node);
+	as_node_destroy(node);
+
+	// Taken connections are closed by the test, not the node.
+	for ( uint32_t i = 0; i < n_taken; i++ ) {
+		close(taken[i]);
+	}
+
+	for ( int i = 0; i < NODE_CONNS; i++ ) {
+		close(peers[i]);
+	}
+
+	assert_int_eq( pooled, NODE_CONNS );
+	assert_int_eq( left, 0 );
+}
+
+TEST( info_node_socket_resolve , "socket profiles: presets fill fields left at 0" ) {
+
+	as_config_socket config;
+	as_config_socket resolved;
+
+	memset(&config, 0, sizeof(config));
+	as_socket_profile_resolve(&config, &resolved);
+	assert_int_eq( resolved.busy_poll_us, 0 );
+	assert_int_eq( resolved.rcvbuf_size, 0 );
+	assert_int_eq( resolved.priority, 0 );
+	assert_false( resolved.quickack );
+	assert_int_eq( resolved.spin_us, 0 );
+
+	config.profile = AS_SOCKET_PROFILE_LATENCY;
+	as_socket_profile_resolve(&config, &resolved);
+	assert_int_eq( resolved.busy_poll_us, 50 );
+	assert_int_eq( resolved.priority, 6 );
+	assert_true( resolved.quickack );
+	assert_int_eq( resolved.spin_us, 50 );
+	assert_int_eq( resolved.rcvbuf_size, 0 );
+
+	// Options set by the user win over the preset.
+	config.spin_us = 10;
+	config.priority = 2;
+	as_socket_profile_resolve(&config, &resolved);
+	assert_int_eq( resolved.spin_us, 10 );
+	assert_int_eq( resolved.priority, 2 );
+	assert_int_eq( resolved.busy_poll_us, 50 );
+
+	memset(&config, 0, sizeof(config));
+	config.profile = AS_SOCKET_PROFILE_THROUGHPUT;
+	as_socket_profile_resolve(&config, &resolved);
+	assert_int_eq( resolved.rcvbuf_size, 4 * 1024 * 1024 );
+	assert_int_eq( resolved.sndbuf_size, 1024 * 1024 );
+	assert_int_eq( resolved.spin_us, 0 );
+}
+
+TEST( info_node_socket_apply , "socket profiles: options are set on new sockets" ) {
+
+	as_config_socket config;
+	memset(&config, 0, sizeof(config));
+	config.priority = 5;
+	config.quickack = true;
+	config.sndbuf_size = 64 * 1024;
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert_true( fd >= 0 );
+
+	as_socket_profile_apply(&config, fd);
+
+	int sndbuf = 0;
+	int priority = 0;
+	socklen_t len = sizeof(int);
+	getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len);
+#ifdef SO_PRIORITY
+	len = sizeof(int);
+	getsockopt(fd, SOL_SOCKET, SO_PRIORITY, &priority, &len);
+#else
+	priority = (int)config.priority;
+#endif
+	close(fd);
+
+	// Linux doubles the requested buffer size for bookkeeping.
+	assert_true( sndbuf >= 64 * 1024 );
+	assert_int_eq( priority, 5 );
+}
+
+TEST( info_node_socket_spin , "socket profiles: spin ends when data arrives or time is up" ) {
+
+	int sv[2];
+	assert_int_eq( socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0 );
+
+	as_config_socket config;
+	memset(&config, 0, sizeof(config));
+	config.spin_us = 20000;
+
+	// Nothing to read - spins for spin_us, then leaves it to the blocking read.
+	uint64_t begin = node_now_us();
+	as_socket_profile_spin(&config, sv[0]);
+	uint64_t idle = node_now_us() - begin;
+
+	// A response already waiting ends the spin at once.
+	char c = 1;
+	ssize_t rv = write(sv[1], &c, 1);
+
+	begin = node_now_us();
+	as_socket_profile_spin(&config, sv[0]);
+	uint64_t ready = node_now_us() - begin;
+
+	// The spin only peeks, so the data is still there.
+	char r = 0;
+	ssize_t got = recv(sv[0], &r, 1, MSG_DONTWAIT);
+
+	close(sv[0]);
+	close(sv[1]);
+
+	assert_int_eq( rv, 1 );
+	assert_true( idle >= 20000 );
+	assert_true( ready < 20000 );
+	assert_int_eq( got, 1 );
+	assert_int_eq( r, 1 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( info_node, "cluster node connections" ) {
+	suite_add( info_node_pools_spill );
+	suite_add( info_node_pools_steal );
+	suite_add( info_node_socket_resolve );
+	suite_add( info_node_socket_apply );
+	suite_add( info_node_socket_spin );
+}
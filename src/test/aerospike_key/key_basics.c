@@ -16,10 +16,13 @@
  */
 #include <aerospike/aerospike.h>
 #include <aerospike/aerospike_key.h>
+#include <aerospike/aerospike_lob.h>
+#include <aerospike/as_cluster.h>
 
 #include <aerospike/as_error.h>
 #include <aerospike/as_status.h>
 
+#include <aerospike/as_lazy.h>
 #include <aerospike/as_record.h>
 #include <aerospike/as_integer.h>
 #include <aerospike/as_string.h>
@@ -30,6 +33,9 @@
 #include <aerospike/as_stringmap.h>
 #include <aerospike/as_val.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "../test.h"
 
 /******************************************************************************
@@ -145,6 +151,130 @@ TEST( key_basics_get , "get: (test,test,foo) = {a: 123, b: 'abc', c: 456, d: 'de
     as_record_destroy(rec);
 }
 
+TEST( key_basics_get_raw , "get raw: (test,test,foo) = {e: [1,2,3], f: {x: 7, y: 8, z: 9}}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.deserialize = false;
+
+	as_record r, *rec = &r;
+	as_record_init(&r, 0);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	as_status rc = aerospike_key_get(as, &err, &policy, &key, &rec);
+
+    assert_int_eq( rc, AEROSPIKE_OK );
+    assert_int_eq( as_record_numbins(rec), 6 );
+    assert_null( as_record_get_list(rec, "e") );
+    assert_null( as_record_get_map(rec, "f") );
+
+    as_bytes * e = as_lazy_fromval((as_val *) as_record_get(rec, "e"));
+    assert_not_null( e );
+
+    uint32_t size = 0;
+    assert_true( as_lazy_size(e, &size) );
+    assert_int_eq( size, 3 );
+
+    as_val * v = as_lazy_list_get(e, 2);
+    assert_not_null( as_integer_fromval(v) );
+    assert_int_eq( as_integer_get(as_integer_fromval(v)), 3 );
+    as_val_destroy(v);
+    assert_null( as_lazy_list_get(e, 3) );
+
+    as_bytes * f = as_lazy_fromval((as_val *) as_record_get(rec, "f"));
+    assert_not_null( f );
+
+    v = as_lazy_map_get_str(f, "y");
+    assert_not_null( as_integer_fromval(v) );
+    assert_int_eq( as_integer_get(as_integer_fromval(v)), 8 );
+    as_val_destroy(v);
+    assert_null( as_lazy_map_get_str(f, "w") );
+
+    // Raw values are written back without being re-encoded.
+    rc = aerospike_key_put(as, &err, NULL, &key, rec);
+    assert_int_eq( rc, AEROSPIKE_OK );
+
+    as_map * map = as_map_fromval(as_lazy_record_get(rec, "f"));
+    assert_not_null( map );
+    assert_int_eq( as_map_size(map), 3 );
+    assert_not_null( as_record_get_map(rec, "f") );
+
+    as_record_destroy(rec);
+
+    rec = NULL;
+    rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+    assert_int_eq( rc, AEROSPIKE_OK );
+
+    as_list * list = as_record_get_list(rec, "e");
+    assert_not_null( list );
+    assert_int_eq( as_list_size(list), 3 );
+
+    as_record_destroy(rec);
+	as_key_destroy(&key);
+}
+
+TEST( key_basics_put_nested , "put: (test,test,nested) = {m: {a: [1, 'x', {b: -70000}], c: 'long...'}}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	// Big enough to need 16-bit msgpack headers.
+	char big[300];
+	memset(big, 'y', sizeof(big) - 1);
+	big[sizeof(big) - 1] = 0;
+
+	as_hashmap * inner = as_hashmap_new(1);
+	as_stringmap_set_int64((as_map *) inner, "b", -70000);
+
+	as_arraylist * list = as_arraylist_new(20, 0);
+	as_arraylist_append_int64(list, 1);
+	as_arraylist_append_str(list, "x");
+	as_arraylist_append_map(list, (as_map *) inner);
+	for ( int i = 3; i < 20; i++ ) {
+		as_arraylist_append_int64(list, i * 1000);
+	}
+
+	as_hashmap * map = as_hashmap_new(2);
+	as_stringmap_set_list((as_map *) map, "a", (as_list *) list);
+	as_stringmap_set_str((as_map *) map, "c", big);
+
+	as_record r, * rec = &r;
+	as_record_init(rec, 1);
+	as_record_set_map(rec, "m", (as_map *) map);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "nested");
+
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, rec);
+	as_record_destroy(rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	as_map * m = as_record_get_map(rec, "m");
+	assert_not_null( m );
+	assert_string_eq( as_stringmap_get_str(m, "c"), big );
+
+	as_list * l = as_stringmap_get_list(m, "a");
+	assert_not_null( l );
+	assert_int_eq( as_list_size(l), 20 );
+	assert_string_eq( as_list_get_str(l, 1), "x" );
+	assert_int_eq( as_list_get_int64(l, 19), 19000 );
+	assert_int_eq( as_stringmap_get_int64(as_list_get_map(l, 2), "b"), -70000 );
+
+	as_record_destroy(rec);
+
+	aerospike_key_remove(as, &err, NULL, &key);
+	as_key_destroy(&key);
+}
+
 TEST( key_basics_select , "select: (test,test,foo) = {a: 123, b: 'abc'}" ) {
 
 	as_error err;
@@ -187,6 +317,79 @@ TEST( key_basics_select , "select: (test,test,foo) = {a: 123, b: 'abc'}" ) {
     as_record_destroy(rec);
 }
 
+TEST( key_basics_select_order , "select: (test,test,foo) = {d: 'def', a: 123, b: 'abc'} in request order" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_record r, *rec = &r;
+	as_record_init(&r, 0);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	const char * bins[4] = { "d", "a", "b", NULL };
+
+	as_status rc = aerospike_key_select(as, &err, NULL, &key, bins, &rec);
+
+	as_key_destroy(&key);
+
+    assert_int_eq( rc, AEROSPIKE_OK );
+    assert_int_eq( as_record_numbins(rec), 3 );
+
+    assert_string_eq( rec->bins.entries[0].name, "d" );
+    assert_string_eq( rec->bins.entries[1].name, "a" );
+    assert_string_eq( rec->bins.entries[2].name, "b" );
+
+    assert_string_eq( as_record_get_str(rec, "d"), "def" );
+    assert_int_eq( as_record_get_int64(rec, "a", 0), 123 );
+    assert_string_eq( as_record_get_str(rec, "b"), "abc" );
+
+    as_record_destroy(rec);
+}
+
+TEST( key_basics_select_prefix , "select: (test,test,prefix) = {abc: 3, a: 1, ab: 2} out of order, names prefixing each other" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "prefix");
+
+	as_record w;
+	as_record_inita(&w, 3);
+	as_record_set_int64(&w, "a", 1);
+	as_record_set_int64(&w, "ab", 2);
+	as_record_set_int64(&w, "abc", 3);
+
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &w);
+	as_record_destroy(&w);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	as_record r, *rec = &r;
+	as_record_init(&r, 0);
+
+	// "a" is a prefix of the bins before it, and the missing "x" breaks
+	// request order, so returned bins must be placed by exact name.
+	const char * bins[5] = { "abc", "x", "a", "ab", NULL };
+
+	rc = aerospike_key_select(as, &err, NULL, &key, bins, &rec);
+
+	as_error rerr;
+	aerospike_key_remove(as, &rerr, NULL, &key);
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	assert_int_eq( as_record_get_int64(rec, "a", 0), 1 );
+	assert_int_eq( as_record_get_int64(rec, "ab", 0), 2 );
+	assert_int_eq( as_record_get_int64(rec, "abc", 0), 3 );
+	assert_null( as_record_get_integer(rec, "x") );
+
+	as_record_destroy(rec);
+}
+
 TEST( key_basics_exists , "exists: (test,test,foo)" ) {
 
 	as_error err;
@@ -206,6 +409,90 @@ TEST( key_basics_exists , "exists: (test,test,foo)" ) {
 	as_record_destroy(rec);
 }
 
+TEST( key_basics_route , "exists: (test,test,foo) twice with routing hints" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key_route route = { 0 };
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+	as_key_set_route(&key, &route);
+
+	as_record * rec = NULL;
+	as_status rc = aerospike_key_exists(as, &err, NULL, &key, &rec);
+
+    assert_int_eq( rc, AEROSPIKE_OK );
+	assert_not_null( rec );
+	assert_not_null( route.table );
+	assert_int_ne( route.generation, 0 );
+
+	as_record_destroy(rec);
+	rec = NULL;
+
+	// The second request is routed through the cached hints.
+	uint32_t generation = route.generation;
+	rc = aerospike_key_exists(as, &err, NULL, &key, &rec);
+
+	as_key_destroy(&key);
+
+    assert_int_eq( rc, AEROSPIKE_OK );
+	assert_not_null( rec );
+	assert_int_eq( route.generation, generation );
+	assert_int_eq( route.seq & 1, 0 );
+	
+	as_record_destroy(rec);
+}
+
+TEST( key_basics_route_other_key , "exists: routing hints of (test,test,foo) attached to another key" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key_route route = { 0 };
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+	as_key_set_route(&key, &route);
+
+	as_record * rec = NULL;
+	as_status rc = aerospike_key_exists(as, &err, NULL, &key, &rec);
+	as_record_destroy(rec);
+	rec = NULL;
+
+	uint32_t n_partitions = as->cluster->n_partitions;
+	uint32_t foo_partition_id = cl_partition_getid(n_partitions, (cf_digest *) as_key_digest(&key)->value);
+	as_key_destroy(&key);
+
+    assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( route.partition_id, foo_partition_id );
+
+	// Find a key in another partition.
+	as_key other;
+	uint32_t other_partition_id = foo_partition_id;
+
+	for ( int i = 0; other_partition_id == foo_partition_id; i++ ) {
+		char name[32];
+		sprintf(name, "route%d", i);
+		as_key_init_strp(&other, "test", "test", strdup(name), true);
+		other_partition_id = cl_partition_getid(n_partitions, (cf_digest *) as_key_digest(&other)->value);
+
+		if ( other_partition_id == foo_partition_id ) {
+			as_key_destroy(&other);
+		}
+	}
+
+	// The hints don't match the other key, so they are resolved again.
+	as_key_set_route(&other, &route);
+	rc = aerospike_key_exists(as, &err, NULL, &other, &rec);
+	as_key_destroy(&other);
+
+	assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+	assert_int_eq( route.partition_id, other_partition_id );
+	assert_int_eq( route.seq & 1, 0 );
+}
+
 TEST( key_basics_notexists , "not exists: (test,test,foozoo)" ) {
 
 	as_error err;
@@ -310,6 +597,59 @@ TEST( key_basics_get2 , "get: (test,test,foo) = {a: 444, b: 'abcdef', d: 'abcdef
 
     as_record_destroy(rec);
 }
+
+TEST( key_basics_lob , "lob: (test,test,lob) = 1MB in 64KB chunks, then 100 bytes inline" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "lob");
+
+	// Static, so failed asserts returning early leak nothing.
+	static uint8_t value[1024 * 1024];
+	static uint8_t buf[1024 * 1024];
+	uint32_t size = sizeof(value);
+
+	for ( uint32_t i = 0; i < size; i++ ) {
+		value[i] = (uint8_t) (i * 31 + (i >> 16));
+	}
+
+	aerospike_lob_remove(as, &err, NULL, &key);
+
+	as_status rc = aerospike_lob_put(as, &err, NULL, &key, value, size, 64 * 1024);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	uint32_t got = 0;
+	rc = aerospike_lob_get(as, &err, NULL, &key, NULL, 0, &got);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( got, size );
+
+	rc = aerospike_lob_get(as, &err, NULL, &key, buf, size - 1, &got);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	rc = aerospike_lob_get(as, &err, NULL, &key, buf, size, &got);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( got, size );
+	assert_true( memcmp(value, buf, size) == 0 );
+
+	rc = aerospike_lob_put(as, &err, NULL, &key, value, 100, 64 * 1024);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	rc = aerospike_lob_get(as, &err, NULL, &key, buf, size, &got);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( got, 100 );
+	assert_true( memcmp(value, buf, 100) == 0 );
+
+	rc = aerospike_lob_remove(as, &err, NULL, &key);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	rc = aerospike_lob_get(as, &err, NULL, &key, buf, size, &got);
+	assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+
+	as_key_destroy(&key);
+}
+
 /******************************************************************************
  * TEST SUITE
  *****************************************************************************/
@@ -319,11 +659,18 @@ SUITE( key_basics, "aerospike_key basic tests" ) {
     suite_add( key_basics_remove );
     suite_add( key_basics_put );
     suite_add( key_basics_exists );
+    suite_add( key_basics_route );
+    suite_add( key_basics_route_other_key );
     suite_add( key_basics_notexists );
     suite_add( key_basics_get );
+    suite_add( key_basics_get_raw );
+    suite_add( key_basics_put_nested );
     suite_add( key_basics_select );
+    suite_add( key_basics_select_order );
+    suite_add( key_basics_select_prefix );
     suite_add( key_basics_operate );
     suite_add( key_basics_get2 );
+    suite_add( key_basics_lob );
     suite_add( key_basics_remove );
     suite_add( key_basics_notexists );
 }
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_config.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_hotkeys.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_partition.h>
+#include <aerospike/as_status.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define HOTKEYS_INTERVAL_MS 200
+#define HOTKEYS_COLD_KEYS 100
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+// A client with just enough cluster to hold a sampler and an empty partition
+// map, so reports can be read without a server.
+typedef struct hotkeys_client_s {
+	aerospike as;
+	as_cluster cluster;
+	as_partition_tables tables;
+} hotkeys_client;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static as_hotkeys * hotkeys_client_init(hotkeys_client * client)
+{
+	as_config_hotkeys config;
+	memset(&config, 0, sizeof(config));
+	config.enabled = true;
+	config.sample_rate = 1;
+	config.interval_ms = HOTKEYS_INTERVAL_MS;
+	config.top_k = 16;
+
+	memset(client, 0, sizeof(hotkeys_client));
+	client->tables.ref_count = 1;
+	client->cluster.partition_tables = &client->tables;
+	client->cluster.hotkeys = as_hotkeys_create(&config);
+	client->as.cluster = &client->cluster;
+	return client->cluster.hotkeys;
+}
+
+static void hotkeys_read(as_hotkeys * hotkeys, int64_t value, uint32_t times, cf_digest * digest)
+{
+	as_key key;
+	as_key_init_int64(&key, "test", "test", value);
+	as_digest * d = as_key_digest(&key);
+	memcpy(digest, d->value, sizeof(cf_digest));
+
+	for ( uint32_t i = 0; i < times; i++ ) {
+		as_hotkeys_sample(hotkeys, "test", "test", digest, false);
+	}
+	as_key_destroy(&key);
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_hotkeys_skewed , "hotkeys: the most read key is reported first" ) {
+
+	hotkeys_client client;
+	as_hotkeys * hotkeys = hotkeys_client_init(&client);
+	assert_not_null( hotkeys );
+
+	// One hot key, one warm key and a tail of cold keys.
+	cf_digest hot;
+	cf_digest warm;
+	cf_digest cold;
+
+	for ( int64_t i = 0; i < HOTKEYS_COLD_KEYS; i++ ) {
+		hotkeys_read(hotkeys, 1000 + i, 3, &cold);
+	}
+	hotkeys_read(hotkeys, 1, 200, &warm);
+	hotkeys_read(hotkeys, 0, 1000, &hot);
+
+	// The report covers the last completed interval.
+	usleep(HOTKEYS_INTERVAL_MS * 1000);
+
+	as_error err;
+	as_hotkeys_report report;
+	as_status rc = aerospike_hotkeys_get(&client.as, &err, &report);
+
+	as_hotkeys_destroy(hotkeys);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( report.size, 16 );
+
+	// The sketch may overcount, never undercount.
+	assert_true( memcmp(&report.keys[0].digest, &hot, sizeof(cf_digest)) == 0 );
+	assert_true( report.keys[0].reads >= 1000 );
+	assert_int_eq( report.keys[0].writes, 0 );
+	assert_string_eq( report.keys[0].ns, "test" );
+	assert_string_eq( report.keys[0].set, "test" );
+
+	assert_true( memcmp(&report.keys[1].digest, &warm, sizeof(cf_digest)) == 0 );
+	assert_true( report.keys[1].reads >= 200 );
+
+	for ( uint32_t i = 1; i < report.size; i++ ) {
+		assert_true( report.keys[i].reads <= report.keys[i - 1].reads );
+	}
+
+	// No partition map, so no owners.
+	assert_string_eq( report.keys[0].master, "" );
+}
+
+TEST( key_hotkeys_disabled , "hotkeys: reports fail while sampling is disabled" ) {
+
+	hotkeys_client client;
+	memset(&client, 0, sizeof(hotkeys_client));
+	client.as.cluster = &client.cluster;
+
+	as_error err;
+	as_hotkeys_report report;
+	as_status rc = aerospike_hotkeys_get(&client.as, &err, &report);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_hotkeys, "as_hotkeys sampling tests" ) {
+	suite_add( key_hotkeys_skewed );
+	suite_add( key_hotkeys_disabled );
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/aerospike_multi.h>
+
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_status.h>
+
+#include <aerospike/as_record.h>
+
+#include <citrusleaf/cf_clock.h>
+#include <citrusleaf/cf_queue.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../test.h"
+#include "../aerospike_test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern int g_port;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+// Adds the test cluster, plus an unreachable one if asked.  The same cluster
+// is added twice, so each read may be answered by either.
+static bool key_multi_connect(aerospike_multi * multi, uint32_t hedge_us, bool unreachable)
+{
+	as_error err;
+
+	aerospike_multi_init(multi);
+	multi->hedge_us = hedge_us;
+
+	for ( int i = 0; i < 2; i++ ) {
+		as_config config;
+		as_config_init(&config);
+		as_config_add_host(&config, g_host, g_port);
+		aerospike_multi_add(multi, &err, &config, i == 0);
+	}
+
+	if ( unreachable ) {
+		as_config config;
+		as_config_init(&config);
+		as_config_add_host(&config, "127.0.0.1", 1);
+		config.fail_if_not_connected = true;
+		aerospike_multi_add(multi, &err, &config, false);
+	}
+
+	return aerospike_multi_connect(multi, &err) == AEROSPIKE_OK;
+}
+
+// Replaces the pooled connections of a cluster's nodes with sockets nobody
+// answers, so its next reads time out.  Returns the peer ends to close.
+static int key_multi_silence(aerospike * as, int * peers, int max)
+{
+	as_nodes * nodes = as_nodes_reserve(as->cluster);
+	int n = 0;
+
+	for ( uint32_t i = 0; i < nodes->size; i++ ) {
+		as_node * node = nodes->array[i];
+		int fd;
+
+		for ( uint32_t q = 0; q < node->conn_qs_size; q++ ) {
+			while ( cf_queue_pop(node->conn_qs[q], &fd, CF_QUEUE_NOWAIT) == CF_QUEUE_OK ) {
+				close(fd);
+			}
+		}
+
+		for ( int j = 0; j < 4 && n < max; j++ ) {
+			int sv[2];
+
+			if ( socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0 ) {
+				break;
+			}
+			as_node_put_connection(node, sv[0]);
+			peers[n++] = sv[1];
+		}
+	}
+
+	as_nodes_release(nodes);
+	return n;
+}
+
+static void key_multi_close(aerospike_multi * multi)
+{
+	as_error err;
+	aerospike_multi_close(multi, &err);
+	aerospike_multi_destroy(multi);
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_multi_put_get , "multi: put to primary, get from best cluster" ) {
+
+	aerospike_multi multi;
+	assert_true( key_multi_connect(&multi, 0, false) );
+
+	as_error err;
+
+	as_key key;
+	as_key_init(&key, "test", "test", "multi");
+
+	as_record r;
+	as_record_inita(&r, 1);
+	as_record_set_int64(&r, "a", 123);
+
+	as_status rc = aerospike_multi_put(&multi, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	for ( int i = 0; i < 200; i++ ) {
+		as_record * rec = NULL;
+		rc = aerospike_multi_get(&multi, &err, NULL, &key, &rec);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		assert_int_eq( as_record_get_int64(rec, "a", 0), 123 );
+		as_record_destroy(rec);
+	}
+
+	// Probing keeps both clusters measured.
+	assert_true( multi.clusters[0].latency_us > 0 );
+	assert_true( multi.clusters[1].latency_us > 0 );
+
+	rc = aerospike_multi_remove(&multi, &err, NULL, &key);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	as_record * rec = NULL;
+	rc = aerospike_multi_get(&multi, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+
+	as_key_destroy(&key);
+	key_multi_close(&multi);
+}
+
+TEST( key_multi_hedge , "multi: hedged select" ) {
+
+	aerospike_multi multi;
+
+	// Hedge after 1us, so most reads go to both clusters.
+	assert_true( key_multi_connect(&multi, 1, false) );
+
+	as_error err;
+
+	as_key key;
+	as_key_init(&key, "test", "test", "multi-hedge");
+
+	as_record r;
+	as_record_inita(&r, 2);
+	as_record_set_int64(&r, "a", 1);
+	as_record_set_str(&r, "b", "two");
+
+	as_status rc = aerospike_multi_put(&multi, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	const char * bins[] = { "b", NULL };
+
+	for ( int i = 0; i < 100; i++ ) {
+		as_record * rec = NULL;
+		rc = aerospike_multi_select(&multi, &err, NULL, &key, bins, &rec);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		assert_int_eq( as_record_numbins(rec), 1 );
+		assert_string_eq( as_record_get_str(rec, "b"), "two" );
+		as_record_destroy(rec);
+	}
+
+	assert_true( multi.clusters[0].latency_us > 0 );
+	assert_true( multi.clusters[1].latency_us > 0 );
+	assert_true( multi.hedges_sent > 0 );
+
+	aerospike_multi_remove(&multi, &err, NULL, &key);
+	as_key_destroy(&key);
+	key_multi_close(&multi);
+}
+
+TEST( key_multi_hedge_win , "multi: a hedge answers while the first attempt hangs" ) {
+
+	aerospike_multi multi;
+	assert_true( key_multi_connect(&multi, 1000, false) );
+
+	// Always try the primary first.
+	multi.probe_interval = 0;
+
+	as_error err;
+
+	as_key key;
+	as_key_init(&key, "test", "test", "multi-hedge-win");
+
+	as_record r;
+	as_record_inita(&r, 1);
+	as_record_set_int64(&r, "a", 9);
+
+	as_status rc = aerospike_multi_put(&multi, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	int peers[64];
+	int n_peers = key_multi_silence(&multi.clusters[0].as, peers, 64);
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.timeout = 2000;
+
+	uint64_t begin = cf_getms();
+	as_record * rec = NULL;
+	rc = aerospike_multi_get(&multi, &err, &policy, &key, &rec);
+	uint64_t elapsed = cf_getms() - begin;
+
+	int64_t a = rc == AEROSPIKE_OK ? as_record_get_int64(rec, "a", 0) : 0;
+
+	if ( rec ) {
+		as_record_destroy(rec);
+	}
+
+	// Waits for the hung attempt to time out.
+	key_multi_close(&multi);
+
+	for ( int i = 0; i < n_peers; i++ ) {
+		close(peers[i]);
+	}
+	as_key_destroy(&key);
+
+	assert_int_ne( n_peers, 0 );
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 9 );
+	assert_int_eq( multi.hedges_sent, 1 );
+	assert_int_eq( multi.hedge_wins, 1 );
+
+	// Answered by the hedge, not after the first attempt timed out.
+	assert_true( elapsed < policy.timeout );
+}
+
+TEST( key_multi_unreachable , "multi: reads skip a cluster that did not connect" ) {
+
+	aerospike_multi multi;
+	assert_true( key_multi_connect(&multi, 0, true) );
+	assert_false( multi.clusters[2].connected );
+
+	as_error err;
+
+	as_key key;
+	as_key_init(&key, "test", "test", "multi-down");
+
+	as_record r;
+	as_record_inita(&r, 1);
+	as_record_set_int64(&r, "a", 7);
+
+	as_status rc = aerospike_multi_put(&multi, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	for ( int i = 0; i < 10; i++ ) {
+		as_record * rec = NULL;
+		rc = aerospike_multi_get(&multi, &err, NULL, &key, &rec);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		assert_int_eq( as_record_get_int64(rec, "a", 0), 7 );
+		as_record_destroy(rec);
+	}
+
+	aerospike_multi_remove(&multi, &err, NULL, &key);
+	as_key_destroy(&key);
+	key_multi_close(&multi);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_multi, "aerospike_multi tests" ) {
+	suite_add( key_multi_put_get );
+	suite_add( key_multi_hedge );
+	suite_add( key_multi_hedge_win );
+	suite_add( key_multi_unreachable );
+}
@@ -15,6 +15,7 @@
  * the License.
  */
 #include <aerospike/aerospike.h>
+#include <aerospike/aerospike_counter.h>
 #include <aerospike/aerospike_key.h>
 
 #include <aerospike/as_error.h>
@@ -141,6 +142,128 @@ TEST( key_operate_9 , "operate: (test,test,key3) = {append, read, write, read, i
     as_operations_destroy( ops );
 }
 
+TEST( key_operate_prepared , "operate: (test,test-set,key4) = prepared {incr, incr, read, read} x 3" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test-set", "key4");
+
+	as_status rc = aerospike_key_remove(as, &err, NULL, &key);
+	assert_true( rc == AEROSPIKE_OK || rc == AEROSPIKE_ERR_RECORD_NOT_FOUND );
+
+	as_operations ops;
+	as_operations_inita(&ops, 4);
+	as_operations_add_incr(&ops, "c1", 0);
+	as_operations_add_incr(&ops, "c2", 0);
+	as_operations_add_read(&ops, "c1");
+	as_operations_add_read(&ops, "c2");
+
+	as_operations_prepared prepared;
+	rc = aerospike_key_operate_prepare(as, &err, NULL, &ops, &prepared);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	as_operations_destroy(&ops);
+
+	as_record * rec = NULL;
+
+	for ( int i = 1; i <= 3; i++ ) {
+		as_operations_inita(&ops, 4);
+		as_operations_add_incr(&ops, "c1", i);
+		as_operations_add_incr(&ops, "c2", 10 * i);
+		as_operations_add_read(&ops, "c1");
+		as_operations_add_read(&ops, "c2");
+
+		rc = aerospike_key_operate_prepared(as, &err, &prepared, &key, &ops, &rec);
+		as_operations_destroy(&ops);
+		assert_int_eq( rc, AEROSPIKE_OK );
+	}
+
+	assert_int_eq( as_record_get_int64(rec, "c1", 0), 6 );
+	assert_int_eq( as_record_get_int64(rec, "c2", 0), 60 );
+	as_record_destroy(rec);
+
+	// A different shape is rejected.
+	as_operations_inita(&ops, 1);
+	as_operations_add_read(&ops, "c1");
+	rc = aerospike_key_operate_prepared(as, &err, &prepared, &key, &ops, NULL);
+	as_operations_destroy(&ops);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	as_operations_prepared_destroy(&prepared);
+}
+
+TEST( key_operate_counter , "operate: sharded counter add, get and reshard" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "operate", "counter");
+
+	as_counter counter;
+	assert_not_null( as_counter_init(&counter, &key, "count", 8) );
+
+	// Start from a clean counter.
+	for ( uint32_t i = 0; i < counter.read_shards; i++ ) {
+		as_key shard;
+		as_counter_shard_key(&counter, i, &shard);
+		aerospike_key_remove(as, &err, NULL, &shard);
+		as_key_destroy(&shard);
+	}
+
+	as_status rc;
+
+	for ( int i = 0; i < 100; i++ ) {
+		rc = aerospike_counter_add(as, &err, NULL, &counter, 2);
+		assert_int_eq( rc, AEROSPIKE_OK );
+	}
+
+	int64_t value = 0;
+	rc = aerospike_counter_get(as, &err, NULL, &counter, &value);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( value, 200 );
+
+	// Shrinking moves the dropped shards' counts into the remaining shards.
+	rc = aerospike_counter_reshard(as, &err, NULL, &counter, 2);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	rc = aerospike_counter_add(as, &err, NULL, &counter, 5);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// Another client loads the stored count.
+	as_counter other;
+	as_counter_init(&other, &key, "count", 8);
+
+	rc = aerospike_counter_load(as, &err, NULL, &other);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( other.n_shards, 2 );
+	assert_int_eq( other.read_shards, 8 );
+
+	// A client that has not loaded it still reads the dropped shards.
+	as_counter shrunk;
+	as_counter_init(&shrunk, &key, "count", 2);
+
+	rc = aerospike_counter_get(as, &err, NULL, &shrunk, &value);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( value, 205 );
+
+	// Resharding to the same count again stops reading the dropped shards.
+	rc = aerospike_counter_reshard(as, &err, NULL, &counter, 2);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( counter.read_shards, 2 );
+
+	rc = aerospike_counter_load(as, &err, NULL, &other);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( other.read_shards, 2 );
+
+	rc = aerospike_counter_get(as, &err, NULL, &other, &value);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( value, 205 );
+
+	as_key_destroy(&key);
+}
+
 /******************************************************************************
  * TEST SUITE
  *****************************************************************************/
@@ -148,4 +271,6 @@ TEST( key_operate_9 , "operate: (test,test,key3) = {append, read, write, read, i
 SUITE( key_operate, "aerospike_key_operate tests" ) {
 	suite_add( key_operate_touchget );
 	suite_add( key_operate_9 );
+	suite_add( key_operate_prepared );
+	suite_add( key_operate_counter );
 }
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_config.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_slowops.h>
+#include <aerospike/as_status.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define SLOWOPS_THREADS 8
+#define SLOWOPS_PER_THREAD 20000
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+// A client with just enough cluster to hold a sampler, so the ring can be
+// tested without a server.
+typedef struct slowops_client_s {
+	aerospike as;
+	as_cluster cluster;
+} slowops_client;
+
+typedef struct slowops_reader_s {
+	aerospike * as;
+	volatile bool stop;
+	uint32_t read;
+	uint32_t torn;
+} slowops_reader;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static as_slowops * slowops_client_init(slowops_client * client, uint32_t capacity)
+{
+	as_config_slowops config;
+	memset(&config, 0, sizeof(config));
+	config.enabled = true;
+	config.threshold_us = 0;
+	config.capacity = capacity;
+	config.log_interval_ms = 0;
+
+	memset(client, 0, sizeof(slowops_client));
+	client->cluster.slowops = as_slowops_create(&config);
+	client->as.cluster = &client->cluster;
+	return client->cluster.slowops;
+}
+
+// Every field of a recorded operation is derived from one value, so a copy
+// mixing two operations is detected.
+static void slowops_end(as_slowops * slowops, int value)
+{
+	cf_digest digest;
+	memset(&digest, 0, sizeof(digest));
+
+	as_slowop op;
+	as_slowop_begin(&op, "test", &digest, false);
+	op.tries = (uint32_t) value;
+	snprintf(op.ns, sizeof(op.ns), "%d", value);
+	as_slowops_end(slowops, &op, value);
+}
+
+static bool slowops_consistent(const as_slowop * op)
+{
+	return (uint32_t) op->result == op->tries && atoi(op->ns) == op->result;
+}
+
+static void * slowops_writer(void * udata)
+{
+	as_slowops * slowops = (as_slowops *) udata;
+
+	for ( int i = 0; i < SLOWOPS_PER_THREAD; i++ ) {
+		slowops_end(slowops, i);
+	}
+	return NULL;
+}
+
+static void * slowops_read(void * udata)
+{
+	slowops_reader * reader = (slowops_reader *) udata;
+	as_slowop ops[16];
+	uint64_t cursor = 0;
+
+	while ( ! reader->stop ) {
+		as_error err;
+		uint32_t n_ops = 16;
+
+		if ( aerospike_slowops_get(reader->as, &err, ops, &n_ops, &cursor) != AEROSPIKE_OK ) {
+			break;
+		}
+
+		for ( uint32_t i = 0; i < n_ops; i++ ) {
+			if ( ! slowops_consistent(&ops[i]) ) {
+				reader->torn++;
+			}
+		}
+		reader->read += n_ops;
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_slowops_ring , "slowops: operations are read back in order" ) {
+
+	slowops_client client;
+	as_slowops * slowops = slowops_client_init(&client, 8);
+	assert_not_null( slowops );
+
+	for ( int i = 0; i < 5; i++ ) {
+		slowops_end(slowops, i);
+	}
+
+	as_error err;
+	as_slowop ops[8];
+	uint32_t n_ops = 8;
+	uint64_t cursor = 0;
+
+	as_status rc = aerospike_slowops_get(&client.as, &err, ops, &n_ops, &cursor);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( n_ops, 5 );
+	assert_int_eq( cursor, 5 );
+
+	for ( uint32_t i = 0; i < n_ops; i++ ) {
+		assert_int_eq( ops[i].result, i );
+		assert_true( slowops_consistent(&ops[i]) );
+	}
+
+	// Nothing new since the cursor.
+	n_ops = 8;
+	rc = aerospike_slowops_get(&client.as, &err, ops, &n_ops, &cursor);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( n_ops, 0 );
+
+	as_slowops_destroy(slowops);
+}
+
+TEST( key_slowops_wrap , "slowops: a full ring keeps the newest operations" ) {
+
+	slowops_client client;
+	as_slowops * slowops = slowops_client_init(&client, 8);
+	assert_not_null( slowops );
+
+	for ( int i = 0; i < 20; i++ ) {
+		slowops_end(slowops, i);
+	}
+
+	as_error err;
+	as_slowop ops[8];
+	uint32_t n_ops = 8;
+	uint64_t cursor = 0;
+
+	as_status rc = aerospike_slowops_get(&client.as, &err, ops, &n_ops, &cursor);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( n_ops, 8 );
+	assert_int_eq( cursor, 20 );
+
+	for ( uint32_t i = 0; i < n_ops; i++ ) {
+		assert_int_eq( ops[i].result, 12 + i );
+	}
+
+	as_slowops_destroy(slowops);
+}
+
+TEST( key_slowops_dropped , "slowops: readers move past a dropped operation" ) {
+
+	slowops_client client;
+	as_slowops * slowops = slowops_client_init(&client, 4);
+	assert_not_null( slowops );
+
+	for ( int i = 0; i < 4; i++ ) {
+		slowops_end(slowops, i);
+	}
+
+	// Pretend the writer of position 0 is still copying, so the writer of
+	// position 4 finds the slot busy and drops its operation.
+	slowops->slots[0].seq = 1;
+	slowops_end(slowops, 4);
+	slowops->slots[0].seq = 2;
+
+	slowops_end(slowops, 5);
+	slowops_end(slowops, 6);
+
+	as_error err;
+	as_slowop ops[4];
+	uint32_t n_ops = 4;
+	uint64_t cursor = 4;
+
+	as_status rc = aerospike_slowops_get(&client.as, &err, ops, &n_ops, &cursor);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( n_ops, 2 );
+	assert_int_eq( cursor, 7 );
+	assert_int_eq( ops[0].result, 5 );
+	assert_int_eq( ops[1].result, 6 );
+
+	as_slowops_destroy(slowops);
+}
+
+TEST( key_slowops_concurrent , "slowops: concurrent writers never tear a slot" ) {
+
+	slowops_client client;
+	as_slowops * slowops = slowops_client_init(&client, 64);
+	assert_not_null( slowops );
+
+	slowops_reader reader = { .as = &client.as, .stop = false, .read = 0, .torn = 0 };
+	pthread_t reader_thread;
+	assert_int_eq( pthread_create(&reader_thread, NULL, slowops_read, &reader), 0 );
+
+	pthread_t writers[SLOWOPS_THREADS];
+
+	for ( int i = 0; i < SLOWOPS_THREADS; i++ ) {
+		assert_int_eq( pthread_create(&writers[i], NULL, slowops_writer, slowops), 0 );
+	}
+
+	for ( int i = 0; i < SLOWOPS_THREADS; i++ ) {
+		pthread_join(writers[i], NULL);
+	}
+
+	reader.stop = true;
+	pthread_join(reader_thread, NULL);
+
+	info("read %u of %u operations", reader.read, SLOWOPS_THREADS * SLOWOPS_PER_THREAD);
+	assert_int_eq( reader.torn, 0 );
+
+	// Every slot left holds a whole operation.
+	as_error err;
+	as_slowop ops[64];
+	uint32_t n_ops = 64;
+	uint64_t cursor = 0;
+
+	as_status rc = aerospike_slowops_get(&client.as, &err, ops, &n_ops, &cursor);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	for ( uint32_t i = 0; i < n_ops; i++ ) {
+		assert_true( slowops_consistent(&ops[i]) );
+	}
+
+	as_slowops_destroy(slowops);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_slowops, "as_slowops ring tests" ) {
+	suite_add( key_slowops_ring );
+	suite_add( key_slowops_wrap );
+	suite_add( key_slowops_dropped );
+	suite_add( key_slowops_concurrent );
+}
@@ -22,6 +22,7 @@
 #include <aerospike/as_error.h>
 #include <aerospike/as_status.h>
 
+#include <aerospike/as_batch.h>
 #include <aerospike/as_query.h>
 #include <aerospike/as_record.h>
 #include <aerospike/as_integer.h>
@@ -34,6 +35,8 @@
 
 #include <aerospike/mod_lua.h>
 
+#include <pthread.h>
+
 #include "../test.h"
 #include "../util/udf.h"
 #include "../util/consumer_stream.h"
@@ -53,6 +56,7 @@ extern aerospike * as;
 
 #define NAMESPACE "test"
 #define SET "test"
+#define JOIN_SET "test_join"
 
 /******************************************************************************
  * STATIC FUNCTIONS
@@ -350,6 +354,174 @@ TEST( query_foreach_4, "sum(d) where b == 100 and d == 1" ) {
 	as_query_destroy(&q);
 }
 
+TEST( query_foreach_5, "sum(e) where a == 'abc' (parallel reduce)" ) {
+	
+	as_error err;
+	as_error_reset(&err);
+
+	int64_t value = 0;
+
+	as_policy_query p;
+	as_policy_query_init(&p);
+	p.parallel_reduce = true;
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 1);
+	as_query_where(&q, "a", string_equals("abc"));
+
+	as_query_apply(&q, UDF_FILE, "sum", NULL);
+
+	aerospike_query_foreach(as, &err, &p, &q, query_foreach_3_callback, &value);
+
+	if ( err.code != AEROSPIKE_OK ) {
+		 fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+	}
+
+	info("value: %ld", value);
+
+	assert_int_eq( err.code, AEROSPIKE_OK );
+	assert_int_eq( value, 24275 );
+
+	as_query_destroy(&q);
+}
+
+typedef struct join_check_s {
+	pthread_mutex_t lock;
+	int found;
+	int not_found;
+	int mismatched;
+} join_check;
+
+static bool query_join_callback(const as_record * rec, const as_batch_read * joined, void * udata) {
+	join_check * check = (join_check *) udata;
+	pthread_mutex_lock(&check->lock);
+	if ( joined->result == AEROSPIKE_OK ) {
+		check->found++;
+		if ( as_record_get_int64(rec, "c", -1) != as_record_get_int64(&joined->record, "id", -2) ) {
+			check->mismatched++;
+		}
+	}
+	else if ( joined->result == AEROSPIKE_ERR_RECORD_NOT_FOUND ) {
+		check->not_found++;
+	}
+	pthread_mutex_unlock(&check->lock);
+	return true;
+}
+
+TEST( query_foreach_join, "join where a == 'abc' on c to "JOIN_SET" keys" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	// Only even values of "c" have a record to join to.
+	for ( int i = 0; i < 100; i += 2 ) {
+		as_record r;
+		as_record_inita(&r, 1);
+		as_record_set_int64(&r, "id", i);
+
+		as_key key;
+		as_key_init_int64(&key, NAMESPACE, JOIN_SET, i);
+
+		aerospike_key_put(as, &err, NULL, &key, &r);
+		assert_int_eq( err.code, AEROSPIKE_OK );
+
+		as_record_destroy(&r);
+	}
+
+	join_check check = {
+		.found = 0,
+		.not_found = 0,
+		.mismatched = 0
+	};
+	pthread_mutex_init(&check.lock, NULL);
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 1);
+	as_query_where(&q, "a", string_equals("abc"));
+
+	// Small batches, so lookups run while the query does.
+	as_query_join join;
+	as_query_join_init(&join, NAMESPACE, JOIN_SET, "c");
+	join.batch_size = 7;
+
+	aerospike_query_join(as, &err, NULL, NULL, &q, &join, query_join_callback, &check);
+
+	pthread_mutex_destroy(&check.lock);
+	as_query_destroy(&q);
+
+	// Remove the records to join to, before any assertion can return.
+	for ( int i = 0; i < 100; i += 2 ) {
+		as_error rerr;
+		as_key key;
+		as_key_init_int64(&key, NAMESPACE, JOIN_SET, i);
+		aerospike_key_remove(as, &rerr, NULL, &key);
+		as_key_destroy(&key);
+	}
+
+	assert_int_eq( err.code, AEROSPIKE_OK );
+	assert_int_eq( check.found, 50 );
+	assert_int_eq( check.not_found, 50 );
+	assert_int_eq( check.mismatched, 0 );
+}
+
+typedef struct where_check_s {
+	pthread_mutex_t lock;
+	int count;
+	int mismatched;
+	bool ended;
+} where_check;
+
+static bool query_foreach_where2_callback(const as_val * v, void * udata) {
+	where_check * check = (where_check *) udata;
+	pthread_mutex_lock(&check->lock);
+	if ( v == NULL ) {
+		check->ended = true;
+	}
+	else {
+		as_record * rec = as_record_fromval(v);
+		int64_t c = as_record_get_int64(rec, "c", -1);
+		if ( c < 20 || c > 59 || c % 10 != 3 || as_record_numbins(rec) != 1 ) {
+			check->mismatched++;
+		}
+		check->count++;
+	}
+	pthread_mutex_unlock(&check->lock);
+	return true;
+}
+
+TEST( query_foreach_where2, "select c where c between 20 and 59 and d == 3" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	where_check check = { .count = 0, .mismatched = 0, .ended = false };
+	pthread_mutex_init(&check.lock, NULL);
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_select_inita(&q, 1);
+	as_query_select(&q, "c");
+
+	as_query_where_inita(&q, 2);
+	as_query_where(&q, "c", integer_range(20, 59));
+	as_query_where(&q, "d", integer_equals(3));
+
+	aerospike_query_foreach(as, &err, NULL, &q, query_foreach_where2_callback, &check);
+
+	pthread_mutex_destroy(&check.lock);
+	as_query_destroy(&q);
+
+	assert_int_eq( err.code, AEROSPIKE_OK );
+	assert_int_eq( check.count, 4 );
+	assert_int_eq( check.mismatched, 0 );
+	assert_true( check.ended );
+}
+
 /******************************************************************************
  * TEST SUITE
  *****************************************************************************/
@@ -364,4 +536,7 @@ SUITE( query_foreach, "aerospike_query_foreach tests" ) {
 	suite_add( query_foreach_2 );
 	suite_add( query_foreach_3 );
 	suite_add( query_foreach_4 );
+	suite_add( query_foreach_5 );
+	suite_add( query_foreach_join );
+	suite_add( query_foreach_where2 );
 }
@@ -22,7 +22,9 @@
 #include <aerospike/as_error.h>
 #include <aerospike/as_status.h>
 
+#include <aerospike/as_columns.h>
 #include <aerospike/as_record.h>
+#include <aerospike/as_scan_throttle.h>
 #include <aerospike/as_integer.h>
 #include <aerospike/as_string.h>
 #include <aerospike/as_list.h>
@@ -374,6 +376,70 @@ static void insert_data(int numrecs, const char *setname)
 }
 
 
+typedef struct scan_columns_check_s {
+	pthread_mutex_t lock;
+	bool failed;
+	bool done;
+	uint32_t count;
+	uint32_t batches;
+} scan_columns_check;
+
+static bool scan_columns_callback(as_columns * columns, const char * node, void * udata)
+{
+	scan_columns_check * check = (scan_columns_check *) udata;
+
+	if ( !columns ) {
+		check->done = true;
+		return true;
+	}
+
+	bool failed = columns->n_rows == 0 || columns->n_rows > columns->capacity || !node;
+
+	as_column * bin1 = &columns->columns[0];
+	as_column * bin2 = &columns->columns[1];
+	as_column * bin3 = &columns->columns[2];
+	as_column * missing = &columns->columns[3];
+
+	for ( uint32_t i = 0; i < columns->n_rows && !failed; i++ ) {
+		if ( !as_column_isvalid(bin1, i) || !as_column_isvalid(bin2, i) || !as_column_isvalid(bin3, i) ) {
+			error("Expected bin1, bin2 and bin3 in row %u", i);
+			failed = true;
+			break;
+		}
+
+		if ( as_column_isvalid(missing, i) ) {
+			error("Expected no value in row %u of a missing bin", i);
+			failed = true;
+			break;
+		}
+
+		char expected[SET_STRSZ];
+		sprintf(expected, "str-%s-%" PRId64, SET1, bin1->values[i]);
+
+		uint32_t len = bin2->offsets[i + 1] - bin2->offsets[i];
+		if ( len != strlen(expected) || memcmp(bin2->data + bin2->offsets[i], expected, len) != 0 ) {
+			error("Expected '%s' in bin2 of row %u", expected, i);
+			failed = true;
+			break;
+		}
+
+		if ( bin3->offsets[i + 1] == bin3->offsets[i] ) {
+			error("Expected msgpack in bin3 of row %u", i);
+			failed = true;
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&check->lock);
+	check->failed |= failed;
+	check->count += columns->n_rows;
+	check->batches++;
+	pthread_mutex_unlock(&check->lock);
+
+	as_columns_destroy(columns);
+	return true;
+}
+
 /******************************************************************************
  * TEST CASES
  *****************************************************************************/
@@ -464,6 +530,84 @@ TEST( scan_basics_set1_concurrent , "scan "SET1" concurrently" ) {
 	as_scan_destroy(&scan);
 }
 
+TEST( scan_basics_set1_throttle , "scan "SET1" concurrently with a throttle" ) {
+
+	scan_check check = {
+		.failed = false,
+		.set = SET1,
+		.count = 0,
+		.nobindata = false,
+		.bins = { "bin1", "bin2", "bin3", NULL },
+		.unique_tcount = 0
+	};
+
+	as_error err;
+
+	as_scan_throttle throttle;
+	as_scan_throttle_init(&throttle, NUM_RECS_SET1, 0);
+
+	as_policy_scan policy;
+	as_policy_scan_init(&policy);
+	policy.throttle = &throttle;
+
+	as_scan scan;
+	as_scan_init(&scan, NS, SET1);
+	as_scan_set_concurrent(&scan, true);
+
+	as_status rc = aerospike_scan_foreach(as, &err, &policy, &scan, scan_check_callback, &check);
+	
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_false( check.failed );
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+
+	// Lift the record limit and cap bytes instead.
+	as_scan_throttle_set(&throttle, 0, 1024 * 1024);
+	check.count = 0;
+
+	rc = aerospike_scan_foreach(as, &err, &policy, &scan, scan_check_callback, &check);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_false( check.failed );
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+
+	as_scan_destroy(&scan);
+	as_scan_throttle_destroy(&throttle);
+}
+
+TEST( scan_basics_set1_columns , "scan "SET1" concurrently into columns" ) {
+
+	scan_columns_check check = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.failed = false,
+		.done = false,
+		.count = 0,
+		.batches = 0
+	};
+
+	as_column_def defs[] = {
+		{ "bin1", AS_COLUMN_INT64 },
+		{ "bin2", AS_COLUMN_STRING },
+		{ "bin3", AS_COLUMN_BYTES },
+		{ "nobin", AS_COLUMN_INT64 }
+	};
+
+	as_error err;
+
+	as_scan scan;
+	as_scan_init(&scan, NS, SET1);
+	as_scan_set_concurrent(&scan, true);
+
+	as_status rc = aerospike_scan_columns(as, &err, NULL, &scan, defs, 4, 16, scan_columns_callback, &check);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_false( check.failed );
+	assert_true( check.done );
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+	assert_true( check.batches >= NUM_RECS_SET1 / 16 );
+
+	as_scan_destroy(&scan);
+}
+
 TEST( scan_basics_set1_select , "scan "SET1" and select 'bin1'" ) {
 
 	scan_check check = {
@@ -771,6 +915,8 @@ SUITE( scan_basics, "aerospike_scan basic tests" ) {
 	suite_add( scan_basics_null_set );
 	suite_add( scan_basics_set1 );
 	suite_add( scan_basics_set1_concurrent );
+	suite_add( scan_basics_set1_throttle );
+	suite_add( scan_basics_set1_columns );
 	suite_add( scan_basics_set1_select );
 	suite_add( scan_basics_set1_nodata );
 	suite_add( scan_basics_background );
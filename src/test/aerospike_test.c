@@ -190,14 +190,19 @@ PLAN( aerospike_test ) {
     plan_add( key_apply );
     plan_add( key_apply2 );
     plan_add( key_operate );
+    plan_add( key_multi );
+    plan_add( key_slowops );
+    plan_add( key_hotkeys );
     
     // aerospike_info module
     plan_add( info_basics );
+    plan_add( info_node );
 
     // aerospike_info module
     plan_add( udf_basics );
     plan_add( udf_types );
     plan_add( udf_record );
+    plan_add( udf_lua_cache );
 
     //aerospike_sindex module
     plan_add( index_basics );
@@ -215,6 +220,9 @@ PLAN( aerospike_test ) {
     plan_add( policy_read );
     plan_add( policy_scan );
 
+    // as_allocator module
+    plan_add( alloc_stats );
+
     // as_ldt module
     plan_add( ldt_lmap );
 
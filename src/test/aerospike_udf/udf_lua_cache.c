@@ -0,0 +1,227 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_lua_cache.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define POOL_THREADS 8
+#define POOL_PER_THREAD 20000
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct pool_user_s {
+	as_lua_pool * pool;
+	uint32_t hits;
+	uint32_t misses;
+} pool_user;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static uint32_t pool_idle(as_lua_pool * pool)
+{
+	return (uint32_t) pool->state;
+}
+
+static void * pool_run(void * udata)
+{
+	pool_user * user = (pool_user *) udata;
+
+	for ( int i = 0; i < POOL_PER_THREAD; i++ ) {
+		bool hit;
+		uint32_t ticket = as_lua_pool_take(user->pool, &hit);
+
+		if ( hit ) {
+			user->hits++;
+		}
+		else {
+			user->misses++;
+		}
+		as_lua_pool_put(user->pool, ticket);
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( udf_lua_cache_reuse , "lua pool: a returned state is reused" ) {
+
+	as_lua_pool pool;
+	memset(&pool, 0, sizeof(pool));
+
+	uint32_t gen = as_lua_pool_reset(&pool);
+	assert_int_ne( gen, 0 );
+	assert_int_eq( pool_idle(&pool), 0 );
+
+	// Nothing pooled yet, so both states are built.
+	bool hit;
+	uint32_t t1 = as_lua_pool_take(&pool, &hit);
+	assert_false( hit );
+	uint32_t t2 = as_lua_pool_take(&pool, &hit);
+	assert_false( hit );
+	assert_int_eq( t1, gen );
+	assert_int_eq( t2, gen );
+
+	assert_true( as_lua_pool_put(&pool, t1) );
+	assert_true( as_lua_pool_put(&pool, t2) );
+	assert_int_eq( pool_idle(&pool), 2 );
+
+	as_lua_pool_take(&pool, &hit);
+	assert_true( hit );
+	as_lua_pool_take(&pool, &hit);
+	assert_true( hit );
+	as_lua_pool_take(&pool, &hit);
+	assert_false( hit );
+	assert_int_eq( pool_idle(&pool), 0 );
+}
+
+TEST( udf_lua_cache_reload , "lua pool: states of a previous load are not pooled" ) {
+
+	as_lua_pool pool;
+	memset(&pool, 0, sizeof(pool));
+
+	// A module which was never loaded is not tracked.
+	bool hit;
+	assert_int_eq( as_lua_pool_take(&pool, &hit), 0 );
+	assert_false( hit );
+	assert_false( as_lua_pool_put(&pool, 0) );
+
+	as_lua_pool_reset(&pool);
+	uint32_t t1 = as_lua_pool_take(&pool, &hit);
+	assert_true( as_lua_pool_put(&pool, t1) );
+	uint32_t t2 = as_lua_pool_take(&pool, &hit);
+	assert_true( hit );
+
+	// Reload while a state is in use drops the pool.
+	as_lua_pool_put(&pool, as_lua_pool_take(&pool, &hit));
+	assert_int_eq( pool_idle(&pool), 1 );
+	uint32_t gen = as_lua_pool_reset(&pool);
+	assert_int_ne( gen, t2 );
+	assert_int_eq( pool_idle(&pool), 0 );
+
+	assert_false( as_lua_pool_put(&pool, t2) );
+	assert_int_eq( pool_idle(&pool), 0 );
+
+	as_lua_pool_take(&pool, &hit);
+	assert_false( hit );
+}
+
+TEST( udf_lua_cache_cap , "lua pool: idle states are capped at the mod_lua pool size" ) {
+
+	as_lua_pool pool;
+	memset(&pool, 0, sizeof(pool));
+	uint32_t gen = as_lua_pool_reset(&pool);
+
+	bool hit;
+	uint32_t n = AS_LUA_POOL_STATES_MAX + 5;
+
+	for ( uint32_t i = 0; i < n; i++ ) {
+		as_lua_pool_take(&pool, &hit);
+		assert_false( hit );
+	}
+
+	uint32_t pooled = 0;
+
+	for ( uint32_t i = 0; i < n; i++ ) {
+		if ( as_lua_pool_put(&pool, gen) ) {
+			pooled++;
+		}
+	}
+	assert_int_eq( pooled, AS_LUA_POOL_STATES_MAX );
+	assert_int_eq( pool_idle(&pool), AS_LUA_POOL_STATES_MAX );
+
+	// States closed by a full pool are never handed out again.
+	for ( uint32_t i = 0; i < AS_LUA_POOL_STATES_MAX; i++ ) {
+		as_lua_pool_take(&pool, &hit);
+		assert_true( hit );
+	}
+	as_lua_pool_take(&pool, &hit);
+	assert_false( hit );
+}
+
+TEST( udf_lua_cache_concurrent , "lua pool: every built state ends up idle" ) {
+
+	as_lua_pool pool;
+	memset(&pool, 0, sizeof(pool));
+	as_lua_pool_reset(&pool);
+
+	pool_user users[POOL_THREADS];
+	pthread_t threads[POOL_THREADS];
+
+	for ( int i = 0; i < POOL_THREADS; i++ ) {
+		users[i].pool = &pool;
+		users[i].hits = 0;
+		users[i].misses = 0;
+		assert_int_eq( pthread_create(&threads[i], NULL, pool_run, &users[i]), 0 );
+	}
+
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+
+	for ( int i = 0; i < POOL_THREADS; i++ ) {
+		pthread_join(threads[i], NULL);
+		hits += users[i].hits;
+		misses += users[i].misses;
+	}
+
+	// At most one state per thread is ever in use, and all were returned.
+	assert_int_eq( hits + misses, POOL_THREADS * POOL_PER_THREAD );
+	assert_true( misses <= POOL_THREADS );
+	assert_int_eq( pool_idle(&pool), misses );
+}
+
+TEST( udf_lua_cache_disabled , "lua cache: executions miss while the cache is disabled" ) {
+
+	// Tests run with as_config_lua.cache_enabled = false.
+	as_lua_cache_stats before;
+	as_lua_cache_get_stats(&before);
+
+	uint32_t ticket = as_lua_cache_reserve("client_stream_simple");
+	assert_int_eq( ticket, 0 );
+	as_lua_cache_release("client_stream_simple", ticket);
+
+	as_lua_cache_stats after;
+	as_lua_cache_get_stats(&after);
+
+	assert_int_eq( after.hits, before.hits );
+	assert_int_eq( after.misses, before.misses + 1 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( udf_lua_cache, "client Lua state cache accounting" ) {
+	suite_add( udf_lua_cache_reuse );
+	suite_add( udf_lua_cache_reload );
+	suite_add( udf_lua_cache_cap );
+	suite_add( udf_lua_cache_concurrent );
+	suite_add( udf_lua_cache_disabled );
+}
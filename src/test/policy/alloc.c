@@ -0,0 +1,172 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_allocator.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+// Calls of the test allocator for scan allocations. Other subsystems may
+// allocate from client threads while the test runs.
+static uint32_t g_scan_allocs = 0;
+static uint32_t g_scan_frees = 0;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void * alloc_test_malloc(size_t size, as_alloc_tag tag, void * udata)
+{
+	if ( tag == AS_ALLOC_TAG_SCAN ) {
+		__sync_fetch_and_add(&g_scan_allocs, 1);
+	}
+	return malloc(size);
+}
+
+static void alloc_test_free(void * ptr, as_alloc_tag tag, void * udata)
+{
+	if ( tag == AS_ALLOC_TAG_SCAN ) {
+		__sync_fetch_and_add(&g_scan_frees, 1);
+	}
+	free(ptr);
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( alloc_stats_count , "stats: allocs, frees and bytes of one subsystem" )
+{
+	as_allocator_configure(NULL, true);
+
+	as_alloc_stats before;
+	as_alloc_stats_get(AS_ALLOC_TAG_SCAN, &before);
+
+	void * a = as_alloc_malloc(AS_ALLOC_TAG_SCAN, 10);
+	void * b = as_alloc_malloc(AS_ALLOC_TAG_SCAN, 100);
+	void * c = as_alloc_malloc(AS_ALLOC_TAG_SCAN, 1000);
+	assert_not_null(a);
+	assert_not_null(b);
+	assert_not_null(c);
+
+	// Memory is usable and blocks don't overlap their headers.
+	memset(a, 1, 10);
+	memset(b, 2, 100);
+	memset(c, 3, 1000);
+
+	as_alloc_stats stats;
+	as_alloc_stats_get(AS_ALLOC_TAG_SCAN, &stats);
+	assert_int_eq(stats.allocs - before.allocs, 3);
+	assert_int_eq(stats.frees - before.frees, 0);
+	assert_int_eq(stats.bytes - before.bytes, 1110);
+	assert_int_eq(stats.live_bytes - before.live_bytes, 1110);
+
+	as_alloc_free(b);
+	as_alloc_free(NULL);
+
+	as_alloc_stats_get(AS_ALLOC_TAG_SCAN, &stats);
+	assert_int_eq(stats.allocs - before.allocs, 3);
+	assert_int_eq(stats.frees - before.frees, 1);
+	assert_int_eq(stats.bytes - before.bytes, 1110);
+	assert_int_eq(stats.live_bytes - before.live_bytes, 1010);
+
+	as_alloc_free(a);
+	as_alloc_free(c);
+
+	as_alloc_stats_get(AS_ALLOC_TAG_SCAN, &stats);
+	assert_int_eq(stats.frees - before.frees, 3);
+	assert_int_eq(stats.live_bytes, before.live_bytes);
+}
+
+TEST( alloc_stats_tags , "stats: allocations are counted under their own tag only" )
+{
+	as_allocator_configure(NULL, true);
+
+	as_alloc_stats scan_before;
+	as_alloc_stats query_before;
+	as_alloc_stats_get(AS_ALLOC_TAG_SCAN, &scan_before);
+	as_alloc_stats_get(AS_ALLOC_TAG_QUERY, &query_before);
+
+	void * p = as_alloc_malloc(AS_ALLOC_TAG_QUERY, 64);
+	assert_not_null(p);
+
+	as_alloc_stats scan;
+	as_alloc_stats query;
+	as_alloc_stats_get(AS_ALLOC_TAG_SCAN, &scan);
+	as_alloc_stats_get(AS_ALLOC_TAG_QUERY, &query);
+
+	as_alloc_free(p);
+
+	assert_int_eq(query.allocs - query_before.allocs, 1);
+	assert_int_eq(query.live_bytes - query_before.live_bytes, 64);
+	assert_int_eq(scan.allocs, scan_before.allocs);
+	assert_int_eq(scan.live_bytes, scan_before.live_bytes);
+
+	// Invalid tags report nothing.
+	as_alloc_stats invalid;
+	as_alloc_stats_get(AS_ALLOC_TAG_MAX, &invalid);
+	assert_int_eq(invalid.allocs, 0);
+	assert_string_eq(as_alloc_tag_name(AS_ALLOC_TAG_SCAN), "scan");
+	assert_string_eq(as_alloc_tag_name(AS_ALLOC_TAG_MAX), "unknown");
+}
+
+TEST( alloc_stats_custom , "custom allocator: called with the tag of each block" )
+{
+	// The allocator stays installed for the process. It only wraps malloc().
+	as_allocator allocator = {
+		.alloc_fn = alloc_test_malloc,
+		.free_fn = alloc_test_free,
+		.udata = NULL
+	};
+	as_allocator_configure(&allocator, true);
+
+	uint32_t allocs = g_scan_allocs;
+	uint32_t frees = g_scan_frees;
+
+	as_alloc_stats before;
+	as_alloc_stats_get(AS_ALLOC_TAG_SCAN, &before);
+
+	void * p = as_alloc_malloc(AS_ALLOC_TAG_SCAN, 32);
+	assert_not_null(p);
+	assert_int_eq(g_scan_allocs - allocs, 1);
+
+	as_alloc_free(p);
+	assert_int_eq(g_scan_frees - frees, 1);
+
+	// Statistics are kept for custom allocators too.
+	as_alloc_stats stats;
+	as_alloc_stats_get(AS_ALLOC_TAG_SCAN, &stats);
+	assert_int_eq(stats.allocs - before.allocs, 1);
+	assert_int_eq(stats.frees - before.frees, 1);
+	assert_int_eq(stats.live_bytes, before.live_bytes);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( alloc_stats, "as_allocator tests" )
+{
+	suite_add( alloc_stats_count );
+	suite_add( alloc_stats_tags );
+	suite_add( alloc_stats_custom );
+}